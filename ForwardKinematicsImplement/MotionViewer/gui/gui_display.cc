@@ -15,6 +15,7 @@
 #include "render_utils.h"
 #include "kinematics_forward.h"
 #include "kinematics_pose.h"
+#include "kinematics_capsule_track.h"
 
 namespace gui {
 
@@ -151,6 +152,40 @@ void Display::Save()
     motion_coll_->at(0).WriteAmcFile("save.amc", acclaim::MoCapScale());
 }
 
+bool Display::ExportCapsuleTrack(const std::string &file_name)
+{
+    const int32_t skeleton_idx = 0;
+    if (this->SkeletonNum() == 0 || this->IsEmptyMotion(skeleton_idx))
+    {
+        LOGWARN << "No motion to export" << std::endl;
+        return FALSE;
+    }
+
+    // the root offset as Show() applies it: translate, then rotate about x, y and z (degrees)
+    const Vector6d_t &root_offset = skeleton_root_offset_coll_->at(skeleton_idx);
+    RotMat_t root_rotation
+        = math::ComputeRotMatX(math::ToRadian(root_offset.AngularVector().x()))
+        * math::ComputeRotMatY(math::ToRadian(root_offset.AngularVector().y()))
+        * math::ComputeRotMatZ(math::ToRadian(root_offset.AngularVector().z()));
+    Vector3d_t root_translation = root_offset.LinearVector() * acclaim::MoCapScale();
+
+    // the viewer advances frame_increment frames every time_step seconds
+    double frame_time = param::ConfigValue<double>("time_step")
+        / param::ConfigValue<int32_t>("frame_increment");
+
+    fk_coll_->at(skeleton_idx).set_motion(motion_coll_->at(skeleton_idx));
+    return kinematics::WriteCapsuleTrack(
+            fk_coll_->at(skeleton_idx),
+            skeleton_coll_->at(skeleton_idx),
+            motion_coll_->at(skeleton_idx).frame_num(),
+            frame_time,
+            param::ConfigValue<double>("capsule_radius"),
+            root_rotation,
+            root_translation,
+            file_name
+            );
+}
+
 void Display::Reset()
 {
     skeleton_coll_->clear();
@@ -138,6 +138,13 @@ public:
      * \brief
      */
     void Save();
+    /**
+     * \brief Write the bones of the first skeleton over its whole motion as
+     * capsules for the cloth simulation, see kinematics::WriteCapsuleTrack
+     * \param[in] file_name
+     * \return FALSE if there is no motion to export or the file cannot be written
+     */
+    bool ExportCapsuleTrack(const std::string &file_name);
     /**
      * \brief
      */
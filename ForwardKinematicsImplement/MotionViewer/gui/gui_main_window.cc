@@ -141,7 +141,8 @@ void MainWindow::InitButton()
         ("pause", 155, 525, 35, 25, "@||")
         ("play", 195, 525, 35, 25, "@>")
         ("rewind", 75, 525, 35, 25, "@|<")
-        ("repeat", 235, 525, 35, 25, "@<->");
+        ("repeat", 235, 525, 35, 25, "@<->")
+        ("export_capsule", 655, 440, 90, 25, "Capsules");
     //("slerp", 535, 500, 100, 30,       "Slerp")
     //("save",   x,   y,   w,  h,        "Save")
     
@@ -157,6 +158,7 @@ void MainWindow::InitButton()
             { "pause", &MainWindow::PauseSlot },
             { "play", &MainWindow::PlaySlot },
             { "repeat", &MainWindow::RepeatSlot },
+            { "export_capsule", &MainWindow::ExportCapsuleSlot },
             //{"slerp", &MainWindow::slerpSlot},
         }
     );
@@ -471,6 +473,21 @@ void MainWindow::SaveSlot(Fl_Widget *widget)
     display_->Save();
 }
 
+void MainWindow::ExportCapsuleSlot(Fl_Widget *widget)
+{
+    const char *track_file_name = fl_file_chooser(
+            "Save capsule track",
+            "*.txt",
+            "../acclaim_file/capsule_track.txt"
+            );
+    if (nullptr == track_file_name)
+    {
+        return;
+    }
+
+    display_->ExportCapsuleTrack(std::string(track_file_name));
+}
+
 void MainWindow::RewindSlot(Fl_Widget *widget)
 {
     this->PlaySlot(widget);
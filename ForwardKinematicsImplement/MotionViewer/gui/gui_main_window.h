@@ -128,6 +128,11 @@ private:
      * \brief Callback (slot) function of the "Save" button (signal)
      */
     void SaveSlot(Fl_Widget *widget);
+    /**
+     * \brief Callback (slot) function of the "Capsules" button (signal),
+     * exports the bone capsules of the playing motion for the cloth simulation
+     */
+    void ExportCapsuleSlot(Fl_Widget *widget);
     /**
      * \brief Callback (slot) function of the "@|<" (rewind) button (signal)
      */
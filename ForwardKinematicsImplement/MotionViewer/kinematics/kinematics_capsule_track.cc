@@ -0,0 +1,64 @@
+#include "kinematics_capsule_track.h"
+#include <fstream>
+#include <iomanip>
+#include "console_log.h"
+#include "acclaim_skeleton.h"
+#include "kinematics_forward.h"
+#include "kinematics_pose.h"
+
+namespace kinematics {
+
+bool WriteCapsuleTrack(
+        Forward &forward,
+        const acclaim::Skeleton &skeleton,
+        const int32_t frame_num,
+        const double frame_time,
+        const double radius,
+        const RotMat_t &root_rotation,
+        const Vector3d_t &root_translation,
+        const std::string &file_name
+        )
+{
+    std::ofstream output_stream(file_name);
+    if (output_stream.fail())
+    {
+        LOGERR << "Failed to open " << file_name << std::endl;
+        return FALSE;
+    }
+
+    const int32_t bone_num = skeleton.bone_num();
+
+    // header lines
+    output_stream << std::setprecision(6) << std::fixed;
+    output_stream << "capsule_track 1" << '\n';
+    output_stream << "bone_num " << bone_num << '\n';
+    output_stream << "frame_num " << frame_num << '\n';
+    output_stream << "frame_time " << frame_time << '\n';
+    for (int32_t bone_idx = 0; bone_idx < bone_num; ++bone_idx)
+    {
+        output_stream << "bone " << skeleton.BoneName(bone_idx) << " " << radius << '\n';
+    }
+
+    for (int32_t frame_idx = 0; frame_idx < frame_num; ++frame_idx)
+    {
+        PoseColl_t pose_coll = forward.ComputeSkeletonPose(frame_idx);
+
+        output_stream << "frame " << frame_idx << '\n';
+        for (int32_t bone_idx = 0; bone_idx < bone_num; ++bone_idx)
+        {
+            // same transform as the root offset applied before the skeleton is drawn
+            Vector3d_t start_pos = root_rotation * pose_coll[bone_idx].start_pos() + root_translation;
+            Vector3d_t end_pos = root_rotation * pose_coll[bone_idx].end_pos() + root_translation;
+            output_stream
+                << start_pos.x() << " " << start_pos.y() << " " << start_pos.z() << " "
+                << end_pos.x() << " " << end_pos.y() << " " << end_pos.z() << '\n';
+        }
+    }
+
+    output_stream.close();
+    LOGMSG << frame_num << " frames of " << bone_num << " capsules are written to " << file_name << std::endl;
+
+    return TRUE;
+}
+
+} // namespace kinematics {
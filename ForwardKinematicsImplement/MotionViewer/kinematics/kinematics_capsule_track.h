@@ -0,0 +1,50 @@
+#ifndef _KINEMATICS_CAPSULE_TRACK_H_
+#define _KINEMATICS_CAPSULE_TRACK_H_
+
+#include <string>
+#include "kinematics_type.h"
+#include "math_type.h"
+
+namespace acclaim {
+class Skeleton;
+} // namespace acclaim {
+
+namespace kinematics {
+
+class Forward;
+
+/**
+ * \brief Write the animated bones of a skeleton as a capsule track, a plain
+ * text file read by the mass-spring system's character collider
+ *
+ * Every bone becomes a capsule of the given radius around the segment from
+ * its start to its end position. The file holds a header ("capsule_track 1",
+ * "bone_num", "frame_num", "frame_time"), one "bone <name> <radius>" line per
+ * bone and then, for every frame, a "frame <idx>" line followed by one
+ * "sx sy sz ex ey ez" line per bone. Positions are in meters after the root
+ * offset is applied, the same space the skeleton is drawn in.
+ *
+ * \param[in] forward FK solver with the skeleton and the motion already set
+ * \param[in] skeleton
+ * \param[in] frame_num Number of frames to sample, starting at frame 0
+ * \param[in] frame_time Seconds between two frames
+ * \param[in] radius Capsule radius of every bone
+ * \param[in] root_rotation Rotation of the root offset
+ * \param[in] root_translation Translation of the root offset, in meters
+ * \param[in] file_name
+ * \return FALSE if the file cannot be written
+ */
+bool WriteCapsuleTrack(
+        Forward &forward,
+        const acclaim::Skeleton &skeleton,
+        const int32_t frame_num,
+        const double frame_time,
+        const double radius,
+        const RotMat_t &root_rotation,
+        const Vector3d_t &root_translation,
+        const std::string &file_name
+        );
+
+} // namespace kinematics {
+
+#endif // #ifndef _KINEMATICS_CAPSULE_TRACK_H_
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <float.h>
+#include <cmath>
+#include "CIntegratorBench.h"
+#include "performanceCounter.h"
+
+#pragma warning(disable:4996)
+
+namespace
+{
+    const double s_cdDivergedError = 10.0;  // RMS meters, the net has flown apart
+    const int s_ciIntegratorNum = CMassSpringSystem::PROJECTIVE_DYNAMICS + 1;
+
+    inline bool IsFinite(const double a_cdValue)
+    {
+        // NaN fails both comparisons
+        return a_cdValue > -DBL_MAX && a_cdValue < DBL_MAX;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Constructor                                 //
+////////////////////////////////////////////////////////////////////////////////
+CIntegratorBench::CIntegratorBench()
+    :m_dDuration(1.0),
+    m_iCheckpointNum(10),
+    m_iReferenceIntegrator(CMassSpringSystem::RUNGE_KUTTA),
+    m_dReferenceDeltaT(0.0001),
+    m_DeltaT(),
+    m_Results()
+{
+    const double cadDeltaT[] = { 0.0002, 0.0005, 0.001, 0.002, 0.005, 0.01 };
+    m_DeltaT.assign(cadDeltaT, cadDeltaT + sizeof(cadDeltaT)/sizeof(cadDeltaT[0]));
+}
+
+const char *CIntegratorBench::GetScenarioName(const enScenario_t a_cScenario)
+{
+    static const char *s_pcScenarioName[Scenario_nCount] = { "Settle", "BallImpact", "BallPile" };
+    return s_pcScenarioName[a_cScenario];
+}
+
+const char *CIntegratorBench::GetIntegratorName(const int a_ciIntegrator)
+{
+    static const char *s_pcIntegratorName[s_ciIntegratorNum] = { "ExplicitEuler", "RungeKutta", "ProjectiveDynamics" };
+    return (a_ciIntegrator >= 0 && a_ciIntegrator < s_ciIntegratorNum) ? s_pcIntegratorName[a_ciIntegrator] : "Unknown";
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Run                                     //
+////////////////////////////////////////////////////////////////////////////////
+void CIntegratorBench::Run(const CMassSpringSystem &a_rcSystem)
+{
+    m_Results.clear();
+    for(int iScenario = 0 ; iScenario<Scenario_nCount ; iScenario++)
+    {
+        const enScenario_t cScenario = (enScenario_t)iScenario;
+        Trajectory reference;
+        Result referenceResult;
+        printf("[Bench] %s, reference %s at dt %g\n", GetScenarioName(cScenario), GetIntegratorName(m_iReferenceIntegrator), m_dReferenceDeltaT);
+        if(!Simulate(a_rcSystem, cScenario, m_iReferenceIntegrator, m_dReferenceDeltaT, reference, referenceResult))
+        {
+            printf("[Warning] CIntegratorBench::Run, the reference of %s diverged, scenario skipped\n", GetScenarioName(cScenario));
+            continue;
+        }
+
+        for(int iIntegrator = 0 ; iIntegrator<s_ciIntegratorNum ; iIntegrator++)
+        {
+            for(size_t uiT = 0 ; uiT<m_DeltaT.size() ; uiT++)
+            {
+                if(m_DeltaT[uiT] > m_dDuration/m_iCheckpointNum)
+                {
+                    continue;   // would not land on the checkpoints
+                }
+                Trajectory trajectory;
+                Result result;
+                if(Simulate(a_rcSystem, cScenario, iIntegrator, m_DeltaT[uiT], trajectory, result))
+                {
+                    Compare(reference, trajectory, result);
+                }
+                m_Results.push_back(result);
+            }
+        }
+    }
+    MarkPareto();
+}
+
+void CIntegratorBench::Setup(CMassSpringSystem &a_rSystem, const enScenario_t a_cScenario) const
+{
+    // nothing random and nothing but the net and the balls
+    a_rSystem.Reset();
+    a_rSystem.SetEmitterEnable(false);
+    a_rSystem.SetCharacterEnable(false);
+    a_rSystem.SetAutoRecover(false);
+    a_rSystem.SetStartSimulation();
+
+    const Vector3d initPos = a_rSystem.GetGoalNet().GetInitPos();
+    const double cdRoof = initPos.y + 0.5*a_rSystem.GetGoalNet().GetHeight();
+    if(a_cScenario == Scenario_nBallImpact)
+    {
+        // the throw of CreateBall() without the random offsets
+        Vector3d ballPos = initPos + Vector3d(7.0, 1.0, 0.0);
+        a_rSystem.CreateBall(ballPos, (initPos - ballPos)*7.0);
+    }
+    else if(a_cScenario == Scenario_nBallPile)
+    {
+        for(int iLayer = 0 ; iLayer<2 ; iLayer++)
+        {
+            for(int iX = -1 ; iX<=1 ; iX++)
+            {
+                for(int iZ = -1 ; iZ<=1 ; iZ++)
+                {
+                    a_rSystem.CreateBall(initPos + Vector3d(0.6*iX, cdRoof - initPos.y + 1.0 + 0.7*iLayer, 1.2*iZ), Vector3d::ZERO);
+                }
+            }
+        }
+    }
+}
+
+bool CIntegratorBench::MatchesSource(const CMassSpringSystem &a_rcSource, CMassSpringSystem &a_rSystem) const
+{
+    GoalNet &rGoalNet = a_rSystem.GetGoalNet();
+    for(int iS = 0 ; iS<rGoalNet.SpringNum() ; iS++)
+    {
+        CSpring &rSpring = rGoalNet.GetSpring(iS);
+        const CSpring::enType_t cType = rSpring.GetSpringType();
+        if(rSpring.GetSpringCoef() != a_rcSource.GetSpringCoef(cType) || rSpring.GetDamperCoef() != a_rcSource.GetDamperCoef(cType))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CIntegratorBench::Simulate(
+    const CMassSpringSystem &a_rcSystem,
+    const enScenario_t a_cScenario,
+    const int a_ciIntegrator,
+    const double a_cdDeltaT,
+    Trajectory &a_rTrajectory,
+    Result &a_rResult
+    ) const
+{
+    CMassSpringSystem system(a_rcSystem);
+    Setup(system, a_cScenario);
+    if(!MatchesSource(a_rcSystem, system))
+    {
+        printf("[Warning] CIntegratorBench::Simulate, the net of the copy lost the spring coefficients of the system, run skipped\n");
+        return false;
+    }
+
+    // a whole number of steps between two checkpoints
+    const double cdInterval = m_dDuration/m_iCheckpointNum;
+    int iStepPerCheckpoint = (int)floor(cdInterval/a_cdDeltaT + 0.5);
+    iStepPerCheckpoint = (iStepPerCheckpoint > 0) ? iStepPerCheckpoint : 1;
+    system.SetIntegratorType(a_ciIntegrator);
+    system.SetDeltaT(cdInterval/iStepPerCheckpoint);
+
+    a_rResult.nScenario = a_cScenario;
+    a_rResult.iIntegrator = a_ciIntegrator;
+    a_rResult.dDeltaT = cdInterval/iStepPerCheckpoint;
+    a_rResult.iStepNum = 0;
+    a_rResult.dPositionError = DBL_MAX;
+    a_rResult.dEnergyError = DBL_MAX;
+    a_rResult.dWallPerSimSecond = 0.0;
+    a_rResult.bDiverged = false;
+    a_rResult.bPareto = false;
+
+    GoalNet &rGoalNet = system.GetGoalNet();
+    PerformanceCounter counter;
+    double dWall = 0.0;
+    a_rTrajectory.Position.resize(m_iCheckpointNum);
+    a_rTrajectory.Energy.resize(m_iCheckpointNum);
+    for(int iC = 0 ; iC<m_iCheckpointNum ; iC++)
+    {
+        counter.StartCounter();
+        for(int iS = 0 ; iS<iStepPerCheckpoint ; iS++)
+        {
+            system.SimulationOneTimeStep();
+        }
+        counter.StopCounter();
+        dWall += counter.GetElapsedTime();
+        a_rResult.iStepNum += iStepPerCheckpoint;
+
+        std::vector<Vector3d> &rPosition = a_rTrajectory.Position[iC];
+        rPosition.resize(rGoalNet.ParticleNum() + system.BallNum());
+        for(int iP = 0 ; iP<rGoalNet.ParticleNum() ; iP++)
+        {
+            rPosition[iP] = rGoalNet.GetParticle(iP).GetPosition();
+        }
+        for(int iB = 0 ; iB<system.BallNum() ; iB++)
+        {
+            rPosition[rGoalNet.ParticleNum() + iB] = system.GetBall(iB).GetPosition();
+        }
+        a_rTrajectory.Energy[iC] = system.MeasureEnergy();
+        if(!IsFinite(a_rTrajectory.Energy[iC]))
+        {
+            a_rResult.bDiverged = true;
+            break;
+        }
+    }
+    a_rResult.dWallPerSimSecond = 1000.0*dWall/(a_rResult.iStepNum*a_rResult.dDeltaT);
+    return !a_rResult.bDiverged;
+}
+
+void CIntegratorBench::Compare(const Trajectory &a_rcReference, const Trajectory &a_rcTrajectory, Result &a_rResult) const
+{
+    a_rResult.dPositionError = 0.0;
+    a_rResult.dEnergyError = 0.0;
+    for(int iC = 0 ; iC<m_iCheckpointNum ; iC++)
+    {
+        const std::vector<Vector3d> &rcReference = a_rcReference.Position[iC];
+        const std::vector<Vector3d> &rcPosition = a_rcTrajectory.Position[iC];
+        double dSum = 0.0;
+        for(size_t uiP = 0 ; uiP<rcReference.size() ; uiP++)
+        {
+            dSum += (rcPosition[uiP] - rcReference[uiP]).SquaredLength();
+        }
+        double dRms = rcReference.empty() ? 0.0 : sqrt(dSum/rcReference.size());
+        double dEnergy = fabs(a_rcTrajectory.Energy[iC] - a_rcReference.Energy[iC]);
+        a_rResult.dPositionError = (dRms > a_rResult.dPositionError) ? dRms : a_rResult.dPositionError;
+        a_rResult.dEnergyError = (dEnergy > a_rResult.dEnergyError) ? dEnergy : a_rResult.dEnergyError;
+    }
+    if(!IsFinite(a_rResult.dPositionError) || a_rResult.dPositionError > s_cdDivergedError)
+    {
+        a_rResult.bDiverged = true;
+    }
+}
+
+void CIntegratorBench::MarkPareto()
+{
+    for(size_t uiI = 0 ; uiI<m_Results.size() ; uiI++)
+    {
+        Result &rResult = m_Results[uiI];
+        if(rResult.bDiverged)
+        {
+            continue;
+        }
+        rResult.bPareto = true;
+        for(size_t uiJ = 0 ; uiJ<m_Results.size() && rResult.bPareto ; uiJ++)
+        {
+            const Result &rcOther = m_Results[uiJ];
+            if(uiJ == uiI || rcOther.bDiverged || rcOther.nScenario != rResult.nScenario)
+            {
+                continue;
+            }
+            bool bNoWorse = rcOther.dPositionError <= rResult.dPositionError && rcOther.dWallPerSimSecond <= rResult.dWallPerSimSecond;
+            bool bBetter = rcOther.dPositionError < rResult.dPositionError || rcOther.dWallPerSimSecond < rResult.dWallPerSimSecond;
+            if(bNoWorse && bBetter)
+            {
+                rResult.bPareto = false;
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Output                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CIntegratorBench::Print() const
+{
+    printf("%-10s  %-18s  %9s  %12s  %12s  %12s  %s\n", "scenario", "integrator", "dt", "pos err [m]", "energy [J]", "ms/sim s", "");
+    for(size_t uiI = 0 ; uiI<m_Results.size() ; uiI++)
+    {
+        const Result &rcResult = m_Results[uiI];
+        if(rcResult.bDiverged)
+        {
+            printf("%-10s  %-18s  %9.6f  %12s  %12s  %12.1f\n", GetScenarioName(rcResult.nScenario), GetIntegratorName(rcResult.iIntegrator),
+                rcResult.dDeltaT, "diverged", "-", rcResult.dWallPerSimSecond);
+            continue;
+        }
+        printf("%-10s  %-18s  %9.6f  %12.3e  %12.3e  %12.1f  %s\n", GetScenarioName(rcResult.nScenario), GetIntegratorName(rcResult.iIntegrator),
+            rcResult.dDeltaT, rcResult.dPositionError, rcResult.dEnergyError, rcResult.dWallPerSimSecond, rcResult.bPareto ? "pareto" : "");
+    }
+}
+
+bool CIntegratorBench::WriteCsv(const std::string &a_rcsFilename) const
+{
+    FILE *pFile = fopen(a_rcsFilename.c_str(), "w");
+    if(pFile == NULL)
+    {
+        printf("[Error] CIntegratorBench::WriteCsv, can not open %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+    fprintf(pFile, "scenario,integrator,dt,steps,position_error_m,energy_error_j,wall_ms_per_sim_s,diverged,pareto\n");
+    for(size_t uiI = 0 ; uiI<m_Results.size() ; uiI++)
+    {
+        const Result &rcResult = m_Results[uiI];
+        fprintf(pFile, "%s,%s,%.8g,%d,%.6e,%.6e,%.4f,%d,%d\n", GetScenarioName(rcResult.nScenario), GetIntegratorName(rcResult.iIntegrator),
+            rcResult.dDeltaT, rcResult.iStepNum, rcResult.dPositionError, rcResult.dEnergyError, rcResult.dWallPerSimSecond,
+            rcResult.bDiverged ? 1 : 0, rcResult.bPareto ? 1 : 0);
+    }
+    fclose(pFile);
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef CINTEGRATORBENCH_H
+#define CINTEGRATORBENCH_H
+
+#include <vector>
+#include <string>
+#include "Vector3d.h"
+#include "CMassSpringSystem.h"
+
+/*
+ * Accuracy against cost of the integrators. Every scenario is run with
+ * every integrator over a range of time steps and compared at a few
+ * checkpoints with a reference run at a tiny step: the RMS distance of
+ * the net particles and balls, and the difference of the total energy.
+ * The cost is the wall time per simulated second. A run is on the
+ * Pareto front of its scenario when no other stable run of the scenario
+ * is both more accurate and cheaper.
+ */
+class CIntegratorBench
+{
+    public:
+        typedef enum
+        {
+            Scenario_nSettle = 0,       // the net sags under gravity
+            Scenario_nBallImpact,       // one ball shot into the net
+            Scenario_nBallPile,         // two layers of balls dropped on the roof
+            Scenario_nCount
+        } enScenario_t;
+
+        struct Result
+        {
+            enScenario_t nScenario;
+            int iIntegrator;
+            double dDeltaT;             // adjusted to land on the checkpoints
+            int iStepNum;
+            double dPositionError;      // worst RMS distance to the reference over the checkpoints, in meter
+            double dEnergyError;        // worst energy difference to the reference, in joule
+            double dWallPerSimSecond;   // in milliseconds
+            bool bDiverged;
+            bool bPareto;
+        };
+
+        CIntegratorBench();
+
+        inline void SetDuration(const double a_cdDuration){ m_dDuration = a_cdDuration; }  // simulated seconds per run
+        inline void SetCheckpointNum(const int a_ciCheckpointNum){ m_iCheckpointNum = (a_ciCheckpointNum > 0) ? a_ciCheckpointNum : 1; }
+        inline void SetReference(const int a_ciIntegrator, const double a_cdDeltaT){ m_iReferenceIntegrator = a_ciIntegrator; m_dReferenceDeltaT = a_cdDeltaT; }
+        inline void ClearDeltaT(){ m_DeltaT.clear(); }
+        inline void AddDeltaT(const double a_cdDeltaT){ m_DeltaT.push_back(a_cdDeltaT); }
+
+        // every run starts from a copy of the system, its net and coefficients are the ones benchmarked
+        void Run(const CMassSpringSystem &a_rcSystem);
+        void Print() const;
+        bool WriteCsv(const std::string &a_rcsFilename) const;
+        inline const std::vector<Result> &GetResults() const { return m_Results; }
+
+        static const char *GetScenarioName(const enScenario_t a_cScenario);
+        static const char *GetIntegratorName(const int a_ciIntegrator);
+
+    private:
+        struct Trajectory
+        {
+            std::vector<std::vector<Vector3d> > Position;   // net particles then balls, per checkpoint
+            std::vector<double> Energy;
+        };
+
+        void Setup(CMassSpringSystem &a_rSystem, const enScenario_t a_cScenario) const;
+        bool MatchesSource(const CMassSpringSystem &a_rcSource, CMassSpringSystem &a_rSystem) const;   // the net carries the coefficients of the source
+        bool Simulate(
+            const CMassSpringSystem &a_rcSystem,
+            const enScenario_t a_cScenario,
+            const int a_ciIntegrator,
+            const double a_cdDeltaT,
+            Trajectory &a_rTrajectory,
+            Result &a_rResult
+            ) const;
+        void Compare(const Trajectory &a_rcReference, const Trajectory &a_rcTrajectory, Result &a_rResult) const;
+        void MarkPareto();
+
+        double m_dDuration;
+        int m_iCheckpointNum;
+        int m_iReferenceIntegrator;
+        double m_dReferenceDeltaT;
+        std::vector<double> m_DeltaT;
+        std::vector<Result> m_Results;
+};
+
+#endif
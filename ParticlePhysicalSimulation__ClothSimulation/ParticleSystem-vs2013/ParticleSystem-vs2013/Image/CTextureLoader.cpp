@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <direct.h>
+#else
+    #include <sys/types.h>
+#endif
+#include "CBmp.h"
+#include "CThreadPool.h"
+#include "CTextureLoader.h"
+#include "glut.h"
+
+#pragma warning(disable:4996)
+
+namespace
+{
+    const char s_ccMipMagic[4] = { 'M', 'I', 'P', 'C' };
+    const int s_ciMipVersion = 1;
+
+    struct MipCacheHeader
+    {
+        char acMagic[4];
+        int iVersion;
+        long long llSourceSize;
+        long long llSourceTime;
+        int iWidth;
+        int iHeight;
+        int iLevelNum;
+        int iReserved;
+    };
+
+    void MakeDirectory(const std::string &a_rcsDirectory)
+    {
+#ifdef _WIN32
+        _mkdir(a_rcsDirectory.c_str());
+#else
+        mkdir(a_rcsDirectory.c_str(), 0755);
+#endif
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CTextureLoader::CTextureLoader()
+    :m_sCacheDirectory("Texture/Cache"),
+    m_iRequestNum(0),
+    m_iUploadNum(0)
+{
+}
+
+CTextureLoader::~CTextureLoader()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    for(size_t uiI = 0 ; uiI<m_Finished.size() ; uiI++)
+    {
+        delete m_Finished[uiI];
+    }
+    m_Finished.clear();
+}
+
+void CTextureLoader::SetCacheDirectory(const std::string &a_rcsDirectory)
+{
+    m_sCacheDirectory = a_rcsDirectory;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Request                                  //
+////////////////////////////////////////////////////////////////////////////////
+void CTextureLoader::Request(const int a_ciSlot, const std::string &a_rcsPath)
+{
+    if(m_iRequestNum == 0)
+    {
+        MakeDirectory(m_sCacheDirectory);
+    }
+    ++m_iRequestNum;
+
+    MipChain *pChain = new MipChain();
+    pChain->iSlot = a_ciSlot;
+    pChain->sPath = a_rcsPath;
+    CThreadPool::Instance().Enqueue([this, pChain]()
+    {
+        Decode(pChain);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Finished.push_back(pChain);
+    });
+}
+
+int CTextureLoader::UploadFinished(const unsigned int *a_pcuiTextureId)
+{
+    std::vector<MipChain *> chains;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        chains.swap(m_Finished);
+    }
+
+    for(size_t uiI = 0 ; uiI<chains.size() ; uiI++)
+    {
+        const MipChain *pcChain = chains[uiI];
+        glEnable(GL_TEXTURE_2D);
+            glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+            glBindTexture(GL_TEXTURE_2D,a_pcuiTextureId[pcChain->iSlot]);
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+            for(size_t uiLevel = 0 ; uiLevel<pcChain->Width.size() ; uiLevel++)
+            {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)uiLevel, GL_RGB, pcChain->Width[uiLevel], pcChain->Height[uiLevel], 0,
+                             GL_RGB, GL_UNSIGNED_BYTE, &pcChain->Data[pcChain->Offset[uiLevel]]);
+            }
+            glBindTexture(GL_TEXTURE_2D,0);
+        glDisable(GL_TEXTURE_2D);
+        delete pcChain;
+    }
+    m_iUploadNum += (int)chains.size();
+    return (int)chains.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Decode                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CTextureLoader::Decode(MipChain *a_pChain) const
+{
+    struct stat sourceStat;
+    long long llSourceSize = 0;
+    long long llSourceTime = 0;
+    if(stat(a_pChain->sPath.c_str(), &sourceStat) == 0)
+    {
+        llSourceSize = (long long)sourceStat.st_size;
+        llSourceTime = (long long)sourceStat.st_mtime;
+        if(LoadCache(a_pChain, llSourceSize, llSourceTime))
+        {
+            return;
+        }
+    }
+
+    CBmp image;
+    image.load(a_pChain->sPath.c_str());
+    BuildMipChain(a_pChain, image.w, image.h, image.rgb);
+    SaveCache(a_pChain, llSourceSize, llSourceTime);
+}
+
+void CTextureLoader::AllocateLevels(MipChain *a_pChain, const int a_ciWidth, const int a_ciHeight) const
+{
+    // level sizes first so the whole chain lives in one allocation
+    a_pChain->Width.clear();
+    a_pChain->Height.clear();
+    a_pChain->Offset.clear();
+
+    int iWidth = a_ciWidth;
+    int iHeight = a_ciHeight;
+    size_t uiTotal = 0;
+    for(;;)
+    {
+        a_pChain->Width.push_back(iWidth);
+        a_pChain->Height.push_back(iHeight);
+        a_pChain->Offset.push_back(uiTotal);
+        uiTotal += (size_t)iWidth*iHeight*3;
+        if(iWidth == 1 && iHeight == 1)
+        {
+            break;
+        }
+        iWidth = (iWidth > 1) ? iWidth/2 : 1;
+        iHeight = (iHeight > 1) ? iHeight/2 : 1;
+    }
+    a_pChain->Data.resize(uiTotal);
+}
+
+void CTextureLoader::BuildMipChain(MipChain *a_pChain, const int a_ciWidth, const int a_ciHeight, const unsigned char *a_pcucRgb) const
+{
+    AllocateLevels(a_pChain, a_ciWidth, a_ciHeight);
+    memcpy(&a_pChain->Data[0], a_pcucRgb, (size_t)a_ciWidth*a_ciHeight*3);
+
+    // 2x2 box filter from the previous level, odd edges clamp to the last texel
+    for(size_t uiLevel = 1 ; uiLevel<a_pChain->Width.size() ; uiLevel++)
+    {
+        const int ciSrcW = a_pChain->Width[uiLevel-1];
+        const int ciSrcH = a_pChain->Height[uiLevel-1];
+        const int ciDstW = a_pChain->Width[uiLevel];
+        const int ciDstH = a_pChain->Height[uiLevel];
+        const unsigned char *pcucSrc = &a_pChain->Data[a_pChain->Offset[uiLevel-1]];
+        unsigned char *pucDst = &a_pChain->Data[a_pChain->Offset[uiLevel]];
+
+        for(int iY = 0 ; iY<ciDstH ; iY++)
+        {
+            int iY0 = iY*2;
+            int iY1 = (iY0+1 < ciSrcH) ? iY0+1 : iY0;
+            for(int iX = 0 ; iX<ciDstW ; iX++)
+            {
+                int iX0 = iX*2;
+                int iX1 = (iX0+1 < ciSrcW) ? iX0+1 : iX0;
+                for(int iC = 0 ; iC<3 ; iC++)
+                {
+                    int iSum = pcucSrc[(iY0*ciSrcW+iX0)*3+iC] + pcucSrc[(iY0*ciSrcW+iX1)*3+iC]
+                             + pcucSrc[(iY1*ciSrcW+iX0)*3+iC] + pcucSrc[(iY1*ciSrcW+iX1)*3+iC];
+                    pucDst[(iY*ciDstW+iX)*3+iC] = (unsigned char)((iSum+2)/4);
+                }
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Cache                                   //
+////////////////////////////////////////////////////////////////////////////////
+std::string CTextureLoader::GetCachePath(const std::string &a_rcsPath) const
+{
+    std::string sName = a_rcsPath;
+    for(size_t uiI = 0 ; uiI<sName.size() ; uiI++)
+    {
+        if(sName[uiI] == '/' || sName[uiI] == '\\' || sName[uiI] == ':')
+        {
+            sName[uiI] = '_';
+        }
+    }
+    return m_sCacheDirectory + "/" + sName + ".mip";
+}
+
+bool CTextureLoader::LoadCache(MipChain *a_pChain, const long long a_cllSourceSize, const long long a_cllSourceTime) const
+{
+    FILE *pFile = fopen(GetCachePath(a_pChain->sPath).c_str(), "rb");
+    if(pFile == NULL)
+    {
+        return false;
+    }
+
+    MipCacheHeader header;
+    if(fread(&header, sizeof(header), 1, pFile) != 1 ||
+       memcmp(header.acMagic, s_ccMipMagic, 4) != 0 ||
+       header.iVersion != s_ciMipVersion ||
+       header.llSourceSize != a_cllSourceSize ||
+       header.llSourceTime != a_cllSourceTime ||
+       header.iWidth <= 0 || header.iHeight <= 0 ||
+       header.iWidth > 16384 || header.iHeight > 16384)
+    {
+        fclose(pFile);
+        return false;
+    }
+
+    // the level table follows from the stored size, the payload is read as is
+    AllocateLevels(a_pChain, header.iWidth, header.iHeight);
+    bool bValid = ((int)a_pChain->Width.size() == header.iLevelNum) &&
+                  (fread(&a_pChain->Data[0], 1, a_pChain->Data.size(), pFile) == a_pChain->Data.size());
+    fclose(pFile);
+
+    if(!bValid)
+    {
+        a_pChain->Width.clear();
+        a_pChain->Height.clear();
+        a_pChain->Offset.clear();
+        a_pChain->Data.clear();
+    }
+    return bValid;
+}
+
+void CTextureLoader::SaveCache(const MipChain *a_pcChain, const long long a_cllSourceSize, const long long a_cllSourceTime) const
+{
+    if(a_cllSourceSize == 0)
+    {
+        return;
+    }
+
+    FILE *pFile = fopen(GetCachePath(a_pcChain->sPath).c_str(), "wb");
+    if(pFile == NULL)
+    {
+        printf("[Warning] CTextureLoader::SaveCache, can not write the cache of %s.\n", a_pcChain->sPath.c_str());
+        return;
+    }
+
+    MipCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.acMagic, s_ccMipMagic, 4);
+    header.iVersion = s_ciMipVersion;
+    header.llSourceSize = a_cllSourceSize;
+    header.llSourceTime = a_cllSourceTime;
+    header.iWidth = a_pcChain->Width[0];
+    header.iHeight = a_pcChain->Height[0];
+    header.iLevelNum = (int)a_pcChain->Width.size();
+
+    fwrite(&header, sizeof(header), 1, pFile);
+    fwrite(&a_pcChain->Data[0], 1, a_pcChain->Data.size(), pFile);
+    fclose(pFile);
+}
@@ -0,0 +1,55 @@
+#ifndef CTEXTURELOADER_H
+#define CTEXTURELOADER_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+
+/*
+ * Decodes bitmaps and builds their mip chains on the thread pool, the GL
+ * thread only uploads the finished chains (UploadFinished() once per frame).
+ * Every chain is cached in the cache directory as raw RGB levels and reused
+ * as long as the size and the modification time of the source file match.
+ */
+class CTextureLoader
+{
+    public:
+        CTextureLoader();
+        ~CTextureLoader();
+
+        void SetCacheDirectory(const std::string &a_rcsDirectory);
+        void Request(const int a_ciSlot, const std::string &a_rcsPath);
+
+        // GL thread only, returns the number of textures uploaded in this call
+        int UploadFinished(const unsigned int *a_pcuiTextureId);
+        inline bool IsDone() const { return m_iUploadNum == m_iRequestNum; }
+
+    private:
+        struct MipChain
+        {
+            int iSlot;
+            std::string sPath;
+            std::vector<int> Width;
+            std::vector<int> Height;
+            std::vector<size_t> Offset;              // start of every level in Data
+            std::vector<unsigned char> Data;
+        };
+
+        CTextureLoader(const CTextureLoader &);
+        CTextureLoader &operator=(const CTextureLoader &);
+
+        void Decode(MipChain *a_pChain) const;
+        void AllocateLevels(MipChain *a_pChain, const int a_ciWidth, const int a_ciHeight) const;
+        void BuildMipChain(MipChain *a_pChain, const int a_ciWidth, const int a_ciHeight, const unsigned char *a_pcucRgb) const;
+        std::string GetCachePath(const std::string &a_rcsPath) const;
+        bool LoadCache(MipChain *a_pChain, const long long a_cllSourceSize, const long long a_cllSourceTime) const;
+        void SaveCache(const MipChain *a_pcChain, const long long a_cllSourceSize, const long long a_cllSourceTime) const;
+
+        std::string m_sCacheDirectory;
+        std::vector<MipChain *> m_Finished;         // guarded by m_Mutex
+        std::mutex m_Mutex;
+        int m_iRequestNum;
+        int m_iUploadNum;
+};
+
+#endif
@@ -22,12 +22,23 @@ namespace enControlID
         PARAM_RESET,
         QUIT,
         THROW,
-        SIM_PER_FRAME        
+        SIM_PER_FRAME,
+        DRAW_PROFILER,
+        PROFILER_CSV,
+        EMITTER,
+        SPLASH,
+        CHARACTER,
+        AUTO_RECOVER,
+        STRAIN_LIMIT,
+        REAL_TIME,
+        FRAME_BUDGET
     };
 }
 
 bool g_bOutputStart = false;
 
+const char g_csProfilerCsvFile[] = "profile.csv";
+
 int g_iMainWindow = -1;
 int g_iCheckboxDrawAxis = 0;
 int g_iCheckboxDrawBackground = 1;
@@ -37,6 +48,12 @@ int g_iCheckboxDrawGoalpost = 1;
 int g_iCheckboxDrawSpringStruct = 0;
 int g_iCheckboxDrawSpringShear = 0;
 int g_iCheckboxDrawSpringBending = 0;
+int g_iCheckboxDrawProfiler = 0;
+int g_iCheckboxProfilerCsv = 0;
+int g_iCheckboxEmitter = 1;
+int g_iCheckboxCharacter = 1;
+int g_iCheckboxAutoRecover = 1;
+int g_iCheckboxRealTime = 0;
 
 int g_iListboxCurrIntegrator = 0;
 
@@ -45,6 +62,8 @@ int g_iSpinnerSimPerFrame = 5;
 float g_dSpinnerSpringCoef = 2500.0;
 float g_dSpinnerDamperCoef = 50.0;
 float g_dSpinnerDeltaT = 0.001;
+float g_dSpinnerStrainLimit = 0.0;
+float g_dSpinnerFrameBudget = 16.7f;   // in milliseconds
 float g_dEditboxFPS = 0.0;
 
 std::string g_sStudentID;
@@ -59,13 +78,21 @@ GLUI_Checkbox *g_pCheckboxDrawShadow;
 GLUI_Checkbox *g_pCheckboxDrawSpringStruct;
 GLUI_Checkbox *g_pCheckboxDrawSpringShear;
 GLUI_Checkbox *g_pCheckboxDrawSpringBending;
+GLUI_Checkbox *g_pCheckboxDrawProfiler;
+GLUI_Checkbox *g_pCheckboxProfilerCsv;
+GLUI_Checkbox *g_pCheckboxEmitter;
+GLUI_Checkbox *g_pCheckboxCharacter;
+GLUI_Checkbox *g_pCheckboxAutoRecover;
+GLUI_Checkbox *g_pCheckboxRealTime;
 
 GLUI_Spinner *g_pSpinnerStiffness;
 GLUI_Spinner *g_pSpinnerDamper;
 GLUI_Spinner *g_pSpinnerDeltaT;
+GLUI_Spinner *g_pSpinnerStrainLimit;
 GLUI_Spinner *g_pSpinnerHeight;
 GLUI_Spinner *g_pSpinnerRotate;
 GLUI_Spinner *g_pSpinnerSimPerFrame;
+GLUI_Spinner *g_pSpinnerFrameBudget;
 
 GLUI_Listbox *g_pListboxIntegrator;
 
@@ -73,6 +100,7 @@ GLUI_Button *g_pButtonStart;
 GLUI_Button *g_pButtonPause;
 GLUI_Button *g_pButtonReset;
 GLUI_Button *g_pButtonThrow;
+GLUI_Button *g_pButtonSplash;
 GLUI_Button *g_pButtonOutputStart;
 GLUI_Button *g_pButtonOutputPause;
 GLUI_Button *g_pButtonQuit;
@@ -88,6 +116,10 @@ void GUIConfigInit()
     bool bDrawSpringStruct  = false;
     bool bDrawSpringShear   = false;
     bool bDrawSpringBending = false;
+    bool bDrawProfiler      = false;
+    bool bProfilerCsv       = false;
+    bool bAutoRecover       = true;
+    bool bRealTime          = false;
 
     char cStudentID[15]     = "\0";
 
@@ -102,13 +134,19 @@ void GUIConfigInit()
     configFile.addOption("DrawSpringStructural",&bDrawSpringStruct);
     configFile.addOption("DrawSpringShear",&bDrawSpringShear);
     configFile.addOption("DrawSpringBending",&bDrawSpringBending);
+    configFile.addOptionOptional("DrawProfiler",&bDrawProfiler,false);
+    configFile.addOptionOptional("ProfilerCsv",&bProfilerCsv,false);
+    configFile.addOptionOptional("StabilityAutoRecover",&bAutoRecover,true);
       
     configFile.addOption("IntegratorType",&g_iListboxCurrIntegrator);
     configFile.addOption("SimulationPerFrame",&g_iSpinnerSimPerFrame);
+    configFile.addOptionOptional("RealTime",&bRealTime,false);
+    configFile.addOptionOptional("FrameBudget",&g_dSpinnerFrameBudget,16.7f);
 
     configFile.addOption("SpringCoef",&g_dSpinnerSpringCoef);
     configFile.addOption("DamperCoef",&g_dSpinnerDamperCoef);
     configFile.addOption("DeltaT",&g_dSpinnerDeltaT);
+    configFile.addOptionOptional("StrainLimit",&g_dSpinnerStrainLimit,0.0f);
 
     configFile.addOption("StudentID",cStudentID);
     
@@ -128,8 +166,20 @@ void GUIConfigInit()
     g_iCheckboxDrawPlane         = (bDrawPlane)?1:0;
     g_iCheckboxDrawBackground    = (bDrawBackground)?1:0;
     g_iCheckboxDrawAxis          = (bDrawAxis)?1:0;
+    g_iCheckboxDrawProfiler      = (bDrawProfiler)?1:0;
+    g_iCheckboxProfilerCsv       = (bProfilerCsv)?1:0;
+    g_iCheckboxAutoRecover       = (bAutoRecover)?1:0;
+    g_iCheckboxRealTime          = (bRealTime)?1:0;
     
     g_sStudentID.assign(cStudentID);
+
+    if(g_iCheckboxProfilerCsv == 1)
+        g_Profiler.StartCsv(g_csProfilerCsvFile);
+    else
+        g_Profiler.StopCsv();
+
+    g_SubstepScheduler.SetEnable(g_iCheckboxRealTime == 1);
+    g_SubstepScheduler.SetFrameBudget(g_dSpinnerFrameBudget/1000.0);
 }
 
 void GLUI_Control_CallBack(int a_iControl)
@@ -242,6 +292,15 @@ void GLUI_Control_CallBack(int a_iControl)
             g_pButtonThrow->disable();
             g_MassSpringSystem.SetIntegratorType(CMassSpringSystem::RUNGE_KUTTA);
         }
+        else if(g_iListboxCurrIntegrator == 2)
+        {
+            g_MassSpringSystem.SetPauseSimulation();
+            g_MassSpringSystem.Reset();
+            g_pButtonStart->enable();
+            g_pButtonPause->disable();
+            g_pButtonThrow->disable();
+            g_MassSpringSystem.SetIntegratorType(CMassSpringSystem::PROJECTIVE_DYNAMICS);
+        }
     }
     else if(a_iControl == enControlID::QUIT)
     {
@@ -259,6 +318,54 @@ void GLUI_Control_CallBack(int a_iControl)
         g_pButtonPause->disable();
         g_pButtonThrow->disable();
     }
+    else if(a_iControl == enControlID::SPLASH)
+    {
+        g_MassSpringSystem.CreateFluid();
+    }
+    else if(a_iControl == enControlID::EMITTER)
+    {
+        if(g_iCheckboxEmitter == 1)
+            g_MassSpringSystem.SetEmitterEnable(true);
+        if(g_iCheckboxEmitter == 0)
+            g_MassSpringSystem.SetEmitterEnable(false);
+    }
+    else if(a_iControl == enControlID::STRAIN_LIMIT)
+    {
+        g_MassSpringSystem.SetStrainLimit(g_dSpinnerStrainLimit/100.0);
+    }
+    else if(a_iControl == enControlID::AUTO_RECOVER)
+    {
+        if(g_iCheckboxAutoRecover == 1)
+            g_MassSpringSystem.SetAutoRecover(true);
+        if(g_iCheckboxAutoRecover == 0)
+            g_MassSpringSystem.SetAutoRecover(false);
+    }
+    else if(a_iControl == enControlID::REAL_TIME)
+    {
+        g_SubstepScheduler.SetEnable(g_iCheckboxRealTime == 1);
+        if(g_iCheckboxRealTime == 1)
+            g_pSpinnerSimPerFrame->disable();
+        if(g_iCheckboxRealTime == 0)
+            g_pSpinnerSimPerFrame->enable();
+    }
+    else if(a_iControl == enControlID::FRAME_BUDGET)
+    {
+        g_SubstepScheduler.SetFrameBudget(g_dSpinnerFrameBudget/1000.0);
+    }
+    else if(a_iControl == enControlID::CHARACTER)
+    {
+        if(g_iCheckboxCharacter == 1)
+            g_MassSpringSystem.SetCharacterEnable(true);
+        if(g_iCheckboxCharacter == 0)
+            g_MassSpringSystem.SetCharacterEnable(false);
+    }
+    else if(a_iControl == enControlID::PROFILER_CSV)
+    {
+        if(g_iCheckboxProfilerCsv == 1)
+            g_Profiler.StartCsv(g_csProfilerCsvFile);
+        if(g_iCheckboxProfilerCsv == 0)
+            g_Profiler.StopCsv();
+    }
     else if(a_iControl == enControlID::OUTPUT_START)
     {
         g_bOutputStart = true;
@@ -301,12 +408,17 @@ void GLUI_Control_CallBack(int a_iControl)
         g_MassSpringSystem.SetDamperCoef(g_dSpinnerDamperCoef,CSpring::Type_nShear);
         g_MassSpringSystem.SetDamperCoef(g_dSpinnerDamperCoef,CSpring::Type_nBending);
         g_MassSpringSystem.SetDeltaT(g_dSpinnerDeltaT);
+        g_MassSpringSystem.SetStrainLimit(g_dSpinnerStrainLimit/100.0);
         g_MassSpringSystem.SetIntegratorType(CMassSpringSystem::EXPLICIT_EULER);
         g_MassSpringSystem.Reset();
         g_pButtonStart->enable();
         g_pButtonPause->disable();
         g_pButtonThrow->disable();
         g_pButtonOutputPause->disable();
+        if(g_iCheckboxRealTime == 1)
+            g_pSpinnerSimPerFrame->disable();
+        if(g_iCheckboxRealTime == 0)
+            g_pSpinnerSimPerFrame->enable();
 
         g_iMouseLastPressX      = 0;
         g_iMouseLastPressY      = 0;
@@ -349,6 +461,14 @@ void GLUIInit()
         g_pSpinnerSimPerFrame = new GLUI_Spinner(pContorlPanel,"Simualtion/Frame",&g_iSpinnerSimPerFrame,
                                                  enControlID::SIM_PER_FRAME,GLUI_Control_CallBack);
         g_pSpinnerSimPerFrame->set_int_limits(1,10);
+        g_pCheckboxRealTime = new GLUI_Checkbox( pContorlPanel, "Real Time" ,&g_iCheckboxRealTime ,
+                                                  enControlID::REAL_TIME,GLUI_Control_CallBack);
+        g_pSpinnerFrameBudget = new GLUI_Spinner(pContorlPanel,"Frame Budget ms",&g_dSpinnerFrameBudget,
+                                                 enControlID::FRAME_BUDGET,GLUI_Control_CallBack);
+        g_pSpinnerFrameBudget->set_float_limits(1.0,200.0);
+        g_pSpinnerFrameBudget->set_speed(0.05f);
+        if(g_iCheckboxRealTime == 1)
+            g_pSpinnerSimPerFrame->disable();
 
     //Object Panel
     GLUI_Panel *pObjectPanel = new GLUI_Panel( pPanel, "Object" );
@@ -356,6 +476,12 @@ void GLUIInit()
         g_pButtonThrow = new GLUI_Button(pObjectPanel, "Throw",
                                          enControlID::THROW, GLUI_Control_CallBack);
         g_pButtonThrow->disable();
+        g_pButtonSplash = new GLUI_Button(pObjectPanel, "Splash",
+                                          enControlID::SPLASH, GLUI_Control_CallBack);
+        g_pCheckboxEmitter = new GLUI_Checkbox( pObjectPanel, "Emitter" ,&g_iCheckboxEmitter ,
+                                                 enControlID::EMITTER,GLUI_Control_CallBack);
+        g_pCheckboxCharacter = new GLUI_Checkbox( pObjectPanel, "Character" ,&g_iCheckboxCharacter ,
+                                                   enControlID::CHARACTER,GLUI_Control_CallBack);
 
     //Render Panel
     GLUI_Panel *pRenderPanel = new GLUI_Panel( pPanel, "Render" );
@@ -376,6 +502,8 @@ void GLUIInit()
                                                            enControlID::DRAW_SHEAR_SPRING,GLUI_Control_CallBack);
         g_pCheckboxDrawSpringBending = new GLUI_Checkbox( pRenderPanel, "DrawSpringBending" ,&g_iCheckboxDrawSpringBending ,
                                                            enControlID::DRAW_BENDING_SPRING,GLUI_Control_CallBack);
+        g_pCheckboxDrawProfiler      = new GLUI_Checkbox( pRenderPanel, "DrawProfiler" ,&g_iCheckboxDrawProfiler ,
+                                                           enControlID::DRAW_PROFILER,GLUI_Control_CallBack);
 
 
     //Spring Panel
@@ -389,6 +517,10 @@ void GLUIInit()
                                                 enControlID::DAMPERCOEF,GLUI_Control_CallBack);
         g_pSpinnerDamper->set_float_limits(0.0,10000.0);
         g_pSpinnerDamper->set_speed(0.005f);
+        g_pSpinnerStrainLimit = new GLUI_Spinner( pSpringPanel, "Strain Limit %" , &g_dSpinnerStrainLimit,
+                                                  enControlID::STRAIN_LIMIT,GLUI_Control_CallBack);
+        g_pSpinnerStrainLimit->set_float_limits(0.0,100.0);
+        g_pSpinnerStrainLimit->set_speed(0.05f);
 
     //Integrator Panel
     GLUI_Panel *pIntegratorPanel = new GLUI_Panel( pPanel, "Integrator" );
@@ -397,11 +529,13 @@ void GLUIInit()
                                              enControlID::DELTAT,GLUI_Control_CallBack);
         g_pSpinnerDeltaT->set_float_limits(0.00001,1.0);
         g_pSpinnerDeltaT->set_speed(0.005f);
-        char *pcIntegratorList[] = { "Explicit Euler", "Runge Kutta 4th"};
+        char *pcIntegratorList[] = { "Explicit Euler", "Runge Kutta 4th", "Projective Dynamics"};
         g_pListboxIntegrator = new GLUI_Listbox( pIntegratorPanel, "Integrator", &g_iListboxCurrIntegrator ,
                                                  enControlID::INTEGRATOR,GLUI_Control_CallBack);
-        for(int i=0; i<2; i++ )
+        for(int i=0; i<3; i++ )
             g_pListboxIntegrator->add_item( i, pcIntegratorList[i] );
+        g_pCheckboxAutoRecover = new GLUI_Checkbox( pIntegratorPanel, "AutoRecover" ,&g_iCheckboxAutoRecover ,
+                                                     enControlID::AUTO_RECOVER,GLUI_Control_CallBack);
 
     //Output Panel
     GLUI_Panel *pOutputPanel = new GLUI_Panel( pPanel, "Output" );
@@ -411,6 +545,8 @@ void GLUIInit()
         g_pButtonOutputPause = new GLUI_Button(pOutputPanel, "Stop Recording" ,
                                                enControlID::OUTPUT_PAUSE,GLUI_Control_CallBack);
         g_pButtonOutputPause->disable();
+        g_pCheckboxProfilerCsv = new GLUI_Checkbox( pOutputPanel, "Profile CSV" ,&g_iCheckboxProfilerCsv ,
+                                                     enControlID::PROFILER_CSV,GLUI_Control_CallBack);
 
     //Program Panel
     GLUI_Panel *pProgramPanel = new GLUI_Panel( pPanel, "Program Control" );
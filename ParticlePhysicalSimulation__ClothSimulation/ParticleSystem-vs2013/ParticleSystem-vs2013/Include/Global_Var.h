@@ -1,10 +1,18 @@
 PerformanceCounter g_PerformanceCounter;
+CSubstepScheduler g_SubstepScheduler;   // steps per frame of the real-time mode
 CMassSpringSystem g_MassSpringSystem("Configuration.txt");
+CScenario g_Scenario;              // empty unless a script is given, then it drives the steps
 CCamera g_Camera("camera.txt");
 
 const int g_ciTexNum = 14;
 
 GLuint g_uiTextureId[g_ciTexNum] = {0};
+CTextureLoader g_TextureLoader;
+
+// display lists of the static scenery, compiled on first use
+GLuint g_uiBackgroundList  = 0;
+GLuint g_uiPlaneList       = 0;
+GLuint g_uiPlaneShadowList = 0;
 
 GLint g_iScreenWidth  = 800;
 GLint g_iScreenHeight = 600;
@@ -15,6 +23,13 @@ int g_iMouseLastPressX      = 0;
 int g_iMouseLastPressY      = 0;
 int g_iMouseLastPressButton = -1;
 
+// middle button or ctrl + left button drags a particle of the net
+const double g_cdPickRadius = 0.05;
+bool g_bNetDrag = false;
+Vector3d g_DragPlanePoint;         // the target moves in the plane through the hit facing the eye
+Vector3d g_DragPlaneNormal;
+Vector3d g_DragOffset;             // from the hit to the particle
+
 double g_dCameraZoom = 1.0;
 double g_dLastCameraZoom = 1.0;
 double g_dCameraRotatePitchDeg = 0.0;
@@ -7,11 +7,15 @@ void drawText2D ( int x, int y,const char* msg);
 void drawText3D ( int x, int y , int z ,const char* msg);
 void mouse(int a_iButton, int a_iState, int a_iPosX, int a_iPosY);
 void motion(int a_iPosX, int a_iPosY);
+bool NetDragStart(int a_iPosX, int a_iPosY);
+void NetDragMove(int a_iPosX, int a_iPosY);
 void OpenGLInit(int argc,char** argv);
 void reshape(int iScreenWidth, int iScreenHeight);
 void keyboard(unsigned char ucPressedKey, int iX, int iY);
 void display();
+void TextureLoadStart();
 void TextureInit();
+void ReleaseStaticScene();
 
 void drawText2D ( int x, int y, const char* msg)
 {
@@ -31,43 +35,95 @@ void drawText3D ( int x, int y , int z ,const char* msg)
         glutBitmapCharacter(font, msg[i]);  
 }
 
+void TextureLoadStart()
+{
+    // decoded and mipmapped on the thread pool while the window and GLUI are set up
+    g_TextureLoader.Request(0,"Texture/skybox0.bmp");
+    g_TextureLoader.Request(1,"Texture/skybox1.bmp");
+    g_TextureLoader.Request(2,"Texture/skybox2.bmp");
+    g_TextureLoader.Request(3,"Texture/skybox3.bmp");
+    g_TextureLoader.Request(4,"Texture/skybox4.bmp");
+    g_TextureLoader.Request(5,"Texture/skybox5.bmp");
+    g_TextureLoader.Request(6,"Texture/dice0.bmp");
+    g_TextureLoader.Request(7,"Texture/dice1.bmp");
+    g_TextureLoader.Request(8,"Texture/dice2.bmp");
+    g_TextureLoader.Request(9,"Texture/dice3.bmp");
+    g_TextureLoader.Request(10,"Texture/dice4.bmp");
+    g_TextureLoader.Request(11,"Texture/dice5.bmp");
+    g_TextureLoader.Request(12,"Texture/ground.bmp");
+    g_TextureLoader.Request(13,"Texture/grass.bmp");
+}
+
 void TextureInit()
 {    
-    CBmp TextureImage[g_ciTexNum];
-    TextureImage[0].load("Texture/skybox0.bmp");
-    TextureImage[1].load("Texture/skybox1.bmp");
-    TextureImage[2].load("Texture/skybox2.bmp");
-    TextureImage[3].load("Texture/skybox3.bmp");
-    TextureImage[4].load("Texture/skybox4.bmp");
-    TextureImage[5].load("Texture/skybox5.bmp");
-    TextureImage[6].load("Texture/dice0.bmp");
-    TextureImage[7].load("Texture/dice1.bmp");
-    TextureImage[8].load("Texture/dice2.bmp");
-    TextureImage[9].load("Texture/dice3.bmp");
-    TextureImage[10].load("Texture/dice4.bmp");
-    TextureImage[11].load("Texture/dice5.bmp");
-    TextureImage[12].load("Texture/ground.bmp");
-    TextureImage[13].load("Texture/grass.bmp");
-
-    for(int iI = 0 ; iI<g_ciTexNum ; iI++)
+    // names only, the images are uploaded by display() as their decodes finish
+    glGenTextures(g_ciTexNum,g_uiTextureId);
+    g_TextureLoader.UploadFinished(g_uiTextureId);
+
+    // the cached scenery refers to the texture ids, compile it again on next draw
+    ReleaseStaticScene();
+}
+
+void ReleaseStaticScene()
+{
+    GLuint *puiList[] = { &g_uiBackgroundList, &g_uiPlaneList, &g_uiPlaneShadowList };
+    for(int iI = 0 ; iI<3 ; iI++)
+    {
+        if(*puiList[iI] != 0)
+        {
+            glDeleteLists(*puiList[iI],1);
+            *puiList[iI] = 0;
+        }
+    }
+}
+
+bool NetDragStart(int a_iPosX, int a_iPosY)
+{
+    Vector3d origin, direction, hit;
+    if(!g_Camera.GetPickRay(a_iPosX, a_iPosY, origin, direction) ||
+       !g_MassSpringSystem.Pick(origin, direction, g_cdPickRadius, hit))
+    {
+        return false;
+    }
+    g_DragPlanePoint = hit;
+    g_DragPlaneNormal = direction;
+    g_DragOffset = g_MassSpringSystem.GetDragTarget() - hit;
+    return true;
+}
+
+void NetDragMove(int a_iPosX, int a_iPosY)
+{
+    Vector3d origin, direction;
+    if(!g_Camera.GetPickRay(a_iPosX, a_iPosY, origin, direction))
     {
-        glEnable(GL_TEXTURE_2D);
-            glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-            glGenTextures(1,&g_uiTextureId[iI]);
-            glBindTexture(GL_TEXTURE_2D,g_uiTextureId[iI]);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB , TextureImage[iI].w, TextureImage[iI].h,0,GL_RGB ,GL_UNSIGNED_BYTE, TextureImage[iI].rgb);
-            //gluBuild2DMipmaps(GL_TEXTURE_2D, 3 , TextureImage[iI].w, TextureImage[iI].h,GL_RGB ,GL_UNSIGNED_BYTE, TextureImage[iI].rgb);
-            glBindTexture(GL_TEXTURE_2D,0);
-        glDisable(GL_TEXTURE_2D);
+        return;
     }
+    double dFacing = direction.DotProduct(g_DragPlaneNormal);
+    if(fabs(dFacing) < 1e-6)
+    {
+        return;
+    }
+    double dDistance = (g_DragPlanePoint - origin).DotProduct(g_DragPlaneNormal)/dFacing;
+    g_MassSpringSystem.SetDragTarget(origin + direction*dDistance + g_DragOffset);
 }
 
 void mouse(int a_iButton, int a_iState, int a_iPosX, int a_iPosY)
 {
+    if(a_iState == GLUT_UP && g_bNetDrag)
+    {
+        g_MassSpringSystem.ReleaseDrag();
+        g_bNetDrag = false;
+    }
+    if(a_iState == GLUT_DOWN &&
+       (a_iButton == GLUT_MIDDLE_BUTTON || (a_iButton == GLUT_LEFT_BUTTON && (glutGetModifiers() & GLUT_ACTIVE_CTRL))))
+    {
+        g_bNetDrag = NetDragStart(a_iPosX, a_iPosY);
+        if(g_bNetDrag)
+        {
+            g_iMouseLastPressButton = a_iButton;
+            return;
+        }
+    }
     if(a_iState == GLUT_DOWN)
     {
         g_iMouseLastPressX      = a_iPosX;
@@ -86,6 +142,11 @@ void mouse(int a_iButton, int a_iState, int a_iPosX, int a_iPosY)
 }
 void motion(int a_iPosX, int a_iPosY)
 {
+    if(g_bNetDrag)
+    {
+        NetDragMove(a_iPosX, a_iPosY);
+        return;
+    }
     if(g_iMouseLastPressButton == GLUT_RIGHT_BUTTON)
     {
         double dDeltaX = (double)( g_iMouseLastPressX - a_iPosX);
@@ -117,6 +178,8 @@ void motion(int a_iPosX, int a_iPosY)
 }
 void OpenGLInit(int argc,char** argv)
 {
+    TextureLoadStart();
+
 	glutInit(&argc, argv);                                    //glut initialization
 	glutInitWindowSize(g_iScreenWidth, g_iScreenHeight);      //define window size
 	glutInitWindowPosition(0, 0);                             //define window initial position
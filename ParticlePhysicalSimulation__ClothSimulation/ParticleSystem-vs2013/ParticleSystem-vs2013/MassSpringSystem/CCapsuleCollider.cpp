@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include "CCapsuleCollider.h"
+#include "CThreadPool.h"
+#include "Render_API.h"
+#include "glut.h"
+
+namespace
+{
+    const int s_ciLeafSize = 2;             // capsules per leaf
+    const int s_ciMaxDepth = 64;            // traversal stack, the median split keeps the tree balanced
+    const int s_ciMinChunk = 256;           // particles per parallel task
+
+    inline double MinOf(const double a_cdA, const double a_cdB){ return (a_cdA < a_cdB) ? a_cdA : a_cdB; }
+    inline double MaxOf(const double a_cdA, const double a_cdB){ return (a_cdA > a_cdB) ? a_cdA : a_cdB; }
+
+    inline void Grow(const Vector3d &a_rcPoint, Vector3d &a_rMin, Vector3d &a_rMax)
+    {
+        a_rMin.x = MinOf(a_rMin.x, a_rcPoint.x); a_rMax.x = MaxOf(a_rMax.x, a_rcPoint.x);
+        a_rMin.y = MinOf(a_rMin.y, a_rcPoint.y); a_rMax.y = MaxOf(a_rMax.y, a_rcPoint.y);
+        a_rMin.z = MinOf(a_rMin.z, a_rcPoint.z); a_rMax.z = MaxOf(a_rMax.z, a_rcPoint.z);
+    }
+
+    inline bool Contains(const Vector3d &a_rcMin, const Vector3d &a_rcMax, const Vector3d &a_rcPoint)
+    {
+        return a_rcPoint.x >= a_rcMin.x && a_rcPoint.x <= a_rcMax.x
+            && a_rcPoint.y >= a_rcMin.y && a_rcPoint.y <= a_rcMax.y
+            && a_rcPoint.z >= a_rcMin.z && a_rcPoint.z <= a_rcMax.z;
+    }
+}
+
+CCapsuleCollider::CCapsuleCollider()
+    :m_dFriction(0.5),
+    m_dThickness(0.01),
+    m_Color(0.8,0.6,0.5),
+    m_iBvhFrame(-1),
+    m_Capsules(),
+    m_FrameScratch(),
+    m_CapsuleMin(),
+    m_CapsuleMax(),
+    m_CapsuleCenter(),
+    m_CapsuleOrder(),
+    m_Nodes()
+{
+}
+
+void CCapsuleCollider::Reset()
+{
+    m_iBvhFrame = -1;
+    m_Capsules.clear();
+    m_Nodes.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Hierarchy                                 //
+////////////////////////////////////////////////////////////////////////////////
+void CCapsuleCollider::Update(const CCapsuleTrack &a_rcTrack, const double a_cdTime)
+{
+    a_rcTrack.Sample(a_cdTime, m_Capsules);
+
+    int iFrame = a_rcTrack.FrameIndex(a_cdTime);
+    if(iFrame == m_iBvhFrame || m_Capsules.empty())
+    {
+        return;
+    }
+    m_iBvhFrame = iFrame;
+
+    // bounds of every capsule at the frame and at the next one, the
+    // interpolated poses in between stay inside
+    const int ciNum = (int)m_Capsules.size();
+    a_rcTrack.GetFrame(iFrame, m_FrameScratch);
+    m_CapsuleMin.resize(ciNum);
+    m_CapsuleMax.resize(ciNum);
+    m_CapsuleCenter.resize(ciNum);
+    m_CapsuleOrder.resize(ciNum);
+    for(int iI = 0 ; iI<ciNum ; iI++)
+    {
+        const Capsule &rcCapsule = m_FrameScratch[iI];
+        Vector3d nextStart = rcCapsule.start + rcCapsule.startVelocity*a_rcTrack.GetFrameTime();
+        Vector3d nextEnd = rcCapsule.end + rcCapsule.endVelocity*a_rcTrack.GetFrameTime();
+        Vector3d min = rcCapsule.start;
+        Vector3d max = rcCapsule.start;
+        Grow(rcCapsule.end, min, max);
+        Grow(nextStart, min, max);
+        Grow(nextEnd, min, max);
+        double dInflate = rcCapsule.dRadius + m_dThickness;
+        m_CapsuleMin[iI] = min - dInflate;
+        m_CapsuleMax[iI] = max + dInflate;
+        m_CapsuleCenter[iI] = (m_CapsuleMin[iI] + m_CapsuleMax[iI])*0.5;
+        m_CapsuleOrder[iI] = iI;
+    }
+
+    m_Nodes.clear();
+    m_Nodes.reserve(2*ciNum);
+    BuildNode(0, ciNum);
+}
+
+int CCapsuleCollider::BuildNode(const int a_ciBegin, const int a_ciEnd)
+{
+    int iNode = (int)m_Nodes.size();
+    m_Nodes.push_back(BvhNode());
+
+    Vector3d min = m_CapsuleMin[m_CapsuleOrder[a_ciBegin]];
+    Vector3d max = m_CapsuleMax[m_CapsuleOrder[a_ciBegin]];
+    Vector3d centerMin = m_CapsuleCenter[m_CapsuleOrder[a_ciBegin]];
+    Vector3d centerMax = centerMin;
+    for(int iI = a_ciBegin + 1 ; iI<a_ciEnd ; iI++)
+    {
+        int iCapsule = m_CapsuleOrder[iI];
+        Grow(m_CapsuleMin[iCapsule], min, max);
+        Grow(m_CapsuleMax[iCapsule], min, max);
+        Grow(m_CapsuleCenter[iCapsule], centerMin, centerMax);
+    }
+    m_Nodes[iNode].min = min;
+    m_Nodes[iNode].max = max;
+
+    if(a_ciEnd - a_ciBegin <= s_ciLeafSize)
+    {
+        m_Nodes[iNode].iLeft = -1;
+        m_Nodes[iNode].iRight = -1;
+        m_Nodes[iNode].iFirst = a_ciBegin;
+        m_Nodes[iNode].iCount = a_ciEnd - a_ciBegin;
+        return iNode;
+    }
+
+    // median split along the widest spread of the centers
+    Vector3d extent = centerMax - centerMin;
+    int iAxis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+    int iMid = (a_ciBegin + a_ciEnd)/2;
+    const std::vector<Vector3d> &rcCenter = m_CapsuleCenter;
+    std::nth_element(m_CapsuleOrder.begin() + a_ciBegin, m_CapsuleOrder.begin() + iMid, m_CapsuleOrder.begin() + a_ciEnd,
+        [&rcCenter, iAxis](int a_iA, int a_iB){ return rcCenter[a_iA][iAxis] < rcCenter[a_iB][iAxis]; });
+
+    int iLeft = BuildNode(a_ciBegin, iMid);
+    int iRight = BuildNode(iMid, a_ciEnd);
+    m_Nodes[iNode].iLeft = iLeft;
+    m_Nodes[iNode].iRight = iRight;
+    m_Nodes[iNode].iFirst = 0;
+    m_Nodes[iNode].iCount = 0;
+    return iNode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Collision                                 //
+////////////////////////////////////////////////////////////////////////////////
+void CCapsuleCollider::Collide(GoalNet &a_rGoalNet) const
+{
+    if(m_Nodes.empty())
+    {
+        return;
+    }
+
+    CThreadPool::Instance().ParallelFor(0, a_rGoalNet.ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        int aiStack[s_ciMaxDepth];
+        for(int iI = a_iBegin ; iI<a_iEnd ; iI++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iI);
+            if(!rParticle.IsMovable())
+            {
+                continue;
+            }
+            Vector3d position = rParticle.GetPosition();
+            if(!Contains(m_Nodes[0].min, m_Nodes[0].max, position))
+            {
+                continue;
+            }
+            Vector3d velocity = rParticle.GetVelocity();
+            bool bHit = false;
+
+            int iTop = 0;
+            aiStack[iTop++] = 0;
+            while(iTop > 0)
+            {
+                const BvhNode &rcNode = m_Nodes[aiStack[--iTop]];
+                if(!Contains(rcNode.min, rcNode.max, position))
+                {
+                    continue;
+                }
+                if(rcNode.iLeft < 0)
+                {
+                    for(int iK = rcNode.iFirst ; iK<rcNode.iFirst + rcNode.iCount ; iK++)
+                    {
+                        bHit = ResolveContact(m_Capsules[m_CapsuleOrder[iK]], position, velocity) || bHit;
+                    }
+                }
+                else
+                {
+                    aiStack[iTop++] = rcNode.iLeft;
+                    aiStack[iTop++] = rcNode.iRight;
+                }
+            }
+
+            if(bHit)
+            {
+                rParticle.SetPosition(position);
+                rParticle.SetVelocity(velocity);
+            }
+        }
+    }, s_ciMinChunk);
+}
+
+bool CCapsuleCollider::ResolveContact(const Capsule &a_rcCapsule, Vector3d &a_rPosition, Vector3d &a_rVelocity) const
+{
+    // closest point of the bone axis
+    Vector3d axis = a_rcCapsule.end - a_rcCapsule.start;
+    double dAxisSq = axis.SquaredLength();
+    double dT = 0.0;
+    if(dAxisSq > 1e-12)
+    {
+        dT = (a_rPosition - a_rcCapsule.start).DotProduct(axis)/dAxisSq;
+        dT = (dT < 0.0) ? 0.0 : ((dT > 1.0) ? 1.0 : dT);
+    }
+    Vector3d closest = a_rcCapsule.start + axis*dT;
+    Vector3d offset = a_rPosition - closest;
+    double dRadius = a_rcCapsule.dRadius + m_dThickness;
+    double dDistSq = offset.SquaredLength();
+    if(dDistSq >= dRadius*dRadius || dDistSq < 1e-12)
+    {
+        return false;
+    }
+
+    double dDist = sqrt(dDistSq);
+    Vector3d normal = offset/dDist;
+    a_rPosition = closest + normal*dRadius;
+
+    // velocity relative to the surface point of the moving bone
+    Vector3d boneVelocity = a_rcCapsule.startVelocity + (a_rcCapsule.endVelocity - a_rcCapsule.startVelocity)*dT;
+    Vector3d relative = a_rVelocity - boneVelocity;
+    double dNormalSpeed = relative.DotProduct(normal);
+    if(dNormalSpeed >= 0.0)
+    {
+        return true;
+    }
+    Vector3d tangent = relative - normal*dNormalSpeed;
+    double dTangentSpeed = tangent.Length();
+    double dKeep = (dTangentSpeed > 1e-12) ? 1.0 + m_dFriction*dNormalSpeed/dTangentSpeed : 0.0;
+    a_rVelocity = boneVelocity + tangent*((dKeep > 0.0) ? dKeep : 0.0);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Draw                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CCapsuleCollider::Draw() const
+{
+    if(m_Capsules.empty())
+    {
+        return;
+    }
+
+    glPushAttrib(GL_CURRENT_BIT);
+    glColor3d(m_Color.x, m_Color.y, m_Color.z);
+    for(size_t uiI = 0 ; uiI<m_Capsules.size() ; uiI++)
+    {
+        const Capsule &rcCapsule = m_Capsules[uiI];
+        // the root has no length, only its sphere is drawn
+        if((rcCapsule.end - rcCapsule.start).SquaredLength() > 1e-8)
+        {
+            drawCylinder(rcCapsule.start, rcCapsule.end, rcCapsule.dRadius);
+        }
+        glPushMatrix();
+            glTranslated(rcCapsule.end.x, rcCapsule.end.y, rcCapsule.end.z);
+            glutSolidSphere(rcCapsule.dRadius, 12, 12);
+        glPopMatrix();
+    }
+    glPopAttrib();
+}
@@ -0,0 +1,64 @@
+#ifndef CCAPSULECOLLIDER_H
+#define CCAPSULECOLLIDER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CCapsuleTrack.h"
+#include "GoalNetModel.h"
+
+/*
+ * Collides the net particles with the capsules of an animated character.
+ * A bounding volume hierarchy over the capsules is built once per motion
+ * capture frame; every box covers its capsule over the whole frame (the
+ * pose at the frame and at the next one), so the same tree serves all the
+ * substeps in between and a particle only tests the capsules whose boxes
+ * hold it. Penetrating particles are pushed to the surface and lose the
+ * velocity they have into the bone, measured against the moving bone, plus
+ * a Coulomb share of the sliding velocity.
+ */
+class CCapsuleCollider
+{
+    public:
+        CCapsuleCollider();
+
+        inline void SetFriction(const double a_cdFriction){ m_dFriction = a_cdFriction; }
+        inline void SetThickness(const double a_cdThickness){ m_dThickness = a_cdThickness; }
+        inline void SetColor(const Vector3d &a_rcColor){ m_Color = a_rcColor; }
+        inline int CapsuleNum() const { return (int)m_Capsules.size(); }
+
+        // poses the capsules at the time, rebuilds the hierarchy when a new frame starts
+        void Update(const CCapsuleTrack &a_rcTrack, const double a_cdTime);
+        void Collide(GoalNet &a_rGoalNet) const;
+        void Reset();
+
+        void Draw() const;
+
+    private:
+        struct BvhNode
+        {
+            Vector3d min;
+            Vector3d max;
+            int iLeft;                      // children, -1 for a leaf
+            int iRight;
+            int iFirst;                     // leaf range in m_CapsuleOrder
+            int iCount;
+        };
+
+        int BuildNode(const int a_ciBegin, const int a_ciEnd);
+        bool ResolveContact(const Capsule &a_rcCapsule, Vector3d &a_rPosition, Vector3d &a_rVelocity) const;    // false if the point is outside
+
+        double m_dFriction;
+        double m_dThickness;                // cloth half thickness added to every radius
+        Vector3d m_Color;
+
+        int m_iBvhFrame;                    // frame the hierarchy was built for, -1 for none
+        std::vector<Capsule> m_Capsules;    // current pose
+        std::vector<Capsule> m_FrameScratch;
+        std::vector<Vector3d> m_CapsuleMin; // swept bounds of the current frame
+        std::vector<Vector3d> m_CapsuleMax;
+        std::vector<Vector3d> m_CapsuleCenter;
+        std::vector<int> m_CapsuleOrder;
+        std::vector<BvhNode> m_Nodes;       // root first
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include "CCapsuleTrack.h"
+
+#pragma warning(disable:4996)
+
+CCapsuleTrack::CCapsuleTrack()
+    :m_iBoneNum(0),
+    m_iFrameNum(0),
+    m_dFrameTime(1.0/120.0),
+    m_Offset(0.0,0.0,0.0),
+    m_dScale(1.0),
+    m_Radius(),
+    m_Start(),
+    m_End()
+{
+}
+
+void CCapsuleTrack::Clear()
+{
+    m_iBoneNum = 0;
+    m_iFrameNum = 0;
+    m_Radius.clear();
+    m_Start.clear();
+    m_End.clear();
+}
+
+bool CCapsuleTrack::Load(const std::string &a_rcsFilename)
+{
+    Clear();
+
+    std::ifstream input(a_rcsFilename.c_str());
+    if(!input)
+    {
+        printf("[Warning] CCapsuleTrack::Load, can not open %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    std::string sKey;
+    int iVersion = 0;
+    int iBoneNum = 0;
+    int iFrameNum = 0;
+    double dFrameTime = 0.0;
+    input >> sKey >> iVersion;
+    if(!input || sKey != "capsule_track" || iVersion != 1)
+    {
+        printf("[Warning] CCapsuleTrack::Load, %s is not a capsule track.\n", a_rcsFilename.c_str());
+        return false;
+    }
+    input >> sKey >> iBoneNum >> sKey >> iFrameNum >> sKey >> dFrameTime;
+    if(!input || iBoneNum <= 0 || iFrameNum <= 0 || dFrameTime <= 0.0)
+    {
+        printf("[Warning] CCapsuleTrack::Load, bad header in %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    std::vector<double> radius(iBoneNum);
+    std::vector<Vector3d> start(iBoneNum*iFrameNum);
+    std::vector<Vector3d> end(iBoneNum*iFrameNum);
+    std::string sName;
+    for(int iB = 0 ; iB<iBoneNum ; iB++)
+    {
+        input >> sKey >> sName >> radius[iB];
+    }
+    for(int iF = 0 ; iF<iFrameNum && input ; iF++)
+    {
+        int iFrame;
+        input >> sKey >> iFrame;
+        for(int iB = 0 ; iB<iBoneNum ; iB++)
+        {
+            Vector3d &rStart = start[iF*iBoneNum + iB];
+            Vector3d &rEnd = end[iF*iBoneNum + iB];
+            input >> rStart.x >> rStart.y >> rStart.z >> rEnd.x >> rEnd.y >> rEnd.z;
+        }
+    }
+    if(!input)
+    {
+        printf("[Warning] CCapsuleTrack::Load, %s ends before its last frame.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    m_iBoneNum = iBoneNum;
+    m_iFrameNum = iFrameNum;
+    m_dFrameTime = dFrameTime;
+    m_Radius.swap(radius);
+    m_Start.swap(start);
+    m_End.swap(end);
+    return true;
+}
+
+int CCapsuleTrack::FrameIndex(const double a_cdTime) const
+{
+    if(m_iFrameNum == 0)
+    {
+        return 0;
+    }
+    double dFrame = floor(a_cdTime/m_dFrameTime);
+    return (int)(dFrame - floor(dFrame/m_iFrameNum)*m_iFrameNum);
+}
+
+void CCapsuleTrack::GetFrame(const int a_ciFrame, std::vector<Capsule> &a_rCapsules) const
+{
+    Interpolate(a_ciFrame, 0.0, a_rCapsules);
+}
+
+void CCapsuleTrack::Sample(const double a_cdTime, std::vector<Capsule> &a_rCapsules) const
+{
+    if(m_iFrameNum == 0)
+    {
+        a_rCapsules.clear();
+        return;
+    }
+    double dFrame = a_cdTime/m_dFrameTime;
+    Interpolate(FrameIndex(a_cdTime), dFrame - floor(dFrame), a_rCapsules);
+}
+
+void CCapsuleTrack::Interpolate(const int a_ciFrame, const double a_cdFraction, std::vector<Capsule> &a_rCapsules) const
+{
+    a_rCapsules.resize(m_iBoneNum);
+    // the loop jumps back to the first pose, that jump is not a motion of the bones
+    int iNext = (a_ciFrame + 1 < m_iFrameNum) ? a_ciFrame + 1 : a_ciFrame;
+    const Vector3d *pcStart0 = &m_Start[a_ciFrame*m_iBoneNum];
+    const Vector3d *pcEnd0 = &m_End[a_ciFrame*m_iBoneNum];
+    const Vector3d *pcStart1 = &m_Start[iNext*m_iBoneNum];
+    const Vector3d *pcEnd1 = &m_End[iNext*m_iBoneNum];
+    double dVelocityScale = m_dScale/m_dFrameTime;
+
+    for(int iB = 0 ; iB<m_iBoneNum ; iB++)
+    {
+        Capsule &rCapsule = a_rCapsules[iB];
+        rCapsule.start = (pcStart0[iB] + (pcStart1[iB] - pcStart0[iB])*a_cdFraction)*m_dScale + m_Offset;
+        rCapsule.end = (pcEnd0[iB] + (pcEnd1[iB] - pcEnd0[iB])*a_cdFraction)*m_dScale + m_Offset;
+        rCapsule.startVelocity = (pcStart1[iB] - pcStart0[iB])*dVelocityScale;
+        rCapsule.endVelocity = (pcEnd1[iB] - pcEnd0[iB])*dVelocityScale;
+        rCapsule.dRadius = m_Radius[iB]*m_dScale;
+    }
+}
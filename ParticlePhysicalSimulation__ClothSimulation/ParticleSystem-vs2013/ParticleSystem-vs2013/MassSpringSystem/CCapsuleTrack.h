@@ -0,0 +1,62 @@
+#ifndef CCAPSULETRACK_H
+#define CCAPSULETRACK_H
+
+#include <string>
+#include <vector>
+#include "Vector3d.h"
+
+struct Capsule
+{
+    Vector3d start;
+    Vector3d end;
+    Vector3d startVelocity;
+    Vector3d endVelocity;
+    double dRadius;
+};
+
+/*
+ * Bones of an animated character as capsules, one pose per motion capture
+ * frame. The track is the text file written by the MotionViewer's
+ * "Capsules" button (kinematics::WriteCapsuleTrack): a header with the bone
+ * number, the frame number and the frame time, one "bone <name> <radius>"
+ * line per bone, then per frame a "frame <idx>" line and the start and end
+ * point of every bone. The motion loops, the poses in between two frames
+ * are interpolated linearly.
+ */
+class CCapsuleTrack
+{
+    public:
+        CCapsuleTrack();
+
+        bool Load(const std::string &a_rcsFilename);  // the track stays empty if the file can not be read
+        void Clear();
+
+        // applied to the positions read from the file: scale first, then offset
+        inline void SetOffset(const Vector3d &a_rcOffset){ m_Offset = a_rcOffset; }
+        inline void SetScale(const double a_cdScale){ m_dScale = a_cdScale; }
+
+        inline bool IsEmpty() const { return m_iFrameNum == 0; }
+        inline int BoneNum() const { return m_iBoneNum; }
+        inline int FrameNum() const { return m_iFrameNum; }
+        inline double GetFrameTime() const { return m_dFrameTime; }
+
+        int FrameIndex(const double a_cdTime) const;  // frame at or before the time
+        void GetFrame(const int a_ciFrame, std::vector<Capsule> &a_rCapsules) const;
+        void Sample(const double a_cdTime, std::vector<Capsule> &a_rCapsules) const;
+
+    private:
+        // pose between a frame and the next one, the velocity is the one of the whole interval
+        void Interpolate(const int a_ciFrame, const double a_cdFraction, std::vector<Capsule> &a_rCapsules) const;
+
+        int m_iBoneNum;
+        int m_iFrameNum;
+        double m_dFrameTime;
+        Vector3d m_Offset;
+        double m_dScale;
+
+        std::vector<double> m_Radius;       // per bone
+        std::vector<Vector3d> m_Start;      // bone_num entries per frame
+        std::vector<Vector3d> m_End;
+};
+
+#endif
@@ -0,0 +1,327 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include "CClothScene.h"
+#include "CThreadPool.h"
+#include "glut.h"
+
+namespace
+{
+    const int s_ciMinChunk = 256;           // particles per parallel task, across instances
+    const double s_cdRestitution = 0.5;     // same contact as the net of CMassSpringSystem
+    const double s_cdFriction = 25.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Constructor & Destructor                            //
+////////////////////////////////////////////////////////////////////////////////
+CClothScene::CClothScene()
+    :m_Templates(),
+    m_Instances(),
+    m_Position(),
+    m_Velocity(),
+    m_Force()
+{
+}
+
+CClothScene::CClothScene(const CClothScene &a_rcClothScene)
+    :m_Templates(),
+    m_Instances(a_rcClothScene.m_Instances),
+    m_Position(a_rcClothScene.m_Position),
+    m_Velocity(a_rcClothScene.m_Velocity),
+    m_Force(a_rcClothScene.m_Force)
+{
+    CopyTemplates(a_rcClothScene);
+}
+
+CClothScene &CClothScene::operator=(const CClothScene &a_rcClothScene)
+{
+    if(this != &a_rcClothScene)
+    {
+        Clear();
+        CopyTemplates(a_rcClothScene);
+        m_Instances = a_rcClothScene.m_Instances;
+        m_Position = a_rcClothScene.m_Position;
+        m_Velocity = a_rcClothScene.m_Velocity;
+        m_Force = a_rcClothScene.m_Force;
+    }
+    return *this;
+}
+
+CClothScene::~CClothScene()
+{
+    Clear();
+}
+
+void CClothScene::CopyTemplates(const CClothScene &a_rcClothScene)
+{
+    for(size_t uiT = 0 ; uiT<a_rcClothScene.m_Templates.size() ; uiT++)
+    {
+        m_Templates.push_back(new CClothTemplate(*a_rcClothScene.m_Templates[uiT]));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                             Templates & Instances                          //
+////////////////////////////////////////////////////////////////////////////////
+int CClothScene::AddTemplate(GoalNet &a_rGoalNet)
+{
+    m_Templates.push_back(new CClothTemplate(a_rGoalNet));
+    return (int)m_Templates.size() - 1;
+}
+
+int CClothScene::AddInstance(const int a_ciTemplate, const Vector3d &a_rcOffset)
+{
+    if(a_ciTemplate < 0 || a_ciTemplate >= TemplateNum())
+    {
+        printf("[Warning] CClothScene::AddInstance, no template %d\n", a_ciTemplate);
+        return -1;
+    }
+    const CClothTemplate &rcTemplate = *m_Templates[a_ciTemplate];
+    Instance instance;
+    instance.iTemplate = a_ciTemplate;
+    instance.iFirst = ParticleNum();
+    instance.offset = a_rcOffset;
+    m_Instances.push_back(instance);
+
+    // only the state grows, the topology stays in the template
+    for(int iP = 0 ; iP<rcTemplate.ParticleNum() ; iP++)
+    {
+        m_Position.push_back(rcTemplate.GetRestPosition(iP) + a_rcOffset);
+    }
+    m_Velocity.resize(m_Position.size(), Vector3d::ZERO);
+    m_Force.resize(m_Position.size(), Vector3d::ZERO);
+    return (int)m_Instances.size() - 1;
+}
+
+void CClothScene::Clear()
+{
+    ClearInstances();
+    for(size_t uiT = 0 ; uiT<m_Templates.size() ; uiT++)
+    {
+        delete m_Templates[uiT];
+    }
+    m_Templates.clear();
+}
+
+void CClothScene::ClearInstances()
+{
+    m_Instances.clear();
+    m_Position.clear();
+    m_Velocity.clear();
+    m_Force.clear();
+}
+
+void CClothScene::Reset()
+{
+    for(size_t uiI = 0 ; uiI<m_Instances.size() ; uiI++)
+    {
+        const Instance &rcInstance = m_Instances[uiI];
+        const CClothTemplate &rcTemplate = *m_Templates[rcInstance.iTemplate];
+        for(int iP = 0 ; iP<rcTemplate.ParticleNum() ; iP++)
+        {
+            m_Position[rcInstance.iFirst + iP] = rcTemplate.GetRestPosition(iP) + rcInstance.offset;
+        }
+    }
+    std::fill(m_Velocity.begin(), m_Velocity.end(), Vector3d::ZERO);
+    std::fill(m_Force.begin(), m_Force.end(), Vector3d::ZERO);
+}
+
+void CClothScene::SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cSpringType)
+{
+    for(size_t uiT = 0 ; uiT<m_Templates.size() ; uiT++)
+    {
+        m_Templates[uiT]->SetSpringCoef(a_cdSpringCoef, a_cSpringType);
+    }
+}
+
+void CClothScene::SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cSpringType)
+{
+    for(size_t uiT = 0 ; uiT<m_Templates.size() ; uiT++)
+    {
+        m_Templates[uiT]->SetDamperCoef(a_cdDamperCoef, a_cSpringType);
+    }
+}
+
+int CClothScene::FindInstance(const int a_ciParticle) const
+{
+    // last instance starting at or before the particle
+    int iLow = 0;
+    int iHigh = (int)m_Instances.size() - 1;
+    while(iLow < iHigh)
+    {
+        int iMid = (iLow + iHigh + 1)/2;
+        if(m_Instances[iMid].iFirst <= a_ciParticle)
+        {
+            iLow = iMid;
+        }
+        else
+        {
+            iHigh = iMid - 1;
+        }
+    }
+    return iLow;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Update                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CClothScene::Update(
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles
+    )
+{
+    if(m_Instances.empty())
+    {
+        return;
+    }
+
+    // the forces read the positions of the neighbors, so every force is
+    // computed before the first particle moves
+    CThreadPool::Instance().ParallelFor(0, ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        ComputeForce(a_iBegin, a_iEnd, a_cdTime, a_rcForceFields);
+    }, s_ciMinChunk);
+
+    CThreadPool::Instance().ParallelFor(0, ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        Integrate(a_iBegin, a_iEnd, a_cdDeltaT, a_rcObstacles);
+    }, s_ciMinChunk);
+}
+
+void CClothScene::ComputeForce(const int a_ciBegin, const int a_ciEnd, const double a_cdTime, const CForceFieldSet &a_rcForceFields)
+{
+    int iInstance = FindInstance(a_ciBegin);
+    ForceFieldBlock block;
+    for(int iStart = a_ciBegin ; iStart<a_ciEnd ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        // a block may span two instances, only the mass depends on the instance here
+        block.iCount = (a_ciEnd - iStart < ForceFieldBlock::s_ciSize) ? a_ciEnd - iStart : ForceFieldBlock::s_ciSize;
+        int iBlockInstance = iInstance;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            int iIdx = iStart + iI;
+            while(iBlockInstance + 1 < InstanceNum() && m_Instances[iBlockInstance+1].iFirst <= iIdx)
+            {
+                ++iBlockInstance;
+            }
+            const Instance &rcInstance = m_Instances[iBlockInstance];
+            const Vector3d &rcPos = m_Position[iIdx];
+            const Vector3d &rcVel = m_Velocity[iIdx];
+            block.adPosX[iI] = rcPos.x; block.adPosY[iI] = rcPos.y; block.adPosZ[iI] = rcPos.z;
+            block.adVelX[iI] = rcVel.x; block.adVelY[iI] = rcVel.y; block.adVelZ[iI] = rcVel.z;
+            block.adMass[iI] = m_Templates[rcInstance.iTemplate]->GetMass(iIdx - rcInstance.iFirst);
+        }
+
+        a_rcForceFields.Evaluate(block, a_cdTime);
+
+        // springs gathered per particle, both ends of a spring compute it once each
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            int iIdx = iStart + iI;
+            while(iInstance + 1 < InstanceNum() && m_Instances[iInstance+1].iFirst <= iIdx)
+            {
+                ++iInstance;
+            }
+            const Instance &rcInstance = m_Instances[iInstance];
+            const CClothTemplate &rcTemplate = *m_Templates[rcInstance.iTemplate];
+            const int ciLocal = iIdx - rcInstance.iFirst;
+
+            Vector3d force(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]);
+            const Vector3d &rcPos = m_Position[iIdx];
+            const Vector3d &rcVel = m_Velocity[iIdx];
+            for(int iK = rcTemplate.IncidenceBegin(ciLocal) ; iK<rcTemplate.IncidenceEnd(ciLocal) ; iK++)
+            {
+                const CClothTemplate::Incidence &rcIncidence = rcTemplate.GetIncidence(iK);
+                const CClothTemplate::Link &rcLink = rcTemplate.GetLink(rcIncidence.iLink);
+                const int ciOther = rcInstance.iFirst + rcIncidence.iOther;
+
+                // same spring and damper as GoalNet::ComputeInternalForce
+                Vector3d offset = rcPos - m_Position[ciOther];
+                double dLength = offset.Length();
+                if(dLength < 1e-12)
+                {
+                    continue;
+                }
+                Vector3d direction = offset/dLength;
+                double dRelativeSpeed = (rcVel - m_Velocity[ciOther]).DotProduct(direction);
+                force -= direction*(rcLink.dSpringCoef*(dLength - rcLink.dRestLength) + rcLink.dDamperCoef*dRelativeSpeed);
+            }
+            m_Force[iIdx] = force;
+        }
+    }
+}
+
+void CClothScene::Integrate(const int a_ciBegin, const int a_ciEnd, const double a_cdDeltaT, const CObstacleField &a_rcObstacles)
+{
+    int iInstance = FindInstance(a_ciBegin);
+    for(int iIdx = a_ciBegin ; iIdx<a_ciEnd ; iIdx++)
+    {
+        while(iInstance + 1 < InstanceNum() && m_Instances[iInstance+1].iFirst <= iIdx)
+        {
+            ++iInstance;
+        }
+        const Instance &rcInstance = m_Instances[iInstance];
+        const CClothTemplate &rcTemplate = *m_Templates[rcInstance.iTemplate];
+        const int ciLocal = iIdx - rcInstance.iFirst;
+        if(!rcTemplate.IsMovable(ciLocal))
+        {
+            continue;
+        }
+
+        Vector3d &rPos = m_Position[iIdx];
+        Vector3d &rVel = m_Velocity[iIdx];
+        Vector3d &rForce = m_Force[iIdx];
+        a_rcObstacles.ResolveContact(rPos, 0.0, s_cdRestitution, s_cdFriction, rVel, rForce);
+
+        // same order as CMassSpringSystem::ExplicitEuler
+        rPos += rVel*a_cdDeltaT;
+        rVel += rForce*(a_cdDeltaT/rcTemplate.GetMass(ciLocal));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Draw                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CClothScene::Draw(const bool a_cbParticle, const bool a_cbStruct, const bool a_cbShear, const bool a_cbBending)
+{
+    if(m_Instances.empty())
+    {
+        return;
+    }
+    const bool abType[3] = { a_cbStruct, a_cbShear, a_cbBending };
+
+    glPushAttrib(GL_ENABLE_BIT | GL_CURRENT_BIT | GL_POINT_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glPointSize(3.0f);
+        for(size_t uiI = 0 ; uiI<m_Instances.size() ; uiI++)
+        {
+            // every copy draws from its own state with the index lists of the template
+            const Instance &rcInstance = m_Instances[uiI];
+            const CClothTemplate &rcTemplate = *m_Templates[rcInstance.iTemplate];
+            glVertexPointer(3, GL_DOUBLE, sizeof(Vector3d), &m_Position[rcInstance.iFirst]);
+            for(int iType = 0 ; iType<3 ; iType++)
+            {
+                const std::vector<unsigned int> &rcIndex = rcTemplate.GetLineIndex((CSpring::enType_t)iType);
+                if(!abType[iType] || rcIndex.empty())
+                {
+                    continue;
+                }
+                const Vector3d &rcColor = rcTemplate.GetColor((CSpring::enType_t)iType);
+                glColor3d(rcColor.x, rcColor.y, rcColor.z);
+                glDrawElements(GL_LINES, (GLsizei)rcIndex.size(), GL_UNSIGNED_INT, &rcIndex[0]);
+            }
+            if(a_cbParticle)
+            {
+                glColor3d(1.0, 0.0, 0.0);
+                glDrawArrays(GL_POINTS, 0, rcTemplate.ParticleNum());
+            }
+        }
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,72 @@
+#ifndef CCLOTHSCENE_H
+#define CCLOTHSCENE_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CClothTemplate.h"
+#include "CForceField.h"
+#include "CObstacleField.h"
+
+/*
+ * Many cloth objects moving together, a row of goal nets or a field of
+ * flags. Copies of the same template share its topology, an instance only
+ * owns its position, velocity and force arrays, and those of all instances
+ * sit back to back in one flat range. A step is two passes over the thread
+ * pool across that whole range, the spring and field forces first, then
+ * the obstacle contacts and the explicit Euler update, so a scene of many
+ * small objects is cut into chunks just like one big net.
+ */
+class CClothScene
+{
+    public:
+        CClothScene();
+        CClothScene(const CClothScene &a_rcClothScene);
+        CClothScene &operator=(const CClothScene &a_rcClothScene);
+        ~CClothScene();
+
+        int AddTemplate(GoalNet &a_rGoalNet);    // the net has to be at rest, returns the template id
+        int AddInstance(const int a_ciTemplate, const Vector3d &a_rcOffset);   // returns the instance id, -1 for an unknown template
+        void Clear();                   // drops the templates and the instances
+        void ClearInstances();
+        void Reset();                   // every instance back to its rest state
+
+        void SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cSpringType);
+        void SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cSpringType);
+
+        inline int TemplateNum() const { return (int)m_Templates.size(); }
+        inline int InstanceNum() const { return (int)m_Instances.size(); }
+        inline int ParticleNum() const { return (int)m_Position.size(); }
+        inline const Vector3d &GetPosition(const int a_ciInstance, const int a_ciParticle) const { return m_Position[m_Instances[a_ciInstance].iFirst + a_ciParticle]; }
+        inline const Vector3d &GetVelocity(const int a_ciInstance, const int a_ciParticle) const { return m_Velocity[m_Instances[a_ciInstance].iFirst + a_ciParticle]; }
+
+        void Update(
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles
+            );
+
+        void Draw(const bool a_cbParticle, const bool a_cbStruct, const bool a_cbShear, const bool a_cbBending);
+
+    private:
+        struct Instance
+        {
+            int iTemplate;
+            int iFirst;                     // first particle in the state arrays
+            Vector3d offset;                // from the rest positions of the template
+        };
+
+        void CopyTemplates(const CClothScene &a_rcClothScene);
+        int FindInstance(const int a_ciParticle) const;
+        void ComputeForce(const int a_ciBegin, const int a_ciEnd, const double a_cdTime, const CForceFieldSet &a_rcForceFields);
+        void Integrate(const int a_ciBegin, const int a_ciEnd, const double a_cdDeltaT, const CObstacleField &a_rcObstacles);
+
+        std::vector<CClothTemplate *> m_Templates;     // owned
+        std::vector<Instance> m_Instances;
+
+        std::vector<Vector3d> m_Position;
+        std::vector<Vector3d> m_Velocity;
+        std::vector<Vector3d> m_Force;
+};
+
+#endif
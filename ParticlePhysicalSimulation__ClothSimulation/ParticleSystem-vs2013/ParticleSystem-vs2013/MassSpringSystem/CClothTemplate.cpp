@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include "CClothTemplate.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CClothTemplate::CClothTemplate(GoalNet &a_rGoalNet)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+
+    m_RestPosition.resize(ciParticleNum);
+    m_Mass.resize(ciParticleNum);
+    m_Movable.resize(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+        m_RestPosition[iP] = rParticle.GetPosition();
+        m_Mass[iP] = rParticle.GetMass();
+        m_Movable[iP] = rParticle.IsMovable() ? 1 : 0;
+    }
+
+    m_Links.resize(ciSpringNum);
+    m_IncidenceStart.assign(ciParticleNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        Link &rLink = m_Links[iS];
+        rLink.iStart = rSpring.GetSpringStartID();
+        rLink.iEnd = rSpring.GetSpringEndID();
+        rLink.dRestLength = rSpring.GetSpringRestLength();
+        rLink.dSpringCoef = rSpring.GetSpringCoef();
+        rLink.dDamperCoef = rSpring.GetDamperCoef();
+        rLink.nType = rSpring.GetSpringType();
+        m_Color[rLink.nType] = rSpring.GetSpringColor();
+        m_LineIndex[rLink.nType].push_back((unsigned int)rLink.iStart);
+        m_LineIndex[rLink.nType].push_back((unsigned int)rLink.iEnd);
+        ++m_IncidenceStart[rLink.iStart+1];
+        ++m_IncidenceStart[rLink.iEnd+1];
+    }
+
+    // springs around every particle, counting sort by particle
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_IncidenceStart[iP+1] += m_IncidenceStart[iP];
+    }
+    m_Incidences.resize(m_IncidenceStart[ciParticleNum]);
+    std::vector<int> cursor(m_IncidenceStart.begin(), m_IncidenceStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        const Link &rcLink = m_Links[iS];
+        Incidence &rAtStart = m_Incidences[cursor[rcLink.iStart]++];
+        rAtStart.iLink = iS;
+        rAtStart.iOther = rcLink.iEnd;
+        Incidence &rAtEnd = m_Incidences[cursor[rcLink.iEnd]++];
+        rAtEnd.iLink = iS;
+        rAtEnd.iOther = rcLink.iStart;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Coefficients                                //
+////////////////////////////////////////////////////////////////////////////////
+void CClothTemplate::SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cSpringType)
+{
+    for(size_t uiL = 0 ; uiL<m_Links.size() ; uiL++)
+    {
+        if(m_Links[uiL].nType == a_cSpringType)
+        {
+            m_Links[uiL].dSpringCoef = a_cdSpringCoef;
+        }
+    }
+}
+
+void CClothTemplate::SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cSpringType)
+{
+    for(size_t uiL = 0 ; uiL<m_Links.size() ; uiL++)
+    {
+        if(m_Links[uiL].nType == a_cSpringType)
+        {
+            m_Links[uiL].dDamperCoef = a_cdDamperCoef;
+        }
+    }
+}
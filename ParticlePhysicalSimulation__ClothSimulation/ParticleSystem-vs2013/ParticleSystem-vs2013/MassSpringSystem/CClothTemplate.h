@@ -0,0 +1,66 @@
+#ifndef CCLOTHTEMPLATE_H
+#define CCLOTHTEMPLATE_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CSpring.h"
+#include "GoalNetModel.h"
+
+/*
+ * Topology of a cloth object, shared by all its copies in a CClothScene:
+ * the rest positions, masses and fixed flags of the particles, the springs
+ * with their rest lengths and coefficients, the springs around every
+ * particle for the force gather and the line indices for drawing. Nothing
+ * in here changes while the copies move.
+ */
+class CClothTemplate
+{
+    public:
+        struct Link
+        {
+            int iStart;
+            int iEnd;
+            double dRestLength;
+            double dSpringCoef;
+            double dDamperCoef;
+            CSpring::enType_t nType;
+        };
+        struct Incidence
+        {
+            int iLink;
+            int iOther;                     // particle at the other end
+        };
+
+        explicit CClothTemplate(GoalNet &a_rGoalNet);   // the net has to be at rest
+
+        void SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cSpringType);
+        void SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cSpringType);
+
+        inline int ParticleNum() const { return (int)m_RestPosition.size(); }
+        inline int SpringNum() const { return (int)m_Links.size(); }
+        inline const Vector3d &GetRestPosition(const int a_ciParticle) const { return m_RestPosition[a_ciParticle]; }
+        inline double GetMass(const int a_ciParticle) const { return m_Mass[a_ciParticle]; }
+        inline bool IsMovable(const int a_ciParticle) const { return m_Movable[a_ciParticle] != 0; }
+        inline const Link &GetLink(const int a_ciLink) const { return m_Links[a_ciLink]; }
+        inline int IncidenceBegin(const int a_ciParticle) const { return m_IncidenceStart[a_ciParticle]; }
+        inline int IncidenceEnd(const int a_ciParticle) const { return m_IncidenceStart[a_ciParticle+1]; }
+        inline const Incidence &GetIncidence(const int a_ciIdx) const { return m_Incidences[a_ciIdx]; }
+
+        // two particle indices per spring of the type, in the order of the links
+        inline const std::vector<unsigned int> &GetLineIndex(const CSpring::enType_t a_cSpringType) const { return m_LineIndex[a_cSpringType]; }
+        inline const Vector3d &GetColor(const CSpring::enType_t a_cSpringType) const { return m_Color[a_cSpringType]; }
+
+    private:
+        static const int s_ciTypeNum = CSpring::Type_nBending + 1;
+
+        std::vector<Vector3d> m_RestPosition;
+        std::vector<double> m_Mass;
+        std::vector<char> m_Movable;
+        std::vector<Link> m_Links;
+        std::vector<int> m_IncidenceStart;  // one extra entry at the end
+        std::vector<Incidence> m_Incidences;
+        std::vector<unsigned int> m_LineIndex[s_ciTypeNum];
+        Vector3d m_Color[s_ciTypeNum];
+};
+
+#endif
@@ -0,0 +1,543 @@
+#include <stdlib.h>
+#include <cmath>
+#include "CContinuousCollider.h"
+
+namespace
+{
+    const double s_cdNetRestitution = 0.0;      // the springs of the net give the bounce
+    const double s_cdObstacleRestitution = 0.3; // as in CMassSpringSystem::BallObstacleCollision()
+    const double s_cdObstacleFriction = 10.0;
+    const double s_cdSkin = 1e-4;               // a hit stops the ball this far before the contact
+    const int s_ciMaxMarchNum = 64;             // conservative advancement steps through the field
+
+    // first t in [0,1] the point o + t*d is r from the center, 0 if it starts inside and goes deeper
+    bool SweepSphere(const Vector3d &a_rcOrigin, const Vector3d &a_rcPath, const Vector3d &a_rcCenter, const double a_cdRadius, double &a_rdTime)
+    {
+        Vector3d m = a_rcOrigin - a_rcCenter;
+        double dC = m.SquaredLength() - a_cdRadius*a_cdRadius;
+        double dA = a_rcPath.SquaredLength();
+        double dB = m.DotProduct(a_rcPath);
+        if(dB >= 0.0 || dA <= 0.0)
+        {
+            return false;
+        }
+        if(dC < 0.0)
+        {
+            a_rdTime = 0.0;
+            return true;
+        }
+        double dDisc = dB*dB - dA*dC;
+        if(dDisc < 0.0)
+        {
+            return false;
+        }
+        a_rdTime = (-dB - sqrt(dDisc))/dA;
+        return a_rdTime <= 1.0;
+    }
+
+    // the same against the infinite cylinder around a b, the hit has to lie between a and b
+    bool SweepCylinder(const Vector3d &a_rcOrigin, const Vector3d &a_rcPath, const Vector3d &a_rcA, const Vector3d &a_rcB, const double a_cdRadius, double &a_rdTime)
+    {
+        Vector3d axis = a_rcB - a_rcA;
+        double dAxis2 = axis.SquaredLength();
+        if(dAxis2 <= 0.0)
+        {
+            return false;
+        }
+        Vector3d m = a_rcOrigin - a_rcA;
+        Vector3d mPerp = m - axis*(m.DotProduct(axis)/dAxis2);
+        Vector3d dPerp = a_rcPath - axis*(a_rcPath.DotProduct(axis)/dAxis2);
+        double dA = dPerp.SquaredLength();
+        double dB = mPerp.DotProduct(dPerp);
+        double dC = mPerp.SquaredLength() - a_cdRadius*a_cdRadius;
+        if(dB >= 0.0 || dA <= 0.0)
+        {
+            return false;
+        }
+        double dTime = 0.0;
+        if(dC >= 0.0)
+        {
+            double dDisc = dB*dB - dA*dC;
+            if(dDisc < 0.0)
+            {
+                return false;
+            }
+            dTime = (-dB - sqrt(dDisc))/dA;
+            if(dTime > 1.0)
+            {
+                return false;
+            }
+        }
+        double dAlong = (m + a_rcPath*dTime).DotProduct(axis)/dAxis2;
+        if(dAlong < 0.0 || dAlong > 1.0)
+        {
+            return false;
+        }
+        a_rdTime = dTime;
+        return true;
+    }
+
+    // the sphere against the triangle grown by the radius: the face, the three edges and the corners
+    bool SweepTriangle(const Vector3d &a_rcOrigin, const Vector3d &a_rcPath, const double a_cdRadius, const Vector3d a_cTri[3], double &a_rdTime)
+    {
+        bool bHit = false;
+        double dTime;
+        Vector3d winding = (a_cTri[1] - a_cTri[0]).CrossProduct(a_cTri[2] - a_cTri[0]);
+        double dArea2 = winding.SquaredLength();
+        if(dArea2 > 0.0)
+        {
+            Vector3d normal = winding/sqrt(dArea2);    // toward the side the ball comes from
+            double dDistance = (a_rcOrigin - a_cTri[0]).DotProduct(normal);
+            if(dDistance < 0.0)
+            {
+                normal = -normal;
+                dDistance = -dDistance;
+            }
+            double dSpeed = a_rcPath.DotProduct(normal);
+            if(dSpeed < 0.0)
+            {
+                // a ball already pressed into the face is caught before its center gets through
+                dTime = (dDistance >= a_cdRadius) ? (dDistance - a_cdRadius)/(-dSpeed) : 0.0;
+                Vector3d contact = a_rcOrigin + a_rcPath*dTime - normal*((dDistance >= a_cdRadius) ? a_cdRadius : dDistance);
+                // inside when it is on the inner side of the three edges
+                bool bInside = dTime <= 1.0;
+                for(int iE = 0 ; iE<3 && bInside ; iE++)
+                {
+                    Vector3d edge = a_cTri[(iE + 1)%3] - a_cTri[iE];
+                    bInside = edge.CrossProduct(contact - a_cTri[iE]).DotProduct(winding) >= 0.0;
+                }
+                if(bInside)
+                {
+                    a_rdTime = dTime;
+                    return true;            // nothing of the triangle is reached before its face
+                }
+            }
+        }
+        for(int iE = 0 ; iE<3 ; iE++)
+        {
+            if(SweepCylinder(a_rcOrigin, a_rcPath, a_cTri[iE], a_cTri[(iE + 1)%3], a_cdRadius, dTime) && (!bHit || dTime < a_rdTime))
+            {
+                a_rdTime = dTime;
+                bHit = true;
+            }
+            if(SweepSphere(a_rcOrigin, a_rcPath, a_cTri[iE], a_cdRadius, dTime) && (!bHit || dTime < a_rdTime))
+            {
+                a_rdTime = dTime;
+                bHit = true;
+            }
+        }
+        return bHit;
+    }
+
+    // closest point of the triangle and its barycentric weights (Ericson 2004, 5.1.5)
+    Vector3d ClosestPoint(const Vector3d &a_rcPoint, const Vector3d a_cTri[3], double a_dWeight[3])
+    {
+        const Vector3d &a = a_cTri[0];
+        const Vector3d &b = a_cTri[1];
+        const Vector3d &c = a_cTri[2];
+        Vector3d ab = b - a;
+        Vector3d ac = c - a;
+        Vector3d ap = a_rcPoint - a;
+        double d1 = ab.DotProduct(ap);
+        double d2 = ac.DotProduct(ap);
+        if(d1 <= 0.0 && d2 <= 0.0)
+        {
+            a_dWeight[0] = 1.0;  a_dWeight[1] = 0.0;  a_dWeight[2] = 0.0;
+            return a;
+        }
+        Vector3d bp = a_rcPoint - b;
+        double d3 = ab.DotProduct(bp);
+        double d4 = ac.DotProduct(bp);
+        if(d3 >= 0.0 && d4 <= d3)
+        {
+            a_dWeight[0] = 0.0;  a_dWeight[1] = 1.0;  a_dWeight[2] = 0.0;
+            return b;
+        }
+        double vc = d1*d4 - d3*d2;
+        if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        {
+            double v = d1/(d1 - d3);
+            a_dWeight[0] = 1.0 - v;  a_dWeight[1] = v;  a_dWeight[2] = 0.0;
+            return a + ab*v;
+        }
+        Vector3d cp = a_rcPoint - c;
+        double d5 = ab.DotProduct(cp);
+        double d6 = ac.DotProduct(cp);
+        if(d6 >= 0.0 && d5 <= d6)
+        {
+            a_dWeight[0] = 0.0;  a_dWeight[1] = 0.0;  a_dWeight[2] = 1.0;
+            return c;
+        }
+        double vb = d5*d2 - d1*d6;
+        if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        {
+            double w = d2/(d2 - d6);
+            a_dWeight[0] = 1.0 - w;  a_dWeight[1] = 0.0;  a_dWeight[2] = w;
+            return a + ac*w;
+        }
+        double va = d3*d6 - d5*d4;
+        if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+        {
+            double w = (d4 - d3)/((d4 - d3) + (d5 - d6));
+            a_dWeight[0] = 0.0;  a_dWeight[1] = 1.0 - w;  a_dWeight[2] = w;
+            return b + (c - b)*w;
+        }
+        double dDenom = 1.0/(va + vb + vc);
+        double v = vb*dDenom;
+        double w = vc*dDenom;
+        a_dWeight[0] = 1.0 - v - w;  a_dWeight[1] = v;  a_dWeight[2] = w;
+        return a + ab*v + ac*w;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CContinuousCollider::CContinuousCollider()
+    :m_bEnable(true),
+    m_iMaxSubstepNum(4),
+    m_iHitNum(0),
+    m_Triangles(),
+    m_iParticleNum(0),
+    m_VertexStart(),
+    m_VertexTriangle(),
+    m_TriangleTorn(),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_NetStart(),
+    m_NetEnd(),
+    m_BallStart()
+{
+}
+
+void CContinuousCollider::Reset()
+{
+    m_iHitNum = 0;
+    m_NetStart.clear();
+    m_BallStart.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Step                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CContinuousCollider::Begin(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls)
+{
+    if(!m_bEnable || a_rBalls.empty())
+    {
+        return;
+    }
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    Sync(a_rGoalNet);
+    m_NetStart.resize(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_NetStart[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+    }
+    m_BallStart.resize(a_rBalls.size());
+    for(size_t uiB = 0 ; uiB<a_rBalls.size() ; uiB++)
+    {
+        m_BallStart[uiB] = a_rBalls[uiB].GetPosition();
+    }
+}
+
+void CContinuousCollider::Resolve(
+    GoalNet &a_rGoalNet,
+    std::vector<Ball> &a_rBalls,
+    const CObstacleField &a_rcObstacles,
+    const double a_cdDeltaT
+    )
+{
+    m_iHitNum = 0;
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    if(!m_bEnable || (int)m_NetStart.size() != ciParticleNum)
+    {
+        return;
+    }
+    m_NetEnd.resize(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_NetEnd[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+    }
+
+    const size_t cuiBallNum = (m_BallStart.size() < a_rBalls.size()) ? m_BallStart.size() : a_rBalls.size();
+    for(size_t uiB = 0 ; uiB<cuiBallNum ; uiB++)
+    {
+        Ball &rBall = a_rBalls[uiB];
+        const double cdRadius = rBall.GetRadius();
+        Vector3d position = m_BallStart[uiB];
+        Vector3d path = rBall.GetPosition() - position;
+        if(path.SquaredLength() <= 0.0)
+        {
+            continue;
+        }
+
+        double dElapsed = 0.0;              // of the step
+        for(int iS = 0 ; iS<m_iMaxSubstepNum ; iS++)
+        {
+            Hit netHit, obstacleHit;
+            bool bNet = SweepNet(position, path, cdRadius, dElapsed, netHit);
+            bool bObstacle = SweepObstacles(a_rcObstacles, position, path, cdRadius, obstacleHit);
+            if(!bNet && !bObstacle)
+            {
+                position += path;
+                break;
+            }
+            const Hit &rcHit = (bNet && (!bObstacle || netHit.dTime <= obstacleHit.dTime)) ? netHit : obstacleHit;
+
+            // back off by the skin so the next sweep starts outside
+            double dLength = path.Length();
+            double dTime = rcHit.dTime - s_cdSkin/dLength;
+            dTime = (dTime > 0.0) ? dTime : 0.0;
+            position += path*dTime;
+            dElapsed += (1.0 - dElapsed)*dTime;
+            rBall.SetPosition(position);
+            ++m_iHitNum;
+
+            if(rcHit.iTriangle >= 0 && !RespondNet(a_rGoalNet, rBall, rcHit.iTriangle, dElapsed) && dTime <= 0.0)
+            {
+                // touching and already moving apart, nothing stops it
+                position += path;
+                break;
+            }
+            else
+            {
+                Vector3d velocity = rBall.GetVelocity();
+                Vector3d force = Vector3d::ZERO;
+                a_rcObstacles.ResolveContact(position, cdRadius, s_cdObstacleRestitution, s_cdObstacleFriction, velocity, force);
+                rBall.SetVelocity(velocity);
+            }
+            // out of substeps the ball waits at the contact
+            path = rBall.GetVelocity()*((1.0 - dElapsed)*a_cdDeltaT);
+        }
+        rBall.SetPosition(position);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Tearing                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CContinuousCollider::Sync(GoalNet &a_rGoalNet)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    if(ciParticleNum != m_iParticleNum)
+    {
+        a_rGoalNet.GetTriangles(m_Triangles);
+        m_iParticleNum = ciParticleNum;
+        const int ciTriangleNum = (int)m_Triangles.size()/3;
+        m_VertexStart.assign(ciParticleNum + 1, 0);
+        for(size_t uiI = 0 ; uiI<m_Triangles.size() ; uiI++)
+        {
+            ++m_VertexStart[m_Triangles[uiI]+1];
+        }
+        for(int iP = 0 ; iP<ciParticleNum ; iP++)
+        {
+            m_VertexStart[iP+1] += m_VertexStart[iP];
+        }
+        m_VertexTriangle.resize(m_Triangles.size());
+        std::vector<int> cursor(m_VertexStart.begin(), m_VertexStart.end() - 1);
+        for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+        {
+            for(int iV = 0 ; iV<3 ; iV++)
+            {
+                m_VertexTriangle[cursor[m_Triangles[3*iT+iV]]++] = iT;
+            }
+        }
+        m_TriangleTorn.clear();
+    }
+
+    if(m_TriangleTorn.empty() || m_iTopologyVersion != a_rGoalNet.GetTopologyVersion())
+    {
+        // after a compaction or a reset the torn edges are the ones without a spring
+        const int ciTriangleNum = (int)m_Triangles.size()/3;
+        m_TriangleTorn.assign(ciTriangleNum, 0);
+        for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+        {
+            const int *pciVertex = &m_Triangles[3*iT];
+            for(int iV = 0 ; iV<3 ; iV++)
+            {
+                if(a_rGoalNet.FindSpring(pciVertex[iV], pciVertex[(iV+1)%3]) < 0)
+                {
+                    m_TriangleTorn[iT] = 1;
+                }
+            }
+        }
+        m_iTopologyVersion = a_rGoalNet.GetTopologyVersion();
+        m_iLogSeen = (int)a_rGoalNet.GetBrokenLog().size();
+        return;
+    }
+
+    const std::vector<int> &rcLog = a_rGoalNet.GetBrokenLog();
+    for( ; m_iLogSeen<(int)rcLog.size() ; m_iLogSeen++)
+    {
+        // the seams of the faces have two springs over the same edge
+        CSpring &rSpring = a_rGoalNet.GetSpring(rcLog[m_iLogSeen]);
+        if(a_rGoalNet.FindSpring(rSpring.GetSpringStartID(), rSpring.GetSpringEndID()) < 0)
+        {
+            MarkTorn(rSpring.GetSpringStartID(), rSpring.GetSpringEndID());
+        }
+    }
+}
+
+void CContinuousCollider::MarkTorn(const int a_ciParticleA, const int a_ciParticleB)
+{
+    // the triangles around one end that have the other end as well, none for a bending spring
+    for(int iK = m_VertexStart[a_ciParticleA] ; iK<m_VertexStart[a_ciParticleA+1] ; iK++)
+    {
+        const int ciTriangle = m_VertexTriangle[iK];
+        const int *pciVertex = &m_Triangles[3*ciTriangle];
+        if(pciVertex[0] == a_ciParticleB || pciVertex[1] == a_ciParticleB || pciVertex[2] == a_ciParticleB)
+        {
+            m_TriangleTorn[ciTriangle] = 1;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Sweeps                                   //
+////////////////////////////////////////////////////////////////////////////////
+Vector3d CContinuousCollider::TrianglePoint(const int a_ciVertex, const double a_cdElapsed) const
+{
+    return m_NetStart[a_ciVertex] + (m_NetEnd[a_ciVertex] - m_NetStart[a_ciVertex])*a_cdElapsed;
+}
+
+bool CContinuousCollider::SweepNet(
+    const Vector3d &a_rcStart,
+    const Vector3d &a_rcPath,
+    const double a_cdRadius,
+    const double a_cdElapsed,
+    Hit &a_rHit
+    ) const
+{
+    bool bHit = false;
+    const double cdRest = 1.0 - a_cdElapsed;
+    const int ciTriangleNum = (int)m_Triangles.size()/3;
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        if(m_TriangleTorn[iT])
+        {
+            continue;
+        }
+        const int *pciVertex = &m_Triangles[3*iT];
+        Vector3d tri[3];
+        Vector3d motion = Vector3d::ZERO;
+        for(int iV = 0 ; iV<3 ; iV++)
+        {
+            tri[iV] = TrianglePoint(pciVertex[iV], a_cdElapsed);
+            motion += m_NetEnd[pciVertex[iV]] - m_NetStart[pciVertex[iV]];
+        }
+        // the ball relative to the triangle moving with its centroid over the rest of the step
+        Vector3d path = a_rcPath - motion*(cdRest/3.0);
+        Vector3d end = a_rcStart + path;
+
+        bool bOverlap = true;
+        for(int iAxis = 0 ; iAxis<3 && bOverlap ; iAxis++)
+        {
+            double dTriMin = tri[0][iAxis];
+            double dTriMax = tri[0][iAxis];
+            for(int iV = 1 ; iV<3 ; iV++)
+            {
+                dTriMin = (tri[iV][iAxis] < dTriMin) ? tri[iV][iAxis] : dTriMin;
+                dTriMax = (tri[iV][iAxis] > dTriMax) ? tri[iV][iAxis] : dTriMax;
+            }
+            double dPathMin = (a_rcStart[iAxis] < end[iAxis]) ? a_rcStart[iAxis] : end[iAxis];
+            double dPathMax = (a_rcStart[iAxis] > end[iAxis]) ? a_rcStart[iAxis] : end[iAxis];
+            bOverlap = dPathMin - a_cdRadius <= dTriMax && dPathMax + a_cdRadius >= dTriMin;
+        }
+        double dTime;
+        if(bOverlap && SweepTriangle(a_rcStart, path, a_cdRadius, tri, dTime) && (!bHit || dTime < a_rHit.dTime))
+        {
+            a_rHit.dTime = dTime;
+            a_rHit.iTriangle = iT;
+            bHit = true;
+        }
+    }
+    return bHit;
+}
+
+bool CContinuousCollider::SweepObstacles(
+    const CObstacleField &a_rcObstacles,
+    const Vector3d &a_rcStart,
+    const Vector3d &a_rcPath,
+    const double a_cdRadius,
+    Hit &a_rHit
+    ) const
+{
+    const double cdLength = a_rcPath.Length();
+    if(!a_rcObstacles.IsBaked() || cdLength <= 0.0)
+    {
+        return false;
+    }
+
+    // the field is never closer than its value, so the ball can move that far
+    double dTime = 0.0;
+    for(int iM = 0 ; iM<s_ciMaxMarchNum ; iM++)
+    {
+        double dDistance;
+        Vector3d normal;
+        if(!a_rcObstacles.Sample(a_rcStart + a_rcPath*dTime, dDistance, normal))
+        {
+            dDistance = a_rcObstacles.GetBandWidth();
+        }
+        double dGap = dDistance - a_cdRadius;
+        if(dGap < 0.0)
+        {
+            return false;                   // a resting contact, BallObstacleCollision() has it
+        }
+        if(dGap <= s_cdSkin)
+        {
+            a_rHit.dTime = dTime;
+            a_rHit.iTriangle = -1;
+            return dTime > 0.0;
+        }
+        dTime += dGap/cdLength;
+        if(dTime > 1.0)
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Response                                  //
+////////////////////////////////////////////////////////////////////////////////
+bool CContinuousCollider::RespondNet(GoalNet &a_rGoalNet, Ball &a_rBall, const int a_ciTriangle, const double a_cdElapsed) const
+{
+    const int *pciVertex = &m_Triangles[3*a_ciTriangle];
+    Vector3d tri[3];
+    for(int iV = 0 ; iV<3 ; iV++)
+    {
+        tri[iV] = TrianglePoint(pciVertex[iV], a_cdElapsed);
+    }
+    double dWeight[3];
+    Vector3d normal = a_rBall.GetPosition() - ClosestPoint(a_rBall.GetPosition(), tri, dWeight);
+    if(normal.SquaredLength() <= 0.0)
+    {
+        return false;
+    }
+    normal.Normalize();
+
+    // the impulse at the contact point, shared by the corners with their weights
+    double dInvMass[3];
+    double dTriangleInvMass = 0.0;
+    Vector3d triangleVelocity = Vector3d::ZERO;
+    for(int iV = 0 ; iV<3 ; iV++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(pciVertex[iV]);
+        dInvMass[iV] = rParticle.IsMovable() ? 1.0/rParticle.GetMass() : 0.0;
+        dTriangleInvMass += dWeight[iV]*dWeight[iV]*dInvMass[iV];
+        triangleVelocity += rParticle.GetVelocity()*dWeight[iV];
+    }
+    double dNormalSpeed = (a_rBall.GetVelocity() - triangleVelocity).DotProduct(normal);
+    if(dNormalSpeed >= 0.0)
+    {
+        return false;
+    }
+    double dImpulse = -(1.0 + s_cdNetRestitution)*dNormalSpeed/(1.0/a_rBall.GetMass() + dTriangleInvMass);
+    a_rBall.AddVelocity(normal*(dImpulse/a_rBall.GetMass()));
+    for(int iV = 0 ; iV<3 ; iV++)
+    {
+        a_rGoalNet.GetParticle(pciVertex[iV]).AddVelocity(normal*(-dImpulse*dWeight[iV]*dInvMass[iV]));
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef CCONTINUOUSCOLLIDER_H
+#define CCONTINUOUSCOLLIDER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "BallModel.h"
+#include "CObstacleField.h"
+
+/*
+ * Continuous collision of the balls with the net and the obstacles. The
+ * positions at the start of a step are kept, and after the integration
+ * every ball is swept from where it was to where it got. Against the net
+ * the sphere is swept through the triangles of its faces: the faces moved
+ * by the plane distance, the edges as cylinders and the corners as
+ * spheres, relative to the motion of the triangle over the step. A ball
+ * already pressed into a triangle and going deeper hits it at once, before
+ * its center gets through. Against the obstacles the distance field is
+ * stepped along the path (conservative advancement). At the first time of
+ * impact the ball is stopped, the net triangle and the ball exchange an
+ * impulse along the contact normal, the velocity into an obstacle bounces,
+ * and the ball goes on with the rest of the step. Only the balls that hit
+ * something are substepped, so a fast throw does not need a small step.
+ * A triangle with a torn edge lets the ball through, the triangles around
+ * the two particles of a torn spring are marked as it breaks.
+ */
+class CContinuousCollider
+{
+    public:
+        CContinuousCollider();
+
+        inline void SetEnable(const bool a_cbEnable){ m_bEnable = a_cbEnable; }
+        inline void SetMaxSubstepNum(const int a_ciMaxSubstepNum){ m_iMaxSubstepNum = (a_ciMaxSubstepNum > 1) ? a_ciMaxSubstepNum : 1; }
+        inline bool IsEnable() const { return m_bEnable; }
+        inline int GetMaxSubstepNum() const { return m_iMaxSubstepNum; }
+        inline int HitNum() const { return m_iHitNum; }    // of the last step
+
+        void Begin(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls);  // before the integration
+        void Resolve(
+            GoalNet &a_rGoalNet,
+            std::vector<Ball> &a_rBalls,
+            const CObstacleField &a_rcObstacles,
+            const double a_cdDeltaT
+            );
+        void Reset();
+
+    private:
+        struct Hit
+        {
+            double dTime;                   // fraction of the swept path
+            int iTriangle;                  // -1 for an obstacle
+        };
+
+        bool SweepNet(
+            const Vector3d &a_rcStart,
+            const Vector3d &a_rcPath,
+            const double a_cdRadius,
+            const double a_cdElapsed,
+            Hit &a_rHit
+            ) const;
+        bool SweepObstacles(
+            const CObstacleField &a_rcObstacles,
+            const Vector3d &a_rcStart,
+            const Vector3d &a_rcPath,
+            const double a_cdRadius,
+            Hit &a_rHit
+            ) const;
+        void Sync(GoalNet &a_rGoalNet);     // follows the torn springs of the net
+        void MarkTorn(const int a_ciParticleA, const int a_ciParticleB);
+        Vector3d TrianglePoint(const int a_ciVertex, const double a_cdElapsed) const;   // linear over the step
+        bool RespondNet(GoalNet &a_rGoalNet, Ball &a_rBall, const int a_ciTriangle, const double a_cdElapsed) const;    // false if they already part
+
+        bool m_bEnable;
+        int m_iMaxSubstepNum;               // sweeps per ball and step
+        int m_iHitNum;
+
+        std::vector<int> m_Triangles;       // three particles each, built for m_iParticleNum
+        int m_iParticleNum;
+        std::vector<int> m_VertexStart;     // triangles around every particle, one extra entry at the end
+        std::vector<int> m_VertexTriangle;
+        std::vector<char> m_TriangleTorn;
+        int m_iTopologyVersion;             // of the net the torn triangles were marked for
+        int m_iLogSeen;
+        std::vector<Vector3d> m_NetStart;   // positions at the start of the step
+        std::vector<Vector3d> m_NetEnd;     // after the integration
+        std::vector<Vector3d> m_BallStart;
+};
+
+#endif
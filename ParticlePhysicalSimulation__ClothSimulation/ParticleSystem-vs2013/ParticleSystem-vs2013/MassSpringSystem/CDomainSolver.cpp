@@ -0,0 +1,582 @@
+#include <stdlib.h>
+#include <algorithm>
+#include "CDomainSolver.h"
+#include "CThreadAffinity.h"
+
+namespace
+{
+    const double s_cdRestitution = 0.5;     // same contact as the net of CMassSpringSystem
+    const double s_cdFriction = 25.0;
+
+    inline double Component(const Vector3d &a_rcVector, const int a_ciAxis)
+    {
+        return (a_ciAxis == 0) ? a_rcVector.x : ((a_ciAxis == 1) ? a_rcVector.y : a_rcVector.z);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Constructor & Destructor                            //
+////////////////////////////////////////////////////////////////////////////////
+CDomainSolver::CDomainSolver()
+    :m_iDomainNum(0),
+    m_bPinThreads(true),
+    m_bBuilt(false),
+    m_iParticleNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_Domains(),
+    m_Owner(),
+    m_Local(),
+    m_Threads(),
+    m_pStartBarrier(NULL),
+    m_pDoneBarrier(NULL),
+    m_pPhaseBarrier(NULL),
+    m_nCommand(Command_nStep),
+    m_pGoalNet(NULL),
+    m_pForceFields(NULL),
+    m_pObstacles(NULL),
+    m_dDeltaT(0.0),
+    m_dTime(0.0),
+    m_dGroundHeight(0.0)
+{
+}
+
+CDomainSolver::CDomainSolver(const CDomainSolver &a_rcDomainSolver)
+    :m_iDomainNum(a_rcDomainSolver.m_iDomainNum),
+    m_bPinThreads(a_rcDomainSolver.m_bPinThreads),
+    m_bBuilt(false),
+    m_iParticleNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_Domains(),
+    m_Owner(),
+    m_Local(),
+    m_Threads(),
+    m_pStartBarrier(NULL),
+    m_pDoneBarrier(NULL),
+    m_pPhaseBarrier(NULL),
+    m_nCommand(Command_nStep),
+    m_pGoalNet(NULL),
+    m_pForceFields(NULL),
+    m_pObstacles(NULL),
+    m_dDeltaT(0.0),
+    m_dTime(0.0),
+    m_dGroundHeight(0.0)
+{
+}
+
+CDomainSolver &CDomainSolver::operator=(const CDomainSolver &a_rcDomainSolver)
+{
+    if(this != &a_rcDomainSolver)
+    {
+        StopThreads();
+        m_Domains.clear();
+        m_iDomainNum = a_rcDomainSolver.m_iDomainNum;
+        m_bPinThreads = a_rcDomainSolver.m_bPinThreads;
+        m_bBuilt = false;
+    }
+    return *this;
+}
+
+CDomainSolver::~CDomainSolver()
+{
+    StopThreads();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Settings                                  //
+////////////////////////////////////////////////////////////////////////////////
+void CDomainSolver::SetDomainNum(const int a_ciDomainNum)
+{
+    int iDomainNum = (a_ciDomainNum > 0) ? a_ciDomainNum : 0;
+    if(iDomainNum != m_iDomainNum)
+    {
+        StopThreads();
+        m_Domains.clear();
+        m_iDomainNum = iDomainNum;
+        m_bBuilt = false;
+    }
+}
+
+void CDomainSolver::SetPinThreads(const bool a_cbPinThreads)
+{
+    if(a_cbPinThreads != m_bPinThreads)
+    {
+        // the threads are started again by the next build
+        m_bPinThreads = a_cbPinThreads;
+        m_bBuilt = false;
+    }
+}
+
+void CDomainSolver::Invalidate()
+{
+    m_bBuilt = false;
+}
+
+int CDomainSolver::HaloNum() const
+{
+    int iNum = 0;
+    for(size_t uiD = 0 ; uiD<m_Domains.size() ; uiD++)
+    {
+        iNum += (int)m_Domains[uiD].Global.size() - m_Domains[uiD].iOwnedNum;
+    }
+    return iNum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Build                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CDomainSolver::Build(GoalNet &a_rGoalNet)
+{
+    StopThreads();
+
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+    const int ciDomainNum = (m_iDomainNum < ciParticleNum) ? m_iDomainNum : ciParticleNum;
+
+    std::vector<Vector3d> position(ciParticleNum);
+    std::vector<int> particles(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        position[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+        particles[iP] = iP;
+    }
+    m_Domains.assign(ciDomainNum, Domain());
+    Bisect(particles, 0, ciDomainNum, position);
+
+    m_Owner.assign(ciParticleNum, 0);
+    m_Local.assign(ciParticleNum, 0);
+    for(int iD = 0 ; iD<ciDomainNum ; iD++)
+    {
+        Domain &rDomain = m_Domains[iD];
+        rDomain.iOwnedNum = (int)rDomain.Global.size();
+        for(int iL = 0 ; iL<rDomain.iOwnedNum ; iL++)
+        {
+            m_Owner[rDomain.Global[iL]] = iD;
+            m_Local[rDomain.Global[iL]] = iL;
+        }
+    }
+
+    // intact springs around every particle, counting sort by particle
+    std::vector<int> incidenceStart(ciParticleNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        ++incidenceStart[rSpring.GetSpringStartID()+1];
+        ++incidenceStart[rSpring.GetSpringEndID()+1];
+    }
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        incidenceStart[iP+1] += incidenceStart[iP];
+    }
+    std::vector<int> incidences(incidenceStart[ciParticleNum]);
+    std::vector<int> cursor(incidenceStart.begin(), incidenceStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        incidences[cursor[rSpring.GetSpringStartID()]++] = iS;
+        incidences[cursor[rSpring.GetSpringEndID()]++] = iS;
+    }
+
+    // local springs of every domain, the far ends outside of it become its halo
+    std::vector<int> haloLocal(ciParticleNum, -1);
+    for(int iD = 0 ; iD<ciDomainNum ; iD++)
+    {
+        Domain &rDomain = m_Domains[iD];
+        rDomain.IncidenceStart.assign(1, 0);
+        for(int iL = 0 ; iL<rDomain.iOwnedNum ; iL++)
+        {
+            const int ciGlobal = rDomain.Global[iL];
+            for(int iK = incidenceStart[ciGlobal] ; iK<incidenceStart[ciGlobal+1] ; iK++)
+            {
+                CSpring &rSpring = a_rGoalNet.GetSpring(incidences[iK]);
+                const int ciOther = (rSpring.GetSpringStartID() == ciGlobal) ? rSpring.GetSpringEndID() : rSpring.GetSpringStartID();
+                Incidence incidence;
+                if(m_Owner[ciOther] == iD)
+                {
+                    incidence.iOther = m_Local[ciOther];
+                }
+                else
+                {
+                    if(haloLocal[ciOther] < 0)
+                    {
+                        haloLocal[ciOther] = (int)rDomain.Global.size();
+                        rDomain.Global.push_back(ciOther);
+                        rDomain.HaloOwner.push_back(m_Owner[ciOther]);
+                        rDomain.HaloSource.push_back(m_Local[ciOther]);
+                    }
+                    incidence.iOther = haloLocal[ciOther];
+                }
+                incidence.iSpring = incidences[iK];
+                incidence.dRestLength = rSpring.GetSpringRestLength();
+                incidence.dSpringCoef = rSpring.GetSpringCoef();
+                incidence.dDamperCoef = rSpring.GetDamperCoef();
+                incidence.bEnergy = (rSpring.GetSpringStartID() == ciGlobal);
+                rDomain.Incidences.push_back(incidence);
+            }
+            rDomain.IncidenceStart.push_back((int)rDomain.Incidences.size());
+        }
+        for(size_t uiH = rDomain.iOwnedNum ; uiH<rDomain.Global.size() ; uiH++)
+        {
+            haloLocal[rDomain.Global[uiH]] = -1;
+        }
+    }
+
+    // the processors of one node next to each other, the bisection numbers
+    // neighboring domains next to each other as well
+    const int ciProcessorNum = CThreadAffinity::ProcessorNum();
+    std::vector<std::pair<int,int> > processors(ciProcessorNum);
+    for(int iC = 0 ; iC<ciProcessorNum ; iC++)
+    {
+        processors[iC] = std::make_pair(CThreadAffinity::NodeOfProcessor(iC), iC);
+    }
+    std::sort(processors.begin(), processors.end());
+    for(int iD = 0 ; iD<ciDomainNum ; iD++)
+    {
+        m_Domains[iD].iProcessor = processors[iD % ciProcessorNum].second;
+    }
+
+    m_iParticleNum = ciParticleNum;
+    m_iTopologyVersion = a_rGoalNet.GetTopologyVersion();
+    m_iLogSeen = (int)a_rGoalNet.GetBrokenLog().size();
+    StartThreads();
+    m_pGoalNet = &a_rGoalNet;
+    Run(Command_nBuild);
+    m_bBuilt = true;
+}
+
+void CDomainSolver::Sync(GoalNet &a_rGoalNet)
+{
+    // called between the steps, the domain threads are waiting
+    const int ciVersion = a_rGoalNet.GetTopologyVersion();
+    if(ciVersion != m_iTopologyVersion)
+    {
+        const std::vector<int> &rcMap = a_rGoalNet.GetCompactionMap();
+        if(ciVersion != m_iTopologyVersion + 1 || rcMap.empty())
+        {
+            Build(a_rGoalNet);
+            return;
+        }
+        // the springs torn since the last step and compacted right away map to -1
+        for(size_t uiD = 0 ; uiD<m_Domains.size() ; uiD++)
+        {
+            std::vector<Incidence> &rIncidences = m_Domains[uiD].Incidences;
+            for(size_t uiK = 0 ; uiK<rIncidences.size() ; uiK++)
+            {
+                Incidence &rIncidence = rIncidences[uiK];
+                rIncidence.iSpring = (rIncidence.iSpring < 0) ? -1 : rcMap[rIncidence.iSpring];
+                if(rIncidence.iSpring < 0)
+                {
+                    rIncidence.dSpringCoef = 0.0;
+                    rIncidence.dDamperCoef = 0.0;
+                }
+            }
+        }
+        m_iTopologyVersion = ciVersion;
+        m_iLogSeen = 0;
+    }
+
+    const std::vector<int> &rcLog = a_rGoalNet.GetBrokenLog();
+    for( ; m_iLogSeen<(int)rcLog.size() ; m_iLogSeen++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(rcLog[m_iLogSeen]);
+        Cut(rcLog[m_iLogSeen], rSpring.GetSpringStartID());
+        Cut(rcLog[m_iLogSeen], rSpring.GetSpringEndID());
+    }
+}
+
+void CDomainSolver::Cut(const int a_ciSpring, const int a_ciParticle)
+{
+    // only the springs of the particle are looked at, the incidence stays with no force
+    Domain &rDomain = m_Domains[m_Owner[a_ciParticle]];
+    const int ciLocal = m_Local[a_ciParticle];
+    for(int iK = rDomain.IncidenceStart[ciLocal] ; iK<rDomain.IncidenceStart[ciLocal+1] ; iK++)
+    {
+        Incidence &rIncidence = rDomain.Incidences[iK];
+        if(rIncidence.iSpring == a_ciSpring)
+        {
+            rIncidence.dSpringCoef = 0.0;
+            rIncidence.dDamperCoef = 0.0;
+        }
+    }
+}
+
+void CDomainSolver::Bisect(std::vector<int> &a_rParticles, const int a_ciFirstDomain, const int a_ciDomainNum, const std::vector<Vector3d> &a_rcPosition)
+{
+    if(a_ciDomainNum == 1)
+    {
+        // in the order of the net, which keeps the rows of the net together
+        std::sort(a_rParticles.begin(), a_rParticles.end());
+        m_Domains[a_ciFirstDomain].Global.swap(a_rParticles);
+        return;
+    }
+
+    // cut across the longest side of the bounding box
+    Vector3d low = a_rcPosition[a_rParticles[0]];
+    Vector3d high = low;
+    for(size_t uiI = 1 ; uiI<a_rParticles.size() ; uiI++)
+    {
+        const Vector3d &rcPos = a_rcPosition[a_rParticles[uiI]];
+        low.x = (rcPos.x < low.x) ? rcPos.x : low.x;
+        low.y = (rcPos.y < low.y) ? rcPos.y : low.y;
+        low.z = (rcPos.z < low.z) ? rcPos.z : low.z;
+        high.x = (rcPos.x > high.x) ? rcPos.x : high.x;
+        high.y = (rcPos.y > high.y) ? rcPos.y : high.y;
+        high.z = (rcPos.z > high.z) ? rcPos.z : high.z;
+    }
+    Vector3d size = high - low;
+    const int ciAxis = (size.x >= size.y && size.x >= size.z) ? 0 : ((size.y >= size.z) ? 1 : 2);
+
+    // the particles are shared in proportion to the domains on each side
+    const int ciLowDomainNum = a_ciDomainNum/2;
+    const size_t cuiCut = a_rParticles.size()*ciLowDomainNum/a_ciDomainNum;
+    std::nth_element(a_rParticles.begin(), a_rParticles.begin() + cuiCut, a_rParticles.end(), [&](int a_iA, int a_iB)
+    {
+        return Component(a_rcPosition[a_iA], ciAxis) < Component(a_rcPosition[a_iB], ciAxis);
+    });
+    std::vector<int> lowSide(a_rParticles.begin(), a_rParticles.begin() + cuiCut);
+    std::vector<int> highSide(a_rParticles.begin() + cuiCut, a_rParticles.end());
+    Bisect(lowSide, a_ciFirstDomain, ciLowDomainNum, a_rcPosition);
+    Bisect(highSide, a_ciFirstDomain + ciLowDomainNum, a_ciDomainNum - ciLowDomainNum, a_rcPosition);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Threads                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CDomainSolver::StartThreads()
+{
+    const int ciDomainNum = (int)m_Domains.size();
+    m_pStartBarrier = new CBarrier(ciDomainNum + 1);
+    m_pDoneBarrier = new CBarrier(ciDomainNum + 1);
+    m_pPhaseBarrier = new CBarrier(ciDomainNum);
+    for(int iD = 0 ; iD<ciDomainNum ; iD++)
+    {
+        m_Threads.push_back(std::thread(&CDomainSolver::ThreadLoop, this, iD));
+    }
+}
+
+void CDomainSolver::StopThreads()
+{
+    if(m_Threads.empty())
+    {
+        return;
+    }
+    m_nCommand = Command_nStop;
+    m_pStartBarrier->Wait();
+    for(size_t uiT = 0 ; uiT<m_Threads.size() ; uiT++)
+    {
+        m_Threads[uiT].join();
+    }
+    m_Threads.clear();
+    delete m_pStartBarrier;
+    delete m_pDoneBarrier;
+    delete m_pPhaseBarrier;
+    m_pStartBarrier = NULL;
+    m_pDoneBarrier = NULL;
+    m_pPhaseBarrier = NULL;
+}
+
+void CDomainSolver::Run(const enCommand_t a_cCommand)
+{
+    m_nCommand = a_cCommand;
+    m_pStartBarrier->Wait();
+    m_pDoneBarrier->Wait();
+}
+
+void CDomainSolver::ThreadLoop(const int a_ciDomain)
+{
+    if(m_bPinThreads)
+    {
+        CThreadAffinity::PinCurrentThread(m_Domains[a_ciDomain].iProcessor);
+    }
+    for(;;)
+    {
+        m_pStartBarrier->Wait();
+        const enCommand_t cCommand = m_nCommand;
+        if(cCommand == Command_nStop)
+        {
+            return;
+        }
+        if(cCommand == Command_nBuild)
+        {
+            Localize(m_Domains[a_ciDomain]);
+        }
+        else
+        {
+            StepDomain(m_Domains[a_ciDomain]);
+        }
+        m_pDoneBarrier->Wait();
+    }
+}
+
+void CDomainSolver::Localize(Domain &a_rDomain)
+{
+    // copied on the pinned thread, so the pages are first touched on its node
+    std::vector<int>(a_rDomain.Global).swap(a_rDomain.Global);
+    std::vector<int>(a_rDomain.HaloOwner).swap(a_rDomain.HaloOwner);
+    std::vector<int>(a_rDomain.HaloSource).swap(a_rDomain.HaloSource);
+    std::vector<int>(a_rDomain.IncidenceStart).swap(a_rDomain.IncidenceStart);
+    std::vector<Incidence>(a_rDomain.Incidences).swap(a_rDomain.Incidences);
+
+    const size_t cuiNum = a_rDomain.Global.size();
+    a_rDomain.Mass.resize(cuiNum);
+    a_rDomain.Movable.resize(cuiNum);
+    a_rDomain.Position.resize(cuiNum);
+    a_rDomain.Velocity.resize(cuiNum);
+    a_rDomain.Force.resize(cuiNum);
+    for(size_t uiL = 0 ; uiL<cuiNum ; uiL++)
+    {
+        CParticle &rParticle = m_pGoalNet->GetParticle(a_rDomain.Global[uiL]);
+        a_rDomain.Mass[uiL] = rParticle.GetMass();
+        a_rDomain.Movable[uiL] = rParticle.IsMovable() ? 1 : 0;
+        a_rDomain.Position[uiL] = rParticle.GetPosition();
+        a_rDomain.Velocity[uiL] = rParticle.GetVelocity();
+        a_rDomain.Force[uiL] = Vector3d::ZERO;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Step                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CDomainSolver::Step(
+    GoalNet &a_rGoalNet,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles,
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const double a_cdGroundHeight,
+    EnergySample &a_rSample
+    )
+{
+    if(!IsEnable() || a_rGoalNet.ParticleNum() == 0)
+    {
+        return;
+    }
+    if(!m_bBuilt || a_rGoalNet.ParticleNum() != m_iParticleNum)
+    {
+        Build(a_rGoalNet);
+    }
+    else
+    {
+        Sync(a_rGoalNet);
+    }
+
+    m_pGoalNet = &a_rGoalNet;
+    m_pForceFields = &a_rcForceFields;
+    m_pObstacles = &a_rcObstacles;
+    m_dDeltaT = a_cdDeltaT;
+    m_dTime = a_cdTime;
+    m_dGroundHeight = a_cdGroundHeight;
+    Run(Command_nStep);
+
+    for(size_t uiD = 0 ; uiD<m_Domains.size() ; uiD++)
+    {
+        const EnergySample &rcSample = m_Domains[uiD].Sample;
+        a_rSample.dKinetic += rcSample.dKinetic;
+        a_rSample.dSpring += rcSample.dSpring;
+        a_rSample.dMassHeight += rcSample.dMassHeight;
+        a_rSample.dMass += rcSample.dMass;
+        a_rSample.dMaxSpeedSq = (rcSample.dMaxSpeedSq > a_rSample.dMaxSpeedSq) ? rcSample.dMaxSpeedSq : a_rSample.dMaxSpeedSq;
+    }
+}
+
+void CDomainSolver::StepDomain(Domain &a_rDomain)
+{
+    const int ciOwnedNum = a_rDomain.iOwnedNum;
+
+    // the own particles from the net, forces of the ball and fluid coupling included
+    for(int iL = 0 ; iL<ciOwnedNum ; iL++)
+    {
+        CParticle &rParticle = m_pGoalNet->GetParticle(a_rDomain.Global[iL]);
+        a_rDomain.Position[iL] = rParticle.GetPosition();
+        a_rDomain.Velocity[iL] = rParticle.GetVelocity();
+        a_rDomain.Force[iL] = rParticle.GetForce();
+    }
+    m_pPhaseBarrier->Wait();
+
+    // halo exchange, every owner is done importing
+    for(size_t uiH = 0 ; uiH<a_rDomain.HaloOwner.size() ; uiH++)
+    {
+        const Domain &rcOwner = m_Domains[a_rDomain.HaloOwner[uiH]];
+        const int ciSource = a_rDomain.HaloSource[uiH];
+        a_rDomain.Position[ciOwnedNum + uiH] = rcOwner.Position[ciSource];
+        a_rDomain.Velocity[ciOwnedNum + uiH] = rcOwner.Velocity[ciSource];
+    }
+    // nobody moves a particle before every halo is read
+    m_pPhaseBarrier->Wait();
+
+    EnergySample &rSample = a_rDomain.Sample;
+    rSample.Clear();
+    ForceFieldBlock block;
+    for(int iStart = 0 ; iStart<ciOwnedNum ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        block.iCount = (ciOwnedNum - iStart < ForceFieldBlock::s_ciSize) ? ciOwnedNum - iStart : ForceFieldBlock::s_ciSize;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            const Vector3d &rcPos = a_rDomain.Position[iStart + iI];
+            const Vector3d &rcVel = a_rDomain.Velocity[iStart + iI];
+            block.adPosX[iI] = rcPos.x; block.adPosY[iI] = rcPos.y; block.adPosZ[iI] = rcPos.z;
+            block.adVelX[iI] = rcVel.x; block.adVelY[iI] = rcVel.y; block.adVelZ[iI] = rcVel.z;
+            block.adMass[iI] = a_rDomain.Mass[iStart + iI];
+        }
+
+        m_pForceFields->Evaluate(block, m_dTime);
+
+        // springs gathered per particle, same spring and damper as GoalNet::ComputeInternalForce
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            const int ciL = iStart + iI;
+            Vector3d force = a_rDomain.Force[ciL] + Vector3d(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]);
+            const Vector3d &rcPos = a_rDomain.Position[ciL];
+            const Vector3d &rcVel = a_rDomain.Velocity[ciL];
+            for(int iK = a_rDomain.IncidenceStart[ciL] ; iK<a_rDomain.IncidenceStart[ciL+1] ; iK++)
+            {
+                const Incidence &rcIncidence = a_rDomain.Incidences[iK];
+                Vector3d offset = rcPos - a_rDomain.Position[rcIncidence.iOther];
+                double dLength = offset.Length();
+                if(dLength < 1e-12)
+                {
+                    continue;
+                }
+                Vector3d direction = offset/dLength;
+                double dStretch = dLength - rcIncidence.dRestLength;
+                double dRelativeSpeed = (rcVel - a_rDomain.Velocity[rcIncidence.iOther]).DotProduct(direction);
+                force -= direction*(rcIncidence.dSpringCoef*dStretch + rcIncidence.dDamperCoef*dRelativeSpeed);
+                if(rcIncidence.bEnergy)
+                {
+                    rSample.dSpring += 0.5*rcIncidence.dSpringCoef*dStretch*dStretch;
+                }
+            }
+            a_rDomain.Force[ciL] = force;
+        }
+    }
+
+    // contacts and explicit Euler in the order of CMassSpringSystem
+    for(int iL = 0 ; iL<ciOwnedNum ; iL++)
+    {
+        Vector3d &rPos = a_rDomain.Position[iL];
+        Vector3d &rVel = a_rDomain.Velocity[iL];
+        if(a_rDomain.Movable[iL])
+        {
+            m_pObstacles->ResolveContact(rPos, 0.0, s_cdRestitution, s_cdFriction, rVel, a_rDomain.Force[iL]);
+        }
+        rSample.AddBody(a_rDomain.Mass[iL], rPos.y - m_dGroundHeight, rVel);
+        if(a_rDomain.Movable[iL])
+        {
+            rPos += rVel*m_dDeltaT;
+            rVel += a_rDomain.Force[iL]*(m_dDeltaT/a_rDomain.Mass[iL]);
+        }
+
+        CParticle &rParticle = m_pGoalNet->GetParticle(a_rDomain.Global[iL]);
+        rParticle.SetPosition(rPos);
+        rParticle.SetVelocity(rVel);
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef CDOMAINSOLVER_H
+#define CDOMAINSOLVER_H
+
+#include <vector>
+#include <thread>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "CForceField.h"
+#include "CObstacleField.h"
+#include "CEnergyMonitor.h"
+#include "CBarrier.h"
+
+/*
+ * Explicit Euler for a large net cut into spatial domains, one persistent
+ * thread per domain. The net is split by recursive coordinate bisection,
+ * so a domain only shares the particles along its cut with its neighbors.
+ * Every domain keeps its own particles first and a halo of copies of the
+ * neighbor particles its springs reach, and the halo is refreshed from
+ * the owners between the phases of a step. The threads are pinned to the
+ * processors of one NUMA node after the other, neighboring domains on
+ * the same node, and each thread allocates its own arrays so they are
+ * placed in the memory of its node. The net stays the state everything
+ * else reads, the domains take it in and give it back in every step.
+ * A torn spring is switched off in the two domains holding its ends, and a
+ * compaction of the net springs only renumbers the incidences, the net is
+ * cut again only after a reset.
+ */
+class CDomainSolver
+{
+    public:
+        CDomainSolver();
+        CDomainSolver(const CDomainSolver &a_rcDomainSolver);   // copies the settings, not the threads
+        CDomainSolver &operator=(const CDomainSolver &a_rcDomainSolver);
+        ~CDomainSolver();
+
+        void SetDomainNum(const int a_ciDomainNum);             // 0 turns the solver off
+        inline int GetDomainNum() const { return m_iDomainNum; }
+        inline bool IsEnable() const { return m_iDomainNum > 0; }
+        void SetPinThreads(const bool a_cbPinThreads);
+        inline bool IsPinThreads() const { return m_bPinThreads; }
+
+        void Invalidate();              // the springs changed, cut the net again on the next step
+        int HaloNum() const;            // halo particles of all domains
+
+        // one step of the net, the forces already on the particles are kept,
+        // the bodies and springs of the net are added to the energy sample
+        void Step(
+            GoalNet &a_rGoalNet,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles,
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const double a_cdGroundHeight,      // of the energy sample
+            EnergySample &a_rSample
+            );
+
+    private:
+        enum enCommand_t
+        {
+            Command_nBuild = 0,
+            Command_nStep,
+            Command_nStop
+        };
+
+        struct Incidence
+        {
+            int iOther;                     // local index of the particle at the other end
+            int iSpring;                    // in the net, -1 once compacted away
+            double dRestLength;
+            double dSpringCoef;
+            double dDamperCoef;
+            bool bEnergy;                   // every spring is counted by one domain only
+        };
+
+        struct Domain
+        {
+            int iProcessor;
+            int iOwnedNum;
+            std::vector<int> Global;        // owned particles first, then the halo
+            std::vector<int> HaloOwner;     // per halo particle, its domain
+            std::vector<int> HaloSource;    // and its local index there
+            std::vector<int> IncidenceStart;    // per owned particle, one extra entry at the end
+            std::vector<Incidence> Incidences;
+            std::vector<double> Mass;
+            std::vector<char> Movable;
+            std::vector<Vector3d> Position;
+            std::vector<Vector3d> Velocity;
+            std::vector<Vector3d> Force;
+            EnergySample Sample;
+        };
+
+        void Build(GoalNet &a_rGoalNet);
+        void Sync(GoalNet &a_rGoalNet);     // follows the torn springs of the net
+        void Cut(const int a_ciSpring, const int a_ciParticle);
+        void Bisect(std::vector<int> &a_rParticles, const int a_ciFirstDomain, const int a_ciDomainNum, const std::vector<Vector3d> &a_rcPosition);
+        void StartThreads();
+        void StopThreads();
+        void Run(const enCommand_t a_cCommand);
+
+        void ThreadLoop(const int a_ciDomain);
+        void Localize(Domain &a_rDomain);
+        void StepDomain(Domain &a_rDomain);
+
+        int m_iDomainNum;
+        bool m_bPinThreads;
+        bool m_bBuilt;
+        int m_iParticleNum;
+        int m_iTopologyVersion;
+        int m_iLogSeen;                     // entries of the broken log already cut
+
+        std::vector<Domain> m_Domains;
+        std::vector<int> m_Owner;           // domain of every particle of the net
+        std::vector<int> m_Local;           // and its index there
+        std::vector<std::thread> m_Threads;
+        CBarrier *m_pStartBarrier;      // the domain threads and the caller
+        CBarrier *m_pDoneBarrier;
+        CBarrier *m_pPhaseBarrier;      // the domain threads only
+        enCommand_t m_nCommand;
+
+        // arguments of the running command
+        GoalNet *m_pGoalNet;
+        const CForceFieldSet *m_pForceFields;
+        const CObstacleField *m_pObstacles;
+        double m_dDeltaT;
+        double m_dTime;
+        double m_dGroundHeight;
+};
+
+#endif
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "CDrapeSolver.h"
+
+namespace
+{
+    const int s_ciHistoryNum = 8;               // correction pairs of L-BFGS
+    const int s_ciMaxBacktrackNum = 30;
+    const double s_cdArmijo = 1e-4;
+    const double s_cdRelativeTolerance = 1e-4;  // largest residual force over the largest load
+    const char s_cacMagic[4] = { 'D', 'R', 'P', '1' };
+
+    // FNV-1a over the bytes of a value
+    template<class T>
+    void HashValue(unsigned long long &a_rulHash, const T &a_rcValue)
+    {
+        const unsigned char *pcByte = reinterpret_cast<const unsigned char *>(&a_rcValue);
+        for(size_t uiI = 0 ; uiI<sizeof(T) ; uiI++)
+        {
+            a_rulHash ^= pcByte[uiI];
+            a_rulHash *= 1099511628211ULL;
+        }
+    }
+
+    double Dot(const std::vector<double> &a_rcA, const std::vector<double> &a_rcB)
+    {
+        double dSum = 0.0;
+        for(size_t uiI = 0 ; uiI<a_rcA.size() ; uiI++)
+        {
+            dSum += a_rcA[uiI]*a_rcB[uiI];
+        }
+        return dSum;
+    }
+
+    double MaxAbs(const std::vector<double> &a_rcA)
+    {
+        double dMax = 0.0;
+        for(size_t uiI = 0 ; uiI<a_rcA.size() ; uiI++)
+        {
+            dMax = (fabs(a_rcA[uiI]) > dMax) ? fabs(a_rcA[uiI]) : dMax;
+        }
+        return dMax;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CDrapeSolver::CDrapeSolver()
+    :m_sCacheDir("."),
+    m_iMaxIterationNum(2000),
+    m_iIterationNum(0),
+    m_bLastValid(false),
+    m_ulLastKey(0),
+    m_Equilibrium()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Drape                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CDrapeSolver::Drape(GoalNet &a_rGoalNet, const CForceFieldSet &a_rcForceFields)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    if(ciParticleNum == 0)
+    {
+        return true;
+    }
+
+    // the load of the fields at rest, the net is still at its lattice positions
+    std::vector<Vector3d> load(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        a_rGoalNet.GetParticle(iP).SetVelocity(Vector3d::ZERO);
+        a_rGoalNet.GetParticle(iP).SetForce(Vector3d::ZERO);
+    }
+    a_rcForceFields.Apply(a_rGoalNet, 0.0);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        load[iP] = a_rGoalNet.GetParticle(iP).GetForce();
+    }
+
+    const unsigned long long culKey = Key(a_rGoalNet, load);
+    bool bConverged = true;
+    m_iIterationNum = 0;
+    if(!(m_bLastValid && m_ulLastKey == culKey) && !Load(culKey, ciParticleNum))
+    {
+        bConverged = Solve(a_rGoalNet, load);
+        if(bConverged)
+        {
+            Save(culKey);
+        }
+        else
+        {
+            printf("[Warning] CDrapeSolver::Drape, no equilibrium after %d iterations, the net starts from the last one.\n", m_iIterationNum);
+        }
+    }
+    m_bLastValid = bConverged;
+    m_ulLastKey = culKey;
+
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+        rParticle.SetPosition(m_Equilibrium[iP]);
+        rParticle.SetVelocity(Vector3d::ZERO);
+        rParticle.SetForce(Vector3d::ZERO);
+    }
+    return bConverged;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Cache                                    //
+////////////////////////////////////////////////////////////////////////////////
+unsigned long long CDrapeSolver::Key(GoalNet &a_rGoalNet, const std::vector<Vector3d> &a_rcLoad) const
+{
+    unsigned long long ulHash = 14695981039346656037ULL;
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+    HashValue(ulHash, ciParticleNum);
+    HashValue(ulHash, ciSpringNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+        const Vector3d cPos = rParticle.GetPosition();
+        HashValue(ulHash, cPos.x);
+        HashValue(ulHash, cPos.y);
+        HashValue(ulHash, cPos.z);
+        HashValue(ulHash, rParticle.GetMass());
+        HashValue(ulHash, (char)(rParticle.IsMovable() ? 1 : 0));
+        HashValue(ulHash, a_rcLoad[iP].x);
+        HashValue(ulHash, a_rcLoad[iP].y);
+        HashValue(ulHash, a_rcLoad[iP].z);
+    }
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        HashValue(ulHash, rSpring.GetSpringStartID());
+        HashValue(ulHash, rSpring.GetSpringEndID());
+        HashValue(ulHash, rSpring.GetSpringRestLength());
+        HashValue(ulHash, rSpring.GetSpringCoef());
+        HashValue(ulHash, (char)(rSpring.IsBroken() ? 1 : 0));
+    }
+    return ulHash;
+}
+
+std::string CDrapeSolver::CacheFilename(const unsigned long long a_culKey) const
+{
+    char acName[32];
+    sprintf(acName, "drape_%016llx.bin", a_culKey);
+    return m_sCacheDir + "/" + acName;
+}
+
+bool CDrapeSolver::Load(const unsigned long long a_culKey, const int a_ciParticleNum)
+{
+    FILE *pFile = fopen(CacheFilename(a_culKey).c_str(), "rb");
+    if(pFile == NULL)
+    {
+        return false;
+    }
+    char acMagic[4];
+    unsigned long long ulKey = 0;
+    int iParticleNum = 0;
+    bool bValid = fread(acMagic, 1, 4, pFile) == 4
+        && acMagic[0] == s_cacMagic[0] && acMagic[1] == s_cacMagic[1] && acMagic[2] == s_cacMagic[2] && acMagic[3] == s_cacMagic[3]
+        && fread(&ulKey, sizeof(ulKey), 1, pFile) == 1 && ulKey == a_culKey
+        && fread(&iParticleNum, sizeof(iParticleNum), 1, pFile) == 1 && iParticleNum == a_ciParticleNum;
+    std::vector<double> position;
+    if(bValid)
+    {
+        position.resize(3*iParticleNum);
+        bValid = fread(&position[0], sizeof(double), position.size(), pFile) == position.size();
+    }
+    fclose(pFile);
+    if(!bValid)
+    {
+        printf("[Warning] CDrapeSolver::Load, %s does not match, solving again.\n", CacheFilename(a_culKey).c_str());
+        return false;
+    }
+    m_Equilibrium.resize(iParticleNum);
+    for(int iP = 0 ; iP<iParticleNum ; iP++)
+    {
+        m_Equilibrium[iP] = Vector3d(position[3*iP], position[3*iP+1], position[3*iP+2]);
+    }
+    return true;
+}
+
+void CDrapeSolver::Save(const unsigned long long a_culKey) const
+{
+    FILE *pFile = fopen(CacheFilename(a_culKey).c_str(), "wb");
+    if(pFile == NULL)
+    {
+        printf("[Warning] CDrapeSolver::Save, can not write %s.\n", CacheFilename(a_culKey).c_str());
+        return;
+    }
+    const int ciParticleNum = (int)m_Equilibrium.size();
+    std::vector<double> position(3*ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        position[3*iP] = m_Equilibrium[iP].x;
+        position[3*iP+1] = m_Equilibrium[iP].y;
+        position[3*iP+2] = m_Equilibrium[iP].z;
+    }
+    fwrite(s_cacMagic, 1, 4, pFile);
+    fwrite(&a_culKey, sizeof(a_culKey), 1, pFile);
+    fwrite(&ciParticleNum, sizeof(ciParticleNum), 1, pFile);
+    fwrite(&position[0], sizeof(double), position.size(), pFile);
+    fclose(pFile);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Solve                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CDrapeSolver::Solve(GoalNet &a_rGoalNet, const std::vector<Vector3d> &a_rcLoad)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    std::vector<int> free;
+    double dMaxLoad = 0.0;
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        if(a_rGoalNet.GetParticle(iP).IsMovable())
+        {
+            free.push_back(iP);
+            dMaxLoad = (a_rcLoad[iP].Length() > dMaxLoad) ? a_rcLoad[iP].Length() : dMaxLoad;
+        }
+    }
+    const double cdTolerance = s_cdRelativeTolerance*((dMaxLoad > 0.0) ? dMaxLoad : 1.0);
+    const int ciDofNum = 3*(int)free.size();
+
+    // the stiffest particle bounds the curvature, the first step is safe with its inverse
+    std::vector<double> stiffness(ciParticleNum, 0.0);
+    for(int iS = 0 ; iS<a_rGoalNet.SpringNum() ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(!rSpring.IsBroken())
+        {
+            stiffness[rSpring.GetSpringStartID()] += rSpring.GetSpringCoef();
+            stiffness[rSpring.GetSpringEndID()] += rSpring.GetSpringCoef();
+        }
+    }
+    double dMaxStiffness = 0.0;
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        dMaxStiffness = (stiffness[iP] > dMaxStiffness) ? stiffness[iP] : dMaxStiffness;
+    }
+    double dGamma = (dMaxStiffness > 0.0) ? 1.0/dMaxStiffness : 1.0;
+
+    std::vector<double> rest(ciDofNum), x(ciDofNum), gradient(ciDofNum);
+    for(size_t uiF = 0 ; uiF<free.size() ; uiF++)
+    {
+        const Vector3d cPos = a_rGoalNet.GetParticle(free[uiF]).GetPosition();
+        rest[3*uiF] = cPos.x;
+        rest[3*uiF+1] = cPos.y;
+        rest[3*uiF+2] = cPos.z;
+    }
+    x = rest;
+    double dEnergy = Evaluate(a_rGoalNet, free, a_rcLoad, rest, x, gradient);
+
+    std::vector< std::vector<double> > s, y;
+    std::vector<double> rho;
+    std::vector<double> direction(ciDofNum), xNext(ciDofNum), gradientNext(ciDofNum), alpha(s_ciHistoryNum);
+    bool bConverged = false;
+    for(m_iIterationNum = 0 ; m_iIterationNum<m_iMaxIterationNum ; m_iIterationNum++)
+    {
+        if(MaxAbs(gradient) < cdTolerance)
+        {
+            bConverged = true;
+            break;
+        }
+
+        // two loop recursion, newest pair last
+        direction = gradient;
+        for(int iH = (int)s.size() - 1 ; iH>=0 ; iH--)
+        {
+            alpha[iH] = rho[iH]*Dot(s[iH], direction);
+            for(int iD = 0 ; iD<ciDofNum ; iD++)
+            {
+                direction[iD] -= alpha[iH]*y[iH][iD];
+            }
+        }
+        for(int iD = 0 ; iD<ciDofNum ; iD++)
+        {
+            direction[iD] *= dGamma;
+        }
+        for(int iH = 0 ; iH<(int)s.size() ; iH++)
+        {
+            const double cdBeta = rho[iH]*Dot(y[iH], direction);
+            for(int iD = 0 ; iD<ciDofNum ; iD++)
+            {
+                direction[iD] += (alpha[iH] - cdBeta)*s[iH][iD];
+            }
+        }
+        for(int iD = 0 ; iD<ciDofNum ; iD++)
+        {
+            direction[iD] = -direction[iD];
+        }
+        double dSlope = Dot(gradient, direction);
+        if(dSlope >= 0.0)
+        {
+            // the history lost the descent, start over from steepest descent
+            s.clear();
+            y.clear();
+            rho.clear();
+            for(int iD = 0 ; iD<ciDofNum ; iD++)
+            {
+                direction[iD] = -dGamma*gradient[iD];
+            }
+            dSlope = Dot(gradient, direction);
+        }
+
+        // backtracking to sufficient decrease
+        double dStep = 1.0;
+        double dEnergyNext = dEnergy;
+        bool bAccepted = false;
+        for(int iB = 0 ; iB<s_ciMaxBacktrackNum ; iB++)
+        {
+            for(int iD = 0 ; iD<ciDofNum ; iD++)
+            {
+                xNext[iD] = x[iD] + dStep*direction[iD];
+            }
+            dEnergyNext = Evaluate(a_rGoalNet, free, a_rcLoad, rest, xNext, gradientNext);
+            if(dEnergyNext <= dEnergy + s_cdArmijo*dStep*dSlope)
+            {
+                bAccepted = true;
+                break;
+            }
+            dStep *= 0.5;
+        }
+        if(!bAccepted)
+        {
+            break;      // the energy is flat to round off, the residual decides
+        }
+
+        std::vector<double> sNew(ciDofNum), yNew(ciDofNum);
+        for(int iD = 0 ; iD<ciDofNum ; iD++)
+        {
+            sNew[iD] = xNext[iD] - x[iD];
+            yNew[iD] = gradientNext[iD] - gradient[iD];
+        }
+        const double cdSY = Dot(sNew, yNew);
+        if(cdSY > 0.0)
+        {
+            if((int)s.size() == s_ciHistoryNum)
+            {
+                s.erase(s.begin());
+                y.erase(y.begin());
+                rho.erase(rho.begin());
+            }
+            dGamma = cdSY/Dot(yNew, yNew);
+            s.push_back(sNew);
+            y.push_back(yNew);
+            rho.push_back(1.0/cdSY);
+        }
+        x.swap(xNext);
+        gradient.swap(gradientNext);
+        dEnergy = dEnergyNext;
+    }
+    if(!bConverged)
+    {
+        bConverged = MaxAbs(gradient) < cdTolerance;
+    }
+
+    m_Equilibrium.resize(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_Equilibrium[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+    }
+    for(size_t uiF = 0 ; uiF<free.size() ; uiF++)
+    {
+        m_Equilibrium[free[uiF]] = Vector3d(x[3*uiF], x[3*uiF+1], x[3*uiF+2]);
+    }
+    return bConverged;
+}
+
+double CDrapeSolver::Evaluate(
+    GoalNet &a_rGoalNet,
+    const std::vector<int> &a_rcFree,
+    const std::vector<Vector3d> &a_rcLoad,
+    const std::vector<double> &a_rcRest,
+    const std::vector<double> &a_rcX,
+    std::vector<double> &a_rGradient
+    )
+{
+    for(size_t uiF = 0 ; uiF<a_rcFree.size() ; uiF++)
+    {
+        a_rGoalNet.GetParticle(a_rcFree[uiF]).SetPosition(Vector3d(a_rcX[3*uiF], a_rcX[3*uiF+1], a_rcX[3*uiF+2]));
+    }
+    for(int iP = 0 ; iP<a_rGoalNet.ParticleNum() ; iP++)
+    {
+        a_rGoalNet.GetParticle(iP).SetForce(Vector3d::ZERO);
+    }
+    a_rGoalNet.ComputeInternalForce();
+
+    double dEnergy = a_rGoalNet.GetSpringEnergy();
+    for(size_t uiF = 0 ; uiF<a_rcFree.size() ; uiF++)
+    {
+        const Vector3d &rcLoad = a_rcLoad[a_rcFree[uiF]];
+        const Vector3d cForce = a_rGoalNet.GetParticle(a_rcFree[uiF]).GetForce() + rcLoad;
+        dEnergy -= rcLoad.x*(a_rcX[3*uiF] - a_rcRest[3*uiF])
+            + rcLoad.y*(a_rcX[3*uiF+1] - a_rcRest[3*uiF+1])
+            + rcLoad.z*(a_rcX[3*uiF+2] - a_rcRest[3*uiF+2]);
+        a_rGradient[3*uiF] = -cForce.x;
+        a_rGradient[3*uiF+1] = -cForce.y;
+        a_rGradient[3*uiF+2] = -cForce.z;
+    }
+    return dEnergy;
+}
@@ -0,0 +1,61 @@
+#ifndef CDRAPESOLVER_H
+#define CDRAPESOLVER_H
+
+#include <string>
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "CForceField.h"
+
+/*
+ * Static equilibrium of the net under its load, found directly instead of
+ * simulated into. The force fields are evaluated once at the lattice
+ * positions at rest, which makes the load a dead load and gravity exact,
+ * and L-BFGS minimizes the spring energy minus the work of the load over
+ * the positions of the movable particles. The gradient is the force of
+ * GoalNet::ComputeInternalForce(), the dampers do nothing at rest.
+ * Contacts are not part of the solve.
+ *
+ * Every equilibrium is kept in a file of the cache directory, named by a
+ * hash of the rest positions, masses, fixed flags, springs, coefficients
+ * and the load, so a scene starts from a cache hit after its first run.
+ * The last equilibrium also stays in memory for the next Reset().
+ */
+class CDrapeSolver
+{
+    public:
+        CDrapeSolver();
+
+        inline void SetCacheDir(const std::string &a_rcsCacheDir){ m_sCacheDir = a_rcsCacheDir; }
+        inline void SetMaxIterationNum(const int a_ciIterationNum){ m_iMaxIterationNum = a_ciIterationNum; }
+        inline int GetIterationNum() const { return m_iIterationNum; }     // of the last Drape(), 0 for a cache hit
+
+        // moves the net at its lattice positions to the equilibrium, false if the solve did not converge
+        bool Drape(GoalNet &a_rGoalNet, const CForceFieldSet &a_rcForceFields);
+
+    private:
+        unsigned long long Key(GoalNet &a_rGoalNet, const std::vector<Vector3d> &a_rcLoad) const;
+        bool Load(const unsigned long long a_culKey, const int a_ciParticleNum);
+        void Save(const unsigned long long a_culKey) const;
+        std::string CacheFilename(const unsigned long long a_culKey) const;
+
+        bool Solve(GoalNet &a_rGoalNet, const std::vector<Vector3d> &a_rcLoad);
+        double Evaluate(            // energy at a_rcX, the gradient into a_rGradient
+            GoalNet &a_rGoalNet,
+            const std::vector<int> &a_rcFree,
+            const std::vector<Vector3d> &a_rcLoad,
+            const std::vector<double> &a_rcRest,    // the work of the load is measured from here
+            const std::vector<double> &a_rcX,
+            std::vector<double> &a_rGradient
+            );
+
+        std::string m_sCacheDir;
+        int m_iMaxIterationNum;
+        int m_iIterationNum;
+
+        bool m_bLastValid;
+        unsigned long long m_ulLastKey;
+        std::vector<Vector3d> m_Equilibrium;    // of the last key, every particle
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <cmath>
+#include "CEmitter.h"
+#include "CThreadPool.h"
+#include "glut.h"
+
+namespace
+{
+    const double s_cdPi = 3.14159265358979323846;
+    const int s_ciMinChunk = 1024;          // particles per parallel task
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CEmitter::CEmitter(const int a_ciCapacity)
+    :m_Pool(a_ciCapacity),
+    m_Position(0.0,-1.0,0.0),
+    m_Direction(0.0,1.0,0.0),
+    m_Color(1.0,0.8,0.3),
+    m_dRate(0.0),
+    m_dSpreadDeg(20.0),
+    m_dSpeed(5.0),
+    m_dSpeedJitter(0.2),
+    m_dLifetime(2.0),
+    m_dLifetimeJitter(0.25),
+    m_dRadius(0.05),
+    m_dParticleMass(0.01),
+    m_dRestitution(0.4),
+    m_dFriction(5.0),
+    m_bEnable(true),
+    m_dSpawnDebt(0.0),
+    m_uiSeed(0),
+    m_Random(),
+    m_BallPosition(),
+    m_BallVelocity(),
+    m_BallRadius(),
+    m_fPointSize(2.0f),
+    m_VertexBuffer(),
+    m_ColorBuffer()
+{
+}
+
+void CEmitter::Reset()
+{
+    m_Pool.Clear();
+    m_dSpawnDebt = 0.0;
+    m_Random.Seed(m_uiSeed);
+}
+
+double CEmitter::Random()
+{
+    // the emitter keeps its own stream so it does not disturb the others
+    return m_Random.Uniform();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Update                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CEmitter::Update(
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles,
+    const vector<Ball> &a_rcBalls
+    )
+{
+    Emit(a_cdDeltaT);
+    if(m_Pool.Size() == 0)
+    {
+        return;
+    }
+
+    // the balls are read only during the step, particles are too light to push them
+    m_BallPosition.resize(a_rcBalls.size());
+    m_BallVelocity.resize(a_rcBalls.size());
+    m_BallRadius.resize(a_rcBalls.size());
+    for(size_t uiI = 0 ; uiI<a_rcBalls.size() ; uiI++)
+    {
+        Ball ball = a_rcBalls[uiI];
+        m_BallPosition[uiI] = ball.GetPosition();
+        m_BallVelocity[uiI] = ball.GetVelocity();
+        m_BallRadius[uiI] = ball.GetRadius();
+    }
+
+    CThreadPool::Instance().ParallelFor(0, m_Pool.Size(), [&](int a_iBegin, int a_iEnd)
+    {
+        Step(a_iBegin, a_iEnd, a_cdDeltaT, a_cdTime, a_rcForceFields, a_rcObstacles);
+    }, s_ciMinChunk);
+
+    m_Pool.RemoveDead();
+}
+
+void CEmitter::Emit(const double a_cdDeltaT)
+{
+    if(!m_bEnable)
+    {
+        return;
+    }
+    m_dSpawnDebt += m_dRate*a_cdDeltaT;
+    int iSpawnNum = (int)m_dSpawnDebt;
+    m_dSpawnDebt -= iSpawnNum;
+
+    // orthonormal frame around the emit direction for the cone sampling
+    Vector3d helper = (fabs(m_Direction.y) < 0.9) ? Vector3d(0.0,1.0,0.0) : Vector3d(1.0,0.0,0.0);
+    Vector3d tangent = m_Direction.CrossProduct(helper).NormalizedCopy();
+    Vector3d bitangent = m_Direction.CrossProduct(tangent);
+    double dCosSpread = cos(m_dSpreadDeg*s_cdPi/180.0);
+
+    for(int iI = 0 ; iI<iSpawnNum && !m_Pool.IsFull() ; iI++)
+    {
+        // uniform direction inside the cone
+        double dCosTheta = 1.0 - Random()*(1.0 - dCosSpread);
+        double dSinTheta = sqrt(1.0 - dCosTheta*dCosTheta);
+        double dPhi = 2.0*s_cdPi*Random();
+        Vector3d dir = m_Direction*dCosTheta + (tangent*cos(dPhi) + bitangent*sin(dPhi))*dSinTheta;
+
+        Vector3d offset(Random()*2.0-1.0, Random()*2.0-1.0, Random()*2.0-1.0);
+        double dSpeed = m_dSpeed*(1.0 + m_dSpeedJitter*(Random()*2.0-1.0));
+        double dLifetime = m_dLifetime*(1.0 + m_dLifetimeJitter*(Random()*2.0-1.0));
+        double dShade = 0.8 + 0.2*Random();
+
+        m_Pool.Spawn(m_Position + offset*m_dRadius, dir*dSpeed, m_Color*dShade, m_dParticleMass, dLifetime);
+    }
+}
+
+void CEmitter::Step(
+    const int a_ciBegin,
+    const int a_ciEnd,
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles
+    )
+{
+    ForceFieldBlock block;
+    for(int iStart = a_ciBegin ; iStart<a_ciEnd ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        block.iCount = (a_ciEnd - iStart < ForceFieldBlock::s_ciSize) ? a_ciEnd - iStart : ForceFieldBlock::s_ciSize;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            const Vector3d &rcPos = m_Pool.m_Position[iStart + iI];
+            const Vector3d &rcVel = m_Pool.m_Velocity[iStart + iI];
+            block.adPosX[iI] = rcPos.x; block.adPosY[iI] = rcPos.y; block.adPosZ[iI] = rcPos.z;
+            block.adVelX[iI] = rcVel.x; block.adVelY[iI] = rcVel.y; block.adVelZ[iI] = rcVel.z;
+            block.adMass[iI] = m_Pool.m_Mass[iStart + iI];
+        }
+
+        a_rcForceFields.Evaluate(block, a_cdTime);
+
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            int iIdx = iStart + iI;
+            Vector3d &rPos = m_Pool.m_Position[iIdx];
+            Vector3d &rVel = m_Pool.m_Velocity[iIdx];
+            Vector3d force(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]);
+
+            a_rcObstacles.ResolveContact(rPos, 0.0, m_dRestitution, m_dFriction, rVel, force);
+
+            // same order as CMassSpringSystem::ExplicitEuler
+            rPos += rVel*a_cdDeltaT;
+            rVel += force*(a_cdDeltaT/m_Pool.m_Mass[iIdx]);
+
+            for(size_t uiBall = 0 ; uiBall<m_BallPosition.size() ; uiBall++)
+            {
+                Vector3d offset = rPos - m_BallPosition[uiBall];
+                double dRadius = m_BallRadius[uiBall];
+                double dDistSq = offset.SquaredLength();
+                if(dDistSq < dRadius*dRadius && dDistSq > 1e-12)
+                {
+                    Vector3d normal = offset/sqrt(dDistSq);
+                    rPos = m_BallPosition[uiBall] + normal*dRadius;
+                    double dNormalSpeed = (rVel - m_BallVelocity[uiBall]).DotProduct(normal);
+                    if(dNormalSpeed < 0.0)
+                    {
+                        rVel -= normal*((1.0 + m_dRestitution)*dNormalSpeed);
+                    }
+                }
+            }
+
+            m_Pool.m_Age[iIdx] += a_cdDeltaT;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Draw                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CEmitter::Draw()
+{
+    const int ciNum = m_Pool.Size();
+    if(ciNum == 0)
+    {
+        return;
+    }
+    if((int)m_VertexBuffer.size() < m_Pool.Capacity()*3)
+    {
+        m_VertexBuffer.resize(m_Pool.Capacity()*3);
+        m_ColorBuffer.resize(m_Pool.Capacity()*4);
+    }
+
+    // fill the float arrays, the particles fade out over their lifetime
+    CThreadPool::Instance().ParallelFor(0, ciNum, [this](int a_iBegin, int a_iEnd)
+    {
+        for(int iI = a_iBegin ; iI<a_iEnd ; iI++)
+        {
+            const Vector3d &rcPos = m_Pool.m_Position[iI];
+            const Vector3d &rcColor = m_Pool.m_Color[iI];
+            double dAlpha = 1.0 - m_Pool.m_Age[iI]/m_Pool.m_Lifetime[iI];
+            m_VertexBuffer[iI*3]   = (float)rcPos.x;
+            m_VertexBuffer[iI*3+1] = (float)rcPos.y;
+            m_VertexBuffer[iI*3+2] = (float)rcPos.z;
+            m_ColorBuffer[iI*4]    = (float)rcColor.x;
+            m_ColorBuffer[iI*4+1]  = (float)rcColor.y;
+            m_ColorBuffer[iI*4+2]  = (float)rcColor.z;
+            m_ColorBuffer[iI*4+3]  = (float)((dAlpha > 0.0) ? dAlpha : 0.0);
+        }
+    }, s_ciMinChunk*4);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glPointSize(m_fPointSize);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, &m_VertexBuffer[0]);
+        glColorPointer(4, GL_FLOAT, 0, &m_ColorBuffer[0]);
+        glDrawArrays(GL_POINTS, 0, ciNum);
+    glPopClientAttrib();
+    glPopAttrib();
+}
@@ -0,0 +1,93 @@
+#ifndef CEMITTER_H
+#define CEMITTER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CParticlePool.h"
+#include "CForceField.h"
+#include "CObstacleField.h"
+#include "BallModel.h"
+#include "CRandom.h"
+
+/*
+ * Spawns free particles (sparks, debris, spray) into a CParticlePool at a
+ * given rate, moves them under the external force fields, bounces them on
+ * the obstacles and off the balls (one way, the balls do not feel them) and
+ * removes them once their lifetime is over.
+ */
+class CEmitter
+{
+    public:
+        explicit CEmitter(const int a_ciCapacity = 100000);
+
+        inline void SetPosition(const Vector3d &a_rcPosition){ m_Position = a_rcPosition; }
+        inline void SetDirection(const Vector3d &a_rcDirection){ m_Direction = a_rcDirection.NormalizedCopy(); }
+        inline void SetRate(const double a_cdRate){ m_dRate = a_cdRate; }                      // particles per second
+        inline void SetSpread(const double a_cdSpreadDeg){ m_dSpreadDeg = a_cdSpreadDeg; }     // half angle of the cone
+        inline void SetSpeed(const double a_cdSpeed, const double a_cdJitter){ m_dSpeed = a_cdSpeed; m_dSpeedJitter = a_cdJitter; }
+        inline void SetLifetime(const double a_cdLifetime, const double a_cdJitter){ m_dLifetime = a_cdLifetime; m_dLifetimeJitter = a_cdJitter; }
+        inline void SetRadius(const double a_cdRadius){ m_dRadius = a_cdRadius; }              // size of the spawn sphere
+        inline void SetColor(const Vector3d &a_rcColor){ m_Color = a_rcColor; }
+        inline void SetParticleMass(const double a_cdMass){ m_dParticleMass = a_cdMass; }
+        inline void SetRestitution(const double a_cdRestitution){ m_dRestitution = a_cdRestitution; }
+        inline void SetFriction(const double a_cdFriction){ m_dFriction = a_cdFriction; }
+        inline void SetPointSize(const float a_cfPointSize){ m_fPointSize = a_cfPointSize; }
+        inline void SetCapacity(const int a_ciCapacity){ m_Pool.Reserve(a_ciCapacity); }
+        inline void SetEnable(const bool a_cbEnable){ m_bEnable = a_cbEnable; }   // a disabled emitter still moves its particles
+        inline void SetSeed(const unsigned int a_cuiSeed){ m_uiSeed = a_cuiSeed; m_Random.Seed(a_cuiSeed); }   // Reset() starts the stream over
+
+        inline int ParticleNum() const { return m_Pool.Size(); }
+        inline double GetRate() const { return m_dRate; }
+
+        void Reset();
+        void Update(
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles,
+            const vector<Ball> &a_rcBalls
+            );
+        void Draw();
+
+    private:
+        void Emit(const double a_cdDeltaT);
+        void Step(
+            const int a_ciBegin,
+            const int a_ciEnd,
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles
+            );
+        double Random();                    // uniform in [0,1)
+
+        CParticlePool m_Pool;
+
+        Vector3d m_Position;
+        Vector3d m_Direction;
+        Vector3d m_Color;
+        double m_dRate;
+        double m_dSpreadDeg;
+        double m_dSpeed;
+        double m_dSpeedJitter;
+        double m_dLifetime;
+        double m_dLifetimeJitter;
+        double m_dRadius;
+        double m_dParticleMass;
+        double m_dRestitution;
+        double m_dFriction;
+        bool m_bEnable;
+        double m_dSpawnDebt;                // fraction of a particle carried over to the next step
+        unsigned int m_uiSeed;
+        CRandom m_Random;
+
+        std::vector<Vector3d> m_BallPosition;   // ball snapshot of the current step
+        std::vector<Vector3d> m_BallVelocity;
+        std::vector<double> m_BallRadius;
+
+        float m_fPointSize;
+        std::vector<float> m_VertexBuffer;  // scratch for the vertex arrays, sized with the capacity
+        std::vector<float> m_ColorBuffer;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <cfloat>
+#include <cmath>
+#include "CEnergyMonitor.h"
+
+namespace
+{
+    const double s_cdFloorHeight = 0.01;    // meters, see the class comment
+    const double s_cdMaxSpeed = 1e6;        // the old CheckStable bound
+}
+
+CEnergyMonitor::CEnergyMonitor(const int a_ciHistorySize)
+    :m_dGravity(9.8),
+    m_dGrowthRate(1.1),
+    m_iGrowthSteps(5),
+    m_Last(),
+    m_dLastInternal(0.0),
+    m_iGrowthStreak(0),
+    m_dStreakGrowth(1.0),
+    m_bDiverging(false),
+    m_History(a_ciHistorySize > 1 ? a_ciHistorySize : 1, 0.0),
+    m_iHistoryHead(0),
+    m_iHistorySize(0)
+{
+    m_Last.Clear();
+}
+
+void CEnergyMonitor::Reset()
+{
+    m_Last.Clear();
+    m_dLastInternal = 0.0;
+    m_iGrowthStreak = 0;
+    m_dStreakGrowth = 1.0;
+    m_bDiverging = false;
+    m_iHistoryHead = 0;
+    m_iHistorySize = 0;
+}
+
+void CEnergyMonitor::Push(const EnergySample &a_rcSample)
+{
+    m_Last = a_rcSample;
+    double dInternal = a_rcSample.dKinetic + a_rcSample.dSpring;
+    double dTotal = GetTotal();
+
+    // NaN fails both comparisons
+    if(!(dTotal > -DBL_MAX && dTotal < DBL_MAX) || a_rcSample.dMaxSpeedSq > s_cdMaxSpeed*s_cdMaxSpeed)
+    {
+        m_bDiverging = true;
+    }
+
+    if(m_iHistorySize > 0)
+    {
+        double dFloor = s_cdFloorHeight*m_dGravity*a_rcSample.dMass;
+        double dBase = (m_dLastInternal > dFloor) ? m_dLastInternal : dFloor;
+        if(dBase > 0.0 && dInternal > m_dGrowthRate*dBase)
+        {
+            ++m_iGrowthStreak;
+            m_dStreakGrowth *= dInternal/dBase;
+        }
+        else
+        {
+            m_iGrowthStreak = 0;
+            m_dStreakGrowth = 1.0;
+        }
+        double dAllowance = pow(m_dGrowthRate, m_iGrowthSteps);
+        if(m_iGrowthStreak >= m_iGrowthSteps || (m_iGrowthStreak >= 2 && m_dStreakGrowth > dAllowance*dAllowance))
+        {
+            m_bDiverging = true;
+        }
+    }
+    m_dLastInternal = dInternal;
+
+    m_History[m_iHistoryHead] = dTotal;
+    m_iHistoryHead = (m_iHistoryHead + 1) % (int)m_History.size();
+    if(m_iHistorySize < (int)m_History.size())
+    {
+        ++m_iHistorySize;
+    }
+}
+
+double CEnergyMonitor::GetHistory(const int a_ciAge) const
+{
+    if(a_ciAge < 0 || a_ciAge >= m_iHistorySize)
+    {
+        return 0.0;
+    }
+    int iSize = (int)m_History.size();
+    return m_History[(m_iHistoryHead - 1 - a_ciAge + iSize) % iSize];
+}
@@ -0,0 +1,87 @@
+#ifndef CENERGYMONITOR_H
+#define CENERGYMONITOR_H
+
+#include <vector>
+#include "Vector3d.h"
+
+/*
+ * Energy sums of one step, filled by the integrators in the loops that
+ * already visit every body, so watching the energy costs a few multiply-adds
+ * per particle and no pass of its own.
+ */
+struct EnergySample
+{
+    double dKinetic;
+    double dSpring;
+    double dMassHeight;         // sum of m*h above the ground, times g gives the gravity energy
+    double dMass;
+    double dMaxSpeedSq;
+
+    inline void Clear()
+    {
+        dKinetic = 0.0;
+        dSpring = 0.0;
+        dMassHeight = 0.0;
+        dMass = 0.0;
+        dMaxSpeedSq = 0.0;
+    }
+    inline void AddBody(const double a_cdMass, const double a_cdHeight, const Vector3d &a_rcVelocity)
+    {
+        double dSpeedSq = a_rcVelocity.SquaredLength();
+        dKinetic += 0.5*a_cdMass*dSpeedSq;
+        dMassHeight += a_cdMass*a_cdHeight;
+        dMass += a_cdMass;
+        dMaxSpeedSq = (dSpeedSq > dMaxSpeedSq) ? dSpeedSq : dMaxSpeedSq;
+    }
+};
+
+/*
+ * Rolling history of the system energy with an early divergence signal.
+ * An unstable integration pumps energy into the springs geometrically,
+ * so the internal energy (kinetic plus spring) is watched for growing by
+ * more than the growth rate on several steps in a row. Thrown balls or
+ * a splash add energy once and do not keep multiplying it, a sagging net
+ * starts from zero, so the growth is measured against a floor of the
+ * energy it takes to lift every body one centimeter. A streak that has
+ * already grown by the square of the whole allowance diverges after two
+ * steps, a non finite energy or a speed beyond any sensible one at once.
+ */
+class CEnergyMonitor
+{
+    public:
+        explicit CEnergyMonitor(const int a_ciHistorySize = 256);
+
+        inline void SetGravity(const double a_cdGravity){ m_dGravity = a_cdGravity; }
+        inline void SetGrowthRate(const double a_cdRate){ m_dGrowthRate = a_cdRate; }
+        inline void SetGrowthSteps(const int a_ciSteps){ m_iGrowthSteps = a_ciSteps; }
+
+        void Reset();
+        void Push(const EnergySample &a_rcSample);
+
+        inline bool IsDiverging() const { return m_bDiverging; }
+        inline bool IsGrowing() const { return m_iGrowthStreak > 0; }
+        inline double GetKinetic() const { return m_Last.dKinetic; }
+        inline double GetSpring() const { return m_Last.dSpring; }
+        inline double GetGravity() const { return m_Last.dMassHeight*m_dGravity; }
+        inline double GetTotal() const { return GetKinetic() + GetSpring() + GetGravity(); }
+
+        inline int HistorySize() const { return m_iHistorySize; }
+        double GetHistory(const int a_ciAge) const;     // total energy a_ciAge steps ago, 0 is the last step
+
+    private:
+        double m_dGravity;
+        double m_dGrowthRate;           // per step ratio counted as growth
+        int m_iGrowthSteps;             // growing steps in a row that signal divergence
+
+        EnergySample m_Last;
+        double m_dLastInternal;
+        int m_iGrowthStreak;
+        double m_dStreakGrowth;         // product of the ratios of the current streak
+        bool m_bDiverging;
+
+        std::vector<double> m_History;  // ring buffer of the total energy
+        int m_iHistoryHead;             // next slot to write
+        int m_iHistorySize;
+};
+
+#endif
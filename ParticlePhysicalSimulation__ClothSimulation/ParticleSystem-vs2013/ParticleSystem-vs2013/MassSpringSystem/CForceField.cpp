@@ -0,0 +1,303 @@
+#include <cmath>
+#include "CForceField.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Value Noise                                //
+////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+    inline double LatticeValue(const int a_ciX, const int a_ciY, const int a_ciZ)
+    {
+        unsigned int uiH = (unsigned int)a_ciX*73856093u ^ (unsigned int)a_ciY*19349663u ^ (unsigned int)a_ciZ*83492791u;
+        uiH = (uiH ^ (uiH >> 13)) * 1274126177u;
+        uiH ^= uiH >> 16;
+        return (double)(uiH & 0xffffu) / 32767.5 - 1.0;          // [-1,1]
+    }
+
+    inline double Fade(const double a_cdT)
+    {
+        return a_cdT*a_cdT*(3.0 - 2.0*a_cdT);
+    }
+
+    // trilinear value noise with smoothstep weights, range [-1,1]
+    double ValueNoise(const double a_cdX, const double a_cdY, const double a_cdZ)
+    {
+        double dFloorX = floor(a_cdX), dFloorY = floor(a_cdY), dFloorZ = floor(a_cdZ);
+        int iX = (int)dFloorX, iY = (int)dFloorY, iZ = (int)dFloorZ;
+        double dU = Fade(a_cdX - dFloorX), dV = Fade(a_cdY - dFloorY), dW = Fade(a_cdZ - dFloorZ);
+
+        double dX00 = LatticeValue(iX,iY  ,iZ  ) + dU*(LatticeValue(iX+1,iY  ,iZ  ) - LatticeValue(iX,iY  ,iZ  ));
+        double dX10 = LatticeValue(iX,iY+1,iZ  ) + dU*(LatticeValue(iX+1,iY+1,iZ  ) - LatticeValue(iX,iY+1,iZ  ));
+        double dX01 = LatticeValue(iX,iY  ,iZ+1) + dU*(LatticeValue(iX+1,iY  ,iZ+1) - LatticeValue(iX,iY  ,iZ+1));
+        double dX11 = LatticeValue(iX,iY+1,iZ+1) + dU*(LatticeValue(iX+1,iY+1,iZ+1) - LatticeValue(iX,iY+1,iZ+1));
+        double dY0 = dX00 + dV*(dX10 - dX00);
+        double dY1 = dX01 + dV*(dX11 - dX01);
+        return dY0 + dW*(dY1 - dY0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Gravity                                  //
+////////////////////////////////////////////////////////////////////////////////
+CGravityField::CGravityField(const Vector3d &a_rcGravity)
+    :m_Gravity(a_rcGravity)
+{
+}
+
+void CGravityField::Apply(ForceFieldBlock &a_rBlock, const double /*a_cdTime*/) const
+{
+    const double cdGX = m_Gravity.x, cdGY = m_Gravity.y, cdGZ = m_Gravity.z;
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        a_rBlock.adForceX[iI] += cdGX*a_rBlock.adMass[iI];
+        a_rBlock.adForceY[iI] += cdGY*a_rBlock.adMass[iI];
+        a_rBlock.adForceZ[iI] += cdGZ*a_rBlock.adMass[iI];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Wind                                    //
+////////////////////////////////////////////////////////////////////////////////
+CWindField::CWindField(
+    const Vector3d &a_rcVelocity,
+    const double a_cdCoef,
+    const double a_cdTurbulence,
+    const double a_cdTurbulenceScale,
+    const double a_cdTurbulenceFrequency
+    )
+    :m_Velocity(a_rcVelocity),
+    m_dCoef(a_cdCoef),
+    m_dTurbulence(a_cdTurbulence),
+    m_dInvTurbulenceScale((a_cdTurbulenceScale > 0.0) ? 1.0/a_cdTurbulenceScale : 1.0),
+    m_dTurbulenceFrequency(a_cdTurbulenceFrequency)
+{
+}
+
+void CWindField::Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const
+{
+    const double cdPhase = a_cdTime*m_dTurbulenceFrequency;
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        double dWindX = m_Velocity.x;
+        double dWindY = m_Velocity.y;
+        double dWindZ = m_Velocity.z;
+        if(m_dTurbulence != 0.0)
+        {
+            // one noise lookup per component, shifted apart so the components are uncorrelated
+            double dX = a_rBlock.adPosX[iI]*m_dInvTurbulenceScale + cdPhase;
+            double dY = a_rBlock.adPosY[iI]*m_dInvTurbulenceScale;
+            double dZ = a_rBlock.adPosZ[iI]*m_dInvTurbulenceScale;
+            dWindX += m_dTurbulence*ValueNoise(dX       , dY       , dZ       );
+            dWindY += m_dTurbulence*ValueNoise(dX + 31.7, dY + 11.3, dZ + 57.1);
+            dWindZ += m_dTurbulence*ValueNoise(dX + 71.9, dY + 43.1, dZ + 19.7);
+        }
+        a_rBlock.adForceX[iI] += m_dCoef*(dWindX - a_rBlock.adVelX[iI]);
+        a_rBlock.adForceY[iI] += m_dCoef*(dWindY - a_rBlock.adVelY[iI]);
+        a_rBlock.adForceZ[iI] += m_dCoef*(dWindZ - a_rBlock.adVelZ[iI]);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Attractor                                 //
+////////////////////////////////////////////////////////////////////////////////
+CAttractorField::CAttractorField(const Vector3d &a_rcCenter, const double a_cdStrength, const double a_cdRadius)
+    :m_Center(a_rcCenter),
+    m_dStrength(a_cdStrength),
+    m_dInvRadiusSq((a_cdRadius > 0.0) ? 1.0/(a_cdRadius*a_cdRadius) : 1.0)
+{
+}
+
+void CAttractorField::Apply(ForceFieldBlock &a_rBlock, const double /*a_cdTime*/) const
+{
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        double dX = m_Center.x - a_rBlock.adPosX[iI];
+        double dY = m_Center.y - a_rBlock.adPosY[iI];
+        double dZ = m_Center.z - a_rBlock.adPosZ[iI];
+        double dDistSq = dX*dX + dY*dY + dZ*dZ;
+        double dDist = sqrt(dDistSq) + 1e-9;
+        double dScale = m_dStrength*a_rBlock.adMass[iI] / (dDist*(1.0 + dDistSq*m_dInvRadiusSq));
+        a_rBlock.adForceX[iI] += dScale*dX;
+        a_rBlock.adForceY[iI] += dScale*dY;
+        a_rBlock.adForceZ[iI] += dScale*dZ;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Vortex                                   //
+////////////////////////////////////////////////////////////////////////////////
+CVortexField::CVortexField(const Vector3d &a_rcCenter, const Vector3d &a_rcAxis, const double a_cdStrength, const double a_cdRadius)
+    :m_Center(a_rcCenter),
+    m_Axis(a_rcAxis.NormalizedCopy()),
+    m_dStrength(a_cdStrength),
+    m_dInvRadiusSq((a_cdRadius > 0.0) ? 1.0/(a_cdRadius*a_cdRadius) : 1.0)
+{
+}
+
+void CVortexField::Apply(ForceFieldBlock &a_rBlock, const double /*a_cdTime*/) const
+{
+    const double cdAX = m_Axis.x, cdAY = m_Axis.y, cdAZ = m_Axis.z;
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        double dX = a_rBlock.adPosX[iI] - m_Center.x;
+        double dY = a_rBlock.adPosY[iI] - m_Center.y;
+        double dZ = a_rBlock.adPosZ[iI] - m_Center.z;
+        // tangent = axis x offset, its length is the distance to the axis
+        double dTX = cdAY*dZ - cdAZ*dY;
+        double dTY = cdAZ*dX - cdAX*dZ;
+        double dTZ = cdAX*dY - cdAY*dX;
+        double dDistSq = dTX*dTX + dTY*dTY + dTZ*dTZ;
+        double dDist = sqrt(dDistSq) + 1e-9;
+        double dScale = m_dStrength*a_rBlock.adMass[iI] / (dDist*(1.0 + dDistSq*m_dInvRadiusSq));
+        a_rBlock.adForceX[iI] += dScale*dTX;
+        a_rBlock.adForceY[iI] += dScale*dTY;
+        a_rBlock.adForceZ[iI] += dScale*dTZ;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Drag                                    //
+////////////////////////////////////////////////////////////////////////////////
+CDragField::CDragField(const double a_cdCoef)
+    :m_dCoef(a_cdCoef)
+{
+}
+
+void CDragField::Apply(ForceFieldBlock &a_rBlock, const double /*a_cdTime*/) const
+{
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        double dVX = a_rBlock.adVelX[iI];
+        double dVY = a_rBlock.adVelY[iI];
+        double dVZ = a_rBlock.adVelZ[iI];
+        double dScale = -m_dCoef*sqrt(dVX*dVX + dVY*dVY + dVZ*dVZ);
+        a_rBlock.adForceX[iI] += dScale*dVX;
+        a_rBlock.adForceY[iI] += dScale*dVY;
+        a_rBlock.adForceZ[iI] += dScale*dVZ;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Field Set                                 //
+////////////////////////////////////////////////////////////////////////////////
+CForceFieldSet::CForceFieldSet()
+    :m_Fields()
+{
+}
+
+CForceFieldSet::CForceFieldSet(const CForceFieldSet &a_rcForceFieldSet)
+    :m_Fields()
+{
+    *this = a_rcForceFieldSet;
+}
+
+CForceFieldSet::~CForceFieldSet()
+{
+    Clear();
+}
+
+CForceFieldSet &CForceFieldSet::operator=(const CForceFieldSet &a_rcForceFieldSet)
+{
+    if(this != &a_rcForceFieldSet)
+    {
+        Clear();
+        for(size_t uiI = 0 ; uiI<a_rcForceFieldSet.m_Fields.size() ; uiI++)
+        {
+            m_Fields.push_back(a_rcForceFieldSet.m_Fields[uiI]->Clone());
+        }
+    }
+    return *this;
+}
+
+void CForceFieldSet::Add(CForceField *a_pField)
+{
+    if(a_pField != NULL)
+    {
+        m_Fields.push_back(a_pField);
+    }
+}
+
+void CForceFieldSet::Clear()
+{
+    for(size_t uiI = 0 ; uiI<m_Fields.size() ; uiI++)
+    {
+        delete m_Fields[uiI];
+    }
+    m_Fields.clear();
+}
+
+void CForceFieldSet::Evaluate(ForceFieldBlock &a_rBlock, const double a_cdTime) const
+{
+    for(int iI = 0 ; iI<a_rBlock.iCount ; iI++)
+    {
+        a_rBlock.adForceX[iI] = 0.0;
+        a_rBlock.adForceY[iI] = 0.0;
+        a_rBlock.adForceZ[iI] = 0.0;
+    }
+    for(size_t uiI = 0 ; uiI<m_Fields.size() ; uiI++)
+    {
+        m_Fields[uiI]->Apply(a_rBlock, a_cdTime);
+    }
+}
+
+void CForceFieldSet::Apply(GoalNet &a_rGoalNet, const double a_cdTime) const
+{
+    if(m_Fields.empty())
+    {
+        return;
+    }
+
+    ForceFieldBlock block;
+    const int ciNum = a_rGoalNet.ParticleNum();
+    for(int iStart = 0 ; iStart<ciNum ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        block.iCount = (ciNum - iStart < ForceFieldBlock::s_ciSize) ? ciNum - iStart : ForceFieldBlock::s_ciSize;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iStart + iI);
+            Vector3d pos = rParticle.GetPosition();
+            Vector3d vel = rParticle.GetVelocity();
+            block.adPosX[iI] = pos.x; block.adPosY[iI] = pos.y; block.adPosZ[iI] = pos.z;
+            block.adVelX[iI] = vel.x; block.adVelY[iI] = vel.y; block.adVelZ[iI] = vel.z;
+            block.adMass[iI] = rParticle.GetMass();
+        }
+
+        Evaluate(block, a_cdTime);
+
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            a_rGoalNet.GetParticle(iStart + iI).AddForce(Vector3d(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]));
+        }
+    }
+}
+
+void CForceFieldSet::Apply(vector<Ball> &a_rBalls, const double a_cdTime) const
+{
+    if(m_Fields.empty())
+    {
+        return;
+    }
+
+    ForceFieldBlock block;
+    const int ciNum = (int)a_rBalls.size();
+    for(int iStart = 0 ; iStart<ciNum ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        block.iCount = (ciNum - iStart < ForceFieldBlock::s_ciSize) ? ciNum - iStart : ForceFieldBlock::s_ciSize;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            Ball &rBall = a_rBalls[iStart + iI];
+            Vector3d pos = rBall.GetPosition();
+            Vector3d vel = rBall.GetVelocity();
+            block.adPosX[iI] = pos.x; block.adPosY[iI] = pos.y; block.adPosZ[iI] = pos.z;
+            block.adVelX[iI] = vel.x; block.adVelY[iI] = vel.y; block.adVelZ[iI] = vel.z;
+            block.adMass[iI] = rBall.GetMass();
+        }
+
+        Evaluate(block, a_cdTime);
+
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            a_rBalls[iStart + iI].AddForce(Vector3d(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]));
+        }
+    }
+}
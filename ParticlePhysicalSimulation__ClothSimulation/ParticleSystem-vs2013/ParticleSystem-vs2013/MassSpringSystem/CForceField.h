@@ -0,0 +1,146 @@
+#ifndef CFORCEFIELD_H
+#define CFORCEFIELD_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "BallModel.h"
+
+/*
+ * A block of particles in structure-of-arrays layout. The fields read the
+ * positions, velocities and masses and accumulate into the force arrays.
+ */
+struct ForceFieldBlock
+{
+    static const int s_ciSize = 64;
+
+    int iCount;
+    double adPosX[s_ciSize], adPosY[s_ciSize], adPosZ[s_ciSize];
+    double adVelX[s_ciSize], adVelY[s_ciSize], adVelZ[s_ciSize];
+    double adMass[s_ciSize];
+    double adForceX[s_ciSize], adForceY[s_ciSize], adForceZ[s_ciSize];
+};
+
+/*
+ * External force field, evaluated over a whole block at once.
+ * New fields derive from this class and are handed to a CForceFieldSet.
+ */
+class CForceField
+{
+    public:
+        virtual ~CForceField(){}
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const = 0;
+        virtual CForceField *Clone() const = 0;
+};
+
+class CGravityField : public CForceField
+{
+    public:
+        explicit CGravityField(const Vector3d &a_rcGravity);
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const;
+        virtual CForceField *Clone() const { return new CGravityField(*this); }
+
+    private:
+        Vector3d m_Gravity;
+};
+
+/*
+ * Linear drag towards the wind velocity. The turbulence is value noise in
+ * space and time added on top of the mean wind.
+ */
+class CWindField : public CForceField
+{
+    public:
+        CWindField(
+            const Vector3d &a_rcVelocity,
+            const double a_cdCoef,
+            const double a_cdTurbulence,
+            const double a_cdTurbulenceScale,
+            const double a_cdTurbulenceFrequency
+            );
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const;
+        virtual CForceField *Clone() const { return new CWindField(*this); }
+
+    private:
+        Vector3d m_Velocity;
+        double m_dCoef;
+        double m_dTurbulence;              // amplitude of the gusts in m/s
+        double m_dInvTurbulenceScale;      // 1 / size of a gust in meter
+        double m_dTurbulenceFrequency;     // gust changes per second
+};
+
+/*
+ * Pull towards (or, with a negative strength, push away from) a point,
+ * the acceleration falls off as 1/(1+(d/r)^2).
+ */
+class CAttractorField : public CForceField
+{
+    public:
+        CAttractorField(const Vector3d &a_rcCenter, const double a_cdStrength, const double a_cdRadius);
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const;
+        virtual CForceField *Clone() const { return new CAttractorField(*this); }
+
+    private:
+        Vector3d m_Center;
+        double m_dStrength;
+        double m_dInvRadiusSq;
+};
+
+/*
+ * Swirl around an axis through a point, same falloff as the attractor
+ * but measured from the axis.
+ */
+class CVortexField : public CForceField
+{
+    public:
+        CVortexField(const Vector3d &a_rcCenter, const Vector3d &a_rcAxis, const double a_cdStrength, const double a_cdRadius);
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const;
+        virtual CForceField *Clone() const { return new CVortexField(*this); }
+
+    private:
+        Vector3d m_Center;
+        Vector3d m_Axis;
+        double m_dStrength;
+        double m_dInvRadiusSq;
+};
+
+/*
+ * Quadratic air drag, F = -c |v| v.
+ */
+class CDragField : public CForceField
+{
+    public:
+        explicit CDragField(const double a_cdCoef);
+        virtual void Apply(ForceFieldBlock &a_rBlock, const double a_cdTime) const;
+        virtual CForceField *Clone() const { return new CDragField(*this); }
+
+    private:
+        double m_dCoef;
+};
+
+/*
+ * Owns a list of fields and evaluates all of them in one pass: particles
+ * are gathered block by block, every field runs over the block and the
+ * summed force is scattered back once.
+ */
+class CForceFieldSet
+{
+    public:
+        CForceFieldSet();
+        CForceFieldSet(const CForceFieldSet &a_rcForceFieldSet);
+        ~CForceFieldSet();
+        CForceFieldSet &operator=(const CForceFieldSet &a_rcForceFieldSet);
+
+        void Add(CForceField *a_pField);        // takes the ownership
+        void Clear();
+        inline int FieldNum() const { return (int)m_Fields.size(); }
+
+        void Apply(GoalNet &a_rGoalNet, const double a_cdTime) const;
+        void Apply(vector<Ball> &a_rBalls, const double a_cdTime) const;
+        void Evaluate(ForceFieldBlock &a_rBlock, const double a_cdTime) const;   // overwrites the block forces
+
+    private:
+        std::vector<CForceField *> m_Fields;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include <stdlib.h>
+#include <mutex>
+#include "CFusedEuler.h"
+#include "CThreadPool.h"
+
+namespace
+{
+    const double s_cdRestitution = 0.5;     // same contact as the net of CMassSpringSystem
+    const double s_cdFriction = 25.0;
+    const int s_ciMinBlockChunk = 4;        // force field blocks per parallel task
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CFusedEuler::CFusedEuler()
+    :m_bBuilt(false),
+    m_iParticleNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_IncidenceStart(),
+    m_Incidences(),
+    m_NextPosition(),
+    m_NextVelocity()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Build                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CFusedEuler::Build(GoalNet &a_rGoalNet)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+
+    // intact springs around every particle, counting sort by particle
+    m_IncidenceStart.assign(ciParticleNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        ++m_IncidenceStart[rSpring.GetSpringStartID()+1];
+        ++m_IncidenceStart[rSpring.GetSpringEndID()+1];
+    }
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_IncidenceStart[iP+1] += m_IncidenceStart[iP];
+    }
+    m_Incidences.resize(m_IncidenceStart[ciParticleNum]);
+    std::vector<int> cursor(m_IncidenceStart.begin(), m_IncidenceStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        const int aciEnd[2] = { rSpring.GetSpringStartID(), rSpring.GetSpringEndID() };
+        for(int iE = 0 ; iE<2 ; iE++)
+        {
+            Incidence &rIncidence = m_Incidences[cursor[aciEnd[iE]]++];
+            rIncidence.iOther = aciEnd[1 - iE];
+            rIncidence.iSpring = iS;
+            rIncidence.dRestLength = rSpring.GetSpringRestLength();
+            rIncidence.dSpringCoef = rSpring.GetSpringCoef();
+            rIncidence.dDamperCoef = rSpring.GetDamperCoef();
+            rIncidence.bEnergy = (iE == 0);
+        }
+    }
+
+    m_NextPosition.resize(ciParticleNum);
+    m_NextVelocity.resize(ciParticleNum);
+    m_iParticleNum = ciParticleNum;
+    m_iTopologyVersion = a_rGoalNet.GetTopologyVersion();
+    m_iLogSeen = (int)a_rGoalNet.GetBrokenLog().size();
+    m_bBuilt = true;
+}
+
+void CFusedEuler::Sync(GoalNet &a_rGoalNet)
+{
+    // a compaction or a reset renumbers the springs, the lists are only counted again
+    if(!m_bBuilt || m_iParticleNum != a_rGoalNet.ParticleNum() || m_iTopologyVersion != a_rGoalNet.GetTopologyVersion())
+    {
+        Build(a_rGoalNet);
+        return;
+    }
+    const std::vector<int> &rcLog = a_rGoalNet.GetBrokenLog();
+    for( ; m_iLogSeen<(int)rcLog.size() ; m_iLogSeen++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(rcLog[m_iLogSeen]);
+        Cut(rcLog[m_iLogSeen], rSpring.GetSpringStartID());
+        Cut(rcLog[m_iLogSeen], rSpring.GetSpringEndID());
+    }
+}
+
+void CFusedEuler::Cut(const int a_ciSpring, const int a_ciParticle)
+{
+    for(int iK = m_IncidenceStart[a_ciParticle] ; iK<m_IncidenceStart[a_ciParticle+1] ; iK++)
+    {
+        Incidence &rIncidence = m_Incidences[iK];
+        if(rIncidence.iSpring == a_ciSpring)
+        {
+            rIncidence.dSpringCoef = 0.0;
+            rIncidence.dDamperCoef = 0.0;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Step                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CFusedEuler::Step(
+    GoalNet &a_rGoalNet,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles,
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const double a_cdGroundHeight,
+    EnergySample &a_rSample
+    )
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    if(ciParticleNum == 0)
+    {
+        return;
+    }
+    // an intact lattice gathers its springs from the stencils, the lists are only needed once torn
+    const bool cbLattice = a_rGoalNet.IsLatticeForce();
+    if(!cbLattice)
+    {
+        Sync(a_rGoalNet);
+    }
+    m_NextPosition.resize(ciParticleNum);
+    m_NextVelocity.resize(ciParticleNum);
+
+    std::mutex sampleMutex;
+    const int ciBlockNum = (ciParticleNum + ForceFieldBlock::s_ciSize - 1)/ForceFieldBlock::s_ciSize;
+    CThreadPool::Instance().ParallelFor(0, ciBlockNum, [&](int a_iBegin, int a_iEnd)
+    {
+        EnergySample sample;
+        sample.Clear();
+        ForceFieldBlock block;
+        for(int iB = a_iBegin ; iB<a_iEnd ; iB++)
+        {
+            const int ciStart = iB*ForceFieldBlock::s_ciSize;
+            block.iCount = (ciParticleNum - ciStart < ForceFieldBlock::s_ciSize) ? ciParticleNum - ciStart : ForceFieldBlock::s_ciSize;
+            for(int iI = 0 ; iI<block.iCount ; iI++)
+            {
+                CParticle &rParticle = a_rGoalNet.GetParticle(ciStart + iI);
+                const Vector3d cPos = rParticle.GetPosition();
+                const Vector3d cVel = rParticle.GetVelocity();
+                block.adPosX[iI] = cPos.x; block.adPosY[iI] = cPos.y; block.adPosZ[iI] = cPos.z;
+                block.adVelX[iI] = cVel.x; block.adVelY[iI] = cVel.y; block.adVelZ[iI] = cVel.z;
+                block.adMass[iI] = rParticle.GetMass();
+            }
+
+            a_rcForceFields.Evaluate(block, a_cdTime);
+
+            for(int iI = 0 ; iI<block.iCount ; iI++)
+            {
+                const int ciP = ciStart + iI;
+                CParticle &rParticle = a_rGoalNet.GetParticle(ciP);
+                Vector3d pos(block.adPosX[iI], block.adPosY[iI], block.adPosZ[iI]);
+                Vector3d vel(block.adVelX[iI], block.adVelY[iI], block.adVelZ[iI]);
+                Vector3d force = rParticle.GetForce() + Vector3d(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]);
+                rParticle.SetForce(Vector3d::ZERO);
+
+                // springs gathered, same spring and damper as GoalNet::ComputeInternalForce
+                if(cbLattice)
+                {
+                    force += a_rGoalNet.GetLattice().Gather(a_rGoalNet, ciP, pos, vel, sample.dSpring);
+                }
+                else
+                {
+                    for(int iK = m_IncidenceStart[ciP] ; iK<m_IncidenceStart[ciP+1] ; iK++)
+                    {
+                        const Incidence &rcIncidence = m_Incidences[iK];
+                        CParticle &rOther = a_rGoalNet.GetParticle(rcIncidence.iOther);
+                        Vector3d offset = pos - rOther.GetPosition();
+                        double dLength = offset.Length();
+                        if(dLength < 1e-12)
+                        {
+                            continue;
+                        }
+                        Vector3d direction = offset/dLength;
+                        double dStretch = dLength - rcIncidence.dRestLength;
+                        double dRelativeSpeed = (vel - rOther.GetVelocity()).DotProduct(direction);
+                        force -= direction*(rcIncidence.dSpringCoef*dStretch + rcIncidence.dDamperCoef*dRelativeSpeed);
+                        if(rcIncidence.bEnergy)
+                        {
+                            sample.dSpring += 0.5*rcIncidence.dSpringCoef*dStretch*dStretch;
+                        }
+                    }
+                }
+
+                // contact and explicit Euler in the order of CMassSpringSystem
+                const double cdMass = block.adMass[iI];
+                if(rParticle.IsMovable())
+                {
+                    a_rcObstacles.ResolveContact(pos, 0.0, s_cdRestitution, s_cdFriction, vel, force);
+                }
+                sample.AddBody(cdMass, pos.y - a_cdGroundHeight, vel);
+                if(rParticle.IsMovable())
+                {
+                    m_NextPosition[ciP] = pos + vel*a_cdDeltaT;
+                    m_NextVelocity[ciP] = vel + force*(a_cdDeltaT/cdMass);
+                }
+                else
+                {
+                    m_NextPosition[ciP] = pos;
+                    m_NextVelocity[ciP] = vel;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(sampleMutex);
+        a_rSample.dKinetic += sample.dKinetic;
+        a_rSample.dSpring += sample.dSpring;
+        a_rSample.dMassHeight += sample.dMassHeight;
+        a_rSample.dMass += sample.dMass;
+        a_rSample.dMaxSpeedSq = (sample.dMaxSpeedSq > a_rSample.dMaxSpeedSq) ? sample.dMaxSpeedSq : a_rSample.dMaxSpeedSq;
+    }, s_ciMinBlockChunk);
+
+    // every neighbor has read the old state, publish the new one
+    CThreadPool::Instance().ParallelFor(0, ciParticleNum, [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iP = a_iBegin ; iP<a_iEnd ; iP++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+            rParticle.SetPosition(m_NextPosition[iP]);
+            rParticle.SetVelocity(m_NextVelocity[iP]);
+        }
+    }, ForceFieldBlock::s_ciSize*s_ciMinBlockChunk);
+}
@@ -0,0 +1,67 @@
+#ifndef CFUSEDEULER_H
+#define CFUSEDEULER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "CForceField.h"
+#include "CObstacleField.h"
+#include "CEnergyMonitor.h"
+
+/*
+ * Explicit Euler of the net in one pass over the particles. Every particle
+ * takes the force already on it (drag, fluid), the force fields, its springs
+ * gathered from the other ends, the obstacle contact, and is integrated at
+ * once, its force cleared on the way. The springs are kept per particle so
+ * nothing is scattered and the particles are split over the thread pool.
+ * The old state stays in the net while the new one goes to a second buffer,
+ * so every particle reads its neighbors from the start of the step, and a
+ * plain copy publishes the new state afterwards. A torn spring is switched
+ * off in the lists of its two ends, and while the net is intact the lists
+ * are not used at all, the springs come from the lattice of GoalNet.
+ */
+class CFusedEuler
+{
+    public:
+        CFusedEuler();
+
+        inline void Invalidate(){ m_bBuilt = false; }    // the springs changed
+
+        // one step of the net, the bodies and springs are added to the energy sample
+        void Step(
+            GoalNet &a_rGoalNet,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles,
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const double a_cdGroundHeight,      // of the energy sample
+            EnergySample &a_rSample
+            );
+
+    private:
+        struct Incidence
+        {
+            int iOther;
+            int iSpring;
+            double dRestLength;
+            double dSpringCoef;
+            double dDamperCoef;
+            bool bEnergy;                   // every spring is counted at its start only
+        };
+
+        void Build(GoalNet &a_rGoalNet);
+        void Sync(GoalNet &a_rGoalNet);     // follows the torn springs of the net
+        void Cut(const int a_ciSpring, const int a_ciParticle);
+
+        bool m_bBuilt;
+        int m_iParticleNum;
+        int m_iTopologyVersion;
+        int m_iLogSeen;                     // entries of the broken log already cut
+
+        std::vector<int> m_IncidenceStart;  // per particle, one extra entry at the end
+        std::vector<Incidence> m_Incidences;
+        std::vector<Vector3d> m_NextPosition;
+        std::vector<Vector3d> m_NextVelocity;
+};
+
+#endif
@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include "CLaggedBroadPhase.h"
+
+namespace
+{
+    const double s_cdMarginSafety = 2.0;    // the speeds of the copy can still grow over the step
+    const double s_cdMinMargin = 1e-3;
+
+    inline unsigned int HashCell(const int a_ciX, const int a_ciY, const int a_ciZ)
+    {
+        return ((unsigned int)a_ciX*73856093u) ^ ((unsigned int)a_ciY*19349663u) ^ ((unsigned int)a_ciZ*83492791u);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CLaggedBroadPhase::CLaggedBroadPhase(const double a_cdReach)
+    :m_bEnable(true),
+    m_dReach(a_cdReach),
+    m_iFallbackNum(0),
+    m_iFront(0),
+    m_bPosted(false),
+    m_Thread(),
+    m_bPending(false),
+    m_bStop(false)
+{
+    m_aFrames[0].bReady = false;
+    m_aFrames[1].bReady = false;
+}
+
+CLaggedBroadPhase::CLaggedBroadPhase(const CLaggedBroadPhase &a_rcBroadPhase)
+    :m_bEnable(a_rcBroadPhase.m_bEnable),
+    m_dReach(a_rcBroadPhase.m_dReach),
+    m_iFallbackNum(0),
+    m_iFront(0),
+    m_bPosted(false),
+    m_Thread(),
+    m_bPending(false),
+    m_bStop(false)
+{
+    m_aFrames[0].bReady = false;
+    m_aFrames[1].bReady = false;
+}
+
+CLaggedBroadPhase &CLaggedBroadPhase::operator=(const CLaggedBroadPhase &a_rcBroadPhase)
+{
+    if(this != &a_rcBroadPhase)
+    {
+        Invalidate();
+        m_bEnable = a_rcBroadPhase.m_bEnable;
+        m_dReach = a_rcBroadPhase.m_dReach;
+    }
+    return *this;
+}
+
+CLaggedBroadPhase::~CLaggedBroadPhase()
+{
+    StopThread();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Settings                                  //
+////////////////////////////////////////////////////////////////////////////////
+void CLaggedBroadPhase::SetEnable(const bool a_cbEnable)
+{
+    if(!a_cbEnable)
+    {
+        StopThread();
+    }
+    Invalidate();
+    m_bEnable = a_cbEnable;
+}
+
+void CLaggedBroadPhase::Invalidate()
+{
+    Wait();
+    m_bPosted = false;
+    m_aFrames[0].bReady = false;
+    m_aFrames[1].bReady = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Steps                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CLaggedBroadPhase::Collect(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls)
+{
+    // the copy of the last step is searched by now, it becomes the front
+    if(m_bPosted)
+    {
+        Wait();
+        m_iFront = 1 - m_iFront;
+        m_bPosted = false;
+    }
+    Frame &rFront = m_aFrames[m_iFront];
+    if(!m_bEnable || !rFront.bReady || !Covers(rFront, a_rGoalNet, a_rBalls))
+    {
+        if(m_bEnable)
+        {
+            ++m_iFallbackNum;
+        }
+        Capture(rFront, a_rGoalNet, a_rBalls, 0.0);
+        Search(rFront);
+    }
+    rFront.bReady = false;      // used up, a stale frame is never taken again
+}
+
+void CLaggedBroadPhase::Post(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls, const double a_cdDeltaT)
+{
+    if(!m_bEnable || a_rBalls.empty())
+    {
+        return;
+    }
+    Wait();
+
+    // both the particles and the balls may travel a step at their current speed
+    double dMaxParticleSpeedSq = 0.0;
+    for(int iP = 0 ; iP<a_rGoalNet.ParticleNum() ; iP++)
+    {
+        const double cdSpeedSq = a_rGoalNet.GetParticle(iP).GetVelocity().SquaredLength();
+        dMaxParticleSpeedSq = (cdSpeedSq > dMaxParticleSpeedSq) ? cdSpeedSq : dMaxParticleSpeedSq;
+    }
+    double dMaxBallSpeedSq = 0.0;
+    for(size_t uiB = 0 ; uiB<a_rBalls.size() ; uiB++)
+    {
+        const double cdSpeedSq = a_rBalls[uiB].GetVelocity().SquaredLength();
+        dMaxBallSpeedSq = (cdSpeedSq > dMaxBallSpeedSq) ? cdSpeedSq : dMaxBallSpeedSq;
+    }
+    const double cdMargin = s_cdMarginSafety*a_cdDeltaT*(sqrt(dMaxParticleSpeedSq) + sqrt(dMaxBallSpeedSq)) + s_cdMinMargin;
+
+    Capture(m_aFrames[1 - m_iFront], a_rGoalNet, a_rBalls, cdMargin);
+    if(!m_Thread.joinable())
+    {
+        StartThread();
+    }
+    m_bPosted = true;
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bPending = true;
+    m_WorkCondition.notify_one();
+}
+
+bool CLaggedBroadPhase::Covers(const Frame &a_rcFrame, GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls) const
+{
+    if((int)a_rcFrame.Particle.size() != a_rGoalNet.ParticleNum() || a_rcFrame.BallCenter.size() != a_rBalls.size() || a_rcFrame.dReach != m_dReach)
+    {
+        return false;
+    }
+    // a pair in reach now was within reach plus both displacements at the copy
+    double dMaxBallMoveSq = 0.0;
+    for(size_t uiB = 0 ; uiB<a_rBalls.size() ; uiB++)
+    {
+        if(a_rBalls[uiB].GetRadius() != a_rcFrame.BallRadius[uiB])
+        {
+            return false;
+        }
+        const double cdMoveSq = (a_rBalls[uiB].GetPosition() - a_rcFrame.BallCenter[uiB]).SquaredLength();
+        dMaxBallMoveSq = (cdMoveSq > dMaxBallMoveSq) ? cdMoveSq : dMaxBallMoveSq;
+    }
+    const double cdBudget = a_rcFrame.dMargin - sqrt(dMaxBallMoveSq);
+    if(cdBudget < 0.0)
+    {
+        return false;
+    }
+    const double cdBudgetSq = cdBudget*cdBudget;
+    for(int iP = 0 ; iP<a_rGoalNet.ParticleNum() ; iP++)
+    {
+        if((a_rGoalNet.GetParticle(iP).GetPosition() - a_rcFrame.Particle[iP]).SquaredLength() > cdBudgetSq)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CLaggedBroadPhase::Capture(Frame &a_rFrame, GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls, const double a_cdMargin) const
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    a_rFrame.Particle.resize(ciParticleNum);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        a_rFrame.Particle[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+    }
+    a_rFrame.BallCenter.resize(a_rBalls.size());
+    a_rFrame.BallRadius.resize(a_rBalls.size());
+    for(size_t uiB = 0 ; uiB<a_rBalls.size() ; uiB++)
+    {
+        a_rFrame.BallCenter[uiB] = a_rBalls[uiB].GetPosition();
+        a_rFrame.BallRadius[uiB] = a_rBalls[uiB].GetRadius();
+    }
+    a_rFrame.dReach = m_dReach;
+    a_rFrame.dMargin = a_cdMargin;
+    a_rFrame.bReady = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Search                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CLaggedBroadPhase::Search(Frame &a_rFrame) const
+{
+    const int ciBallNum = (int)a_rFrame.BallCenter.size();
+    const int ciParticleNum = (int)a_rFrame.Particle.size();
+    a_rFrame.CandidateStart.assign(ciBallNum + 1, 0);
+    a_rFrame.Candidates.clear();
+    if(ciBallNum == 0 || ciParticleNum == 0)
+    {
+        a_rFrame.bReady = true;
+        return;
+    }
+
+    // one cell as large as the largest reach, a ball covers three cells per axis at most
+    double dCellSize = 0.0;
+    for(int iB = 0 ; iB<ciBallNum ; iB++)
+    {
+        const double cdReach = a_rFrame.BallRadius[iB] + a_rFrame.dReach + a_rFrame.dMargin;
+        dCellSize = (cdReach > dCellSize) ? cdReach : dCellSize;
+    }
+    const double cdInvCellSize = 1.0/dCellSize;
+
+    // particles counting sorted into the buckets of their cells
+    unsigned int uiBucketNum = 1;
+    while(uiBucketNum < 2u*(unsigned int)ciParticleNum)
+    {
+        uiBucketNum <<= 1;
+    }
+    const unsigned int cuiMask = uiBucketNum - 1;
+    std::vector<unsigned int> bucket(ciParticleNum);
+    a_rFrame.BucketStart.assign(uiBucketNum + 1, 0);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        const Vector3d &rcPos = a_rFrame.Particle[iP];
+        bucket[iP] = HashCell((int)floor(rcPos.x*cdInvCellSize), (int)floor(rcPos.y*cdInvCellSize), (int)floor(rcPos.z*cdInvCellSize)) & cuiMask;
+        ++a_rFrame.BucketStart[bucket[iP] + 1];
+    }
+    for(unsigned int uiK = 0 ; uiK<uiBucketNum ; uiK++)
+    {
+        a_rFrame.BucketStart[uiK + 1] += a_rFrame.BucketStart[uiK];
+    }
+    a_rFrame.BucketParticle.resize(ciParticleNum);
+    std::vector<int> cursor(a_rFrame.BucketStart.begin(), a_rFrame.BucketStart.end() - 1);
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        a_rFrame.BucketParticle[cursor[bucket[iP]]++] = iP;
+    }
+
+    // every ball looks through the buckets of the cells its reach overlaps,
+    // two cells may share a bucket, so the list is made unique afterwards
+    for(int iB = 0 ; iB<ciBallNum ; iB++)
+    {
+        const Vector3d &rcCenter = a_rFrame.BallCenter[iB];
+        const double cdReach = a_rFrame.BallRadius[iB] + a_rFrame.dReach + a_rFrame.dMargin;
+        const double cdReachSq = cdReach*cdReach;
+        int aiMin[3], aiMax[3];
+        for(int iA = 0 ; iA<3 ; iA++)
+        {
+            aiMin[iA] = (int)floor((rcCenter[iA] - cdReach)*cdInvCellSize);
+            aiMax[iA] = (int)floor((rcCenter[iA] + cdReach)*cdInvCellSize);
+        }
+        const size_t cuiFirst = a_rFrame.Candidates.size();
+        for(int iX = aiMin[0] ; iX<=aiMax[0] ; iX++)
+        {
+            for(int iY = aiMin[1] ; iY<=aiMax[1] ; iY++)
+            {
+                for(int iZ = aiMin[2] ; iZ<=aiMax[2] ; iZ++)
+                {
+                    const unsigned int cuiBucket = HashCell(iX, iY, iZ) & cuiMask;
+                    for(int iK = a_rFrame.BucketStart[cuiBucket] ; iK<a_rFrame.BucketStart[cuiBucket + 1] ; iK++)
+                    {
+                        const int ciP = a_rFrame.BucketParticle[iK];
+                        if((a_rFrame.Particle[ciP] - rcCenter).SquaredLength() < cdReachSq)
+                        {
+                            a_rFrame.Candidates.push_back(ciP);
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(a_rFrame.Candidates.begin() + cuiFirst, a_rFrame.Candidates.end());
+        a_rFrame.Candidates.erase(std::unique(a_rFrame.Candidates.begin() + cuiFirst, a_rFrame.Candidates.end()), a_rFrame.Candidates.end());
+        a_rFrame.CandidateStart[iB + 1] = (int)a_rFrame.Candidates.size();
+    }
+    a_rFrame.bReady = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Thread                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CLaggedBroadPhase::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while(m_bPending)
+    {
+        m_DoneCondition.wait(lock);
+    }
+}
+
+void CLaggedBroadPhase::StartThread()
+{
+    m_bStop = false;
+    m_Thread = std::thread(&CLaggedBroadPhase::ThreadLoop, this);
+}
+
+void CLaggedBroadPhase::StopThread()
+{
+    if(!m_Thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+        m_WorkCondition.notify_one();
+    }
+    m_Thread.join();
+    m_bPending = false;
+}
+
+void CLaggedBroadPhase::ThreadLoop()
+{
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while(!m_bPending && !m_bStop)
+            {
+                m_WorkCondition.wait(lock);
+            }
+            if(m_bStop)
+            {
+                return;
+            }
+        }
+        // the back frame is left alone by the caller until the search is done
+        Search(m_aFrames[1 - m_iFront]);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bPending = false;
+        m_DoneCondition.notify_all();
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef CLAGGEDBROADPHASE_H
+#define CLAGGEDBROADPHASE_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "BallModel.h"
+
+/*
+ * Ball/particle broad phase one step behind the integrator, on a thread of
+ * its own. After the contacts of a step Post() copies the net and the balls
+ * into the back frame and wakes the thread, which bins the particles in a
+ * spatial hash and lists the particles within reach of every ball, the
+ * reach grown by the distance the bodies can travel in a step. The next
+ * step picks the list up in Collect() and swaps the frames, so the search
+ * runs while the forces are computed. Collect() checks that no particle and
+ * no ball moved further since the copy than the margin covers, and searches
+ * the current state itself if they did, or if the balls changed, so no
+ * contact is missed. The candidates of a ball are in ascending order, the
+ * narrow phase sees the particles in the same order as a full sweep.
+ */
+class CLaggedBroadPhase
+{
+    public:
+        explicit CLaggedBroadPhase(const double a_cdReach = 0.0);
+        CLaggedBroadPhase(const CLaggedBroadPhase &a_rcBroadPhase);    // copies the settings, not the thread
+        CLaggedBroadPhase &operator=(const CLaggedBroadPhase &a_rcBroadPhase);
+        ~CLaggedBroadPhase();
+
+        void SetEnable(const bool a_cbEnable);      // off, every step searches its own state
+        inline bool IsEnable() const { return m_bEnable; }
+        inline void SetReach(const double a_cdReach){ m_dReach = a_cdReach; }  // contact distance beyond the ball radius
+        void Invalidate();                          // the net or the balls jumped, drop the pending search
+        inline int GetFallbackNum() const { return m_iFallbackNum; }   // steps the lagged search did not cover
+
+        // candidates of this step, then the state after the contacts for the next one
+        void Collect(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls);
+        void Post(GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls, const double a_cdDeltaT);
+
+        inline int CandidateBegin(const int a_ciBall) const { return m_aFrames[m_iFront].CandidateStart[a_ciBall]; }
+        inline int CandidateEnd(const int a_ciBall) const { return m_aFrames[m_iFront].CandidateStart[a_ciBall+1]; }
+        inline int GetCandidate(const int a_ciIdx) const { return m_aFrames[m_iFront].Candidates[a_ciIdx]; }
+
+    private:
+        struct Frame
+        {
+            bool bReady;                        // the candidates belong to the copy
+            double dReach;                      // beyond the ball radius
+            double dMargin;                     // the reach is grown by this
+            std::vector<Vector3d> Particle;     // positions at the copy
+            std::vector<Vector3d> BallCenter;
+            std::vector<double> BallRadius;
+            std::vector<int> CandidateStart;    // per ball, one extra entry at the end
+            std::vector<int> Candidates;
+            std::vector<int> BucketStart;       // spatial hash of the particles
+            std::vector<int> BucketParticle;
+        };
+
+        void Capture(Frame &a_rFrame, GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls, const double a_cdMargin) const;
+        void Search(Frame &a_rFrame) const;
+        bool Covers(const Frame &a_rcFrame, GoalNet &a_rGoalNet, std::vector<Ball> &a_rBalls) const;
+        void Wait();                            // for the running search
+        void StartThread();
+        void StopThread();
+        void ThreadLoop();
+
+        bool m_bEnable;
+        double m_dReach;
+        int m_iFallbackNum;
+
+        Frame m_aFrames[2];
+        int m_iFront;                           // read by the narrow phase, the other one is searched
+        bool m_bPosted;                         // the back frame holds a copy not collected yet
+
+        std::thread m_Thread;
+        std::mutex m_Mutex;
+        std::condition_variable m_WorkCondition;
+        std::condition_variable m_DoneCondition;
+        bool m_bPending;                        // a copy waits for or is in the search, guarded by the mutex
+        bool m_bStop;
+};
+
+#endif
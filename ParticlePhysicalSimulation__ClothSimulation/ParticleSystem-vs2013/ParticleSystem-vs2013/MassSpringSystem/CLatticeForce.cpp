@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <math.h>
+#include "CLatticeForce.h"
+#include "GoalNetModel.h"
+
+namespace
+{
+    const double s_cdRestTolerance = 1e-9;  // relative, between a rest length of the list and of the grid
+}
+
+// struct, shear and bending, the same springs as GoalNet::InitializeSpring, each with both signs
+const int Lattice::NetStencil::s_aiU[Lattice::NetStencil::s_ciNum] = { 1, -1,  0,  0,  1, -1,  1, -1,  2, -2,  0,  0 };
+const int Lattice::NetStencil::s_aiV[Lattice::NetStencil::s_ciNum] = { 0,  0,  1, -1,  1, -1, -1,  1,  0,  0,  2, -2 };
+const CSpring::enType_t Lattice::NetStencil::s_acType[Lattice::NetStencil::s_ciNum] =
+{
+    CSpring::Type_nStruct,  CSpring::Type_nStruct,  CSpring::Type_nStruct,  CSpring::Type_nStruct,
+    CSpring::Type_nShear,   CSpring::Type_nShear,   CSpring::Type_nShear,   CSpring::Type_nShear,
+    CSpring::Type_nBending, CSpring::Type_nBending, CSpring::Type_nBending, CSpring::Type_nBending
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CLatticeForce::CLatticeForce()
+    :m_bBuilt(false),
+    m_Grids(),
+    m_SlotStart(),
+    m_Slots()
+{
+    for(int iA = 0 ; iA<3 ; iA++)
+    {
+        m_adSpacing[iA] = 0.0;
+        m_adSpringCoef[iA] = 0.0;
+        m_adDamperCoef[iA] = 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Build                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CLatticeForce::Build(GoalNet &a_rGoalNet)
+{
+    m_bBuilt = false;
+    m_Grids.clear();
+    m_SlotStart.clear();
+    m_Slots.clear();
+
+    const int ciWidthNum = a_rGoalNet.GetWidthNum();
+    const int ciHeightNum = a_rGoalNet.GetHeightNum();
+    const int ciLengthNum = a_rGoalNet.GetLengthNum();
+    if(ciWidthNum < 2 || ciHeightNum < 2 || ciLengthNum < 2)
+    {
+        return false;
+    }
+    m_adSpacing[0] = a_rGoalNet.GetWidth()/(ciWidthNum - 1);
+    m_adSpacing[1] = a_rGoalNet.GetHeight()/(ciHeightNum - 1);
+    m_adSpacing[2] = a_rGoalNet.GetLength()/(ciLengthNum - 1);
+
+    // the four faces in the order of GoalNet::InitializeSpring
+    AddGrid<Lattice::BackFace>(a_rGoalNet, 0);
+    AddGrid<Lattice::SideFace>(a_rGoalNet, 0);
+    AddGrid<Lattice::SideFace>(a_rGoalNet, ciLengthNum - 1);
+    AddGrid<Lattice::RoofFace>(a_rGoalNet, ciHeightNum - 1);
+
+    // grid nodes of every particle, counting sort by particle
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    m_SlotStart.assign(ciParticleNum + 1, 0);
+    for(unsigned int uiG = 0 ; uiG<m_Grids.size() ; uiG++)
+    {
+        const std::vector<int> &rcIndex = m_Grids[uiG].Index;
+        for(unsigned int uiN = 0 ; uiN<rcIndex.size() ; uiN++)
+        {
+            if(rcIndex[uiN] < 0 || rcIndex[uiN] >= ciParticleNum)
+            {
+                return false;
+            }
+            ++m_SlotStart[rcIndex[uiN]+1];
+        }
+    }
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        m_SlotStart[iP+1] += m_SlotStart[iP];
+    }
+    m_Slots.resize(m_SlotStart[ciParticleNum]);
+    std::vector<int> cursor(m_SlotStart.begin(), m_SlotStart.end() - 1);
+    for(unsigned int uiG = 0 ; uiG<m_Grids.size() ; uiG++)
+    {
+        const Grid &rcGrid = m_Grids[uiG];
+        for(int iU = 0 ; iU<rcGrid.iNumU ; iU++)
+        {
+            for(int iV = 0 ; iV<rcGrid.iNumV ; iV++)
+            {
+                Slot &rSlot = m_Slots[cursor[rcGrid.Index[iU*rcGrid.iNumV + iV]]++];
+                rSlot.iGrid = uiG;
+                rSlot.iU = iU;
+                rSlot.iV = iV;
+            }
+        }
+    }
+
+    // the stencils have to give the spring list, no spring more or less,
+    // with one coefficient per type and the rest lengths of the grid
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+    if(PairNum<Stencil_t>() != ciSpringNum)
+    {
+        return false;
+    }
+    bool abTypeSeen[3] = { false, false, false };
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        const CSpring::enType_t cType = rSpring.GetSpringType();
+        if(rSpring.IsBroken())
+        {
+            return false;
+        }
+        if(!abTypeSeen[cType])
+        {
+            abTypeSeen[cType] = true;
+            m_adSpringCoef[cType] = rSpring.GetSpringCoef();
+            m_adDamperCoef[cType] = rSpring.GetDamperCoef();
+        }
+        else if(rSpring.GetSpringCoef() != m_adSpringCoef[cType] || rSpring.GetDamperCoef() != m_adDamperCoef[cType])
+        {
+            return false;
+        }
+        const double cdRestLength = StencilRestLength<Stencil_t>(rSpring.GetSpringStartID(), rSpring.GetSpringEndID(), cType);
+        if(cdRestLength < 0.0 || fabs(cdRestLength - rSpring.GetSpringRestLength()) > s_cdRestTolerance*cdRestLength)
+        {
+            return false;
+        }
+    }
+
+    m_bBuilt = true;
+    return true;
+}
+
+template<class Face>
+void CLatticeForce::AddGrid(GoalNet &a_rGoalNet, const int a_ciFixed)
+{
+    const int aciNum[3] = { a_rGoalNet.GetWidthNum(), a_rGoalNet.GetHeightNum(), a_rGoalNet.GetLengthNum() };
+    const int ciFixedAxis = 3 - Face::s_ciAxisU - Face::s_ciAxisV;
+
+    m_Grids.push_back(Grid());
+    Grid &rGrid = m_Grids.back();
+    rGrid.iNumU = aciNum[Face::s_ciAxisU];
+    rGrid.iNumV = aciNum[Face::s_ciAxisV];
+    rGrid.Index.resize(rGrid.iNumU*rGrid.iNumV);
+    int aiID[3];
+    aiID[ciFixedAxis] = a_ciFixed;
+    for(int iU = 0 ; iU<rGrid.iNumU ; iU++)
+    {
+        for(int iV = 0 ; iV<rGrid.iNumV ; iV++)
+        {
+            aiID[Face::s_ciAxisU] = iU;
+            aiID[Face::s_ciAxisV] = iV;
+            rGrid.Index[iU*rGrid.iNumV + iV] = a_rGoalNet.GetParticleID(aiID[0], aiID[1], aiID[2]);
+        }
+    }
+
+    const double cdSpacingU = m_adSpacing[Face::s_ciAxisU];
+    const double cdSpacingV = m_adSpacing[Face::s_ciAxisV];
+    for(int iS = 0 ; iS<Stencil_t::s_ciNum ; iS++)
+    {
+        const double cdU = Stencil_t::s_aiU[iS]*cdSpacingU;
+        const double cdV = Stencil_t::s_aiV[iS]*cdSpacingV;
+        rGrid.adRestLength[iS] = sqrt(cdU*cdU + cdV*cdV);
+    }
+}
+
+template<class Stencil>
+int CLatticeForce::PairNum() const
+{
+    int iNum = 0;
+    for(unsigned int uiG = 0 ; uiG<m_Grids.size() ; uiG++)
+    {
+        const Grid &rcGrid = m_Grids[uiG];
+        for(int iS = 0 ; iS<Stencil::s_ciNum ; iS++)
+        {
+            const int ciSpanU = rcGrid.iNumU - abs(Stencil::s_aiU[iS]);
+            const int ciSpanV = rcGrid.iNumV - abs(Stencil::s_aiV[iS]);
+            if(ciSpanU > 0 && ciSpanV > 0)
+            {
+                iNum += ciSpanU*ciSpanV;
+            }
+        }
+    }
+    return iNum/2;      // every spring is in the stencil with both signs
+}
+
+template<class Stencil>
+double CLatticeForce::StencilRestLength(const int a_ciStart, const int a_ciEnd, const CSpring::enType_t a_cType) const
+{
+    for(int iK = m_SlotStart[a_ciStart] ; iK<m_SlotStart[a_ciStart+1] ; iK++)
+    {
+        const Slot &rcSlot = m_Slots[iK];
+        const Grid &rcGrid = m_Grids[rcSlot.iGrid];
+        for(int iS = 0 ; iS<Stencil::s_ciNum ; iS++)
+        {
+            const int ciU = rcSlot.iU + Stencil::s_aiU[iS];
+            const int ciV = rcSlot.iV + Stencil::s_aiV[iS];
+            if(Stencil::s_acType[iS] == a_cType && ciU >= 0 && ciU < rcGrid.iNumU && ciV >= 0 && ciV < rcGrid.iNumV
+                && rcGrid.Index[ciU*rcGrid.iNumV + ciV] == a_ciEnd)
+            {
+                return rcGrid.adRestLength[iS];
+            }
+        }
+    }
+    return -1.0;
+}
+
+void CLatticeForce::SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cType)
+{
+    m_adSpringCoef[a_cType] = a_cdSpringCoef;
+}
+
+void CLatticeForce::SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cType)
+{
+    m_adDamperCoef[a_cType] = a_cdDamperCoef;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Gather                                   //
+////////////////////////////////////////////////////////////////////////////////
+Vector3d CLatticeForce::Gather(
+    GoalNet &a_rGoalNet,
+    const int a_ciParticle,
+    const Vector3d &a_rcPosition,
+    const Vector3d &a_rcVelocity,
+    double &a_rdEnergy
+    ) const
+{
+    Vector3d force(0.0, 0.0, 0.0);
+    for(int iK = m_SlotStart[a_ciParticle] ; iK<m_SlotStart[a_ciParticle+1] ; iK++)
+    {
+        force += GatherGrid<Stencil_t>(a_rGoalNet, m_Slots[iK], a_rcPosition, a_rcVelocity, a_rdEnergy);
+    }
+    return force;
+}
+
+template<class Stencil>
+Vector3d CLatticeForce::GatherGrid(
+    GoalNet &a_rGoalNet,
+    const Slot &a_rcSlot,
+    const Vector3d &a_rcPosition,
+    const Vector3d &a_rcVelocity,
+    double &a_rdEnergy
+    ) const
+{
+    // same spring and damper as GoalNet::ComputeInternalForce
+    const Grid &rcGrid = m_Grids[a_rcSlot.iGrid];
+    Vector3d force(0.0, 0.0, 0.0);
+    for(int iS = 0 ; iS<Stencil::s_ciNum ; iS++)
+    {
+        const int ciU = a_rcSlot.iU + Stencil::s_aiU[iS];
+        const int ciV = a_rcSlot.iV + Stencil::s_aiV[iS];
+        if(ciU < 0 || ciU >= rcGrid.iNumU || ciV < 0 || ciV >= rcGrid.iNumV)
+        {
+            continue;
+        }
+        CParticle &rOther = a_rGoalNet.GetParticle(rcGrid.Index[ciU*rcGrid.iNumV + ciV]);
+        Vector3d offset = a_rcPosition - rOther.GetPosition();
+        double dLength = offset.Length();
+        if(dLength < 1e-12)
+        {
+            continue;
+        }
+        const double cdSpringCoef = m_adSpringCoef[Stencil::s_acType[iS]];
+        const double cdDamperCoef = m_adDamperCoef[Stencil::s_acType[iS]];
+        Vector3d direction = offset/dLength;
+        double dStretch = dLength - rcGrid.adRestLength[iS];
+        double dRelativeSpeed = (a_rcVelocity - rOther.GetVelocity()).DotProduct(direction);
+        force -= direction*(cdSpringCoef*dStretch + cdDamperCoef*dRelativeSpeed);
+        a_rdEnergy += 0.25*cdSpringCoef*dStretch*dStretch;
+    }
+    return force;
+}
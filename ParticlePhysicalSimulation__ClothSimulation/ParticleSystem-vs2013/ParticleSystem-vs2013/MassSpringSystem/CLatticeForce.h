@@ -0,0 +1,97 @@
+#ifndef CLATTICEFORCE_H
+#define CLATTICEFORCE_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CSpring.h"
+
+class GoalNet;
+
+namespace Lattice
+{
+    // a face of the net, a grid over two of the axes (0 x, 1 y, 2 z)
+    template<int t_iAxisU, int t_iAxisV>
+    struct Face
+    {
+        enum { s_ciAxisU = t_iAxisU, s_ciAxisV = t_iAxisV };
+    };
+    typedef Face<1,2> BackFace;     // at the first width index
+    typedef Face<0,2> RoofFace;     // at the top
+    typedef Face<0,1> SideFace;     // at both ends of the length
+
+    // the springs around a grid node as offsets in the two grid directions,
+    // both signs of every spring, so a node gathers all of its springs
+    struct NetStencil
+    {
+        enum { s_ciNum = 12 };
+        static const int s_aiU[s_ciNum];
+        static const int s_aiV[s_ciNum];
+        static const CSpring::enType_t s_acType[s_ciNum];
+    };
+}
+
+/*
+ * Spring forces of a net that is a lattice, without the spring list. Every
+ * face is a grid of particle ids, and a particle gathers its springs from
+ * the stencil around its node in each face it lies on, the rest lengths
+ * come from the grid spacing and the coefficients are the ones of the
+ * three spring types. The seams between two faces get the springs of both
+ * faces, as the spring list of GoalNet has them twice. Build() checks that
+ * the stencils give exactly the springs of the net and refuses the net
+ * otherwise, GoalNet then keeps using its list.
+ */
+class CLatticeForce
+{
+    public:
+        typedef Lattice::NetStencil Stencil_t;
+
+        CLatticeForce();
+
+        bool Build(GoalNet &a_rGoalNet);        // false if the springs are not the ones of the stencils
+        inline bool IsBuilt() const { return m_bBuilt; }
+        void SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cType);
+        void SetDamperCoef(const double a_cdDamperCoef, const CSpring::enType_t a_cType);
+
+        // spring and damper force on one particle, half the energy of its springs is added to a_rdEnergy
+        Vector3d Gather(
+            GoalNet &a_rGoalNet,
+            const int a_ciParticle,
+            const Vector3d &a_rcPosition,
+            const Vector3d &a_rcVelocity,
+            double &a_rdEnergy
+            ) const;
+
+    private:
+        struct Grid
+        {
+            int iNumU;
+            int iNumV;
+            std::vector<int> Index;             // particle of every node, u major
+            double adRestLength[Stencil_t::s_ciNum];
+        };
+        struct Slot
+        {
+            int iGrid;
+            int iU;
+            int iV;
+        };
+
+        template<class Face>
+        void AddGrid(GoalNet &a_rGoalNet, const int a_ciFixed);   // the index of the third axis
+        template<class Stencil>
+        int PairNum() const;                    // springs the stencil gives over all grids
+        template<class Stencil>
+        double StencilRestLength(const int a_ciStart, const int a_ciEnd, const CSpring::enType_t a_cType) const;   // -1 if no stencil has the spring
+        template<class Stencil>
+        Vector3d GatherGrid(GoalNet &a_rGoalNet, const Slot &a_rcSlot, const Vector3d &a_rcPosition, const Vector3d &a_rcVelocity, double &a_rdEnergy) const;
+
+        bool m_bBuilt;
+        double m_adSpacing[3];                  // between two particles along every axis
+        double m_adSpringCoef[3];               // per spring type
+        double m_adDamperCoef[3];
+        std::vector<Grid> m_Grids;
+        std::vector<int> m_SlotStart;           // grid nodes of every particle, one extra entry at the end
+        std::vector<Slot> m_Slots;
+};
+
+#endif
@@ -1,7 +1,10 @@
+#include <stdio.h>
 #include <cmath>
 #include <iostream>
 #include "configFile.h"
 #include "CMassSpringSystem.h"
+#include "CProfiler.h"
+#include "CThreadPool.h"
 #include "glut.h"
 #include "Render_API.h"
 
@@ -10,8 +13,11 @@
 const double g_cdDeltaT = 0.001f;
 const double g_cdK	   = 2500.0f;
 const double g_cdD	   = 50.0f;
-const double eps = 0.01;
-const Vector3d  normal = Vector3d(0,1.0,0);
+const double g_cdGravity = 9.8;
+const double g_cdGroundHeight = -1.0;
+const double g_cdGoalpostRadius = 0.05;
+const int g_ciCompactRatio = 4;     //springs per broken one before the net drops the broken ones
+const double g_cdBallReach = 0.1;   //a ball hits the particles this far beyond its radius
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Constructor & Destructor
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -22,10 +28,14 @@ CMassSpringSystem::CMassSpringSystem()
     m_bDrawBending(false),
     m_bDrawGoalpost(true),
     m_bSimulation(false),
+    m_bEmitter(true),
+    m_bCharacter(true),
+    m_bAutoRecover(true),
 
     m_iIntegratorType(EXPLICIT_EULER),
 
     m_dDeltaT(g_cdDeltaT),
+    m_dBaseDeltaT(g_cdDeltaT),
     m_dSpringCoefStruct(g_cdK),
     m_dSpringCoefShear(g_cdK),
     m_dSpringCoefBending(g_cdK),
@@ -33,18 +43,112 @@ CMassSpringSystem::CMassSpringSystem()
     m_dDamperCoefShear(g_cdD),
     m_dDamperCoefBending(g_cdD),
 
-    m_ForceField(Vector3d(0.0,-9.8,0.0)),
+    m_ForceFields(),
+    m_dSimTime(0.0),
+    m_uiSeed(1),
+    m_Random(1),
 
     m_GoalNet(),
-    m_Balls()
+    m_Balls(),
+    m_Emitters(),
+    m_Fluid(),
+
+    m_FluidBlockMin(3.7,0.7,-0.3),
+    m_FluidBlockMax(4.3,1.3,0.3),
+    m_FluidVelocity(-8.0,2.0,0.0),
+
+    m_CharacterTrack(),
+    m_CharacterCollider(),
+
+    m_StrainLimiter(),
+    m_ContinuousCollider(),
+    m_ProjectiveDynamics(),
+    m_DomainSolver(),
+    m_FusedEuler(),
+    m_bFusedEuler(true),
+    m_dTearStrain(0.0),
+    m_DrapeSolver(),
+    m_bDrape(false),
+    m_BroadPhase(g_cdBallReach),
+
+    m_Picker(),
+    m_iDragParticle(-1),
+    m_DragTarget(),
+    m_dDragStiffness(1000.0),
+    m_dDragDamping(10.0),
+
+    m_Cloths(),
+    m_iNetTemplate(-1),
+
+    m_Obstacles(),
+
+    m_EnergyMonitor(),
+    m_EnergySample(),
+    m_dMinDeltaT(1e-5),
+    m_iSnapshotInterval(32),
+    m_iStepSinceSnapshot(0),
+    m_iRecoveryNum(0),
+    m_bSnapshotValid(false),
+    m_dSnapshotTime(0.0),
+
+    m_uiGoalpostList(0),
+    m_bGoalpostDirty(true)
 {
+    m_ForceFields.Add(new CGravityField(Vector3d(0.0,-g_cdGravity,0.0)));
+    BuildObstacles();
+    m_iNetTemplate = m_Cloths.AddTemplate(m_GoalNet);
 }
 
 CMassSpringSystem::CMassSpringSystem(const std::string &a_rcsConfigFilename)
-:m_GoalNet(a_rcsConfigFilename)
+:m_bEmitter(true),
+m_bCharacter(true),
+m_dSimTime(0.0),
+m_uiSeed(1),
+m_Random(1),
+m_GoalNet(a_rcsConfigFilename),
+m_BroadPhase(g_cdBallReach),
+m_iDragParticle(-1),
+m_iNetTemplate(-1),
+m_iStepSinceSnapshot(0),
+m_iRecoveryNum(0),
+m_bSnapshotValid(false),
+m_dSnapshotTime(0.0),
+m_uiGoalpostList(0),
+m_bGoalpostDirty(true)
 {
     int iIntegratorType;
     double dSpringCoef,dDamperCoef;
+    double dWindX,dWindY,dWindZ,dWindCoef,dWindTurbulence,dWindTurbulenceScale,dWindTurbulenceFrequency;
+    double dAirDragCoef;
+    double dEmitterRate,dEmitterLifetime,dEmitterSpeed,dEmitterSpread;
+    double dEmitterX,dEmitterY,dEmitterZ;
+    int iEmitterCapacity;
+    double dFluidRadius,dFluidDensity,dFluidStiffness,dFluidViscosity,dFluidBlockSize;
+    double dFluidX,dFluidY,dFluidZ,dFluidVelX,dFluidVelY,dFluidVelZ;
+    int iFluidCapacity;
+    char acCharacterTrack[256];
+    double dCharacterX,dCharacterY,dCharacterZ,dCharacterScale,dCharacterFriction;
+    double dObstacleCellSize,dObstacleBandWidth,dObstacleExtent;
+    char acObstacleMesh[256];
+    double dObstacleMeshX,dObstacleMeshY,dObstacleMeshZ,dObstacleMeshScale;
+    double dStrainLimit;
+    int iStrainLimitIterations;
+    int iStrainLimitSolver;
+    double dStrainLimitSpectralRadius;
+    double dTearStrain;
+    bool bContinuousCollision;
+    int iContinuousSubsteps;
+    int iProjectiveIterations;
+    int iClothCopies;
+    int iDomainNum;
+    int iRandomSeed;
+    bool bDomainPinThreads;
+    bool bLatticeForce;
+    char acDrapeCacheDir[256];
+    bool bLaggedBroadPhase;
+    double dClothSpacingX,dClothSpacingY,dClothSpacingZ;
+    double dGrowthRate;
+    int iGrowthSteps;
 
     ConfigFile configFile;
     configFile.suppressWarnings(1);
@@ -60,6 +164,88 @@ CMassSpringSystem::CMassSpringSystem(const std::string &a_rcsConfigFilename)
     configFile.addOption("DeltaT"    ,&m_dDeltaT);
     configFile.addOption("SpringCoef",&dSpringCoef);
     configFile.addOption("DamperCoef",&dDamperCoef);
+    configFile.addOptionOptional("ProjectiveIterations",&iProjectiveIterations,10);
+
+    configFile.addOptionOptional("WindVelocityX"          ,&dWindX                  ,0.0);
+    configFile.addOptionOptional("WindVelocityY"          ,&dWindY                  ,0.0);
+    configFile.addOptionOptional("WindVelocityZ"          ,&dWindZ                  ,0.0);
+    configFile.addOptionOptional("WindCoef"               ,&dWindCoef               ,0.0);
+    configFile.addOptionOptional("WindTurbulence"         ,&dWindTurbulence         ,0.0);
+    configFile.addOptionOptional("WindTurbulenceScale"    ,&dWindTurbulenceScale    ,1.0);
+    configFile.addOptionOptional("WindTurbulenceFrequency",&dWindTurbulenceFrequency,1.0);
+    configFile.addOptionOptional("AirDragCoef"            ,&dAirDragCoef            ,0.0);
+
+    configFile.addOptionOptional("EmitterRate"     ,&dEmitterRate     ,0.0);
+    configFile.addOptionOptional("EmitterCapacity" ,&iEmitterCapacity ,100000);
+    configFile.addOptionOptional("EmitterLifetime" ,&dEmitterLifetime ,2.0);
+    configFile.addOptionOptional("EmitterSpeed"    ,&dEmitterSpeed    ,5.0);
+    configFile.addOptionOptional("EmitterSpread"   ,&dEmitterSpread   ,20.0);
+    configFile.addOptionOptional("EmitterPositionX",&dEmitterX        ,0.0);
+    configFile.addOptionOptional("EmitterPositionY",&dEmitterY        ,-1.0);
+    configFile.addOptionOptional("EmitterPositionZ",&dEmitterZ        ,0.0);
+    configFile.addOptionOptional("FluidSmoothingRadius",&dFluidRadius   ,0.1);
+    configFile.addOptionOptional("FluidRestDensity"    ,&dFluidDensity  ,1000.0);
+    configFile.addOptionOptional("FluidStiffness"      ,&dFluidStiffness,1000.0);
+    configFile.addOptionOptional("FluidViscosity"      ,&dFluidViscosity,1.0);
+    configFile.addOptionOptional("FluidCapacity"       ,&iFluidCapacity ,200000);
+    configFile.addOptionOptional("FluidBlockSize"      ,&dFluidBlockSize,0.6);
+    configFile.addOptionOptional("FluidBlockPositionX" ,&dFluidX        ,4.0);
+    configFile.addOptionOptional("FluidBlockPositionY" ,&dFluidY        ,1.0);
+    configFile.addOptionOptional("FluidBlockPositionZ" ,&dFluidZ        ,0.0);
+    configFile.addOptionOptional("FluidVelocityX"      ,&dFluidVelX     ,-8.0);
+    configFile.addOptionOptional("FluidVelocityY"      ,&dFluidVelY     ,2.0);
+    configFile.addOptionOptional("FluidVelocityZ"      ,&dFluidVelZ     ,0.0);
+
+    configFile.addOptionOptional("CharacterTrack"    ,acCharacterTrack   ,"none");
+    configFile.addOptionOptional("CharacterOffsetX"  ,&dCharacterX       ,0.0);
+    configFile.addOptionOptional("CharacterOffsetY"  ,&dCharacterY       ,-1.0);
+    configFile.addOptionOptional("CharacterOffsetZ"  ,&dCharacterZ       ,0.0);
+    configFile.addOptionOptional("CharacterScale"    ,&dCharacterScale   ,1.0);
+    configFile.addOptionOptional("CharacterFriction" ,&dCharacterFriction,0.5);
+
+    configFile.addOptionOptional("ObstacleCellSize"   ,&dObstacleCellSize ,0.1);
+    configFile.addOptionOptional("ObstacleBandWidth"  ,&dObstacleBandWidth,0.4);
+    configFile.addOptionOptional("ObstacleExtent"     ,&dObstacleExtent   ,20.0);
+    configFile.addOptionOptional("ObstacleMesh"       ,acObstacleMesh     ,"none");
+    configFile.addOptionOptional("ObstacleMeshOffsetX",&dObstacleMeshX    ,0.0);
+    configFile.addOptionOptional("ObstacleMeshOffsetY",&dObstacleMeshY    ,0.0);
+    configFile.addOptionOptional("ObstacleMeshOffsetZ",&dObstacleMeshZ    ,0.0);
+    configFile.addOptionOptional("ObstacleMeshScale"  ,&dObstacleMeshScale,1.0);
+
+    configFile.addOptionOptional("ClothCopies"  ,&iClothCopies   ,0);
+    configFile.addOptionOptional("ClothSpacingX",&dClothSpacingX,-4.0);
+    configFile.addOptionOptional("ClothSpacingY",&dClothSpacingY,0.0);
+    configFile.addOptionOptional("ClothSpacingZ",&dClothSpacingZ,0.0);
+
+    configFile.addOptionOptional("RandomSeed",&iRandomSeed,1);
+
+    configFile.addOptionOptional("DomainNum"       ,&iDomainNum       ,0);
+    configFile.addOptionOptional("DomainPinThreads",&bDomainPinThreads,true);
+    configFile.addOptionOptional("FusedEuler"      ,&m_bFusedEuler      ,true);
+    configFile.addOptionOptional("LatticeForce"    ,&bLatticeForce      ,true);
+
+    configFile.addOptionOptional("StrainLimit"          ,&dStrainLimit          ,0.0);
+    configFile.addOptionOptional("StrainLimitIterations",&iStrainLimitIterations,4);
+    configFile.addOptionOptional("StrainLimitSolver"    ,&iStrainLimitSolver    ,0);
+    configFile.addOptionOptional("StrainLimitSpectralRadius",&dStrainLimitSpectralRadius,0.9);
+    configFile.addOptionOptional("TearStrain"           ,&dTearStrain           ,0.0);
+
+    configFile.addOptionOptional("Drape"        ,&m_bDrape       ,false);
+    configFile.addOptionOptional("DrapeCacheDir",acDrapeCacheDir,".");
+
+    configFile.addOptionOptional("LaggedBroadPhase",&bLaggedBroadPhase,true);
+
+    configFile.addOptionOptional("ContinuousCollision",&bContinuousCollision,true);
+    configFile.addOptionOptional("ContinuousSubsteps" ,&iContinuousSubsteps ,4);
+
+    configFile.addOptionOptional("DragStiffness",&m_dDragStiffness,1000.0);
+    configFile.addOptionOptional("DragDamping"  ,&m_dDragDamping  ,10.0);
+
+    configFile.addOptionOptional("StabilityGrowthRate"      ,&dGrowthRate        ,1.1);
+    configFile.addOptionOptional("StabilityGrowthSteps"     ,&iGrowthSteps       ,5);
+    configFile.addOptionOptional("StabilityAutoRecover"     ,&m_bAutoRecover     ,true);
+    configFile.addOptionOptional("StabilityMinDeltaT"       ,&m_dMinDeltaT       ,1e-5);
+    configFile.addOptionOptional("StabilitySnapshotInterval",&m_iSnapshotInterval,32);
 
     int code = configFile.parseOptions((char *)a_rcsConfigFilename.c_str());
     if(code == 1)
@@ -68,11 +254,21 @@ CMassSpringSystem::CMassSpringSystem(const std::string &a_rcsConfigFilename)
         system("pause");
         exit(0);
     }
+    m_dBaseDeltaT = m_dDeltaT;
     m_iIntegratorType = CMassSpringSystem::EXPLICIT_EULER;
     if(iIntegratorType == 1)
     {
         m_iIntegratorType = CMassSpringSystem::RUNGE_KUTTA;
     }
+    else if(iIntegratorType == 2)
+    {
+        m_iIntegratorType = CMassSpringSystem::PROJECTIVE_DYNAMICS;
+    }
+    m_ProjectiveDynamics.SetIterationNum(iProjectiveIterations);
+    SetSeed((unsigned int)iRandomSeed);
+    m_DomainSolver.SetDomainNum(iDomainNum);
+    m_DomainSolver.SetPinThreads(bDomainPinThreads);
+    m_GoalNet.SetLatticeForce(bLatticeForce);
 
     m_dSpringCoefStruct  = dSpringCoef;
     m_dSpringCoefShear   = dSpringCoef;
@@ -81,9 +277,79 @@ CMassSpringSystem::CMassSpringSystem(const std::string &a_rcsConfigFilename)
     m_dDamperCoefShear   = dDamperCoef;
     m_dDamperCoefBending = dDamperCoef;
 
-    m_ForceField   = Vector3d(0.0,-9.8,0.0);
+    m_ForceFields.Add(new CGravityField(Vector3d(0.0,-g_cdGravity,0.0)));
+    if(dWindCoef != 0.0)
+    {
+        m_ForceFields.Add(new CWindField(Vector3d(dWindX,dWindY,dWindZ),dWindCoef,
+                                         dWindTurbulence,dWindTurbulenceScale,dWindTurbulenceFrequency));
+    }
+    if(dAirDragCoef != 0.0)
+    {
+        m_ForceFields.Add(new CDragField(dAirDragCoef));
+    }
+
+    if(dEmitterRate > 0.0)
+    {
+        CEmitter emitter(iEmitterCapacity);
+        emitter.SetPosition(Vector3d(dEmitterX,dEmitterY,dEmitterZ));
+        emitter.SetRate(dEmitterRate);
+        emitter.SetLifetime(dEmitterLifetime,0.25);
+        emitter.SetSpeed(dEmitterSpeed,0.2);
+        emitter.SetSpread(dEmitterSpread);
+        AddEmitter(emitter);
+    }
+
+    m_Fluid.SetSmoothingRadius(dFluidRadius);
+    m_Fluid.SetRestDensity(dFluidDensity);
+    m_Fluid.SetStiffness(dFluidStiffness);
+    m_Fluid.SetViscosity(dFluidViscosity);
+    m_Fluid.SetCapacity(iFluidCapacity);
+    Vector3d fluidHalfSize(0.5*dFluidBlockSize,0.5*dFluidBlockSize,0.5*dFluidBlockSize);
+    m_FluidBlockMin = Vector3d(dFluidX,dFluidY,dFluidZ) - fluidHalfSize;
+    m_FluidBlockMax = Vector3d(dFluidX,dFluidY,dFluidZ) + fluidHalfSize;
+    m_FluidVelocity = Vector3d(dFluidVelX,dFluidVelY,dFluidVelZ);
+
+    m_CharacterTrack.SetOffset(Vector3d(dCharacterX,dCharacterY,dCharacterZ));
+    m_CharacterTrack.SetScale(dCharacterScale);
+    m_CharacterCollider.SetFriction(dCharacterFriction);
+    if(std::string(acCharacterTrack) != "none")
+    {
+        LoadCharacter(acCharacterTrack);
+    }
+
+    m_StrainLimiter.SetMaxStrain(dStrainLimit/100.0);
+    m_StrainLimiter.SetIterationNum(iStrainLimitIterations);
+    m_StrainLimiter.SetSolver((iStrainLimitSolver == 1) ? CStrainLimiter::Solver_nJacobi : CStrainLimiter::Solver_nGaussSeidel);
+    m_StrainLimiter.SetSpectralRadius(dStrainLimitSpectralRadius);
+    SetTearStrain(dTearStrain/100.0);
+    m_DrapeSolver.SetCacheDir(acDrapeCacheDir);
+    m_BroadPhase.SetEnable(bLaggedBroadPhase);
+    m_ContinuousCollider.SetEnable(bContinuousCollision);
+    m_ContinuousCollider.SetMaxSubstepNum(iContinuousSubsteps);
+
+    m_EnergyMonitor.SetGravity(g_cdGravity);
+    m_EnergyMonitor.SetGrowthRate(dGrowthRate);
+    m_EnergyMonitor.SetGrowthSteps(iGrowthSteps);
 
     Reset();
+
+    m_iNetTemplate = m_Cloths.AddTemplate(m_GoalNet);
+    for(int iI = 1 ; iI<=iClothCopies ; iI++)
+    {
+        AddNetCopy(Vector3d(dClothSpacingX,dClothSpacingY,dClothSpacingZ)*iI);
+    }
+
+    m_Obstacles.SetCellSize(dObstacleCellSize);
+    m_Obstacles.SetBandWidth(dObstacleBandWidth);
+    m_Obstacles.SetExtent(dObstacleExtent);
+    if(std::string(acObstacleMesh) != "none")
+    {
+        LoadObstacleMesh(acObstacleMesh, Vector3d(dObstacleMeshX,dObstacleMeshY,dObstacleMeshZ), dObstacleMeshScale);
+    }
+    else
+    {
+        BuildObstacles();
+    }
 }
 
 CMassSpringSystem::CMassSpringSystem(const CMassSpringSystem &a_rcMassSpringSystem)
@@ -93,10 +359,14 @@ CMassSpringSystem::CMassSpringSystem(const CMassSpringSystem &a_rcMassSpringSyst
     m_bDrawBending(a_rcMassSpringSystem.m_bDrawBending),
     m_bDrawGoalpost(a_rcMassSpringSystem.m_bDrawGoalpost),
     m_bSimulation(a_rcMassSpringSystem.m_bSimulation),
+    m_bEmitter(a_rcMassSpringSystem.m_bEmitter),
+    m_bCharacter(a_rcMassSpringSystem.m_bCharacter),
+    m_bAutoRecover(a_rcMassSpringSystem.m_bAutoRecover),
 
     m_iIntegratorType(a_rcMassSpringSystem.m_iIntegratorType),
 
     m_dDeltaT(a_rcMassSpringSystem.m_dDeltaT),
+    m_dBaseDeltaT(a_rcMassSpringSystem.m_dBaseDeltaT),
     m_dSpringCoefStruct(a_rcMassSpringSystem.m_dSpringCoefStruct),
     m_dSpringCoefShear(a_rcMassSpringSystem.m_dSpringCoefShear),
     m_dSpringCoefBending(a_rcMassSpringSystem.m_dSpringCoefBending),
@@ -104,7 +374,56 @@ CMassSpringSystem::CMassSpringSystem(const CMassSpringSystem &a_rcMassSpringSyst
     m_dDamperCoefShear(a_rcMassSpringSystem.m_dDamperCoefShear),
     m_dDamperCoefBending(a_rcMassSpringSystem.m_dDamperCoefBending),
 
-    m_ForceField(a_rcMassSpringSystem.m_ForceField)
+    m_ForceFields(a_rcMassSpringSystem.m_ForceFields),
+    m_dSimTime(a_rcMassSpringSystem.m_dSimTime),
+    m_uiSeed(a_rcMassSpringSystem.m_uiSeed),
+    m_Random(a_rcMassSpringSystem.m_Random),
+
+    m_GoalNet(a_rcMassSpringSystem.m_GoalNet),
+    m_Balls(a_rcMassSpringSystem.m_Balls),
+    m_Emitters(a_rcMassSpringSystem.m_Emitters),
+    m_Fluid(a_rcMassSpringSystem.m_Fluid),
+
+    m_FluidBlockMin(a_rcMassSpringSystem.m_FluidBlockMin),
+    m_FluidBlockMax(a_rcMassSpringSystem.m_FluidBlockMax),
+    m_FluidVelocity(a_rcMassSpringSystem.m_FluidVelocity),
+
+    m_CharacterTrack(a_rcMassSpringSystem.m_CharacterTrack),
+    m_CharacterCollider(a_rcMassSpringSystem.m_CharacterCollider),
+
+    m_StrainLimiter(a_rcMassSpringSystem.m_StrainLimiter),
+    m_ContinuousCollider(a_rcMassSpringSystem.m_ContinuousCollider),
+    m_ProjectiveDynamics(a_rcMassSpringSystem.m_ProjectiveDynamics),
+    m_DomainSolver(a_rcMassSpringSystem.m_DomainSolver),
+    m_FusedEuler(),
+    m_bFusedEuler(a_rcMassSpringSystem.m_bFusedEuler),
+    m_dTearStrain(a_rcMassSpringSystem.m_dTearStrain),
+    m_DrapeSolver(a_rcMassSpringSystem.m_DrapeSolver),
+    m_bDrape(a_rcMassSpringSystem.m_bDrape),
+    m_BroadPhase(a_rcMassSpringSystem.m_BroadPhase),
+
+    m_Picker(),
+    m_iDragParticle(-1),
+    m_DragTarget(),
+    m_dDragStiffness(a_rcMassSpringSystem.m_dDragStiffness),
+    m_dDragDamping(a_rcMassSpringSystem.m_dDragDamping),
+
+    m_Cloths(a_rcMassSpringSystem.m_Cloths),
+    m_iNetTemplate(a_rcMassSpringSystem.m_iNetTemplate),
+
+    m_Obstacles(a_rcMassSpringSystem.m_Obstacles),
+
+    m_EnergyMonitor(a_rcMassSpringSystem.m_EnergyMonitor),
+    m_EnergySample(a_rcMassSpringSystem.m_EnergySample),
+    m_dMinDeltaT(a_rcMassSpringSystem.m_dMinDeltaT),
+    m_iSnapshotInterval(a_rcMassSpringSystem.m_iSnapshotInterval),
+    m_iStepSinceSnapshot(0),
+    m_iRecoveryNum(a_rcMassSpringSystem.m_iRecoveryNum),
+    m_bSnapshotValid(false),
+    m_dSnapshotTime(0.0),
+
+    m_uiGoalpostList(0),
+    m_bGoalpostDirty(true)
 {
 }
 CMassSpringSystem::~CMassSpringSystem()
@@ -116,11 +435,19 @@ CMassSpringSystem::~CMassSpringSystem()
 void CMassSpringSystem::Draw()
 {
     DrawGoalNet();
+    DrawCloth();
+    DrawObstacle();
     DrawBall();
+    DrawCharacter();
+    DrawEmitter();
+    DrawFluid();
+    DrawDrag();
 }
 
 void CMassSpringSystem::DrawGoalNet()
 {    
+    g_Profiler.Begin(CProfiler::Phase_nDrawGoalNet);
+
     // draw particle
     if (m_bDrawParticle)
     {
@@ -137,6 +464,10 @@ void CMassSpringSystem::DrawGoalNet()
     glPushAttrib(GL_CURRENT_BIT);
     for (int uiI = 0; uiI < m_GoalNet.SpringNum(); uiI++)
     {
+        if (m_GoalNet.GetSpring(uiI).IsBroken())
+        {
+            continue;
+        }
         if ((m_GoalNet.GetSpring(uiI).GetSpringType() == CSpring::Type_nStruct && m_bDrawStruct) ||
             (m_GoalNet.GetSpring(uiI).GetSpringType() == CSpring::Type_nShear && m_bDrawShear) ||
             (m_GoalNet.GetSpring(uiI).GetSpringType() == CSpring::Type_nBending && m_bDrawBending))
@@ -153,6 +484,8 @@ void CMassSpringSystem::DrawGoalNet()
     }
     glPopAttrib();
 
+    g_Profiler.End(CProfiler::Phase_nDrawGoalNet);
+
     if (m_bDrawGoalpost)
     {
         DrawGoalpost();
@@ -161,68 +494,153 @@ void CMassSpringSystem::DrawGoalNet()
 
 void CMassSpringSystem::DrawGoalpost()
 {
+    CScopedTimer timer(CProfiler::Phase_nDrawGoalpost);
+    // the corners of the goalpost are fixed particles, so the cylinders only
+    // have to be compiled again after the net is reset
+    if (m_uiGoalpostList != 0 && !m_bGoalpostDirty)
+    {
+        glCallList(m_uiGoalpostList);
+        return;
+    }
+    if (m_uiGoalpostList == 0)
+    {
+        m_uiGoalpostList = glGenLists(1);
+    }
+    m_bGoalpostDirty = false;
+    glNewList(m_uiGoalpostList, GL_COMPILE_AND_EXECUTE);
+
     // draw cylinder
+    Vector3d aStart[s_ciGoalpostNum];
+    Vector3d aEnd[s_ciGoalpostNum];
+    GetGoalposts(aStart, aEnd);
+    for (int i = 0; i < s_ciGoalpostNum; ++i)
+    {
+        drawCylinder(aStart[i], aEnd[i], g_cdGoalpostRadius);
+    }
+
+    glEndList();
+}
+
+void CMassSpringSystem::GetGoalposts(Vector3d *a_pStart, Vector3d *a_pEnd)
+{
     int widthNum = m_GoalNet.GetWidthNum();
     int heightNum = m_GoalNet.GetHeightNum();
     int lengthNum = m_GoalNet.GetLengthNum();
 
-    int backBottomRightId = m_GoalNet.GetParticleID(0, 0, 0);
-    int backBottomLeftId = m_GoalNet.GetParticleID(0, 0, lengthNum - 1);
-    int frontBottomRightId = m_GoalNet.GetParticleID(widthNum - 1, 0, 0);
-    int frontBottomLeftId = m_GoalNet.GetParticleID(widthNum - 1, 0, lengthNum - 1);
-    int backTopRightId = m_GoalNet.GetParticleID(0, heightNum - 1, 0);
-    int backTopLeftId = m_GoalNet.GetParticleID(0, heightNum - 1, lengthNum - 1);
-    int frontTopRightId = m_GoalNet.GetParticleID(widthNum - 1, heightNum - 1, 0);
-    int frontTopLeftId = m_GoalNet.GetParticleID(widthNum - 1, heightNum - 1, lengthNum - 1);
-    drawCylinder(
-        m_GoalNet.GetParticle(backBottomLeftId).GetPosition(),
-        m_GoalNet.GetParticle(backTopLeftId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(backBottomRightId).GetPosition(),
-        m_GoalNet.GetParticle(backTopRightId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(backTopRightId).GetPosition(),
-        m_GoalNet.GetParticle(backTopLeftId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(backTopRightId).GetPosition(),
-        m_GoalNet.GetParticle(frontTopRightId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(backTopLeftId).GetPosition(),
-        m_GoalNet.GetParticle(frontTopLeftId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(frontTopRightId).GetPosition(),
-        m_GoalNet.GetParticle(frontTopLeftId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(frontBottomRightId).GetPosition(),
-        m_GoalNet.GetParticle(frontTopRightId).GetPosition(),
-        0.05);
-    drawCylinder(
-        m_GoalNet.GetParticle(frontBottomLeftId).GetPosition(),
-        m_GoalNet.GetParticle(frontTopLeftId).GetPosition(),
-        0.05);
+    Vector3d backBottomRight = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(0, 0, 0)).GetPosition();
+    Vector3d backBottomLeft = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(0, 0, lengthNum - 1)).GetPosition();
+    Vector3d frontBottomRight = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(widthNum - 1, 0, 0)).GetPosition();
+    Vector3d frontBottomLeft = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(widthNum - 1, 0, lengthNum - 1)).GetPosition();
+    Vector3d backTopRight = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(0, heightNum - 1, 0)).GetPosition();
+    Vector3d backTopLeft = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(0, heightNum - 1, lengthNum - 1)).GetPosition();
+    Vector3d frontTopRight = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(widthNum - 1, heightNum - 1, 0)).GetPosition();
+    Vector3d frontTopLeft = m_GoalNet.GetParticle(m_GoalNet.GetParticleID(widthNum - 1, heightNum - 1, lengthNum - 1)).GetPosition();
+
+    a_pStart[0] = backBottomLeft;   a_pEnd[0] = backTopLeft;
+    a_pStart[1] = backBottomRight;  a_pEnd[1] = backTopRight;
+    a_pStart[2] = backTopRight;     a_pEnd[2] = backTopLeft;
+    a_pStart[3] = backTopRight;     a_pEnd[3] = frontTopRight;
+    a_pStart[4] = backTopLeft;      a_pEnd[4] = frontTopLeft;
+    a_pStart[5] = frontTopRight;    a_pEnd[5] = frontTopLeft;
+    a_pStart[6] = frontBottomRight; a_pEnd[6] = frontTopRight;
+    a_pStart[7] = frontBottomLeft;  a_pEnd[7] = frontTopLeft;
+}
+
+void CMassSpringSystem::DrawCloth()
+{
+    if(m_Cloths.InstanceNum() == 0)
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nDrawCloth);
+    m_Cloths.Draw(m_bDrawParticle, m_bDrawStruct, m_bDrawShear, m_bDrawBending);
 }
 
 void CMassSpringSystem::DrawBall()
 {
+    CScopedTimer timer(CProfiler::Phase_nDrawBall);
     for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
         drawSolidBall(m_Balls[ballIdx].GetPosition(), m_Balls[ballIdx].GetRadius());
     }
 }
 
+void CMassSpringSystem::DrawObstacle()
+{
+    CScopedTimer timer(CProfiler::Phase_nDrawObstacle);
+    m_Obstacles.Draw();
+}
+
+void CMassSpringSystem::DrawCharacter()
+{
+    if(!m_bCharacter)
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nDrawCharacter);
+    m_CharacterCollider.Draw();
+}
+
+void CMassSpringSystem::DrawEmitter()
+{
+    CScopedTimer timer(CProfiler::Phase_nDrawEmitter);
+    for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+    {
+        m_Emitters[uiI].Draw();
+    }
+}
+
+void CMassSpringSystem::DrawFluid()
+{
+    CScopedTimer timer(CProfiler::Phase_nDrawFluid);
+    m_Fluid.Draw();
+}
+
+void CMassSpringSystem::DrawDrag()
+{
+    if(m_iDragParticle < 0)
+    {
+        return;
+    }
+    glPushAttrib(GL_CURRENT_BIT);
+    setColor3f(1.0, 1.0, 0.0);
+    drawLine(m_GoalNet.GetParticle(m_iDragParticle).GetPosition(), m_DragTarget);
+    drawPoint(m_DragTarget, 6.0);
+    glPopAttrib();
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Set and Update
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void CMassSpringSystem::Reset()
 { 
     m_GoalNet.Reset();
+    if(m_bDrape)
+    {
+        m_DrapeSolver.Drape(m_GoalNet, m_ForceFields);
+    }
     m_Balls.clear();
+    m_bGoalpostDirty = true;
+    m_dSimTime = 0.0;
+    m_Random.Seed(m_uiSeed);
+    for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+    {
+        m_Emitters[uiI].Reset();
+    }
+    m_Fluid.Reset();
+    m_CharacterCollider.Reset();
+    m_ProjectiveDynamics.Invalidate();
+    m_ContinuousCollider.Reset();
+    m_Picker.Invalidate();
+    m_BroadPhase.Invalidate();
+    m_iDragParticle = -1;
+    m_Cloths.Reset();
+    m_EnergyMonitor.Reset();
+    m_EnergySample.Clear();
+    m_bSnapshotValid = false;
+    m_iStepSinceSnapshot = 0;
+    m_iRecoveryNum = 0;
+    m_dDeltaT = m_dBaseDeltaT;
 }
 
 void CMassSpringSystem::SetSpringCoef(const double a_cdSpringCoef, const CSpring::enType_t a_cSpringType)
@@ -231,16 +649,28 @@ void CMassSpringSystem::SetSpringCoef(const double a_cdSpringCoef, const CSpring
     {
         m_dSpringCoefStruct = a_cdSpringCoef;
         m_GoalNet.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nStruct);
+        m_Cloths.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nStruct);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else if (a_cSpringType == CSpring::Type_nShear)
     {
         m_dSpringCoefShear = a_cdSpringCoef;
         m_GoalNet.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nShear);
+        m_Cloths.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nShear);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else if (a_cSpringType == CSpring::Type_nBending)
     {
         m_dSpringCoefBending = a_cdSpringCoef;
         m_GoalNet.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nBending);
+        m_Cloths.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nBending);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else
     {
@@ -255,16 +685,28 @@ void CMassSpringSystem::SetDamperCoef(const double a_cdDamperCoef, const CSpring
     {
         m_dDamperCoefStruct = a_cdDamperCoef;
         m_GoalNet.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nStruct);
+        m_Cloths.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nStruct);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else if (a_cSpringType == CSpring::Type_nShear)
     {
         m_dDamperCoefShear = a_cdDamperCoef;
         m_GoalNet.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nShear);
+        m_Cloths.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nShear);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else if (a_cSpringType == CSpring::Type_nBending)
     {
         m_dDamperCoefBending = a_cdDamperCoef;
         m_GoalNet.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nBending);
+        m_Cloths.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nBending);
+        m_ProjectiveDynamics.Invalidate();
+        m_DomainSolver.Invalidate();
+        m_FusedEuler.Invalidate();
     }
     else
     {
@@ -272,7 +714,7 @@ void CMassSpringSystem::SetDamperCoef(const double a_cdDamperCoef, const CSpring
     }
 }
 
-double CMassSpringSystem::GetSpringCoef(const CSpring::enType_t a_cSpringType)
+double CMassSpringSystem::GetSpringCoef(const CSpring::enType_t a_cSpringType) const
 {
     if(a_cSpringType == CSpring::Type_nStruct)
     {
@@ -292,7 +734,7 @@ double CMassSpringSystem::GetSpringCoef(const CSpring::enType_t a_cSpringType)
         return -1.0;
     }
 }
-double CMassSpringSystem::GetDamperCoef(const CSpring::enType_t a_cSpringType)
+double CMassSpringSystem::GetDamperCoef(const CSpring::enType_t a_cSpringType) const
 {
     if(a_cSpringType == CSpring::Type_nStruct)
     {
@@ -317,22 +759,71 @@ double CMassSpringSystem::GetDamperCoef(const CSpring::enType_t a_cSpringType)
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool CMassSpringSystem::CheckStable()
 {
-    double threshold = 1e6;
-    for(int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); pIdx++)
+    // the energies are summed inside the integrators, nothing to scan here
+    return !m_EnergyMonitor.IsDiverging();
+}
+double CMassSpringSystem::MeasureEnergy()
+{
+    // the same sums as the integrators, the springs from the positions
+    EnergySample sample;
+    sample.Clear();
+    for (int sIdx = 0; sIdx < m_GoalNet.SpringNum(); ++sIdx)
     {
-        Vector3d particleVel = m_GoalNet.GetParticle(pIdx).GetVelocity();
-        if (particleVel.Magnitude() > threshold)
+        CSpring &s = m_GoalNet.GetSpring(sIdx);
+        if (s.IsBroken())
         {
-            return false;
-        }  
+            continue;
+        }
+        double dStretch = (m_GoalNet.GetParticle(s.GetSpringStartID()).GetPosition() - m_GoalNet.GetParticle(s.GetSpringEndID()).GetPosition()).Length() - s.GetSpringRestLength();
+        sample.dSpring += 0.5*s.GetSpringCoef()*dStretch*dStretch;
     }
-    return true;
+    for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
+    {
+        CParticle &p = m_GoalNet.GetParticle(pIdx);
+        sample.AddBody(p.GetMass(), p.GetPosition().y - g_cdGroundHeight, p.GetVelocity());
+    }
+    for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
+    {
+        Ball &b = m_Balls[ballIdx];
+        sample.AddBody(b.GetMass(), b.GetPosition().y - g_cdGroundHeight, b.GetVelocity());
+    }
+    return sample.dKinetic + sample.dSpring + sample.dMassHeight*g_cdGravity;
 }
+
 void CMassSpringSystem::SimulationOneTimeStep()
 {
     if(m_bSimulation)
     {
+        m_ContinuousCollider.Begin(m_GoalNet, m_Balls);
         Integrate();
+        ContinuousCollision();
+        Tear();
+        StrainLimit();
+        CharacterCollision();
+
+        if(m_Cloths.InstanceNum() > 0)
+        {
+            CScopedTimer timer(CProfiler::Phase_nCloth);
+            m_Cloths.Update(m_dDeltaT, m_dSimTime, m_ForceFields, m_Obstacles);
+        }
+
+        if(!m_Emitters.empty())
+        {
+            CScopedTimer timer(CProfiler::Phase_nEmitter);
+            for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+            {
+                m_Emitters[uiI].Update(m_dDeltaT, m_dSimTime, m_ForceFields, m_Obstacles, m_Balls);
+            }
+        }
+
+        if(m_Fluid.ParticleNum() > 0)
+        {
+            CScopedTimer timer(CProfiler::Phase_nFluid);
+            m_Fluid.Update(m_dDeltaT, m_dSimTime, m_ForceFields, m_Obstacles, m_GoalNet, m_Balls);
+        }
+        m_dSimTime += m_dDeltaT;
+
+        MonitorStability();
     }
     
 }
@@ -344,32 +835,153 @@ void CMassSpringSystem::CreateBall()
 {
     // randomly assign initial velocity and position to a ball
     Ball newBall;
-    Vector3d randomOffset((double)(rand() % 5 + 5.0), (double)(rand() % 5), (double)(rand() % 5));
-    Vector3d randomVelOffset(0.0, 0.0, (double)(rand() % 3));
+    Vector3d randomOffset((double)(m_Random.UniformInt(5) + 5.0), (double)m_Random.UniformInt(5), (double)m_Random.UniformInt(5));
+    Vector3d randomVelOffset(0.0, 0.0, (double)m_Random.UniformInt(3));
     Vector3d initBallPos = m_GoalNet.GetInitPos() + randomOffset;
     Vector3d initBallVel = (m_GoalNet.GetInitPos() + randomVelOffset - initBallPos)*7.0 +Vector3d(0,0,0) ;
-	cout << initBallVel << endl;
     //Vector3d initBallVel = Vector3d::ZERO;
     newBall.SetPosition(initBallPos);
     newBall.SetVelocity(initBallVel);
     m_Balls.push_back(newBall);
 }
 
+void CMassSpringSystem::CreateBall(const Vector3d &a_rcPosition, const Vector3d &a_rcVelocity, const double a_cdMass)
+{
+    Ball newBall;
+    newBall.SetMass(a_cdMass);
+    newBall.SetPosition(a_rcPosition);
+    newBall.SetVelocity(a_rcVelocity);
+    m_Balls.push_back(newBall);
+}
+
 int CMassSpringSystem::BallNum()
 {
     return m_Balls.size();
 }
 
+void CMassSpringSystem::AddForceField(CForceField *a_pField)
+{
+    m_ForceFields.Add(a_pField);
+}
+
+void CMassSpringSystem::ClearForceField()
+{
+    m_ForceFields.Clear();
+}
+
+void CMassSpringSystem::AddEmitter(const CEmitter &a_rcEmitter)
+{
+    m_Emitters.push_back(a_rcEmitter);
+    m_Emitters.back().SetEnable(m_bEmitter);
+    m_Emitters.back().SetSeed(m_uiSeed + 0x9e3779b9u*(unsigned int)m_Emitters.size());
+}
+
+void CMassSpringSystem::SetSeed(const unsigned int a_cuiSeed)
+{
+    // every emitter draws from a stream of its own
+    m_uiSeed = a_cuiSeed;
+    m_Random.Seed(a_cuiSeed);
+    for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+    {
+        m_Emitters[uiI].SetSeed(a_cuiSeed + 0x9e3779b9u*(unsigned int)(uiI + 1));
+    }
+}
+
+bool CMassSpringSystem::Pick(const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const double a_cdRadius, Vector3d &a_rHitPoint)
+{
+    CScopedTimer timer(CProfiler::Phase_nPick);
+    CPicker::Result result;
+    m_iDragParticle = -1;
+    if(!m_Picker.Pick(m_GoalNet, a_rcOrigin, a_rcDirection.NormalizedCopy(), a_cdRadius, result))
+    {
+        return false;
+    }
+    // the spring starts slack, the particle only moves once the mouse does
+    m_iDragParticle = result.iParticle;
+    m_DragTarget = m_GoalNet.GetParticle(m_iDragParticle).GetPosition();
+    a_rHitPoint = result.point;
+    return true;
+}
+
+void CMassSpringSystem::SetEmitterEnable(const bool a_cbEmitter)
+{
+    m_bEmitter = a_cbEmitter;
+    for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+    {
+        m_Emitters[uiI].SetEnable(a_cbEmitter);
+    }
+}
+
+int CMassSpringSystem::EmitterParticleNum()
+{
+    int iNum = 0;
+    for(size_t uiI = 0 ; uiI<m_Emitters.size() ; uiI++)
+    {
+        iNum += m_Emitters[uiI].ParticleNum();
+    }
+    return iNum;
+}
+
+void CMassSpringSystem::CreateFluid()
+{
+    m_Fluid.AddBlock(m_FluidBlockMin, m_FluidBlockMax, m_FluidVelocity);
+}
+
+int CMassSpringSystem::FluidParticleNum()
+{
+    return m_Fluid.ParticleNum();
+}
+
+void CMassSpringSystem::BuildObstacles()
+{
+    // the posts are only added once the fixed corners are in place, the mesh stays
+    m_Obstacles.ClearPrimitives();
+    m_Obstacles.AddPlane(Vector3d(0.0,g_cdGroundHeight,0.0), Vector3d(0.0,1.0,0.0));
+    Vector3d aStart[s_ciGoalpostNum];
+    Vector3d aEnd[s_ciGoalpostNum];
+    GetGoalposts(aStart, aEnd);
+    for(int iI = 0 ; iI<s_ciGoalpostNum ; iI++)
+    {
+        m_Obstacles.AddCapsule(aStart[iI], aEnd[iI], g_cdGoalpostRadius, false);    // DrawGoalpost() draws them
+    }
+    m_Obstacles.Bake();
+}
+
+bool CMassSpringSystem::LoadObstacleMesh(const std::string &a_rcsFilename, const Vector3d &a_rcOffset, const double a_cdScale)
+{
+    m_Obstacles.ClearMeshes();
+    bool bLoaded = m_Obstacles.AddMesh(a_rcsFilename, a_rcOffset, a_cdScale);
+    BuildObstacles();
+    return bLoaded;
+}
+
+int CMassSpringSystem::AddNetCopy(const Vector3d &a_rcOffset)
+{
+    return m_Cloths.AddInstance(m_iNetTemplate, a_rcOffset);
+}
+
+bool CMassSpringSystem::LoadCharacter(const std::string &a_rcsTrackFilename)
+{
+    m_CharacterCollider.Reset();
+    return m_CharacterTrack.Load(a_rcsTrackFilename);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Compute Force
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void CMassSpringSystem::ResetAllForce()
 {
+    CScopedTimer timer(CProfiler::Phase_nResetForce);
     for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
     {
         m_GoalNet.GetParticle(pIdx).SetAcceleration(Vector3d::ZERO);
     }
 
+    ResetBallForce();
+}
+
+void CMassSpringSystem::ResetBallForce()
+{
     for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
         m_Balls[ballIdx].SetAcceleration(Vector3d::ZERO);
@@ -378,107 +990,87 @@ void CMassSpringSystem::ResetAllForce()
 
 void CMassSpringSystem::ComputeAllForce()
 {
+    CScopedTimer timer(CProfiler::Phase_nForce);
     ComputeParticleForce();
     ComputeBallForce();
+    ComputeDragForce();
+    m_Fluid.ApplyCoupling(m_GoalNet, m_Balls);
 }
 
 void CMassSpringSystem::ComputeParticleForce()
 {
-    m_GoalNet.AddForceField(m_ForceField);
+    m_ForceFields.Apply(m_GoalNet, m_dSimTime);
     m_GoalNet.ComputeInternalForce();
 }
 
 void CMassSpringSystem::ComputeBallForce()
 {
-    for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
+    m_ForceFields.Apply(m_Balls, m_dSimTime);
+}
+
+void CMassSpringSystem::ComputeExternalForce()
+{
+    CScopedTimer timer(CProfiler::Phase_nForce);
+    m_ForceFields.Apply(m_GoalNet, m_dSimTime);
+    ComputeBallForce();
+    ComputeDragForce();
+    m_Fluid.ApplyCoupling(m_GoalNet, m_Balls);
+}
+
+void CMassSpringSystem::ComputeDragForce()
+{
+    if(m_iDragParticle < 0)
     {
-        m_Balls[ballIdx].AddForce(m_ForceField * m_Balls[ballIdx].GetMass());
+        return;
     }
+    // a damped spring from the picked particle to the mouse
+    CParticle &rParticle = m_GoalNet.GetParticle(m_iDragParticle);
+    rParticle.AddForce((m_DragTarget - rParticle.GetPosition())*m_dDragStiffness - rParticle.GetVelocity()*m_dDragDamping);
 }
 
 void CMassSpringSystem::HandleCollision()
 {
-    ParticlePlaneCollision();
-    BallPlaneCollision();
+    ParticleObstacleCollision();
+    BallObstacleCollision();
     BallToBallCollision();
     BallParticleCollision();
 }
 
-void CMassSpringSystem::ParticlePlaneCollision()
-{
-    //TO DO 
-	for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); pIdx++){
-		CParticle p = m_GoalNet.GetParticle(pIdx);
-		double kr = 0.5;
-		double kf = 25;
-		if (p.GetPosition().DotProduct(normal) < (-1.0+eps) && p.GetVelocity().DotProduct(normal) < 0){
-			Vector3d temp = p.GetVelocity();
-			temp.y = temp.y * kr * (-1);
-			p.SetVelocity(temp);
-		
-		}
-
-
-			if (p.GetPosition().DotProduct(normal) <(-1.0+eps)){
-
-				if (abs(p.GetVelocity().DotProduct(normal)) < eps && p.GetForce().DotProduct(normal) < 0){   // Friction
-					Vector3d temp = p.GetVelocity();
-					temp.y = 0;
-					temp.Normalize();
-					p.AddForce(p.GetForce().DotProduct(normal)*(-1)*kf*(-1)*temp);
-				}
-				
 
-				if (p.GetForce().DotProduct(normal) < 0){
-					p.AddForce(p.GetForce().DotProduct(normal) * normal * (-1));
-				}
-
-			}
-
-		m_GoalNet.setParticle(p, pIdx);
-	}
+void CMassSpringSystem::ParticleObstacleCollision()
+{
+    CScopedTimer timer(CProfiler::Phase_nParticleObstacleCollision);
+    CThreadPool::Instance().ParallelFor(0, m_GoalNet.ParticleNum(), [this](int a_iBegin, int a_iEnd)
+    {
+        for (int pIdx = a_iBegin; pIdx < a_iEnd; pIdx++)
+        {
+            CParticle &p = m_GoalNet.GetParticle(pIdx);
+            Vector3d vel = p.GetVelocity();
+            Vector3d force = p.GetForce();
+            m_Obstacles.ResolveContact(p.GetPosition(), 0.0, 0.5, 25, vel, force);
+            p.SetVelocity(vel);
+            p.SetForce(force);
+        }
+    }, 256);
 }
-
-void CMassSpringSystem::BallPlaneCollision()
+void CMassSpringSystem::BallObstacleCollision()
 {
-    //TO DO
-	  for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
+    CScopedTimer timer(CProfiler::Phase_nBallObstacleCollision);
+	for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
 		Ball b = m_Balls[ballIdx];
-		double kr = 0.3;
-		double kf = 10;
-		if((b.GetPosition()).DotProduct(normal)<(eps-1.0+b.GetRadius())&&b.GetVelocity().DotProduct(normal)<0){
-			Vector3d temp = b.GetVelocity();
-			temp.y = temp.y * kr * (-1);
-			b.SetVelocity(temp);
-			//cout << "YOOO" << endl;
-		}
-
-		if ((b.GetPosition()).DotProduct(normal)<(eps -1.0 +b.GetRadius())){
-
-			if (b.GetVelocity().DotProduct(normal) <= 0.01 && b.GetForce().DotProduct(normal)<0){   // Friction
-				Vector3d temp = b.GetVelocity();
-				temp.y = 0;
-				temp.Normalize();
-				b.AddForce(b.GetForce().DotProduct(normal)*(-1)*kf*(-1)*temp);
-				//cout << "bbb " << b.GetForce().DotProduct(normal)*(-1)*kf*(-1)*temp << endl;
-			}
-			
-			
-			if(b.GetForce().DotProduct(normal)<0){   
-				b.AddForce(b.GetForce().DotProduct(normal) * normal * (-1));
-				//cout << "aaa Position:" <<b.GetPosition()<< endl;
-			}
-		
-		}
-	  
+		Vector3d vel = b.GetVelocity();
+		Vector3d force = b.GetForce();
+		m_Obstacles.ResolveContact(b.GetPosition(), b.GetRadius(), 0.3, 10, vel, force);
+		b.SetVelocity(vel);
+		b.SetForce(force);
 		m_Balls[ballIdx] = b;
 	}
-	
 }
 
 void CMassSpringSystem::BallToBallCollision()
 {
+    CScopedTimer timer(CProfiler::Phase_nBallToBallCollision);
     //TO DO
 	for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
@@ -510,16 +1102,24 @@ void CMassSpringSystem::BallToBallCollision()
 
 void CMassSpringSystem::BallParticleCollision()
 {
+    CScopedTimer timer(CProfiler::Phase_nBallParticleCollision);
     //TO DO
+    if (m_Balls.empty())
+    {
+        return;
+    }
+    // only the particles the broad phase found within reach, in ascending order
+    m_BroadPhase.Collect(m_GoalNet, m_Balls);
 	for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
 		Ball b = m_Balls[ballIdx];
 		int count = 0;
-		for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
+		for (int iK = m_BroadPhase.CandidateBegin(ballIdx); iK < m_BroadPhase.CandidateEnd(ballIdx); ++iK)
 		{	
+			int pIdx = m_BroadPhase.GetCandidate(iK);
 			CParticle p = m_GoalNet.GetParticle(pIdx);
 			Vector3d l = b.GetPosition() - p.GetPosition();
-		if (l.Length()<b.GetRadius()+0.1 && (b.GetVelocity()-p.GetVelocity()).DotProduct(l.NormalizedCopy())<=0 ){
+		if (l.Length()<b.GetRadius()+g_cdBallReach && (b.GetVelocity()-p.GetVelocity()).DotProduct(l.NormalizedCopy())<=0 ){
 				
 			
 				Vector3d pv = p.GetVelocity();
@@ -545,7 +1145,122 @@ void CMassSpringSystem::BallParticleCollision()
 		m_Balls[ballIdx] = b;
 		
 	}
+    // the search for the next step runs while its forces are computed
+    m_BroadPhase.Post(m_GoalNet, m_Balls, m_dDeltaT);
+
+}
+
+void CMassSpringSystem::ContinuousCollision()
+{
+    if(!m_ContinuousCollider.IsEnable() || m_Balls.empty())
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nContinuousCollision);
+    m_ContinuousCollider.Resolve(m_GoalNet, m_Balls, m_Obstacles, m_dDeltaT);
+}
+
+void CMassSpringSystem::StrainLimit()
+{
+    if(!m_StrainLimiter.IsEnable())
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nStrainLimit);
+    m_StrainLimiter.Apply(m_GoalNet, m_Obstacles);
+}
+
+void CMassSpringSystem::Tear()
+{
+    if(m_dTearStrain <= 0.0)
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nTear);
+    m_GoalNet.Tear(m_dTearStrain);
+    // the solvers patch themselves for every break, the broken springs are
+    // only dropped once they are a good part of the net
+    if(m_GoalNet.BrokenSpringNum()*g_ciCompactRatio > m_GoalNet.SpringNum())
+    {
+        m_GoalNet.CompactSprings();
+    }
+}
 
+void CMassSpringSystem::CharacterCollision()
+{
+    if(!m_bCharacter || m_CharacterTrack.IsEmpty())
+    {
+        return;
+    }
+    CScopedTimer timer(CProfiler::Phase_nCharacter);
+    // the net is already at the end of the step, so is the character
+    m_CharacterCollider.Update(m_CharacterTrack, m_dSimTime + m_dDeltaT);
+    m_CharacterCollider.Collide(m_GoalNet);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//Stability
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CMassSpringSystem::MonitorStability()
+{
+    m_EnergyMonitor.Push(m_EnergySample);
+    if(m_EnergyMonitor.IsDiverging())
+    {
+        if(m_bAutoRecover)
+        {
+            Rollback();
+        }
+        return;
+    }
+
+    // only a state whose energy is not on the rise is worth going back to
+    if(!m_EnergyMonitor.IsGrowing() && (!m_bSnapshotValid || ++m_iStepSinceSnapshot >= m_iSnapshotInterval))
+    {
+        TakeSnapshot();
+    }
+}
+
+void CMassSpringSystem::TakeSnapshot()
+{
+    int iNum = m_GoalNet.ParticleNum();
+    m_SnapshotPosition.resize(iNum);
+    m_SnapshotVelocity.resize(iNum);
+    for(int pIdx = 0; pIdx < iNum; pIdx++)
+    {
+        CParticle &rParticle = m_GoalNet.GetParticle(pIdx);
+        m_SnapshotPosition[pIdx] = rParticle.GetPosition();
+        m_SnapshotVelocity[pIdx] = rParticle.GetVelocity();
+    }
+    m_SnapshotBalls = m_Balls;
+    m_dSnapshotTime = m_dSimTime;
+    m_iStepSinceSnapshot = 0;
+    m_bSnapshotValid = true;
+}
+
+bool CMassSpringSystem::Rollback()
+{
+    if(!m_bSnapshotValid || 0.5*m_dDeltaT < m_dMinDeltaT)
+    {
+        return false;
+    }
+
+    // the net and the balls go back, free particles and the fluid keep going
+    for(int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); pIdx++)
+    {
+        CParticle &rParticle = m_GoalNet.GetParticle(pIdx);
+        rParticle.SetPosition(m_SnapshotPosition[pIdx]);
+        rParticle.SetVelocity(m_SnapshotVelocity[pIdx]);
+        rParticle.SetForce(Vector3d::ZERO);
+    }
+    m_Balls = m_SnapshotBalls;
+    printf("[Warning] CMassSpringSystem::Rollback, energy diverged at t=%f, rolled back to t=%f with DeltaT %g until the next reset\n",
+           m_dSimTime, m_dSnapshotTime, 0.5*m_dDeltaT);
+    m_dSimTime = m_dSnapshotTime;
+    m_dDeltaT *= 0.5;
+    m_EnergyMonitor.Reset();
+    m_iStepSinceSnapshot = 0;
+    ++m_iRecoveryNum;
+    return true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -553,7 +1268,39 @@ void CMassSpringSystem::BallParticleCollision()
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void CMassSpringSystem::Integrate()
 {
-    if(m_iIntegratorType == CMassSpringSystem::EXPLICIT_EULER)
+    if(m_iIntegratorType == CMassSpringSystem::EXPLICIT_EULER && m_DomainSolver.IsEnable())
+    {
+        // the domains add the fields and springs of the net and its contacts
+        // with the obstacles, the balls, the drag and the fluid are coupled here before
+        {
+            CScopedTimer timer(CProfiler::Phase_nForce);
+            ComputeBallForce();
+            ComputeDragForce();
+            m_Fluid.ApplyCoupling(m_GoalNet, m_Balls);
+        }
+        BallObstacleCollision();
+        BallToBallCollision();
+        BallParticleCollision();
+        DomainExplicitEuler();
+        ResetAllForce();
+    }
+    else if(m_iIntegratorType == CMassSpringSystem::EXPLICIT_EULER && m_bFusedEuler)
+    {
+        // the fields, springs and obstacle contacts of the net are in the fused
+        // pass, which also clears the forces of the particles
+        {
+            CScopedTimer timer(CProfiler::Phase_nForce);
+            ComputeBallForce();
+            ComputeDragForce();
+            m_Fluid.ApplyCoupling(m_GoalNet, m_Balls);
+        }
+        BallObstacleCollision();
+        BallToBallCollision();
+        BallParticleCollision();
+        FusedExplicitEuler();
+        ResetBallForce();
+    }
+    else if(m_iIntegratorType == CMassSpringSystem::EXPLICIT_EULER)
     {
         ComputeAllForce();
         HandleCollision();
@@ -567,6 +1314,14 @@ void CMassSpringSystem::Integrate()
         RungeKutta();
 		//ResetAllForce(); 
     }
+    else if(m_iIntegratorType == CMassSpringSystem::PROJECTIVE_DYNAMICS)
+    {
+        // the springs of the net are solved implicitly, only the rest is a force
+        ComputeExternalForce();
+        HandleCollision();
+        ProjectiveDynamics();
+        ResetAllForce();
+    }
     else
     {
         std::cout<<"Error integrator type, use explicit Euler instead!!"<<std::endl;
@@ -579,30 +1334,56 @@ void CMassSpringSystem::Integrate()
 
 void CMassSpringSystem::ExplicitEuler()
 {
+    CScopedTimer timer(CProfiler::Phase_nExplicitEuler);
     //TO DO
 	//cout << "YOOO" << endl;
+    m_EnergySample.Clear();
+    m_EnergySample.dSpring = m_GoalNet.GetSpringEnergy();
 	for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
     {	
 		
 		CParticle p =m_GoalNet.GetParticle(pIdx);
-		p.SetPosition(p.GetVelocity()*g_cdDeltaT + p.GetPosition());
-		p.SetVelocity(p.GetAcceleration()*g_cdDeltaT + p.GetVelocity());
+        m_EnergySample.AddBody(p.GetMass(), p.GetPosition().y - g_cdGroundHeight, p.GetVelocity());
+		p.SetPosition(p.GetVelocity()*m_dDeltaT + p.GetPosition());
+		p.SetVelocity(p.GetAcceleration()*m_dDeltaT + p.GetVelocity());
 
 		m_GoalNet.setParticle(p, pIdx);
 			
 	}
+    ExplicitEulerBall();
+}
+
+void CMassSpringSystem::ExplicitEulerBall()
+{
     for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
     {
         Ball b = m_Balls[ballIdx];
+        m_EnergySample.AddBody(b.GetMass(), b.GetPosition().y - g_cdGroundHeight, b.GetVelocity());
 
-		b.SetPosition(b.GetVelocity()*g_cdDeltaT + b.GetPosition());
-		b.SetVelocity(b.GetAcceleration()*g_cdDeltaT + b.GetVelocity());
+		b.SetPosition(b.GetVelocity()*m_dDeltaT + b.GetPosition());
+		b.SetVelocity(b.GetAcceleration()*m_dDeltaT + b.GetVelocity());
 		
 		m_Balls[ballIdx] = b;
     }
 
 }
 
+void CMassSpringSystem::DomainExplicitEuler()
+{
+    CScopedTimer timer(CProfiler::Phase_nDomain);
+    m_EnergySample.Clear();
+    m_DomainSolver.Step(m_GoalNet, m_ForceFields, m_Obstacles, m_dDeltaT, m_dSimTime, g_cdGroundHeight, m_EnergySample);
+    ExplicitEulerBall();
+}
+
+void CMassSpringSystem::FusedExplicitEuler()
+{
+    CScopedTimer timer(CProfiler::Phase_nFusedEuler);
+    m_EnergySample.Clear();
+    m_FusedEuler.Step(m_GoalNet, m_ForceFields, m_Obstacles, m_dDeltaT, m_dSimTime, g_cdGroundHeight, m_EnergySample);
+    ExplicitEulerBall();
+}
+
 void CMassSpringSystem::RungeKutta()
 {
     //TO DO
@@ -619,11 +1400,14 @@ void CMassSpringSystem::RungeKutta()
 	
 	ComputeAllForce();
 	HandleCollision();
+	g_Profiler.Begin(CProfiler::Phase_nRungeKuttaStage1);
 
-	
+    m_EnergySample.Clear();
+    m_EnergySample.dSpring = m_GoalNet.GetSpringEnergy();
 	for (int pIdx = 0; pIdx < num ; ++pIdx)
     {	
 		CParticle p = m_GoalNet.GetParticle(pIdx);
+        m_EnergySample.AddBody(p.GetMass(), p.GetPosition().y - g_cdGroundHeight, p.GetVelocity());
 		t0a[pIdx] = p.GetForce()/p.GetMass();
 		t0v[pIdx] = p.GetVelocity();
 		t0p[pIdx] = p.GetPosition();
@@ -631,6 +1415,7 @@ void CMassSpringSystem::RungeKutta()
 	for (int pIdx = num; pIdx < bnum +num ; pIdx++){
 
 		Ball b = m_Balls[pIdx-num];
+        m_EnergySample.AddBody(b.GetMass(), b.GetPosition().y - g_cdGroundHeight, b.GetVelocity());
 		t0a[pIdx] = b.GetForce() / b.GetMass();
 		t0v[pIdx] = b.GetVelocity();
 		t0p[pIdx] = b.GetPosition();
@@ -643,10 +1428,10 @@ void CMassSpringSystem::RungeKutta()
     {	
 		CParticle p = m_GoalNet.GetParticle(pIdx);
 		
-		k1p[pIdx] = p.GetVelocity()*g_cdDeltaT;
-		k1v[pIdx] = p.GetAcceleration() * g_cdDeltaT;
-		p.SetPosition(p.GetVelocity()*g_cdDeltaT*0.5 + p.GetPosition());
-		p.SetVelocity(p.GetAcceleration()*g_cdDeltaT*0.5 + p.GetVelocity());
+		k1p[pIdx] = p.GetVelocity()*m_dDeltaT;
+		k1v[pIdx] = p.GetAcceleration() * m_dDeltaT;
+		p.SetPosition(p.GetVelocity()*m_dDeltaT*0.5 + p.GetPosition());
+		p.SetVelocity(p.GetAcceleration()*m_dDeltaT*0.5 + p.GetVelocity());
 		m_GoalNet.setParticle(p, pIdx);
 
 	}
@@ -654,24 +1439,26 @@ void CMassSpringSystem::RungeKutta()
 	for (int pIdx = num; pIdx < bnum + num; pIdx++){
 
 		Ball b = m_Balls[pIdx - num];  // ?
-		k1p[pIdx] = b.GetVelocity()*g_cdDeltaT;
-		k1v[pIdx] = b.GetAcceleration() * g_cdDeltaT;
-		b.SetPosition(b.GetVelocity()*g_cdDeltaT*0.5 + b.GetPosition());
-		b.SetVelocity(b.GetAcceleration()*g_cdDeltaT*0.5 + b.GetVelocity());
+		k1p[pIdx] = b.GetVelocity()*m_dDeltaT;
+		k1v[pIdx] = b.GetAcceleration() * m_dDeltaT;
+		b.SetPosition(b.GetVelocity()*m_dDeltaT*0.5 + b.GetPosition());
+		b.SetVelocity(b.GetAcceleration()*m_dDeltaT*0.5 + b.GetVelocity());
 		m_Balls[pIdx - num] = b;
 
 	}
 	
+	g_Profiler.End(CProfiler::Phase_nRungeKuttaStage1);
 	ResetAllForce();
 	
 	
 	ComputeAllForce();
     HandleCollision();
+	g_Profiler.Begin(CProfiler::Phase_nRungeKuttaStage2);
 	for ( int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
     {	
 		CParticle p = m_GoalNet.GetParticle(pIdx);
-		k2p[pIdx] = p.GetVelocity()*g_cdDeltaT;
-		k2v[pIdx] = p.GetAcceleration() * g_cdDeltaT;
+		k2p[pIdx] = p.GetVelocity()*m_dDeltaT;
+		k2v[pIdx] = p.GetAcceleration() * m_dDeltaT;
 		p.SetPosition(t0p[pIdx]+0.5*k2p[pIdx]);
 		p.SetVelocity(t0v[pIdx]+0.5*k2v[pIdx]);
 		
@@ -681,24 +1468,26 @@ void CMassSpringSystem::RungeKutta()
 	for (int pIdx = num; pIdx < bnum + num; pIdx++){
 
 		Ball b = m_Balls[pIdx - num];  // ?
-		k2p[pIdx] = b.GetVelocity()*g_cdDeltaT;
-		k2v[pIdx] = b.GetAcceleration() * g_cdDeltaT;
+		k2p[pIdx] = b.GetVelocity()*m_dDeltaT;
+		k2v[pIdx] = b.GetAcceleration() * m_dDeltaT;
 		b.SetPosition(t0p[pIdx] + 0.5 *k2p[pIdx]);
 		b.SetVelocity(t0v[pIdx] + 0.5*k2v[pIdx]);
 		m_Balls[pIdx - num] = b;
 
 	}
 	
+	g_Profiler.End(CProfiler::Phase_nRungeKuttaStage2);
 	ResetAllForce();
 	
 	
 	ComputeAllForce();
 	HandleCollision();
+	g_Profiler.Begin(CProfiler::Phase_nRungeKuttaStage3);
 	for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
 	{
 		CParticle p = m_GoalNet.GetParticle(pIdx);
-		k3p[pIdx] = p.GetVelocity()*g_cdDeltaT;
-		k3v[pIdx] = p.GetAcceleration() * g_cdDeltaT;
+		k3p[pIdx] = p.GetVelocity()*m_dDeltaT;
+		k3v[pIdx] = p.GetAcceleration() * m_dDeltaT;
 		p.SetPosition(t0p[pIdx]+k3p[pIdx]);
 		p.SetVelocity(t0v[pIdx]+k3v[pIdx]);
 
@@ -708,26 +1497,28 @@ void CMassSpringSystem::RungeKutta()
 	for (int pIdx = num; pIdx < bnum + num; pIdx++){
 
 		Ball b = m_Balls[pIdx - num];  // ?
-		k3p[pIdx] = b.GetVelocity()*g_cdDeltaT;
-		k3v[pIdx] = b.GetAcceleration() * g_cdDeltaT;
+		k3p[pIdx] = b.GetVelocity()*m_dDeltaT;
+		k3v[pIdx] = b.GetAcceleration() * m_dDeltaT;
 		b.SetPosition(t0p[pIdx] + k3p[pIdx]);
 		b.SetVelocity(t0v[pIdx] + k3v[pIdx]);
 		m_Balls[pIdx - num] = b;
 
 	}
 	
+	g_Profiler.End(CProfiler::Phase_nRungeKuttaStage3);
 	ResetAllForce();
 
 	
 	ComputeAllForce();
 	HandleCollision();
+	g_Profiler.Begin(CProfiler::Phase_nRungeKuttaStage4);
 	double t = 1 ;
 	t /= 6;
 	for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
 	{
 		CParticle p = m_GoalNet.GetParticle(pIdx);
-		k4p[pIdx] = p.GetVelocity()*g_cdDeltaT;
-		k4v[pIdx] = p.GetAcceleration() * g_cdDeltaT;
+		k4p[pIdx] = p.GetVelocity()*m_dDeltaT;
+		k4v[pIdx] = p.GetAcceleration() * m_dDeltaT;
 		p.SetPosition(t0p[pIdx] + (t*k1p[pIdx] +2*t*k2p[pIdx]+2*t*k3p[pIdx]+t*k4p[pIdx]));
 		p.SetVelocity(t0v[pIdx] + (t*k1v[pIdx] + 2*t*k2v[pIdx] + 2*t*k3v[pIdx] + t*k4v[pIdx]));
 		//cout << " qq " << ((1 / 6)*k1v[pIdx] + (2 / 6)*k2v[pIdx] + (2 / 6)*k3v[pIdx] + (1/6)*k4v[pIdx]) << endl;
@@ -739,8 +1530,8 @@ void CMassSpringSystem::RungeKutta()
 	for (int pIdx = num; pIdx < bnum + num; pIdx++){
 
 		Ball b = m_Balls[pIdx - num];  // ?
-		k4p[pIdx] = b.GetVelocity()*g_cdDeltaT;
-		k4v[pIdx] = b.GetAcceleration() * g_cdDeltaT;
+		k4p[pIdx] = b.GetVelocity()*m_dDeltaT;
+		k4v[pIdx] = b.GetAcceleration() * m_dDeltaT;
 		b.SetPosition(t0p[pIdx] + (t*k1p[pIdx] + 2 * t*k2p[pIdx] + 2 * t*k3p[pIdx] + t*k4p[pIdx]));
 		b.SetVelocity(t0v[pIdx] + t*k1v[pIdx] + 2 * t*k2v[pIdx] + 2 * t*k3v[pIdx] + t*k4v[pIdx]);
 		//b.SetPosition(b.GetPosition() + k4p[pIdx]);
@@ -749,7 +1540,37 @@ void CMassSpringSystem::RungeKutta()
 		m_Balls[pIdx - num] = b;
 
 	}
+	g_Profiler.End(CProfiler::Phase_nRungeKuttaStage4);
 	ResetAllForce();
 	
 	
 }
+
+void CMassSpringSystem::ProjectiveDynamics()
+{
+    CScopedTimer timer(CProfiler::Phase_nProjectiveDynamics);
+    m_EnergySample.Clear();
+    for (int pIdx = 0; pIdx < m_GoalNet.ParticleNum(); ++pIdx)
+    {
+        CParticle &p = m_GoalNet.GetParticle(pIdx);
+        m_EnergySample.AddBody(p.GetMass(), p.GetPosition().y - g_cdGroundHeight, p.GetVelocity());
+    }
+    if(!m_ProjectiveDynamics.Step(m_GoalNet, m_dDeltaT))
+    {
+        // the net stays where it is, the warning came from the factorization
+        m_EnergySample.dSpring = m_GoalNet.GetSpringEnergy();
+    }
+    else
+    {
+        m_EnergySample.dSpring = m_ProjectiveDynamics.GetSpringEnergy();
+    }
+
+    // the balls carry no spring, explicit Euler is enough for them
+    for (int ballIdx = 0; ballIdx < BallNum(); ++ballIdx)
+    {
+        Ball &b = m_Balls[ballIdx];
+        m_EnergySample.AddBody(b.GetMass(), b.GetPosition().y - g_cdGroundHeight, b.GetVelocity());
+        b.SetPosition(b.GetVelocity()*m_dDeltaT + b.GetPosition());
+        b.SetVelocity(b.GetAcceleration()*m_dDeltaT + b.GetVelocity());
+    }
+}
@@ -8,6 +8,22 @@
 #include "CSpring.h"
 #include "GoalNetModel.h"
 #include "BallModel.h"
+#include "CForceField.h"
+#include "CEmitter.h"
+#include "CSphFluid.h"
+#include "CCapsuleCollider.h"
+#include "CEnergyMonitor.h"
+#include "CStrainLimiter.h"
+#include "CContinuousCollider.h"
+#include "CObstacleField.h"
+#include "CProjectiveDynamics.h"
+#include "CClothScene.h"
+#include "CDomainSolver.h"
+#include "CFusedEuler.h"
+#include "CDrapeSolver.h"
+#include "CLaggedBroadPhase.h"
+#include "CPicker.h"
+#include "CRandom.h"
 
 using std::vector;
 
@@ -17,7 +33,8 @@ class CMassSpringSystem
         enum
         {
             EXPLICIT_EULER = 0 ,
-            RUNGE_KUTTA
+            RUNGE_KUTTA,
+            PROJECTIVE_DYNAMICS
         };
 
         CMassSpringSystem();
@@ -29,7 +46,83 @@ class CMassSpringSystem
         void SimulationOneTimeStep();
 
         int BallNum();
-        void CreateBall();
+        void CreateBall();              // a random throw at the net from the seeded stream
+        void CreateBall(const Vector3d &a_rcPosition, const Vector3d &a_rcVelocity, const double a_cdMass = 1.0);
+        inline Ball &GetBall(const int a_ciBallIdx){ return m_Balls[a_ciBallIdx]; }
+        inline GoalNet &GetGoalNet(){ return m_GoalNet; }
+
+        void AddForceField(CForceField *a_pField);    // takes the ownership
+        void ClearForceField();
+
+        void AddEmitter(const CEmitter &a_rcEmitter);
+        int EmitterParticleNum();
+
+        void CreateFluid();             // drops the configured fluid block
+        int FluidParticleNum();
+
+        bool LoadCharacter(const std::string &a_rcsTrackFilename);   // capsule track of the MotionViewer
+        inline void SetCharacterEnable(const bool a_cbCharacter){ m_bCharacter = a_cbCharacter; }
+        inline bool IsCharacterEnable() const { return m_bCharacter; }
+
+        // springs are pulled back to (1 + strain) times their rest length after every step, 0 disables it
+        inline void SetStrainLimit(const double a_cdMaxStrain){ m_StrainLimiter.SetMaxStrain(a_cdMaxStrain); }
+        inline double GetStrainLimit() const { return m_StrainLimiter.GetMaxStrain(); }
+        inline void SetStrainLimitSolver(const CStrainLimiter::enSolver_t a_cnSolver){ m_StrainLimiter.SetSolver(a_cnSolver); }
+        inline CStrainLimiter::enSolver_t GetStrainLimitSolver() const { return m_StrainLimiter.GetSolver(); }
+        inline void SetStrainLimitSpectralRadius(const double a_cdRadius){ m_StrainLimiter.SetSpectralRadius(a_cdRadius); }   // 0 turns Chebyshev off
+
+        // springs of the net stretched beyond (1 + strain) times their rest length break, 0 disables it
+        inline void SetTearStrain(const double a_cdTearStrain){ m_dTearStrain = (a_cdTearStrain > 0.0) ? a_cdTearStrain : 0.0; }
+        inline double GetTearStrain() const { return m_dTearStrain; }
+
+        // local/global iterations of every projective dynamics step
+        inline void SetProjectiveIterations(const int a_ciIterationNum){ m_ProjectiveDynamics.SetIterationNum(a_ciIterationNum); }
+        inline int GetProjectiveIterations() const { return m_ProjectiveDynamics.GetIterationNum(); }
+
+        // fast balls are swept through the net and the obstacles over every step
+        inline void SetContinuousCollision(const bool a_cbEnable){ m_ContinuousCollider.SetEnable(a_cbEnable); }
+        inline bool IsContinuousCollision() const { return m_ContinuousCollider.IsEnable(); }
+
+        // explicit Euler of the net on one pinned thread per spatial domain, 0 domains turns it off
+        inline void SetDomainNum(const int a_ciDomainNum){ m_DomainSolver.SetDomainNum(a_ciDomainNum); }
+        inline int GetDomainNum() const { return m_DomainSolver.GetDomainNum(); }
+
+        // explicit Euler of the net in one fused pass over the particles instead of a pass per phase
+        inline void SetFusedEuler(const bool a_cbFused){ m_bFusedEuler = a_cbFused; }
+        inline bool IsFusedEuler() const { return m_bFusedEuler; }
+
+        // spring forces of the intact net from the lattice stencils instead of the spring list
+        inline void SetLatticeForce(const bool a_cbLattice){ m_GoalNet.SetLatticeForce(a_cbLattice); }
+        inline bool IsLatticeForce() const { return m_GoalNet.IsLatticeForce(); }
+
+        // Reset() starts the net from its static equilibrium under the force fields instead of the lattice
+        inline void SetDrape(const bool a_cbDrape){ m_bDrape = a_cbDrape; }
+        inline bool IsDrape() const { return m_bDrape; }
+        inline void SetDrapeCacheDir(const std::string &a_rcsCacheDir){ m_DrapeSolver.SetCacheDir(a_rcsCacheDir); }
+
+        // ball/particle broad phase on its own thread one step behind, off searches every step itself
+        inline void SetLaggedBroadPhase(const bool a_cbLagged){ m_BroadPhase.SetEnable(a_cbLagged); }
+        inline bool IsLaggedBroadPhase() const { return m_BroadPhase.IsEnable(); }
+
+        // the mouse grabs the net particle the ray hits or passes within the radius of,
+        // a damped spring pulls it to the drag target inside every step until it is released
+        bool Pick(const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const double a_cdRadius, Vector3d &a_rHitPoint);
+        inline void SetDragTarget(const Vector3d &a_rcTarget){ m_DragTarget = a_rcTarget; }
+        inline const Vector3d &GetDragTarget() const { return m_DragTarget; }
+        inline void ReleaseDrag(){ m_iDragParticle = -1; }
+        inline bool IsDragging() const { return m_iDragParticle >= 0; }
+        inline int GetDragParticle() const { return m_iDragParticle; }
+        inline void SetDragStiffness(const double a_cdStiffness){ m_dDragStiffness = a_cdStiffness; }
+        inline void SetDragDamping(const double a_cdDamping){ m_dDragDamping = a_cdDamping; }
+
+        // more copies of the net sharing its topology, stepped together with it
+        int AddNetCopy(const Vector3d &a_rcOffset);     // returns the instance id
+        inline CClothScene &GetCloths(){ return m_Cloths; }
+        inline int ClothParticleNum() const { return m_Cloths.ParticleNum(); }
+
+        // ground, goalposts and the configured mesh, shared by everything that collides
+        inline const CObstacleField &GetObstacles() const { return m_Obstacles; }
+        bool LoadObstacleMesh(const std::string &a_rcsFilename, const Vector3d &a_rcOffset, const double a_cdScale);
 
         void Draw();
 
@@ -41,17 +134,29 @@ class CMassSpringSystem
             const double a_cdDamperCoef, 
             const CSpring::enType_t a_cSpringType
             );
-        double GetSpringCoef(const CSpring::enType_t a_cSpringType);
-        double GetDamperCoef(const CSpring::enType_t a_cSpringType);
+        double GetSpringCoef(const CSpring::enType_t a_cSpringType) const;
+        double GetDamperCoef(const CSpring::enType_t a_cSpringType) const;
 
-        bool CheckStable();
+        // every random choice of the system and its emitters starts over from the seed on Reset()
+        void SetSeed(const unsigned int a_cuiSeed);
+        inline unsigned int GetSeed() const { return m_uiSeed; }
+        inline double GetSimTime() const { return m_dSimTime; }
+
+        bool CheckStable();             // false once the energy monitor saw a divergence
+        double MeasureEnergy();         // of the current state of the net and the balls, not of the last step
+        inline const CEnergyMonitor &GetEnergyMonitor() const { return m_EnergyMonitor; }
+        inline void SetAutoRecover(const bool a_cbAutoRecover){ m_bAutoRecover = a_cbAutoRecover; }
+        inline bool IsAutoRecover() const { return m_bAutoRecover; }
+        inline int RecoveryNum() const { return m_iRecoveryNum; }
 
         inline void SetDrawParticle(const bool a_bDrawParticle){ m_bDrawParticle = a_bDrawParticle; }
         inline void SetDrawGoalpost(const bool a_bDrawGoalpost){ m_bDrawGoalpost = a_bDrawGoalpost; }
         inline void SetDrawStruct(const bool a_bDrawStruct){m_bDrawStruct = a_bDrawStruct;}
         inline void SetDrawShear(const bool a_bDrawShear){m_bDrawShear = a_bDrawShear;}
         inline void SetDrawBending(const bool a_bDrawBending){m_bDrawBending = a_bDrawBending;}
-        inline void SetDeltaT(const double a_cdDeltaT){m_dDeltaT = a_cdDeltaT;}
+        void SetEmitterEnable(const bool a_cbEmitter);
+        inline bool IsEmitterEnable() const { return m_bEmitter; }
+        inline void SetDeltaT(const double a_cdDeltaT){m_dDeltaT = a_cdDeltaT; m_dBaseDeltaT = a_cdDeltaT;}
         inline void SetIntegratorType(const int a_ciIntegratorType){m_iIntegratorType = a_ciIntegratorType;}
         inline void SetStartSimulation(){m_bSimulation = true;}
         inline void SetPauseSimulation(){m_bSimulation = false;}
@@ -67,10 +172,14 @@ private:
     bool m_bDrawBending;
     bool m_bDrawGoalpost;
     bool m_bSimulation;      //start or pause
+    bool m_bEmitter;         //emitters spawn new particles
+    bool m_bCharacter;       //the character moves and collides with the net
+    bool m_bAutoRecover;     //roll back and halve dt when the energy diverges, until the next Reset()
 
     int m_iIntegratorType;
 
     double m_dDeltaT;            //delta t    
+    double m_dBaseDeltaT;        //as configured, Reset() restores it after the rollbacks halved m_dDeltaT
     double m_dSpringCoefStruct;
     double m_dSpringCoefShear;
     double m_dSpringCoefBending;
@@ -78,30 +187,104 @@ private:
     double m_dDamperCoefShear;
     double m_dDamperCoefBending;
 
-    Vector3d m_ForceField;      //external force field
+    CForceFieldSet m_ForceFields;   //external force fields, gravity first
+    double m_dSimTime;              //simulated seconds since reset, drives the turbulence
+    unsigned int m_uiSeed;
+    CRandom m_Random;               //ball throws
 
     GoalNet m_GoalNet;
     vector<Ball> m_Balls;
+    vector<CEmitter> m_Emitters;
+    CSphFluid m_Fluid;
+
+    Vector3d m_FluidBlockMin;        //box filled by CreateFluid()
+    Vector3d m_FluidBlockMax;
+    Vector3d m_FluidVelocity;
+
+    CCapsuleTrack m_CharacterTrack;
+    CCapsuleCollider m_CharacterCollider;
+
+    CStrainLimiter m_StrainLimiter;
+    CContinuousCollider m_ContinuousCollider;
+    CProjectiveDynamics m_ProjectiveDynamics;
+    CDomainSolver m_DomainSolver;
+    CFusedEuler m_FusedEuler;
+    bool m_bFusedEuler;
+    double m_dTearStrain;
+    CDrapeSolver m_DrapeSolver;
+    bool m_bDrape;
+    CLaggedBroadPhase m_BroadPhase;  //candidates of BallParticleCollision
+
+    CPicker m_Picker;
+    int m_iDragParticle;             //net particle held by the mouse, -1 for none
+    Vector3d m_DragTarget;
+    double m_dDragStiffness;
+    double m_dDragDamping;
+
+    CClothScene m_Cloths;
+    int m_iNetTemplate;              //template of the net in m_Cloths, built at rest
+
+    CObstacleField m_Obstacles;
+
+    CEnergyMonitor m_EnergyMonitor;
+    EnergySample m_EnergySample;     //summed by the integrators, state at the start of the step
+    double m_dMinDeltaT;             //the rollback does not halve dt below this
+    int m_iSnapshotInterval;         //steps between two rollback snapshots
+    int m_iStepSinceSnapshot;
+    int m_iRecoveryNum;
+    bool m_bSnapshotValid;
+    double m_dSnapshotTime;
+    vector<Vector3d> m_SnapshotPosition;
+    vector<Vector3d> m_SnapshotVelocity;
+    vector<Ball> m_SnapshotBalls;
+
+    unsigned int m_uiGoalpostList;   //display list of the goalpost cylinders
+    bool m_bGoalpostDirty;           //recompile the goalpost list on next draw
 
     void ResetAllForce();
+    void ResetBallForce();
 
     void ComputeAllForce();         //compute force of whole systems
     void ComputeParticleForce();
     void ComputeBallForce();
+    void ComputeExternalForce();    //everything but the springs of the net
+    void ComputeDragForce();        //of the picked particle
 
     void HandleCollision();
-    void ParticlePlaneCollision();
-    void BallPlaneCollision();
+    void ParticleObstacleCollision();
+    void BallObstacleCollision();
     void BallToBallCollision();
     void BallParticleCollision();
+    void CharacterCollision();
+    void ContinuousCollision();     //sweeps the balls that moved far over the step
+    void StrainLimit();
+    void Tear();                    //breaks the overstretched springs of the net
+
+    void MonitorStability();
+    void TakeSnapshot();
+    bool Rollback();
 
     void Integrate();
     void ExplicitEuler();
+    void ExplicitEulerBall();
+    void DomainExplicitEuler();
+    void FusedExplicitEuler();
     void RungeKutta();
+    void ProjectiveDynamics();
 
     void DrawGoalNet();
     void DrawGoalpost();
+    void DrawObstacle();
+
+    static const int s_ciGoalpostNum = 8;
+    void GetGoalposts(Vector3d *a_pStart, Vector3d *a_pEnd);    // the cylinders between the fixed corners
+    void BuildObstacles();
     void DrawBall();
+    void DrawEmitter();
+    void DrawFluid();
+    void DrawCharacter();
+    void DrawCloth();
+    void DrawDrag();
 };
 
 #endif
\ No newline at end of file
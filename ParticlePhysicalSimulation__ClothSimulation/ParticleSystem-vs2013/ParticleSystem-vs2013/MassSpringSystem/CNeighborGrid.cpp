@@ -0,0 +1,114 @@
+#include "CNeighborGrid.h"
+#include "CThreadPool.h"
+
+namespace
+{
+    const int s_ciMinBucketNum = 1024;
+    const int s_ciMinChunk = 4096;          // points per parallel task
+}
+
+CNeighborGrid::CNeighborGrid()
+    :m_iNum(0),
+    m_dCellSize(1.0),
+    m_dInvCellSize(1.0),
+    m_uiMask(0),
+    m_PointBucket(),
+    m_CellStart(),
+    m_SortedIndex()
+{
+}
+
+void CNeighborGrid::Build(const std::vector<Vector3d> &a_rcPositions, const int a_ciNum, const double a_cdCellSize)
+{
+    m_iNum = a_ciNum;
+    m_dCellSize = a_cdCellSize;
+    m_dInvCellSize = 1.0/a_cdCellSize;
+
+    int iBucketNum = s_ciMinBucketNum;
+    while(iBucketNum < 2*m_iNum)
+    {
+        iBucketNum <<= 1;
+    }
+    m_uiMask = (unsigned int)(iBucketNum - 1);
+
+    if((int)m_PointBucket.size() < m_iNum)
+    {
+        m_PointBucket.resize(m_iNum);
+        m_SortedIndex.resize(m_iNum);
+    }
+    m_CellStart.assign(iBucketNum + 1, 0);
+
+    CThreadPool::Instance().ParallelFor(0, m_iNum, [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iI = a_iBegin ; iI<a_iEnd ; iI++)
+        {
+            const Vector3d &rcPos = a_rcPositions[iI];
+            m_PointBucket[iI] = Bucket(CellCoord(rcPos.x), CellCoord(rcPos.y), CellCoord(rcPos.z));
+        }
+    }, s_ciMinChunk);
+
+    // counting sort: histogram, exclusive prefix sum, stable scatter
+    for(int iI = 0 ; iI<m_iNum ; iI++)
+    {
+        ++m_CellStart[m_PointBucket[iI]+1];
+    }
+    for(int iB = 0 ; iB<iBucketNum ; iB++)
+    {
+        m_CellStart[iB+1] += m_CellStart[iB];
+    }
+    for(int iI = 0 ; iI<m_iNum ; iI++)
+    {
+        int iBucket = m_PointBucket[iI];
+        m_SortedIndex[m_CellStart[iBucket]] = iI;
+        ++m_CellStart[iBucket];
+    }
+    // the starts were used as write cursors and ended at the next bucket's start
+    for(int iB = iBucketNum ; iB>0 ; iB--)
+    {
+        m_CellStart[iB] = m_CellStart[iB-1];
+    }
+    m_CellStart[0] = 0;
+}
+
+void CNeighborGrid::SetSorted()
+{
+    for(int iI = 0 ; iI<m_iNum ; iI++)
+    {
+        m_SortedIndex[iI] = iI;
+    }
+}
+
+int CNeighborGrid::GatherBuckets(const Vector3d &a_rcPosition, const int a_ciRing, int *a_piBucket) const
+{
+    int iRing = (a_ciRing < s_ciMaxRing) ? a_ciRing : s_ciMaxRing;
+    int iX = CellCoord(a_rcPosition.x);
+    int iY = CellCoord(a_rcPosition.y);
+    int iZ = CellCoord(a_rcPosition.z);
+
+    int iNum = 0;
+    for(int iDX = -iRing ; iDX<=iRing ; iDX++)
+    {
+        for(int iDY = -iRing ; iDY<=iRing ; iDY++)
+        {
+            for(int iDZ = -iRing ; iDZ<=iRing ; iDZ++)
+            {
+                int iBucket = Bucket(iX+iDX, iY+iDY, iZ+iDZ);
+                if(m_CellStart[iBucket] == m_CellStart[iBucket+1])
+                {
+                    continue;
+                }
+                // two cells may hash to the same bucket, visit it only once
+                bool bSeen = false;
+                for(int iK = 0 ; iK<iNum && !bSeen ; iK++)
+                {
+                    bSeen = (a_piBucket[iK] == iBucket);
+                }
+                if(!bSeen)
+                {
+                    a_piBucket[iNum++] = iBucket;
+                }
+            }
+        }
+    }
+    return iNum;
+}
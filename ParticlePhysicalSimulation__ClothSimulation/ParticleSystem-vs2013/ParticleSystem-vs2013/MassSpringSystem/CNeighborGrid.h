@@ -0,0 +1,75 @@
+#ifndef CNEIGHBORGRID_H
+#define CNEIGHBORGRID_H
+
+#include <cmath>
+#include <vector>
+#include "Vector3d.h"
+
+/*
+ * Cell list for fixed radius neighbor queries, rebuilt from scratch every
+ * step. The cells are hashed into a power of two table (about two buckets
+ * per point) so the domain needs no bounds, and the points are bucketed with
+ * a counting sort, so both the build and a query cost O(1) per point no
+ * matter how many points there are. A bucket may hold points of unrelated
+ * cells that share its hash, the callers test the distance anyway.
+ */
+class CNeighborGrid
+{
+    public:
+        CNeighborGrid();
+
+        void Build(const std::vector<Vector3d> &a_rcPositions, const int a_ciNum, const double a_cdCellSize);
+
+        // the caller has reordered its points into GetSortedIndex() order,
+        // from now on the grid hands out the new indices
+        void SetSorted();
+
+        inline const std::vector<int> &GetSortedIndex() const { return m_SortedIndex; }
+        inline double GetCellSize() const { return m_dCellSize; }
+        inline int PointNum() const { return m_iNum; }
+
+        // calls a_Visitor(index) for every point in the cells up to a_ciRing
+        // cells away from the position (27 cells for one ring, at most two
+        // rings), each bucket is visited once
+        template<class Visitor>
+        void ForEachCandidate(const Vector3d &a_rcPosition, Visitor a_Visitor, const int a_ciRing = 1) const
+        {
+            if(m_iNum == 0)
+            {
+                return;
+            }
+            int aiBucket[s_ciMaxBucketNum];
+            int iBucketNum = GatherBuckets(a_rcPosition, a_ciRing, aiBucket);
+            for(int iB = 0 ; iB<iBucketNum ; iB++)
+            {
+                const int ciEnd = m_CellStart[aiBucket[iB]+1];
+                for(int iK = m_CellStart[aiBucket[iB]] ; iK<ciEnd ; iK++)
+                {
+                    a_Visitor(m_SortedIndex[iK]);
+                }
+            }
+        }
+
+    private:
+        static const int s_ciMaxRing = 2;
+        static const int s_ciMaxBucketNum = (2*s_ciMaxRing+1)*(2*s_ciMaxRing+1)*(2*s_ciMaxRing+1);
+
+        int GatherBuckets(const Vector3d &a_rcPosition, const int a_ciRing, int *a_piBucket) const;
+        inline int CellCoord(const double a_cdValue) const { return (int)floor(a_cdValue*m_dInvCellSize); }
+        inline int Bucket(const int a_ciX, const int a_ciY, const int a_ciZ) const
+        {
+            unsigned int uiHash = ((unsigned int)a_ciX*73856093u) ^ ((unsigned int)a_ciY*19349663u) ^ ((unsigned int)a_ciZ*83492791u);
+            return (int)(uiHash & m_uiMask);
+        }
+
+        int m_iNum;
+        double m_dCellSize;
+        double m_dInvCellSize;
+        unsigned int m_uiMask;              // bucket count - 1
+
+        std::vector<int> m_PointBucket;     // bucket of every point
+        std::vector<int> m_CellStart;       // first sorted slot of every bucket, one extra entry at the end
+        std::vector<int> m_SortedIndex;     // point indices grouped by bucket
+};
+
+#endif
@@ -0,0 +1,750 @@
+#include <stdlib.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <algorithm>
+#include "CObstacleField.h"
+#include "CThreadPool.h"
+#include "Render_API.h"
+#include "glut.h"
+
+#pragma warning(disable:4996)
+
+namespace
+{
+    const double s_cdContactEps = 0.01;     // contact margin and resting speed of the old ground test
+    const int s_ciMinChunk = 64;            // bricks per parallel task
+    const int s_ciLeafSize = 4;             // triangles per mesh leaf
+    const int s_ciFarOutside = -1;          // brick table entries of the bricks without samples
+    const int s_ciFarInside = -2;
+
+    inline double Max3(const double a_cdA, const double a_cdB, const double a_cdC)
+    {
+        double dMax = (a_cdA > a_cdB) ? a_cdA : a_cdB;
+        return (dMax > a_cdC) ? dMax : a_cdC;
+    }
+    inline void GrowBox(Vector3d &a_rMin, Vector3d &a_rMax, const Vector3d &a_rcPoint)
+    {
+        for(int iA = 0 ; iA<3 ; iA++)
+        {
+            if(a_rcPoint[iA] < a_rMin[iA]) a_rMin[iA] = a_rcPoint[iA];
+            if(a_rcPoint[iA] > a_rMax[iA]) a_rMax[iA] = a_rcPoint[iA];
+        }
+    }
+    inline double BoxSquaredDistance(const Vector3d &a_rcMin, const Vector3d &a_rcMax, const Vector3d &a_rcPoint)
+    {
+        double dDistSq = 0.0;
+        for(int iA = 0 ; iA<3 ; iA++)
+        {
+            double dOut = 0.0;
+            if(a_rcPoint[iA] < a_rcMin[iA]) dOut = a_rcMin[iA] - a_rcPoint[iA];
+            if(a_rcPoint[iA] > a_rcMax[iA]) dOut = a_rcPoint[iA] - a_rcMax[iA];
+            dDistSq += dOut*dOut;
+        }
+        return dDistSq;
+    }
+
+    // closest point of the triangle (Ericson, Real-Time Collision Detection 5.1.5),
+    // the feature is 0 for the face, 1..3 for the vertices a b c, 4..6 for the edges ab bc ca
+    Vector3d ClosestOnTriangle(
+        const Vector3d &a_rcP,
+        const Vector3d &a_rcA,
+        const Vector3d &a_rcB,
+        const Vector3d &a_rcC,
+        int &a_riFeature
+        )
+    {
+        Vector3d ab = a_rcB - a_rcA;
+        Vector3d ac = a_rcC - a_rcA;
+        Vector3d ap = a_rcP - a_rcA;
+        double d1 = ab.DotProduct(ap);
+        double d2 = ac.DotProduct(ap);
+        if(d1 <= 0.0 && d2 <= 0.0)
+        {
+            a_riFeature = 1;
+            return a_rcA;
+        }
+        Vector3d bp = a_rcP - a_rcB;
+        double d3 = ab.DotProduct(bp);
+        double d4 = ac.DotProduct(bp);
+        if(d3 >= 0.0 && d4 <= d3)
+        {
+            a_riFeature = 2;
+            return a_rcB;
+        }
+        double vc = d1*d4 - d3*d2;
+        if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+        {
+            a_riFeature = 4;
+            return a_rcA + ab*(d1/(d1 - d3));
+        }
+        Vector3d cp = a_rcP - a_rcC;
+        double d5 = ab.DotProduct(cp);
+        double d6 = ac.DotProduct(cp);
+        if(d6 >= 0.0 && d5 <= d6)
+        {
+            a_riFeature = 3;
+            return a_rcC;
+        }
+        double vb = d5*d2 - d1*d6;
+        if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+        {
+            a_riFeature = 6;
+            return a_rcA + ac*(d2/(d2 - d6));
+        }
+        double va = d3*d6 - d5*d4;
+        if(va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+        {
+            a_riFeature = 5;
+            return a_rcB + (a_rcC - a_rcB)*((d4 - d3)/((d4 - d3) + (d5 - d6)));
+        }
+        double dDenom = 1.0/(va + vb + vc);
+        a_riFeature = 0;
+        return a_rcA + ab*(vb*dDenom) + ac*(vc*dDenom);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CObstacleField::CObstacleField()
+    :m_dCellSize(0.1),
+    m_dBandWidth(0.4),
+    m_dExtent(20.0),
+    m_Color(0.6,0.6,0.65),
+    m_Primitives(),
+    m_Meshes(),
+    m_Origin(0.0,0.0,0.0),
+    m_BrickIndex(),
+    m_Samples(),
+    m_uiDrawList(0),
+    m_bDrawDirty(true)
+{
+    m_aiBrickNum[0] = m_aiBrickNum[1] = m_aiBrickNum[2] = 0;
+}
+
+// both keep the baked field until the next Bake()
+void CObstacleField::ClearPrimitives()
+{
+    m_Primitives.clear();
+    m_bDrawDirty = true;
+}
+
+void CObstacleField::ClearMeshes()
+{
+    m_Meshes.clear();
+    m_bDrawDirty = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Obstacles                                  //
+////////////////////////////////////////////////////////////////////////////////
+void CObstacleField::AddPlane(const Vector3d &a_rcPoint, const Vector3d &a_rcNormal)
+{
+    Primitive plane = { Type_nPlane, a_rcPoint, a_rcNormal.NormalizedCopy(), 0.0, false };
+    m_Primitives.push_back(plane);
+}
+
+void CObstacleField::AddSphere(const Vector3d &a_rcCenter, const double a_cdRadius)
+{
+    Primitive sphere = { Type_nSphere, a_rcCenter, a_rcCenter, a_cdRadius, true };
+    m_Primitives.push_back(sphere);
+    m_bDrawDirty = true;
+}
+
+void CObstacleField::AddCapsule(const Vector3d &a_rcStart, const Vector3d &a_rcEnd, const double a_cdRadius, const bool a_cbDraw)
+{
+    Primitive capsule = { Type_nCapsule, a_rcStart, a_rcEnd, a_cdRadius, a_cbDraw };
+    m_Primitives.push_back(capsule);
+    m_bDrawDirty = true;
+}
+
+void CObstacleField::AddBox(const Vector3d &a_rcMin, const Vector3d &a_rcMax)
+{
+    Primitive box = { Type_nBox, a_rcMin, a_rcMax, 0.0, true };
+    m_Primitives.push_back(box);
+    m_bDrawDirty = true;
+}
+
+bool CObstacleField::AddMesh(const std::string &a_rcsFilename, const Vector3d &a_rcOffset, const double a_cdScale)
+{
+    std::ifstream input(a_rcsFilename.c_str());
+    if(!input)
+    {
+        printf("[Warning] CObstacleField::AddMesh, can not open %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    // only the v and f lines matter, polygons are cut into fans
+    Mesh mesh;
+    std::string sLine;
+    while(std::getline(input, sLine))
+    {
+        std::istringstream line(sLine);
+        std::string sKey;
+        line >> sKey;
+        if(sKey == "v")
+        {
+            Vector3d vertex;
+            line >> vertex.x >> vertex.y >> vertex.z;
+            mesh.vertex.push_back(vertex*a_cdScale + a_rcOffset);
+        }
+        else if(sKey == "f")
+        {
+            std::vector<int> face;
+            std::string sCorner;
+            while(line >> sCorner)
+            {
+                int iIndex = atoi(sCorner.c_str());     // stops at the first '/'
+                face.push_back((iIndex < 0) ? (int)mesh.vertex.size() + iIndex : iIndex - 1);
+            }
+            for(size_t uiI = 2 ; uiI<face.size() ; uiI++)
+            {
+                mesh.triangle.push_back(face[0]);
+                mesh.triangle.push_back(face[uiI-1]);
+                mesh.triangle.push_back(face[uiI]);
+            }
+        }
+    }
+    for(size_t uiI = 0 ; uiI<mesh.triangle.size() ; uiI++)
+    {
+        if(mesh.triangle[uiI] < 0 || mesh.triangle[uiI] >= (int)mesh.vertex.size())
+        {
+            printf("[Warning] CObstacleField::AddMesh, %s has a face with a bad vertex.\n", a_rcsFilename.c_str());
+            return false;
+        }
+    }
+    if(mesh.triangle.empty())
+    {
+        printf("[Warning] CObstacleField::AddMesh, %s has no faces.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    m_Meshes.push_back(mesh);
+    BuildMesh(m_Meshes.back());
+    m_bDrawDirty = true;
+    return true;
+}
+
+void CObstacleField::BuildMesh(Mesh &a_rMesh)
+{
+    const int ciTriangleNum = (int)a_rMesh.triangle.size()/3;
+    a_rMesh.faceNormal.resize(ciTriangleNum);
+    a_rMesh.vertexNormal.assign(a_rMesh.vertex.size(), Vector3d::ZERO);
+    a_rMesh.edgeNormal.resize(ciTriangleNum*3);
+
+    // pseudo normals (Baerentzen and Aanaes 2005): the sign of the distance is
+    // read off the normal of the closest feature, angle weighted at the vertices
+    std::map<std::pair<int,int>, Vector3d> edgeSum;
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        const int *pciV = &a_rMesh.triangle[iT*3];
+        Vector3d faceNormal = (a_rMesh.vertex[pciV[1]] - a_rMesh.vertex[pciV[0]]).CrossProduct(a_rMesh.vertex[pciV[2]] - a_rMesh.vertex[pciV[0]]);
+        if(faceNormal.SquaredLength() > 0.0)
+        {
+            faceNormal.Normalize();
+        }
+        a_rMesh.faceNormal[iT] = faceNormal;
+        for(int iC = 0 ; iC<3 ; iC++)
+        {
+            Vector3d toNext = a_rMesh.vertex[pciV[(iC+1)%3]] - a_rMesh.vertex[pciV[iC]];
+            Vector3d toPrev = a_rMesh.vertex[pciV[(iC+2)%3]] - a_rMesh.vertex[pciV[iC]];
+            double dLengthProduct = toNext.Length()*toPrev.Length();
+            if(dLengthProduct > 0.0)
+            {
+                double dCos = toNext.DotProduct(toPrev)/dLengthProduct;
+                dCos = (dCos > 1.0) ? 1.0 : ((dCos < -1.0) ? -1.0 : dCos);
+                a_rMesh.vertexNormal[pciV[iC]] += faceNormal*acos(dCos);
+            }
+            int iFrom = pciV[iC];
+            int iTo = pciV[(iC+1)%3];
+            edgeSum[std::make_pair((iFrom < iTo) ? iFrom : iTo, (iFrom < iTo) ? iTo : iFrom)] += faceNormal;
+        }
+    }
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        const int *pciV = &a_rMesh.triangle[iT*3];
+        for(int iC = 0 ; iC<3 ; iC++)
+        {
+            int iFrom = pciV[iC];
+            int iTo = pciV[(iC+1)%3];
+            a_rMesh.edgeNormal[iT*3 + iC] = edgeSum[std::make_pair((iFrom < iTo) ? iFrom : iTo, (iFrom < iTo) ? iTo : iFrom)];
+        }
+    }
+
+    a_rMesh.order.resize(ciTriangleNum);
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        a_rMesh.order[iT] = iT;
+    }
+    a_rMesh.nodes.clear();
+    a_rMesh.nodes.reserve(ciTriangleNum*2/s_ciLeafSize + 1);
+    BuildNode(a_rMesh, 0, ciTriangleNum);
+}
+
+int CObstacleField::BuildNode(Mesh &a_rMesh, const int a_ciBegin, const int a_ciEnd)
+{
+    BvhNode node;
+    node.min = Vector3d(1e30,1e30,1e30);
+    node.max = Vector3d(-1e30,-1e30,-1e30);
+    Vector3d centerMin = node.min;
+    Vector3d centerMax = node.max;
+    for(int iI = a_ciBegin ; iI<a_ciEnd ; iI++)
+    {
+        const int *pciV = &a_rMesh.triangle[a_rMesh.order[iI]*3];
+        Vector3d center(0.0,0.0,0.0);
+        for(int iC = 0 ; iC<3 ; iC++)
+        {
+            GrowBox(node.min, node.max, a_rMesh.vertex[pciV[iC]]);
+            center += a_rMesh.vertex[pciV[iC]]/3.0;
+        }
+        GrowBox(centerMin, centerMax, center);
+    }
+    node.iLeft = node.iRight = -1;
+    node.iFirst = a_ciBegin;
+    node.iCount = a_ciEnd - a_ciBegin;
+
+    int iNode = (int)a_rMesh.nodes.size();
+    a_rMesh.nodes.push_back(node);
+    if(node.iCount <= s_ciLeafSize)
+    {
+        return iNode;
+    }
+
+    // median split on the longest axis of the triangle centers
+    Vector3d extent = centerMax - centerMin;
+    int iAxis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+    int iMid = (a_ciBegin + a_ciEnd)/2;
+    const Mesh &rcMesh = a_rMesh;
+    std::nth_element(a_rMesh.order.begin() + a_ciBegin, a_rMesh.order.begin() + iMid, a_rMesh.order.begin() + a_ciEnd,
+        [&rcMesh, iAxis](int a_iA, int a_iB)
+        {
+            const int *pciA = &rcMesh.triangle[a_iA*3];
+            const int *pciB = &rcMesh.triangle[a_iB*3];
+            return rcMesh.vertex[pciA[0]][iAxis] + rcMesh.vertex[pciA[1]][iAxis] + rcMesh.vertex[pciA[2]][iAxis]
+                 < rcMesh.vertex[pciB[0]][iAxis] + rcMesh.vertex[pciB[1]][iAxis] + rcMesh.vertex[pciB[2]][iAxis];
+        });
+
+    int iLeft = BuildNode(a_rMesh, a_ciBegin, iMid);
+    int iRight = BuildNode(a_rMesh, iMid, a_ciEnd);
+    a_rMesh.nodes[iNode].iLeft = iLeft;
+    a_rMesh.nodes[iNode].iRight = iRight;
+    a_rMesh.nodes[iNode].iCount = 0;
+    return iNode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Exact distance                               //
+////////////////////////////////////////////////////////////////////////////////
+double CObstacleField::ExactDistance(const Vector3d &a_rcPosition, const std::vector<int> *a_pcPrimitives) const
+{
+    double dDistance = 1e30;
+    const int ciNum = a_pcPrimitives ? (int)a_pcPrimitives->size() : (int)m_Primitives.size();
+    for(int iI = 0 ; iI<ciNum ; iI++)
+    {
+        double dPrimitive = PrimitiveDistance(m_Primitives[a_pcPrimitives ? (*a_pcPrimitives)[iI] : iI], a_rcPosition);
+        if(dPrimitive < dDistance)
+        {
+            dDistance = dPrimitive;
+        }
+    }
+    for(size_t uiI = 0 ; uiI<m_Meshes.size() ; uiI++)
+    {
+        double dMesh = MeshDistance(m_Meshes[uiI], a_rcPosition);
+        if(dMesh < dDistance)
+        {
+            dDistance = dMesh;
+        }
+    }
+    return dDistance;
+}
+
+double CObstacleField::PrimitiveDistance(const Primitive &a_rcPrimitive, const Vector3d &a_rcPosition) const
+{
+    switch(a_rcPrimitive.iType)
+    {
+        case Type_nPlane:
+            return (a_rcPosition - a_rcPrimitive.a).DotProduct(a_rcPrimitive.b);
+        case Type_nSphere:
+            return (a_rcPosition - a_rcPrimitive.a).Length() - a_rcPrimitive.dRadius;
+        case Type_nCapsule:
+        {
+            Vector3d axis = a_rcPrimitive.b - a_rcPrimitive.a;
+            double dLengthSq = axis.SquaredLength();
+            double dT = (dLengthSq > 0.0) ? (a_rcPosition - a_rcPrimitive.a).DotProduct(axis)/dLengthSq : 0.0;
+            dT = (dT < 0.0) ? 0.0 : ((dT > 1.0) ? 1.0 : dT);
+            return (a_rcPosition - (a_rcPrimitive.a + axis*dT)).Length() - a_rcPrimitive.dRadius;
+        }
+        case Type_nBox:
+        {
+            Vector3d center = (a_rcPrimitive.a + a_rcPrimitive.b)*0.5;
+            Vector3d halfSize = (a_rcPrimitive.b - a_rcPrimitive.a)*0.5;
+            Vector3d q(fabs(a_rcPosition.x - center.x) - halfSize.x,
+                       fabs(a_rcPosition.y - center.y) - halfSize.y,
+                       fabs(a_rcPosition.z - center.z) - halfSize.z);
+            Vector3d outside((q.x > 0.0) ? q.x : 0.0, (q.y > 0.0) ? q.y : 0.0, (q.z > 0.0) ? q.z : 0.0);
+            double dInside = Max3(q.x, q.y, q.z);
+            return outside.Length() + ((dInside < 0.0) ? dInside : 0.0);
+        }
+    }
+    return 1e30;
+}
+
+double CObstacleField::MeshDistance(const Mesh &a_rcMesh, const Vector3d &a_rcPosition) const
+{
+    double dBestSq = 1e60;
+    Vector3d bestPoint;
+    Vector3d bestNormal;
+
+    int aiStack[64];
+    int iTop = 0;
+    aiStack[iTop++] = 0;
+    while(iTop > 0)
+    {
+        const BvhNode &rcNode = a_rcMesh.nodes[aiStack[--iTop]];
+        if(BoxSquaredDistance(rcNode.min, rcNode.max, a_rcPosition) >= dBestSq)
+        {
+            continue;
+        }
+        if(rcNode.iLeft < 0)
+        {
+            for(int iI = rcNode.iFirst ; iI<rcNode.iFirst + rcNode.iCount ; iI++)
+            {
+                int iT = a_rcMesh.order[iI];
+                const int *pciV = &a_rcMesh.triangle[iT*3];
+                int iFeature;
+                Vector3d point = ClosestOnTriangle(a_rcPosition, a_rcMesh.vertex[pciV[0]], a_rcMesh.vertex[pciV[1]],
+                                                   a_rcMesh.vertex[pciV[2]], iFeature);
+                double dDistSq = (a_rcPosition - point).SquaredLength();
+                if(dDistSq < dBestSq)
+                {
+                    dBestSq = dDistSq;
+                    bestPoint = point;
+                    if(iFeature == 0)
+                        bestNormal = a_rcMesh.faceNormal[iT];
+                    else if(iFeature <= 3)
+                        bestNormal = a_rcMesh.vertexNormal[pciV[iFeature-1]];
+                    else
+                        bestNormal = a_rcMesh.edgeNormal[iT*3 + iFeature-4];
+                }
+            }
+            continue;
+        }
+        // nearer child last so it is popped first
+        const BvhNode &rcLeft = a_rcMesh.nodes[rcNode.iLeft];
+        const BvhNode &rcRight = a_rcMesh.nodes[rcNode.iRight];
+        bool bLeftFirst = BoxSquaredDistance(rcLeft.min, rcLeft.max, a_rcPosition) < BoxSquaredDistance(rcRight.min, rcRight.max, a_rcPosition);
+        aiStack[iTop++] = bLeftFirst ? rcNode.iRight : rcNode.iLeft;
+        aiStack[iTop++] = bLeftFirst ? rcNode.iLeft : rcNode.iRight;
+    }
+
+    double dDistance = sqrt(dBestSq);
+    return ((a_rcPosition - bestPoint).DotProduct(bestNormal) < 0.0) ? -dDistance : dDistance;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Bake                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CObstacleField::Bake()
+{
+    m_BrickIndex.clear();
+    m_Samples.clear();
+    if(m_Primitives.empty() && m_Meshes.empty())
+    {
+        return;
+    }
+
+    // the finite obstacles plus the band, the planes over the extent
+    Vector3d domainMin(1e30,1e30,1e30);
+    Vector3d domainMax(-1e30,-1e30,-1e30);
+    Vector3d band(m_dBandWidth,m_dBandWidth,m_dBandWidth);
+    for(size_t uiI = 0 ; uiI<m_Primitives.size() ; uiI++)
+    {
+        const Primitive &rcPrimitive = m_Primitives[uiI];
+        if(rcPrimitive.iType == Type_nPlane)
+        {
+            Vector3d extent(m_dExtent,0.0,m_dExtent);
+            GrowBox(domainMin, domainMax, rcPrimitive.a - extent - band);
+            GrowBox(domainMin, domainMax, rcPrimitive.a + extent + band);
+        }
+        else
+        {
+            Vector3d radius(rcPrimitive.dRadius,rcPrimitive.dRadius,rcPrimitive.dRadius);
+            GrowBox(domainMin, domainMax, rcPrimitive.a - radius - band);
+            GrowBox(domainMin, domainMax, rcPrimitive.a + radius + band);
+            GrowBox(domainMin, domainMax, rcPrimitive.b - radius - band);
+            GrowBox(domainMin, domainMax, rcPrimitive.b + radius + band);
+        }
+    }
+    for(size_t uiI = 0 ; uiI<m_Meshes.size() ; uiI++)
+    {
+        GrowBox(domainMin, domainMax, m_Meshes[uiI].nodes[0].min - band);
+        GrowBox(domainMin, domainMax, m_Meshes[uiI].nodes[0].max + band);
+    }
+
+    const double cdBrickSize = m_dCellSize*s_ciBrickCellNum;
+    m_Origin = domainMin;
+    for(int iA = 0 ; iA<3 ; iA++)
+    {
+        m_aiBrickNum[iA] = (int)ceil((domainMax[iA] - domainMin[iA])/cdBrickSize);
+        m_aiBrickNum[iA] = (m_aiBrickNum[iA] > 0) ? m_aiBrickNum[iA] : 1;
+    }
+    const int ciBrickNum = m_aiBrickNum[0]*m_aiBrickNum[1]*m_aiBrickNum[2];
+    m_BrickIndex.assign(ciBrickNum, s_ciFarOutside);
+
+    // the samples go one cell past the band so the interpolation inside the
+    // band is not bent by the clamp, a brick whose center is farther than
+    // that plus its half diagonal holds no such sample
+    const double cdClamp = m_dBandWidth + m_dCellSize;
+    const double cdHalfDiagonal = 0.5*sqrt(3.0)*cdBrickSize;
+    std::vector<char> inBand(ciBrickNum, 0);
+    CThreadPool::Instance().ParallelFor(0, ciBrickNum, [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iB = a_iBegin ; iB<a_iEnd ; iB++)
+        {
+            int iX = iB%m_aiBrickNum[0];
+            int iY = (iB/m_aiBrickNum[0])%m_aiBrickNum[1];
+            int iZ = iB/(m_aiBrickNum[0]*m_aiBrickNum[1]);
+            Vector3d center = m_Origin + Vector3d(iX + 0.5, iY + 0.5, iZ + 0.5)*cdBrickSize;
+            double dDistance = ExactDistance(center);
+            if(fabs(dDistance) <= cdClamp + cdHalfDiagonal)
+            {
+                inBand[iB] = 1;
+            }
+            else
+            {
+                m_BrickIndex[iB] = (dDistance < 0.0) ? s_ciFarInside : s_ciFarOutside;
+            }
+        }
+    }, s_ciMinChunk);
+
+    std::vector<int> bandBrick;
+    for(int iB = 0 ; iB<ciBrickNum ; iB++)
+    {
+        if(inBand[iB])
+        {
+            m_BrickIndex[iB] = (int)bandBrick.size();
+            bandBrick.push_back(iB);
+        }
+    }
+
+    m_Samples.resize(bandBrick.size()*s_ciBrickSampleNum);
+    CThreadPool::Instance().ParallelFor(0, (int)bandBrick.size(), [&](int a_iBegin, int a_iEnd)
+    {
+        std::vector<int> primitives;
+        for(int iN = a_iBegin ; iN<a_iEnd ; iN++)
+        {
+            int iB = bandBrick[iN];
+            int iX = iB%m_aiBrickNum[0];
+            int iY = (iB/m_aiBrickNum[0])%m_aiBrickNum[1];
+            int iZ = iB/(m_aiBrickNum[0]*m_aiBrickNum[1]);
+            Vector3d corner = m_Origin + Vector3d(iX, iY, iZ)*cdBrickSize;
+
+            // a primitive farther than the clamp from the whole brick can not change a sample
+            Vector3d center = corner + Vector3d(0.5, 0.5, 0.5)*cdBrickSize;
+            primitives.clear();
+            for(int iP = 0 ; iP<(int)m_Primitives.size() ; iP++)
+            {
+                if(PrimitiveDistance(m_Primitives[iP], center) <= cdClamp + cdHalfDiagonal)
+                {
+                    primitives.push_back(iP);
+                }
+            }
+            float *pfSample = &m_Samples[iN*s_ciBrickSampleNum];
+            for(int iK = 0 ; iK<s_ciBrickSide ; iK++)
+            {
+                for(int iJ = 0 ; iJ<s_ciBrickSide ; iJ++)
+                {
+                    for(int iI = 0 ; iI<s_ciBrickSide ; iI++)
+                    {
+                        double dDistance = ExactDistance(corner + Vector3d(iI, iJ, iK)*m_dCellSize, &primitives);
+                        dDistance = (dDistance > cdClamp) ? cdClamp : ((dDistance < -cdClamp) ? -cdClamp : dDistance);
+                        pfSample[(iK*s_ciBrickSide + iJ)*s_ciBrickSide + iI] = (float)dDistance;
+                    }
+                }
+            }
+        }
+    }, 1);
+
+    printf("CObstacleField::Bake, %d of %d bricks in the band, %.1f MB.\n", (int)bandBrick.size(), ciBrickNum,
+           (m_Samples.size()*sizeof(float) + m_BrickIndex.size()*sizeof(int))/1048576.0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Query                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CObstacleField::Sample(const Vector3d &a_rcPosition, double &a_rdDistance, Vector3d &a_rNormal) const
+{
+    if(m_BrickIndex.empty())
+    {
+        return false;
+    }
+
+    const double cdInvCellSize = 1.0/m_dCellSize;
+    int aiCell[3];
+    double adFrac[3];
+    int aiBrick[3];
+    for(int iA = 0 ; iA<3 ; iA++)
+    {
+        // clamp into the domain, the field goes on with its border value,
+        // a NaN of a diverged body fails the first test and lands on 0
+        double dCoord = (a_rcPosition[iA] - m_Origin[iA])*cdInvCellSize;
+        double dMax = (double)(m_aiBrickNum[iA]*s_ciBrickCellNum);
+        dCoord = !(dCoord > 0.0) ? 0.0 : ((dCoord > dMax) ? dMax : dCoord);
+        int iCell = (int)dCoord;
+        iCell = (iCell < m_aiBrickNum[iA]*s_ciBrickCellNum) ? iCell : m_aiBrickNum[iA]*s_ciBrickCellNum - 1;
+        aiBrick[iA] = iCell/s_ciBrickCellNum;
+        aiCell[iA] = iCell - aiBrick[iA]*s_ciBrickCellNum;
+        adFrac[iA] = dCoord - iCell;
+    }
+
+    int iSlot = m_BrickIndex[(aiBrick[2]*m_aiBrickNum[1] + aiBrick[1])*m_aiBrickNum[0] + aiBrick[0]];
+    if(iSlot < 0)
+    {
+        a_rdDistance = (iSlot == s_ciFarInside) ? -m_dBandWidth : m_dBandWidth;
+        return false;
+    }
+
+    const float *pcfCell = &m_Samples[iSlot*s_ciBrickSampleNum + (aiCell[2]*s_ciBrickSide + aiCell[1])*s_ciBrickSide + aiCell[0]];
+    const int ciDY = s_ciBrickSide;
+    const int ciDZ = s_ciBrickSide*s_ciBrickSide;
+    double d000 = pcfCell[0],       d100 = pcfCell[1];
+    double d010 = pcfCell[ciDY],    d110 = pcfCell[ciDY+1];
+    double d001 = pcfCell[ciDZ],    d101 = pcfCell[ciDZ+1];
+    double d011 = pcfCell[ciDZ+ciDY], d111 = pcfCell[ciDZ+ciDY+1];
+    double fx = adFrac[0], fy = adFrac[1], fz = adFrac[2];
+
+    // trilinear value and its exact gradient
+    double d00 = d000 + (d100 - d000)*fx;
+    double d10 = d010 + (d110 - d010)*fx;
+    double d01 = d001 + (d101 - d001)*fx;
+    double d11 = d011 + (d111 - d011)*fx;
+    double d0 = d00 + (d10 - d00)*fy;
+    double d1 = d01 + (d11 - d01)*fy;
+    a_rdDistance = d0 + (d1 - d0)*fz;
+    if(a_rdDistance >= m_dBandWidth)
+    {
+        return false;
+    }
+
+    double dGradX = ((d100 - d000)*(1.0-fy) + (d110 - d010)*fy)*(1.0-fz) + ((d101 - d001)*(1.0-fy) + (d111 - d011)*fy)*fz;
+    double dGradY = (d10 - d00)*(1.0-fz) + (d11 - d01)*fz;
+    double dGradZ = d1 - d0;
+    a_rNormal = Vector3d(dGradX, dGradY, dGradZ);
+    double dLength = a_rNormal.Length();
+    if(dLength < 1e-12)
+    {
+        return false;
+    }
+    a_rNormal /= dLength;
+    return true;
+}
+
+void CObstacleField::ResolveContact(
+    const Vector3d &a_rcPosition,
+    const double a_cdRadius,
+    const double a_cdRestitution,
+    const double a_cdFriction,
+    Vector3d &a_rVelocity,
+    Vector3d &a_rForce
+    ) const
+{
+    double dDistance;
+    Vector3d normal;
+    if(!Sample(a_rcPosition, dDistance, normal) || dDistance >= s_cdContactEps + a_cdRadius)
+    {
+        return;
+    }
+
+    double dNormalSpeed = a_rVelocity.DotProduct(normal);
+    if(dNormalSpeed < 0.0)
+    {
+        a_rVelocity -= normal*((1.0 + a_cdRestitution)*dNormalSpeed);
+    }
+
+    if(fabs(a_rVelocity.DotProduct(normal)) < s_cdContactEps && a_rForce.DotProduct(normal) < 0.0)    // Friction
+    {
+        Vector3d slide = a_rVelocity - normal*a_rVelocity.DotProduct(normal);
+        if(slide.SquaredLength() > 0.0)
+        {
+            slide.Normalize();
+            a_rForce += a_rForce.DotProduct(normal)*a_cdFriction*slide;
+        }
+    }
+
+    double dNormalForce = a_rForce.DotProduct(normal);
+    if(dNormalForce < 0.0)
+    {
+        a_rForce -= normal*dNormalForce;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Draw                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CObstacleField::Draw()
+{
+    // the obstacles never move, so they are compiled once
+    if(m_uiDrawList != 0 && !m_bDrawDirty)
+    {
+        glCallList(m_uiDrawList);
+        return;
+    }
+    if(m_uiDrawList == 0)
+    {
+        m_uiDrawList = glGenLists(1);
+    }
+    m_bDrawDirty = false;
+    glNewList(m_uiDrawList, GL_COMPILE_AND_EXECUTE);
+
+    glPushAttrib(GL_CURRENT_BIT | GL_LIGHTING_BIT);
+    glEnable(GL_COLOR_MATERIAL);
+    glColor3d(m_Color.x, m_Color.y, m_Color.z);
+    for(size_t uiI = 0 ; uiI<m_Primitives.size() ; uiI++)
+    {
+        const Primitive &rcPrimitive = m_Primitives[uiI];
+        if(!rcPrimitive.bDraw)
+        {
+            continue;
+        }
+        if(rcPrimitive.iType == Type_nSphere)
+        {
+            drawSolidBall(rcPrimitive.a, rcPrimitive.dRadius);
+        }
+        else if(rcPrimitive.iType == Type_nCapsule)
+        {
+            drawCylinder(rcPrimitive.a, rcPrimitive.b, rcPrimitive.dRadius);
+        }
+        else if(rcPrimitive.iType == Type_nBox)
+        {
+            Vector3d center = (rcPrimitive.a + rcPrimitive.b)*0.5;
+            Vector3d size = rcPrimitive.b - rcPrimitive.a;
+            glPushMatrix();
+                glTranslated(center.x, center.y, center.z);
+                glScaled(size.x, size.y, size.z);
+                glutSolidCube(1.0);
+            glPopMatrix();
+        }
+    }
+    glBegin(GL_TRIANGLES);
+    for(size_t uiM = 0 ; uiM<m_Meshes.size() ; uiM++)
+    {
+        const Mesh &rcMesh = m_Meshes[uiM];
+        for(size_t uiT = 0 ; uiT<rcMesh.faceNormal.size() ; uiT++)
+        {
+            const Vector3d &rcNormal = rcMesh.faceNormal[uiT];
+            glNormal3d(rcNormal.x, rcNormal.y, rcNormal.z);
+            for(int iC = 0 ; iC<3 ; iC++)
+            {
+                const Vector3d &rcVertex = rcMesh.vertex[rcMesh.triangle[uiT*3 + iC]];
+                glVertex3d(rcVertex.x, rcVertex.y, rcVertex.z);
+            }
+        }
+    }
+    glEnd();
+    glPopAttrib();
+
+    glEndList();
+}
@@ -0,0 +1,123 @@
+#ifndef COBSTACLEFIELD_H
+#define COBSTACLEFIELD_H
+
+#include <string>
+#include <vector>
+#include "Vector3d.h"
+
+/*
+ * Static obstacles (the ground, the goalposts, boxes, spheres and closed
+ * triangle meshes) baked into one narrow band signed distance field. The
+ * domain is cut into bricks of 8x8x8 cells; only the bricks the band passes
+ * through store samples (9x9x9, the border samples are repeated so a cell
+ * never straddles two bricks), the others only remember whether they are
+ * outside or inside. A query is one look up in the brick table plus a
+ * trilinear interpolation, the normal is the gradient of the same
+ * interpolation, so it costs the same whatever the obstacles are and
+ * however many there are. Outside the domain the field continues with its
+ * value at the border, which lets the ground go on forever.
+ */
+class CObstacleField
+{
+    public:
+        CObstacleField();
+
+        inline void SetCellSize(const double a_cdCellSize){ m_dCellSize = a_cdCellSize; }
+        inline void SetBandWidth(const double a_cdBandWidth){ m_dBandWidth = a_cdBandWidth; }
+        inline void SetExtent(const double a_cdExtent){ m_dExtent = a_cdExtent; }    // half size of the baked ground
+        inline void SetColor(const Vector3d &a_rcColor){ m_Color = a_rcColor; }
+        inline double GetBandWidth() const { return m_dBandWidth; }
+        inline int BrickNum() const { return (int)m_BrickIndex.size(); }
+        inline int StoredBrickNum() const { return (int)(m_Samples.size()/s_ciBrickSampleNum); }
+        inline bool IsBaked() const { return !m_BrickIndex.empty(); }
+
+        void ClearPrimitives();
+        void ClearMeshes();
+        void AddPlane(const Vector3d &a_rcPoint, const Vector3d &a_rcNormal);     // solid below the plane
+        void AddSphere(const Vector3d &a_rcCenter, const double a_cdRadius);
+        void AddCapsule(const Vector3d &a_rcStart, const Vector3d &a_rcEnd, const double a_cdRadius, const bool a_cbDraw = true);
+        void AddBox(const Vector3d &a_rcMin, const Vector3d &a_rcMax);
+        bool AddMesh(const std::string &a_rcsFilename, const Vector3d &a_rcOffset, const double a_cdScale);   // closed Wavefront OBJ
+
+        void Bake();
+
+        // signed distance and outward unit normal, false if the point is not within the band
+        bool Sample(const Vector3d &a_rcPosition, double &a_rdDistance, Vector3d &a_rNormal) const;
+
+        // the contact the ground used to have: the velocity into the obstacle
+        // bounces, a resting body gets friction and loses its force into it
+        void ResolveContact(
+            const Vector3d &a_rcPosition,
+            const double a_cdRadius,
+            const double a_cdRestitution,
+            const double a_cdFriction,
+            Vector3d &a_rVelocity,
+            Vector3d &a_rForce
+            ) const;
+
+        void Draw();
+
+    private:
+        enum
+        {
+            Type_nPlane = 0,
+            Type_nSphere,
+            Type_nCapsule,
+            Type_nBox
+        };
+        struct Primitive
+        {
+            int iType;
+            Vector3d a;                     // plane point, sphere center, capsule start, box min
+            Vector3d b;                     // plane normal, capsule end, box max
+            double dRadius;
+            bool bDraw;
+        };
+        struct BvhNode
+        {
+            Vector3d min;
+            Vector3d max;
+            int iLeft;                      // children, -1 for a leaf
+            int iRight;
+            int iFirst;                     // leaf range in Mesh::order
+            int iCount;
+        };
+        struct Mesh
+        {
+            std::vector<Vector3d> vertex;
+            std::vector<int> triangle;      // three vertices each
+            std::vector<Vector3d> faceNormal;
+            std::vector<Vector3d> vertexNormal; // angle weighted pseudo normals for the sign
+            std::vector<Vector3d> edgeNormal;   // three per triangle, ab bc ca
+            std::vector<BvhNode> nodes;
+            std::vector<int> order;
+        };
+
+        static const int s_ciBrickCellNum = 8;
+        static const int s_ciBrickSide = s_ciBrickCellNum + 1;
+        static const int s_ciBrickSampleNum = s_ciBrickSide*s_ciBrickSide*s_ciBrickSide;
+
+        double ExactDistance(const Vector3d &a_rcPosition, const std::vector<int> *a_pcPrimitives = NULL) const;    // all primitives for NULL
+        double PrimitiveDistance(const Primitive &a_rcPrimitive, const Vector3d &a_rcPosition) const;
+        double MeshDistance(const Mesh &a_rcMesh, const Vector3d &a_rcPosition) const;
+        void BuildMesh(Mesh &a_rMesh);
+        int BuildNode(Mesh &a_rMesh, const int a_ciBegin, const int a_ciEnd);
+
+        double m_dCellSize;
+        double m_dBandWidth;
+        double m_dExtent;
+        Vector3d m_Color;
+
+        std::vector<Primitive> m_Primitives;
+        std::vector<Mesh> m_Meshes;
+
+        Vector3d m_Origin;                  // min corner of the domain
+        int m_aiBrickNum[3];
+        std::vector<int> m_BrickIndex;      // sample block of the brick, negative for the bricks out of the band
+        std::vector<float> m_Samples;
+
+        unsigned int m_uiDrawList;
+        bool m_bDrawDirty;
+};
+
+#endif
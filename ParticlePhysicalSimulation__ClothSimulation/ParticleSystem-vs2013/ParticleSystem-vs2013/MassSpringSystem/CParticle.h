@@ -28,6 +28,7 @@ public:
         inline void ResetNormal(){m_AccumulateNormal = Vector3d(0, 0, 0);}
 
         inline double GetMass(){return m_dMass;}
+        inline bool IsMovable(){return m_IsMovable;}
         inline Vector3d GetPosition(){return m_Position;}
         inline Vector3d GetVelocity(){return m_Velocity;}
         inline Vector3d GetAcceleration(){return m_Force/m_dMass;}
@@ -0,0 +1,73 @@
+#include "CParticlePool.h"
+
+CParticlePool::CParticlePool(const int a_ciCapacity)
+    :m_iSize(0)
+{
+    Reserve(a_ciCapacity);
+}
+
+void CParticlePool::Reserve(const int a_ciCapacity)
+{
+    int iCapacity = (a_ciCapacity > 0) ? a_ciCapacity : 0;
+    m_Position.resize(iCapacity);
+    m_Velocity.resize(iCapacity);
+    m_Color.resize(iCapacity);
+    m_Mass.resize(iCapacity);
+    m_Age.resize(iCapacity);
+    m_Lifetime.resize(iCapacity);
+    if(m_iSize > iCapacity)
+    {
+        m_iSize = iCapacity;
+    }
+}
+
+int CParticlePool::Spawn(
+    const Vector3d &a_rcPosition,
+    const Vector3d &a_rcVelocity,
+    const Vector3d &a_rcColor,
+    const double a_cdMass,
+    const double a_cdLifetime
+    )
+{
+    if(IsFull())
+    {
+        return -1;
+    }
+    int iIdx = m_iSize++;
+    m_Position[iIdx] = a_rcPosition;
+    m_Velocity[iIdx] = a_rcVelocity;
+    m_Color[iIdx]    = a_rcColor;
+    m_Mass[iIdx]     = a_cdMass;
+    m_Age[iIdx]      = 0.0;
+    m_Lifetime[iIdx] = a_cdLifetime;
+    return iIdx;
+}
+
+void CParticlePool::Kill(const int a_ciIdx)
+{
+    int iLast = --m_iSize;
+    if(a_ciIdx != iLast)
+    {
+        m_Position[a_ciIdx] = m_Position[iLast];
+        m_Velocity[a_ciIdx] = m_Velocity[iLast];
+        m_Color[a_ciIdx]    = m_Color[iLast];
+        m_Mass[a_ciIdx]     = m_Mass[iLast];
+        m_Age[a_ciIdx]      = m_Age[iLast];
+        m_Lifetime[a_ciIdx] = m_Lifetime[iLast];
+    }
+}
+
+int CParticlePool::RemoveDead()
+{
+    // walk backwards so the particle swapped in has already been checked
+    int iRemoved = 0;
+    for(int iI = m_iSize-1 ; iI>=0 ; iI--)
+    {
+        if(m_Age[iI] >= m_Lifetime[iI])
+        {
+            Kill(iI);
+            ++iRemoved;
+        }
+    }
+    return iRemoved;
+}
@@ -0,0 +1,47 @@
+#ifndef CPARTICLEPOOL_H
+#define CPARTICLEPOOL_H
+
+#include <vector>
+#include "Vector3d.h"
+
+/*
+ * Free particles in structure-of-arrays layout. All arrays are allocated
+ * once with the capacity, the first Size() entries are alive. A dead
+ * particle is replaced by the last one (swap-remove), so spawning and
+ * killing never touch the heap.
+ */
+class CParticlePool
+{
+    public:
+        explicit CParticlePool(const int a_ciCapacity = 0);
+
+        void Reserve(const int a_ciCapacity);
+        inline void Clear(){ m_iSize = 0; }
+
+        // returns the index of the new particle or -1 when the pool is full
+        int Spawn(
+            const Vector3d &a_rcPosition,
+            const Vector3d &a_rcVelocity,
+            const Vector3d &a_rcColor,
+            const double a_cdMass,
+            const double a_cdLifetime
+            );
+        void Kill(const int a_ciIdx);
+        int RemoveDead();                    // kills every particle past its lifetime, returns the number removed
+
+        inline int Size() const { return m_iSize; }
+        inline int Capacity() const { return (int)m_Position.size(); }
+        inline bool IsFull() const { return m_iSize == Capacity(); }
+
+        std::vector<Vector3d> m_Position;
+        std::vector<Vector3d> m_Velocity;
+        std::vector<Vector3d> m_Color;
+        std::vector<double> m_Mass;
+        std::vector<double> m_Age;
+        std::vector<double> m_Lifetime;
+
+    private:
+        int m_iSize;
+};
+
+#endif
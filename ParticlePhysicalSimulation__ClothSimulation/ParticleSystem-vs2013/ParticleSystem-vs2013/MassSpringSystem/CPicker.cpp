@@ -0,0 +1,357 @@
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include "CPicker.h"
+#include "CThreadPool.h"
+
+namespace
+{
+    const int s_ciLeafSize = 4;             // triangles per leaf
+    const int s_ciMaxDepth = 64;            // of the traversal stack, the tree is balanced
+    const int s_ciMinChunk = 256;           // leaves per refit task
+    const double s_cdParallel = 1e-12;
+
+    struct CentroidLess
+    {
+        const std::vector<Vector3d> *pCentroid;
+        int iAxis;
+        bool operator()(const int a_ciA, const int a_ciB) const
+        {
+            return (*pCentroid)[a_ciA][iAxis] < (*pCentroid)[a_ciB][iAxis];
+        }
+    };
+
+    // entry distance of the ray into the box, false if it misses or enters past a_cdMaxDistance
+    bool RayBox(const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const Vector3d &a_rcMin, const Vector3d &a_rcMax, const double a_cdMaxDistance)
+    {
+        double dEnter = 0.0;
+        double dExit = a_cdMaxDistance;
+        for(int iA = 0 ; iA<3 ; iA++)
+        {
+            if(fabs(a_rcDirection[iA]) < s_cdParallel)
+            {
+                if(a_rcOrigin[iA] < a_rcMin[iA] || a_rcOrigin[iA] > a_rcMax[iA])
+                {
+                    return false;
+                }
+                continue;
+            }
+            double dInv = 1.0/a_rcDirection[iA];
+            double dT0 = (a_rcMin[iA] - a_rcOrigin[iA])*dInv;
+            double dT1 = (a_rcMax[iA] - a_rcOrigin[iA])*dInv;
+            if(dT0 > dT1)
+            {
+                double dTmp = dT0; dT0 = dT1; dT1 = dTmp;
+            }
+            dEnter = (dT0 > dEnter) ? dT0 : dEnter;
+            dExit = (dT1 < dExit) ? dT1 : dExit;
+            if(dEnter > dExit)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Moller-Trumbore, both sides of the triangle count
+    bool RayTriangle(const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const Vector3d &a_rcA, const Vector3d &a_rcB, const Vector3d &a_rcC, double &a_rdDistance)
+    {
+        Vector3d e1 = a_rcB - a_rcA;
+        Vector3d e2 = a_rcC - a_rcA;
+        Vector3d p = a_rcDirection.CrossProduct(e2);
+        double dDet = e1.DotProduct(p);
+        if(fabs(dDet) < s_cdParallel)
+        {
+            return false;
+        }
+        double dInvDet = 1.0/dDet;
+        Vector3d s = a_rcOrigin - a_rcA;
+        double dU = s.DotProduct(p)*dInvDet;
+        if(dU < 0.0 || dU > 1.0)
+        {
+            return false;
+        }
+        Vector3d q = s.CrossProduct(e1);
+        double dV = a_rcDirection.DotProduct(q)*dInvDet;
+        if(dV < 0.0 || dU + dV > 1.0)
+        {
+            return false;
+        }
+        a_rdDistance = e2.DotProduct(q)*dInvDet;
+        return a_rdDistance > 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                Constructor                                 //
+////////////////////////////////////////////////////////////////////////////////
+CPicker::CPicker()
+    :m_Triangles(),
+    m_Order(),
+    m_Centroid(),
+    m_Position(),
+    m_Movable(),
+    m_Nodes(),
+    m_Leaves(),
+    m_Inners(),
+    m_iParticleNum(0)
+{
+}
+
+void CPicker::Invalidate()
+{
+    m_Nodes.clear();
+    m_iParticleNum = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Build                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CPicker::Build(GoalNet &a_rGoalNet)
+{
+    m_iParticleNum = a_rGoalNet.ParticleNum();
+    a_rGoalNet.GetTriangles(m_Triangles);
+    const int ciTriangleNum = (int)m_Triangles.size()/3;
+
+    m_Position.resize(m_iParticleNum);
+    for(int iI = 0 ; iI<m_iParticleNum ; iI++)
+    {
+        m_Position[iI] = a_rGoalNet.GetParticle(iI).GetPosition();
+    }
+    m_Order.resize(ciTriangleNum);
+    m_Centroid.resize(ciTriangleNum);
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        m_Order[iT] = iT;
+        m_Centroid[iT] = (m_Position[m_Triangles[3*iT]] + m_Position[m_Triangles[3*iT+1]] + m_Position[m_Triangles[3*iT+2]])/3.0;
+    }
+
+    m_Nodes.clear();
+    m_Leaves.clear();
+    m_Inners.clear();
+    m_Nodes.reserve(2*(ciTriangleNum/s_ciLeafSize + 1));
+    if(ciTriangleNum > 0)
+    {
+        BuildNode(0, ciTriangleNum);
+    }
+
+    // the corners of a leaf sit next to each other from now on
+    std::vector<int> sorted(m_Triangles.size());
+    for(int iT = 0 ; iT<ciTriangleNum ; iT++)
+    {
+        for(int iV = 0 ; iV<3 ; iV++)
+        {
+            sorted[3*iT+iV] = m_Triangles[3*m_Order[iT]+iV];
+        }
+    }
+    m_Triangles.swap(sorted);
+    for(int iN = 0 ; iN<(int)m_Nodes.size() ; iN++)
+    {
+        if(m_Nodes[iN].iRight < 0)
+        {
+            m_Leaves.push_back(iN);
+        }
+        else
+        {
+            m_Inners.push_back(iN);
+        }
+    }
+    m_Order.clear();
+    m_Centroid.clear();
+}
+
+int CPicker::BuildNode(const int a_ciFirst, const int a_ciCount)
+{
+    const int ciNode = (int)m_Nodes.size();
+    Node node;
+    node.iRight = -1;
+    node.iFirst = a_ciFirst;
+    node.iCount = a_ciCount;
+    m_Nodes.push_back(node);
+    if(a_ciCount <= s_ciLeafSize)
+    {
+        return ciNode;
+    }
+
+    // median split of the centroids along their widest axis
+    Vector3d lo = m_Centroid[m_Order[a_ciFirst]];
+    Vector3d hi = lo;
+    for(int iI = a_ciFirst + 1 ; iI<a_ciFirst + a_ciCount ; iI++)
+    {
+        const Vector3d &rcC = m_Centroid[m_Order[iI]];
+        for(int iA = 0 ; iA<3 ; iA++)
+        {
+            lo[iA] = (rcC[iA] < lo[iA]) ? rcC[iA] : lo[iA];
+            hi[iA] = (rcC[iA] > hi[iA]) ? rcC[iA] : hi[iA];
+        }
+    }
+    Vector3d extent = hi - lo;
+    CentroidLess less;
+    less.pCentroid = &m_Centroid;
+    less.iAxis = (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2) : ((extent.y > extent.z) ? 1 : 2);
+    const int ciHalf = a_ciCount/2;
+    std::nth_element(m_Order.begin() + a_ciFirst, m_Order.begin() + a_ciFirst + ciHalf, m_Order.begin() + a_ciFirst + a_ciCount, less);
+
+    BuildNode(a_ciFirst, ciHalf);
+    int iRight = BuildNode(a_ciFirst + ciHalf, a_ciCount - ciHalf);
+    m_Nodes[ciNode].iRight = iRight;
+    return ciNode;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Refit                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CPicker::Refit(GoalNet &a_rGoalNet)
+{
+    m_Movable.resize(m_iParticleNum);
+    for(int iI = 0 ; iI<m_iParticleNum ; iI++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iI);
+        m_Position[iI] = rParticle.GetPosition();
+        m_Movable[iI] = rParticle.IsMovable() ? 1 : 0;
+    }
+
+    CThreadPool::Instance().ParallelFor(0, (int)m_Leaves.size(), [&](int a_iBegin, int a_iEnd)
+    {
+        RefitLeaves(a_iBegin, a_iEnd);
+    }, s_ciMinChunk);
+
+    // the children come after their parent, so the boxes grow from the back
+    for(int iI = (int)m_Inners.size() - 1 ; iI>=0 ; iI--)
+    {
+        const int ciNode = m_Inners[iI];
+        Node &rNode = m_Nodes[ciNode];
+        const Node &rcLeft = m_Nodes[ciNode+1];
+        const Node &rcRight = m_Nodes[rNode.iRight];
+        rNode.boxMin.x = (rcLeft.boxMin.x < rcRight.boxMin.x) ? rcLeft.boxMin.x : rcRight.boxMin.x;
+        rNode.boxMin.y = (rcLeft.boxMin.y < rcRight.boxMin.y) ? rcLeft.boxMin.y : rcRight.boxMin.y;
+        rNode.boxMin.z = (rcLeft.boxMin.z < rcRight.boxMin.z) ? rcLeft.boxMin.z : rcRight.boxMin.z;
+        rNode.boxMax.x = (rcLeft.boxMax.x > rcRight.boxMax.x) ? rcLeft.boxMax.x : rcRight.boxMax.x;
+        rNode.boxMax.y = (rcLeft.boxMax.y > rcRight.boxMax.y) ? rcLeft.boxMax.y : rcRight.boxMax.y;
+        rNode.boxMax.z = (rcLeft.boxMax.z > rcRight.boxMax.z) ? rcLeft.boxMax.z : rcRight.boxMax.z;
+    }
+}
+
+void CPicker::RefitLeaves(const int a_ciBegin, const int a_ciEnd)
+{
+    for(int iL = a_ciBegin ; iL<a_ciEnd ; iL++)
+    {
+        Node &rNode = m_Nodes[m_Leaves[iL]];
+        const int *pciCorner = &m_Triangles[3*rNode.iFirst];
+        const int *pciEnd = pciCorner + 3*rNode.iCount;
+        Vector3d lo = m_Position[*pciCorner];
+        Vector3d hi = lo;
+        for(++pciCorner ; pciCorner<pciEnd ; ++pciCorner)
+        {
+            const Vector3d &rcP = m_Position[*pciCorner];
+            lo.x = (rcP.x < lo.x) ? rcP.x : lo.x;
+            lo.y = (rcP.y < lo.y) ? rcP.y : lo.y;
+            lo.z = (rcP.z < lo.z) ? rcP.z : lo.z;
+            hi.x = (rcP.x > hi.x) ? rcP.x : hi.x;
+            hi.y = (rcP.y > hi.y) ? rcP.y : hi.y;
+            hi.z = (rcP.z > hi.z) ? rcP.z : hi.z;
+        }
+        rNode.boxMin = lo;
+        rNode.boxMax = hi;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Query                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CPicker::Pick(
+    GoalNet &a_rGoalNet,
+    const Vector3d &a_rcOrigin,
+    const Vector3d &a_rcDirection,
+    const double a_cdRadius,
+    Result &a_rResult
+    )
+{
+    a_rResult.iParticle = -1;
+    a_rResult.dDistance = 1e300;
+    if(m_Nodes.empty() || a_rGoalNet.ParticleNum() != m_iParticleNum)
+    {
+        Build(a_rGoalNet);
+    }
+    if(m_Nodes.empty())
+    {
+        return false;
+    }
+    Refit(a_rGoalNet);
+
+    // the boxes grow by the radius so the particles near the ray are found too
+    Vector3d inflate(a_cdRadius, a_cdRadius, a_cdRadius);
+    int aiStack[s_ciMaxDepth];
+    int iTop = 0;
+    aiStack[iTop++] = 0;
+    while(iTop > 0)
+    {
+        const Node &rcNode = m_Nodes[aiStack[--iTop]];
+        if(!RayBox(a_rcOrigin, a_rcDirection, rcNode.boxMin - inflate, rcNode.boxMax + inflate, a_rResult.dDistance))
+        {
+            continue;
+        }
+        if(rcNode.iRight < 0)
+        {
+            TestLeaf(rcNode, a_rcOrigin, a_rcDirection, a_cdRadius, a_rResult);
+        }
+        else
+        {
+            const int ciLeft = (int)(&rcNode - &m_Nodes[0]) + 1;
+            aiStack[iTop++] = rcNode.iRight;
+            aiStack[iTop++] = ciLeft;
+        }
+    }
+    return a_rResult.iParticle >= 0;
+}
+
+void CPicker::TestLeaf(const Node &a_rcNode, const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const double a_cdRadius, Result &a_rResult) const
+{
+    const double cdRadius2 = a_cdRadius*a_cdRadius;
+    for(int iI = a_rcNode.iFirst ; iI<a_rcNode.iFirst + a_rcNode.iCount ; iI++)
+    {
+        const int *pciCorner = &m_Triangles[3*iI];
+
+        // the face, its closest movable corner is the one that gets dragged
+        double dDistance = 0.0;
+        if(RayTriangle(a_rcOrigin, a_rcDirection, m_Position[pciCorner[0]], m_Position[pciCorner[1]], m_Position[pciCorner[2]], dDistance) &&
+           dDistance < a_rResult.dDistance)
+        {
+            Vector3d hit = a_rcOrigin + a_rcDirection*dDistance;
+            int iBest = -1;
+            double dBest = 0.0;
+            for(int iV = 0 ; iV<3 ; iV++)
+            {
+                double dCorner = (m_Position[pciCorner[iV]] - hit).SquaredLength();
+                if(m_Movable[pciCorner[iV]] && (iBest < 0 || dCorner < dBest))
+                {
+                    iBest = pciCorner[iV];
+                    dBest = dCorner;
+                }
+            }
+            if(iBest >= 0)
+            {
+                a_rResult.iParticle = iBest;
+                a_rResult.dDistance = dDistance;
+                a_rResult.point = hit;
+            }
+        }
+
+        // the corners themselves, for a ray that grazes the net
+        for(int iV = 0 ; iV<3 ; iV++)
+        {
+            if(!m_Movable[pciCorner[iV]])
+            {
+                continue;
+            }
+            Vector3d offset = m_Position[pciCorner[iV]] - a_rcOrigin;
+            double dAlong = offset.DotProduct(a_rcDirection);
+            if(dAlong > 0.0 && dAlong < a_rResult.dDistance && offset.SquaredLength() - dAlong*dAlong <= cdRadius2)
+            {
+                a_rResult.iParticle = pciCorner[iV];
+                a_rResult.dDistance = dAlong;
+                a_rResult.point = a_rcOrigin + a_rcDirection*dAlong;
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CPICKER_H
+#define CPICKER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+
+/*
+ * Ray queries against the net for the mouse. A bounding volume hierarchy
+ * over the triangles of the net faces is built once from the positions of
+ * the first query and then only refit to the current positions, so a query
+ * costs one pass over the particles and a descent through the boxes. The
+ * triangles are stored in leaf order and the leaves are refit on the thread
+ * pool, the inner boxes after them from the bottom up. A ray
+ * that hits a triangle picks the closest movable corner of it, a ray that
+ * passes within the pick radius of a movable particle picks that particle,
+ * whichever of the two is nearer to the eye wins.
+ */
+class CPicker
+{
+    public:
+        struct Result
+        {
+            int iParticle;                  // -1 if nothing was hit
+            double dDistance;               // along the ray
+            Vector3d point;                 // where the ray hit
+        };
+
+        CPicker();
+
+        // a_rcDirection has to be unit length
+        bool Pick(
+            GoalNet &a_rGoalNet,
+            const Vector3d &a_rcOrigin,
+            const Vector3d &a_rcDirection,
+            const double a_cdRadius,
+            Result &a_rResult
+            );
+        void Invalidate();              // the next query builds the hierarchy again
+
+        inline int NodeNum() const { return (int)m_Nodes.size(); }
+
+    private:
+        struct Node
+        {
+            Vector3d boxMin;
+            Vector3d boxMax;
+            int iRight;                     // the left child follows its parent, -1 for a leaf
+            int iFirst;                     // leaf triangles in m_Triangles
+            int iCount;
+        };
+
+        void Build(GoalNet &a_rGoalNet);
+        int BuildNode(const int a_ciFirst, const int a_ciCount);
+        void Refit(GoalNet &a_rGoalNet);
+        void RefitLeaves(const int a_ciBegin, const int a_ciEnd);
+        void TestLeaf(const Node &a_rcNode, const Vector3d &a_rcOrigin, const Vector3d &a_rcDirection, const double a_cdRadius, Result &a_rResult) const;
+
+        std::vector<int> m_Triangles;       // three particles each, grouped by leaf
+        std::vector<int> m_Order;           // triangle ids while building
+        std::vector<Vector3d> m_Centroid;
+        std::vector<Vector3d> m_Position;   // of the particles at the last query
+        std::vector<char> m_Movable;
+        std::vector<Node> m_Nodes;
+        std::vector<int> m_Leaves;          // node ids
+        std::vector<int> m_Inners;          // node ids, parents first
+        int m_iParticleNum;
+};
+
+#endif
@@ -0,0 +1,412 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <cmath>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseCholesky>
+#include "CProjectiveDynamics.h"
+#include "CThreadPool.h"
+
+namespace
+{
+    const int s_ciLinkChunk = 256;          // links per parallel task of the local step
+    const int s_ciNodeChunk = 128;          // unknowns per parallel task of the gather
+    const int s_ciRefactorLag = 16;         // steps a torn spring is cancelled in the local step
+}
+
+struct CProjectiveDynamics::Factor
+{
+    Eigen::SparseMatrix<double> matrix;
+    Eigen::SimplicialLLT<Eigen::SparseMatrix<double> > solver;
+    Eigen::MatrixXd rhs;                    // one column per axis
+    Eigen::MatrixXd position;
+    bool bAnalyzed;                         // the pattern is only analyzed again for new springs
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                        Constructor & Destructor                            //
+////////////////////////////////////////////////////////////////////////////////
+CProjectiveDynamics::CProjectiveDynamics()
+    :m_iIterationNum(10),
+    m_bDirty(true),
+    m_bFactored(false),
+    m_iFactorizationNum(0),
+    m_dDeltaT(0.0),
+    m_dSpringEnergy(0.0),
+    m_iParticleNum(0),
+    m_iSpringNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_iLagStepNum(0),
+    m_pFactor(new Factor())
+{
+    m_pFactor->bAnalyzed = false;
+}
+
+CProjectiveDynamics::CProjectiveDynamics(const CProjectiveDynamics &a_rcProjectiveDynamics)
+    :m_iIterationNum(a_rcProjectiveDynamics.m_iIterationNum),
+    m_bDirty(true),
+    m_bFactored(false),
+    m_iFactorizationNum(0),
+    m_dDeltaT(0.0),
+    m_dSpringEnergy(0.0),
+    m_iParticleNum(0),
+    m_iSpringNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_iLagStepNum(0),
+    m_pFactor(new Factor())
+{
+    m_pFactor->bAnalyzed = false;
+}
+
+CProjectiveDynamics &CProjectiveDynamics::operator=(const CProjectiveDynamics &a_rcProjectiveDynamics)
+{
+    if(this != &a_rcProjectiveDynamics)
+    {
+        m_iIterationNum = a_rcProjectiveDynamics.m_iIterationNum;
+        Reset();
+    }
+    return *this;
+}
+
+CProjectiveDynamics::~CProjectiveDynamics()
+{
+    delete m_pFactor;
+}
+
+void CProjectiveDynamics::Reset()
+{
+    m_bDirty = true;
+    m_bFactored = false;
+    m_iParticleNum = 0;
+    m_iSpringNum = 0;
+    m_pFactor->bAnalyzed = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                               System Setup                                 //
+////////////////////////////////////////////////////////////////////////////////
+void CProjectiveDynamics::Build(GoalNet &a_rGoalNet)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+    m_iParticleNum = ciParticleNum;
+    m_iSpringNum = ciSpringNum;
+    m_iTopologyVersion = a_rGoalNet.GetTopologyVersion();
+    m_iLogSeen = (int)a_rGoalNet.GetBrokenLog().size();
+    m_iLagStepNum = 0;
+
+    m_FreeIndex.assign(ciParticleNum, -1);
+    m_Free.clear();
+    m_Mass.clear();
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+        if(rParticle.IsMovable())
+        {
+            m_FreeIndex[iP] = (int)m_Free.size();
+            m_Free.push_back(iP);
+            m_Mass.push_back(rParticle.GetMass());
+        }
+    }
+    const int ciFreeNum = (int)m_Free.size();
+
+    m_Links.resize(ciSpringNum);
+    m_IncidenceStart.assign(ciFreeNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        Link &rLink = m_Links[iS];
+        rLink.iStart = rSpring.GetSpringStartID();
+        rLink.iEnd = rSpring.GetSpringEndID();
+        rLink.dRestLength = rSpring.GetSpringRestLength();
+        rLink.bBroken = rSpring.IsBroken();
+        if(m_FreeIndex[rLink.iStart] >= 0)
+        {
+            ++m_IncidenceStart[m_FreeIndex[rLink.iStart]+1];
+        }
+        if(m_FreeIndex[rLink.iEnd] >= 0)
+        {
+            ++m_IncidenceStart[m_FreeIndex[rLink.iEnd]+1];
+        }
+    }
+    for(int iF = 0 ; iF<ciFreeNum ; iF++)
+    {
+        m_IncidenceStart[iF+1] += m_IncidenceStart[iF];
+    }
+    m_Incidences.resize(m_IncidenceStart[ciFreeNum]);
+    std::vector<int> cursor(m_IncidenceStart.begin(), m_IncidenceStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        const int ciStart = m_FreeIndex[m_Links[iS].iStart];
+        const int ciEnd = m_FreeIndex[m_Links[iS].iEnd];
+        if(ciStart >= 0)
+        {
+            Incidence &rIncidence = m_Incidences[cursor[ciStart]++];
+            rIncidence.iLink = iS;
+            rIncidence.dSign = 1.0;
+        }
+        if(ciEnd >= 0)
+        {
+            Incidence &rIncidence = m_Incidences[cursor[ciEnd]++];
+            rIncidence.iLink = iS;
+            rIncidence.dSign = -1.0;
+        }
+    }
+
+    m_Start.resize(ciParticleNum);
+    m_Inertia.resize(ciFreeNum);
+    m_Damping.resize(ciSpringNum);
+    m_Target.resize(ciSpringNum);
+    m_pFactor->rhs.resize(ciFreeNum, 3);
+    m_pFactor->position.resize(ciFreeNum, 3);
+    m_pFactor->bAnalyzed = false;
+    m_bDirty = true;
+}
+
+void CProjectiveDynamics::Sync(GoalNet &a_rGoalNet)
+{
+    // a compaction renumbers the springs and changes the pattern, that is built anew
+    if(m_iParticleNum != a_rGoalNet.ParticleNum() || m_iTopologyVersion != a_rGoalNet.GetTopologyVersion())
+    {
+        Build(a_rGoalNet);
+        return;
+    }
+    const std::vector<int> &rcLog = a_rGoalNet.GetBrokenLog();
+    for( ; m_iLogSeen<(int)rcLog.size() ; m_iLogSeen++)
+    {
+        m_Links[rcLog[m_iLogSeen]].bBroken = true;
+        if(m_iLagStepNum == 0)
+        {
+            m_iLagStepNum = 1;
+        }
+    }
+    if(m_iLagStepNum > 0 && m_iLagStepNum++ >= s_ciRefactorLag)
+    {
+        m_bDirty = true;
+    }
+}
+
+bool CProjectiveDynamics::Factorize(const double a_cdDeltaT)
+{
+    const int ciFreeNum = (int)m_Free.size();
+    const double cdInvDeltaT = 1.0/a_cdDeltaT;
+    const double cdInvDeltaT2 = cdInvDeltaT*cdInvDeltaT;
+
+    typedef Eigen::Triplet<double> Triplet_t;
+    std::vector<Triplet_t> triplets;
+    triplets.reserve(ciFreeNum + 4*m_Links.size());
+    for(int iF = 0 ; iF<ciFreeNum ; iF++)
+    {
+        triplets.push_back(Triplet_t(iF, iF, m_Mass[iF]*cdInvDeltaT2));
+    }
+    for(size_t uiL = 0 ; uiL<m_Links.size() ; uiL++)
+    {
+        Link &rLink = m_Links[uiL];
+        // a torn spring keeps its entries at zero, the pattern stays analyzed
+        rLink.dFactorWeight = rLink.bBroken ? 0.0 : rLink.dSpringCoef + rLink.dDamperCoef*cdInvDeltaT;
+        const double cdWeight = rLink.dFactorWeight;
+        const int ciStart = m_FreeIndex[rLink.iStart];
+        const int ciEnd = m_FreeIndex[rLink.iEnd];
+        if(ciStart >= 0)
+        {
+            triplets.push_back(Triplet_t(ciStart, ciStart, cdWeight));
+        }
+        if(ciEnd >= 0)
+        {
+            triplets.push_back(Triplet_t(ciEnd, ciEnd, cdWeight));
+        }
+        if(ciStart >= 0 && ciEnd >= 0)
+        {
+            triplets.push_back(Triplet_t(ciStart, ciEnd, -cdWeight));
+            triplets.push_back(Triplet_t(ciEnd, ciStart, -cdWeight));
+        }
+    }
+    m_pFactor->matrix.resize(ciFreeNum, ciFreeNum);
+    m_pFactor->matrix.setFromTriplets(triplets.begin(), triplets.end());
+
+    // the ordering only depends on the springs, a new h or coefficient reuses it
+    if(!m_pFactor->bAnalyzed)
+    {
+        m_pFactor->solver.analyzePattern(m_pFactor->matrix);
+        m_pFactor->bAnalyzed = true;
+    }
+    m_pFactor->solver.factorize(m_pFactor->matrix);
+
+    m_dDeltaT = a_cdDeltaT;
+    m_bDirty = false;
+    m_iLagStepNum = 0;
+    ++m_iFactorizationNum;
+    m_bFactored = (m_pFactor->solver.info() == Eigen::Success);
+    if(!m_bFactored)
+    {
+        printf("[Warning] CProjectiveDynamics::Factorize, the system is not positive definite, check the spring and damper coefficients\n");
+    }
+    return m_bFactored;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Step                                    //
+////////////////////////////////////////////////////////////////////////////////
+bool CProjectiveDynamics::Step(GoalNet &a_rGoalNet, const double a_cdDeltaT)
+{
+    Sync(a_rGoalNet);
+    if(m_bDirty)
+    {
+        // the coefficients are only read back when they may have changed
+        for(int iS = 0 ; iS<m_iSpringNum ; iS++)
+        {
+            CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+            m_Links[iS].dSpringCoef = rSpring.GetSpringCoef();
+            m_Links[iS].dDamperCoef = rSpring.GetDamperCoef();
+        }
+    }
+    if(m_bDirty || a_cdDeltaT != m_dDeltaT)
+    {
+        Factorize(a_cdDeltaT);
+    }
+    if(!m_bFactored)
+    {
+        return false;
+    }
+
+    const int ciFreeNum = (int)m_Free.size();
+    const double cdInvDeltaT = 1.0/a_cdDeltaT;
+    const double cdInvDeltaT2 = cdInvDeltaT*cdInvDeltaT;
+
+    for(int iP = 0 ; iP<m_iParticleNum ; iP++)
+    {
+        m_Start[iP] = a_rGoalNet.GetParticle(iP).GetPosition();
+    }
+
+    // spring energy and the damping part of the targets, both from the start of the step
+    m_dSpringEnergy = 0.0;
+    for(int iL = 0 ; iL<m_iSpringNum ; iL++)
+    {
+        const Link &rcLink = m_Links[iL];
+        if(rcLink.bBroken)
+        {
+            m_Damping[iL] = Vector3d::ZERO;
+            continue;
+        }
+        Vector3d offset = m_Start[rcLink.iStart] - m_Start[rcLink.iEnd];
+        double dStretch = offset.Length() - rcLink.dRestLength;
+        m_dSpringEnergy += 0.5*rcLink.dSpringCoef*dStretch*dStretch;
+        m_Damping[iL] = offset*(rcLink.dDamperCoef*cdInvDeltaT);
+    }
+
+    // inertial target y = x + h v + h^2 f/m, also the first guess
+    Eigen::MatrixXd &rPosition = m_pFactor->position;
+    for(int iF = 0 ; iF<ciFreeNum ; iF++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(m_Free[iF]);
+        Vector3d inertia = m_Start[m_Free[iF]] + rParticle.GetVelocity()*a_cdDeltaT
+                         + rParticle.GetForce()*(a_cdDeltaT*a_cdDeltaT/m_Mass[iF]);
+        rPosition(iF, 0) = inertia.x;
+        rPosition(iF, 1) = inertia.y;
+        rPosition(iF, 2) = inertia.z;
+        m_Inertia[iF] = inertia*(m_Mass[iF]*cdInvDeltaT2);
+    }
+    // a fixed neighbor pulls with the full weight the link has in the factor
+    for(int iL = 0 ; iL<m_iSpringNum ; iL++)
+    {
+        const Link &rcLink = m_Links[iL];
+        const double cdWeight = rcLink.dFactorWeight;
+        const int ciStart = m_FreeIndex[rcLink.iStart];
+        const int ciEnd = m_FreeIndex[rcLink.iEnd];
+        if(ciStart >= 0 && ciEnd < 0)
+        {
+            m_Inertia[ciStart] += m_Start[rcLink.iEnd]*cdWeight;
+        }
+        else if(ciStart < 0 && ciEnd >= 0)
+        {
+            m_Inertia[ciEnd] += m_Start[rcLink.iStart]*cdWeight;
+        }
+    }
+
+    for(int iIter = 0 ; iIter<m_iIterationNum ; iIter++)
+    {
+        Project();
+        Gather();
+
+        // the three axes share the factor, one triangular pair each
+        CThreadPool::Instance().ParallelFor(0, 3, [this, &rPosition](int a_iBegin, int a_iEnd)
+        {
+            for(int iAxis = a_iBegin ; iAxis<a_iEnd ; iAxis++)
+            {
+                rPosition.col(iAxis) = m_pFactor->solver.solve(m_pFactor->rhs.col(iAxis));
+            }
+        }, 1);
+    }
+
+    CThreadPool::Instance().ParallelFor(0, ciFreeNum, [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iF = a_iBegin ; iF<a_iEnd ; iF++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(m_Free[iF]);
+            Vector3d position(rPosition(iF, 0), rPosition(iF, 1), rPosition(iF, 2));
+            rParticle.SetVelocity((position - m_Start[m_Free[iF]])*cdInvDeltaT);
+            rParticle.SetPosition(position);
+        }
+    }, s_ciNodeChunk);
+    return true;
+}
+
+Vector3d CProjectiveDynamics::Position(const int a_ciParticle) const
+{
+    const int ciFree = m_FreeIndex[a_ciParticle];
+    if(ciFree < 0)
+    {
+        return m_Start[a_ciParticle];
+    }
+    const Eigen::MatrixXd &rcPosition = m_pFactor->position;
+    return Vector3d(rcPosition(ciFree, 0), rcPosition(ciFree, 1), rcPosition(ciFree, 2));
+}
+
+void CProjectiveDynamics::Project()
+{
+    // local step: the closest point of every spring at rest length, scaled by k
+    CThreadPool::Instance().ParallelFor(0, m_iSpringNum, [this](int a_iBegin, int a_iEnd)
+    {
+        for(int iL = a_iBegin ; iL<a_iEnd ; iL++)
+        {
+            const Link &rcLink = m_Links[iL];
+            Vector3d offset = Position(rcLink.iStart) - Position(rcLink.iEnd);
+            if(rcLink.bBroken)
+            {
+                // cancels what the factor still holds of the spring, 0 once factored torn
+                m_Target[iL] = offset*rcLink.dFactorWeight;
+                continue;
+            }
+            double dLength = offset.Length();
+            if(dLength < 1e-12)
+            {
+                // no direction to project on, keep the one of the start of the step
+                offset = m_Start[rcLink.iStart] - m_Start[rcLink.iEnd];
+                dLength = offset.Length();
+            }
+            Vector3d projection = (dLength < 1e-12) ? Vector3d::ZERO : offset*(rcLink.dRestLength/dLength);
+            m_Target[iL] = projection*rcLink.dSpringCoef + m_Damping[iL];
+        }
+    }, s_ciLinkChunk);
+}
+
+void CProjectiveDynamics::Gather()
+{
+    // right hand side per unknown, every task writes its own rows only
+    Eigen::MatrixXd &rRhs = m_pFactor->rhs;
+    CThreadPool::Instance().ParallelFor(0, (int)m_Free.size(), [this, &rRhs](int a_iBegin, int a_iEnd)
+    {
+        for(int iF = a_iBegin ; iF<a_iEnd ; iF++)
+        {
+            Vector3d sum = m_Inertia[iF];
+            for(int iK = m_IncidenceStart[iF] ; iK<m_IncidenceStart[iF+1] ; iK++)
+            {
+                sum += m_Target[m_Incidences[iK].iLink]*m_Incidences[iK].dSign;
+            }
+            rRhs(iF, 0) = sum.x;
+            rRhs(iF, 1) = sum.y;
+            rRhs(iF, 2) = sum.z;
+        }
+    }, s_ciNodeChunk);
+}
@@ -0,0 +1,97 @@
+#ifndef CPROJECTIVEDYNAMICS_H
+#define CPROJECTIVEDYNAMICS_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+
+/*
+ * Projective Dynamics for the springs of the net (Liu et al. 2013, Bouaziz
+ * et al. 2014). A step minimizes the implicit Euler energy by alternating a
+ * local step, every spring projected onto its rest length in parallel, and
+ * a global step solving
+ *     (M/h^2 + sum w L) x = M/h^2 y + sum A^T (k p + d/h (xa - xb))
+ * for the positions, w = k + d/h. The matrix only depends on the masses,
+ * the coefficients, h and the springs, so it is factored once with a sparse
+ * Cholesky (the bundled Eigen) and an iteration costs two triangular solves
+ * per axis. The dampers act implicitly on the whole relative velocity of
+ * their two particles. Fixed particles are not unknowns, their springs go to
+ * the right hand side. A torn spring stays in the factor until the next
+ * refactoring, its local step pulls with w (xa - xb) of the current iterate
+ * instead, which cancels its row terms over the iterations, so a tear does
+ * not stop the step for a factorization. The matrix is factored again with
+ * the torn springs at zero weight a few steps later, on the same pattern,
+ * and built anew only when the net compacts its springs.
+ */
+class CProjectiveDynamics
+{
+    public:
+        CProjectiveDynamics();
+        CProjectiveDynamics(const CProjectiveDynamics &a_rcProjectiveDynamics);    // the copy factors again
+        CProjectiveDynamics &operator=(const CProjectiveDynamics &a_rcProjectiveDynamics);
+        ~CProjectiveDynamics();
+
+        inline void SetIterationNum(const int a_ciIterationNum){ m_iIterationNum = (a_ciIterationNum > 1) ? a_ciIterationNum : 1; }
+        inline int GetIterationNum() const { return m_iIterationNum; }
+        inline void Invalidate(){ m_bDirty = true; }        // the spring or damper coefficients changed
+        inline int FactorizationNum() const { return m_iFactorizationNum; }
+        inline double GetSpringEnergy() const { return m_dSpringEnergy; }   // at the start of the last step
+
+        // moves the net by one step, the particles only carry the external forces;
+        // false leaves the net where it is because the system could not be factored
+        bool Step(GoalNet &a_rGoalNet, const double a_cdDeltaT);
+        void Reset();
+
+    private:
+        struct Link
+        {
+            int iStart;
+            int iEnd;
+            double dRestLength;
+            double dSpringCoef;
+            double dDamperCoef;
+            double dFactorWeight;           // w in the current factor, 0 once factored torn
+            bool bBroken;
+        };
+        struct Incidence
+        {
+            int iLink;
+            double dSign;                   // +1 at the start of the link, -1 at the end
+        };
+        struct Factor;                      // the Eigen side, kept out of the header
+
+        void Build(GoalNet &a_rGoalNet);
+        void Sync(GoalNet &a_rGoalNet);     // follows the torn springs of the net
+        bool Factorize(const double a_cdDeltaT);
+        void Project();
+        void Gather();
+        Vector3d Position(const int a_ciParticle) const;
+
+        int m_iIterationNum;
+        bool m_bDirty;
+        bool m_bFactored;
+        int m_iFactorizationNum;
+        double m_dDeltaT;                   // h the matrix was factored with
+        double m_dSpringEnergy;
+
+        int m_iParticleNum;                 // net the system was built for
+        int m_iSpringNum;
+        int m_iTopologyVersion;
+        int m_iLogSeen;                     // entries of the broken log already applied
+        int m_iLagStepNum;                  // steps with torn springs still in the factor
+        std::vector<Link> m_Links;
+        std::vector<double> m_Mass;         // of the unknowns
+        std::vector<int> m_FreeIndex;       // unknown of every particle, -1 for the fixed ones
+        std::vector<int> m_Free;            // particle of every unknown
+        std::vector<int> m_IncidenceStart;  // links around every unknown, one extra entry at the end
+        std::vector<Incidence> m_Incidences;
+
+        std::vector<Vector3d> m_Start;      // positions at the start of the step, all particles
+        std::vector<Vector3d> m_Inertia;    // M/h^2 y plus the pull of the fixed neighbors
+        std::vector<Vector3d> m_Damping;    // d/h (xa - xb) at the start of the step
+        std::vector<Vector3d> m_Target;     // k p + the damping, per link
+
+        Factor *m_pFactor;
+};
+
+#endif
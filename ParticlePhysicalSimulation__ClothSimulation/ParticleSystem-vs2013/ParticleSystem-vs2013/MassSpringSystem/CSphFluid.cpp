@@ -0,0 +1,601 @@
+#include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include "CSphFluid.h"
+#include "CThreadPool.h"
+#include "glut.h"
+
+namespace
+{
+    const double s_cdPi = 3.14159265358979323846;
+    const int s_ciMinChunk = 512;           // fluid particles per parallel task
+    const int s_ciMinSegmentChunk = 128;    // string pieces per parallel task
+    const double s_cdBallPsi = 4.0;         // boundary weight of a ball sample in fluid particle masses
+    const double s_cdColorSpeed = 6.0;      // speed at which the spray turns white
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CSphFluid::CSphFluid(const int a_ciCapacity)
+    :m_iCapacity(a_ciCapacity),
+    m_iNum(0),
+    m_dSmoothingRadius(0.1),
+    m_dSpacing(0.05),
+    m_dRestDensity(1000.0),
+    m_dParticleMass(0.0),
+    m_dStiffness(1000.0),
+    m_dViscosity(1.0),
+    m_dRestitution(0.1),
+    m_dFriction(2.0),
+    m_dPoly6(0.0),
+    m_dSpikyGrad(0.0),
+    m_dViscLaplacian(0.0),
+    m_Position(),
+    m_Velocity(),
+    m_Acceleration(),
+    m_Density(),
+    m_Pressure(),
+    m_SortScratch(),
+    m_Grid(),
+    m_SegmentGrid(),
+    m_NetPosition(),
+    m_NetVelocity(),
+    m_Segments(),
+    m_SegmentMid(),
+    m_SegmentReaction(),
+    m_BallPosition(),
+    m_BallVelocity(),
+    m_BallRadius(),
+    m_NetReaction(),
+    m_BallReaction(),
+    m_ChunkReaction(),
+    m_Color(0.2,0.45,0.9),
+    m_fPointSize(3.0f),
+    m_VertexBuffer(),
+    m_ColorBuffer()
+{
+    SetSmoothingRadius(m_dSmoothingRadius);
+}
+
+void CSphFluid::SetSmoothingRadius(const double a_cdRadius)
+{
+    const double cdH = a_cdRadius;
+    m_dSmoothingRadius = cdH;
+    m_dSpacing = 0.5*cdH;
+    m_dPoly6 = 315.0/(64.0*s_cdPi*pow(cdH,9));
+    m_dSpikyGrad = 45.0/(s_cdPi*pow(cdH,6));
+    m_dViscLaplacian = 45.0/(s_cdPi*pow(cdH,6));
+    UpdateParticleMass();
+}
+
+void CSphFluid::UpdateParticleMass()
+{
+    // density an inner particle of the rest lattice sees with unit mass
+    const double cdH2 = m_dSmoothingRadius*m_dSmoothingRadius;
+    double dSum = 0.0;
+    for(int iX = -2 ; iX<=2 ; iX++)
+    {
+        for(int iY = -2 ; iY<=2 ; iY++)
+        {
+            for(int iZ = -2 ; iZ<=2 ; iZ++)
+            {
+                double dR2 = (iX*iX + iY*iY + iZ*iZ)*m_dSpacing*m_dSpacing;
+                if(dR2 < cdH2)
+                {
+                    double dDiff = cdH2 - dR2;
+                    dSum += m_dPoly6*dDiff*dDiff*dDiff;
+                }
+            }
+        }
+    }
+    m_dParticleMass = m_dRestDensity/dSum;
+}
+
+int CSphFluid::AddBlock(const Vector3d &a_rcMin, const Vector3d &a_rcMax, const Vector3d &a_rcVelocity)
+{
+    int iNumX = (int)((a_rcMax.x - a_rcMin.x)/m_dSpacing) + 1;
+    int iNumY = (int)((a_rcMax.y - a_rcMin.y)/m_dSpacing) + 1;
+    int iNumZ = (int)((a_rcMax.z - a_rcMin.z)/m_dSpacing) + 1;
+
+    int iAdded = 0;
+    for(int iY = 0 ; iY<iNumY ; iY++)
+    {
+        for(int iX = 0 ; iX<iNumX ; iX++)
+        {
+            for(int iZ = 0 ; iZ<iNumZ ; iZ++)
+            {
+                if(m_iNum >= m_iCapacity)
+                {
+                    return iAdded;
+                }
+                if((int)m_Position.size() <= m_iNum)
+                {
+                    int iSize = (int)m_Position.size()*2 + 1024;
+                    iSize = (iSize < m_iCapacity) ? iSize : m_iCapacity;
+                    m_Position.resize(iSize);
+                    m_Velocity.resize(iSize);
+                    m_Acceleration.resize(iSize);
+                    m_Density.resize(iSize);
+                    m_Pressure.resize(iSize);
+                    m_SortScratch.resize(iSize);
+                }
+                m_Position[m_iNum] = a_rcMin + Vector3d(iX*m_dSpacing, iY*m_dSpacing, iZ*m_dSpacing);
+                m_Velocity[m_iNum] = a_rcVelocity;
+                ++m_iNum;
+                ++iAdded;
+            }
+        }
+    }
+    return iAdded;
+}
+
+void CSphFluid::Reset()
+{
+    m_iNum = 0;
+    m_NetReaction.clear();
+    m_BallReaction.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Update                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CSphFluid::Update(
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles,
+    GoalNet &a_rGoalNet,
+    vector<Ball> &a_rBalls
+    )
+{
+    m_NetReaction.clear();
+    m_BallReaction.clear();
+    if(m_iNum == 0)
+    {
+        return;
+    }
+
+    SortParticles();
+    SnapshotSolids(a_rGoalNet, a_rBalls);
+
+    CThreadPool &rPool = CThreadPool::Instance();
+    m_BallReaction.assign(m_BallPosition.size(), Vector3d::ZERO);
+
+    // the ball reactions are summed per fixed chunk of particles and the
+    // chunks in their order, the same sums whatever thread runs a chunk
+    const int ciBallNum = (int)m_BallPosition.size();
+    const int ciChunkNum = (m_iNum + s_ciMinChunk - 1)/s_ciMinChunk;
+
+    rPool.ParallelFor(0, m_iNum, [this](int a_iBegin, int a_iEnd)
+    {
+        ComputeDensity(a_iBegin, a_iEnd);
+    }, s_ciMinChunk);
+
+    m_ChunkReaction.assign(ciChunkNum*ciBallNum, Vector3d::ZERO);
+    rPool.ParallelFor(0, ciChunkNum, [&](int a_iBegin, int a_iEnd)
+    {
+        std::vector<Vector3d> ballReaction(ciBallNum);
+        for(int iC = a_iBegin ; iC<a_iEnd ; iC++)
+        {
+            const int ciEnd = ((iC + 1)*s_ciMinChunk < m_iNum) ? (iC + 1)*s_ciMinChunk : m_iNum;
+            ballReaction.assign(ciBallNum, Vector3d::ZERO);
+            ComputeAcceleration(iC*s_ciMinChunk, ciEnd, ballReaction);
+            std::copy(ballReaction.begin(), ballReaction.end(), m_ChunkReaction.begin() + iC*ciBallNum);
+        }
+    }, 1);
+    SumChunkReaction(ciChunkNum);
+
+    // the strings gather the same pair terms from the fluid before the fluid
+    // moves, the pieces then pass them on to the particles at their ends
+    m_SegmentReaction.resize(m_Segments.size()*2);
+    rPool.ParallelFor(0, (int)m_Segments.size(), [this](int a_iBegin, int a_iEnd)
+    {
+        ComputeSegmentReaction(a_iBegin, a_iEnd);
+    }, s_ciMinSegmentChunk);
+    m_NetReaction.assign(m_NetPosition.size(), Vector3d::ZERO);
+    for(size_t uiS = 0 ; uiS<m_Segments.size() ; uiS++)
+    {
+        m_NetReaction[m_Segments[uiS].iStart] += m_SegmentReaction[uiS*2];
+        m_NetReaction[m_Segments[uiS].iEnd]   += m_SegmentReaction[uiS*2+1];
+    }
+
+    m_ChunkReaction.assign(ciChunkNum*ciBallNum, Vector3d::ZERO);
+    rPool.ParallelFor(0, ciChunkNum, [&](int a_iBegin, int a_iEnd)
+    {
+        std::vector<Vector3d> ballReaction(ciBallNum);
+        for(int iC = a_iBegin ; iC<a_iEnd ; iC++)
+        {
+            const int ciEnd = ((iC + 1)*s_ciMinChunk < m_iNum) ? (iC + 1)*s_ciMinChunk : m_iNum;
+            ballReaction.assign(ciBallNum, Vector3d::ZERO);
+            Advance(iC*s_ciMinChunk, ciEnd, a_cdDeltaT, a_cdTime, a_rcForceFields, a_rcObstacles, ballReaction);
+            std::copy(ballReaction.begin(), ballReaction.end(), m_ChunkReaction.begin() + iC*ciBallNum);
+        }
+    }, 1);
+    SumChunkReaction(ciChunkNum);
+}
+
+void CSphFluid::SumChunkReaction(const int a_ciChunkNum)
+{
+    const size_t cuiBallNum = m_BallReaction.size();
+    for(int iC = 0 ; iC<a_ciChunkNum ; iC++)
+    {
+        for(size_t uiB = 0 ; uiB<cuiBallNum ; uiB++)
+        {
+            m_BallReaction[uiB] += m_ChunkReaction[iC*cuiBallNum + uiB];
+        }
+    }
+}
+
+void CSphFluid::ApplyCoupling(GoalNet &a_rGoalNet, vector<Ball> &a_rBalls) const
+{
+    int iNetNum = (int)m_NetReaction.size();
+    if(iNetNum > a_rGoalNet.ParticleNum())
+    {
+        iNetNum = a_rGoalNet.ParticleNum();
+    }
+    for(int iI = 0 ; iI<iNetNum ; iI++)
+    {
+        a_rGoalNet.GetParticle(iI).AddForce(m_NetReaction[iI]);
+    }
+
+    // balls thrown after the last fluid step have no reaction yet
+    size_t uiBallNum = (m_BallReaction.size() < a_rBalls.size()) ? m_BallReaction.size() : a_rBalls.size();
+    for(size_t uiI = 0 ; uiI<uiBallNum ; uiI++)
+    {
+        a_rBalls[uiI].AddForce(m_BallReaction[uiI]);
+    }
+}
+
+void CSphFluid::SortParticles()
+{
+    // reorder the particles cell by cell, the neighbors of a particle are
+    // then mostly next to it in memory
+    m_Grid.Build(m_Position, m_iNum, m_dSmoothingRadius);
+    const std::vector<int> &rcOrder = m_Grid.GetSortedIndex();
+
+    for(int iI = 0 ; iI<m_iNum ; iI++)
+    {
+        m_SortScratch[iI] = m_Position[rcOrder[iI]];
+    }
+    m_Position.swap(m_SortScratch);
+    for(int iI = 0 ; iI<m_iNum ; iI++)
+    {
+        m_SortScratch[iI] = m_Velocity[rcOrder[iI]];
+    }
+    m_Velocity.swap(m_SortScratch);
+
+    m_Grid.SetSorted();
+}
+
+void CSphFluid::SnapshotSolids(GoalNet &a_rGoalNet, vector<Ball> &a_rBalls)
+{
+    const int ciNetNum = a_rGoalNet.ParticleNum();
+    m_NetPosition.resize(ciNetNum);
+    m_NetVelocity.resize(ciNetNum);
+    for(int iI = 0 ; iI<ciNetNum ; iI++)
+    {
+        CParticle &rParticle = a_rGoalNet.GetParticle(iI);
+        m_NetPosition[iI] = rParticle.GetPosition();
+        m_NetVelocity[iI] = rParticle.GetVelocity();
+    }
+
+    // cut the strings into pieces no longer than h, a piece midpoint is then
+    // at most 1.5 h away from any fluid particle the piece touches
+    m_Segments.clear();
+    m_SegmentMid.clear();
+    for(int iS = 0 ; iS<a_rGoalNet.SpringNum() ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.GetSpringType() != CSpring::Type_nStruct || rSpring.IsBroken())
+        {
+            continue;
+        }
+        NetSegment segment;
+        segment.iStart = rSpring.GetSpringStartID();
+        segment.iEnd = rSpring.GetSpringEndID();
+        Vector3d start = m_NetPosition[segment.iStart];
+        Vector3d span = m_NetPosition[segment.iEnd] - start;
+        int iPieceNum = (int)ceil(span.Length()/m_dSmoothingRadius);
+        iPieceNum = (iPieceNum > 1) ? iPieceNum : 1;
+        for(int iP = 0 ; iP<iPieceNum ; iP++)
+        {
+            segment.dT0 = (double)iP/iPieceNum;
+            segment.dT1 = (double)(iP+1)/iPieceNum;
+            m_Segments.push_back(segment);
+            m_SegmentMid.push_back(start + span*(0.5*(segment.dT0 + segment.dT1)));
+        }
+    }
+    m_SegmentGrid.Build(m_SegmentMid, (int)m_SegmentMid.size(), 1.5*m_dSmoothingRadius);
+
+    m_BallPosition.resize(a_rBalls.size());
+    m_BallVelocity.resize(a_rBalls.size());
+    m_BallRadius.resize(a_rBalls.size());
+    for(size_t uiI = 0 ; uiI<a_rBalls.size() ; uiI++)
+    {
+        m_BallPosition[uiI] = a_rBalls[uiI].GetPosition();
+        m_BallVelocity[uiI] = a_rBalls[uiI].GetVelocity();
+        m_BallRadius[uiI] = a_rBalls[uiI].GetRadius();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Kernels                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CSphFluid::ComputeDensity(const int a_ciBegin, const int a_ciEnd)
+{
+    const double cdH2 = m_dSmoothingRadius*m_dSmoothingRadius;
+    const double cdMassPoly6 = m_dParticleMass*m_dPoly6;
+
+    for(int iI = a_ciBegin ; iI<a_ciEnd ; iI++)
+    {
+        const Vector3d &rcPos = m_Position[iI];
+        double dSum = 0.0;
+        auto accumulate = [&](const Vector3d &a_rcOther)
+        {
+            double dR2 = (rcPos - a_rcOther).SquaredLength();
+            if(dR2 < cdH2)
+            {
+                double dDiff = cdH2 - dR2;
+                dSum += dDiff*dDiff*dDiff;
+            }
+        };
+        m_Grid.ForEachCandidate(rcPos, [&](int a_iJ){ accumulate(m_Position[a_iJ]); });
+        m_SegmentGrid.ForEachCandidate(rcPos, [&](int a_iS)
+        {
+            Vector3d samplePos, sampleVel;
+            NearestSegmentSample(a_iS, rcPos, samplePos, sampleVel);
+            accumulate(samplePos);
+        });
+        double dDensity = cdMassPoly6*dSum;
+
+        for(size_t uiBall = 0 ; uiBall<m_BallPosition.size() ; uiBall++)
+        {
+            double dR2 = (rcPos - NearestBallSample((int)uiBall, rcPos)).SquaredLength();
+            if(dR2 < cdH2)
+            {
+                double dDiff = cdH2 - dR2;
+                dDensity += s_cdBallPsi*cdMassPoly6*dDiff*dDiff*dDiff;
+            }
+        }
+
+        // no negative pressure, a free surface must not pull the particles into clumps
+        m_Density[iI] = dDensity;
+        double dPressure = m_dStiffness*(dDensity - m_dRestDensity);
+        m_Pressure[iI] = (dPressure > 0.0) ? dPressure : 0.0;
+    }
+}
+
+void CSphFluid::ComputeAcceleration(const int a_ciBegin, const int a_ciEnd, std::vector<Vector3d> &a_rBallReaction)
+{
+    const double cdH = m_dSmoothingRadius;
+
+    for(int iI = a_ciBegin ; iI<a_ciEnd ; iI++)
+    {
+        const Vector3d &rcPos = m_Position[iI];
+        const Vector3d &rcVel = m_Velocity[iI];
+        const double cdDensity = m_Density[iI];
+        const double cdPressure = m_Pressure[iI];
+        Vector3d acc(0.0,0.0,0.0);
+
+        m_Grid.ForEachCandidate(rcPos, [&](int a_iJ)
+        {
+            Vector3d offset = rcPos - m_Position[a_iJ];
+            double dR2 = offset.SquaredLength();
+            if(a_iJ == iI || dR2 >= cdH*cdH || dR2 < 1e-18)
+            {
+                return;
+            }
+            double dR = sqrt(dR2);
+            double dDiff = cdH - dR;
+            double dInvDensity2 = 1.0/(cdDensity*m_Density[a_iJ]);
+            acc += offset*(m_dParticleMass*0.5*(cdPressure + m_Pressure[a_iJ])*dInvDensity2*m_dSpikyGrad*dDiff*dDiff/dR);
+            acc += (m_Velocity[a_iJ] - rcVel)*(m_dViscosity*m_dParticleMass*dInvDensity2*m_dViscLaplacian*dDiff);
+        });
+
+        m_SegmentGrid.ForEachCandidate(rcPos, [&](int a_iS)
+        {
+            Vector3d samplePos, sampleVel;
+            NearestSegmentSample(a_iS, rcPos, samplePos, sampleVel);
+            acc += BoundaryAcceleration(iI, samplePos, sampleVel, m_dParticleMass);
+        });
+
+        for(size_t uiBall = 0 ; uiBall<m_BallPosition.size() ; uiBall++)
+        {
+            Vector3d ballAcc = BoundaryAcceleration(iI, NearestBallSample((int)uiBall, rcPos), m_BallVelocity[uiBall], s_cdBallPsi*m_dParticleMass);
+            acc += ballAcc;
+            a_rBallReaction[uiBall] -= ballAcc*m_dParticleMass;
+        }
+
+        m_Acceleration[iI] = acc;
+    }
+}
+
+void CSphFluid::ComputeSegmentReaction(const int a_ciBegin, const int a_ciEnd)
+{
+    for(int iS = a_ciBegin ; iS<a_ciEnd ; iS++)
+    {
+        Vector3d startForce(0.0,0.0,0.0);
+        Vector3d endForce(0.0,0.0,0.0);
+        // fluid grid cells are h wide, two rings reach the 1.5 h around the midpoint
+        m_Grid.ForEachCandidate(m_SegmentMid[iS], [&](int a_iI)
+        {
+            Vector3d samplePos, sampleVel;
+            double dT = NearestSegmentSample(iS, m_Position[a_iI], samplePos, sampleVel);
+            Vector3d force = BoundaryAcceleration(a_iI, samplePos, sampleVel, m_dParticleMass)*(-m_dParticleMass);
+            startForce += force*(1.0 - dT);
+            endForce += force*dT;
+        }, 2);
+        m_SegmentReaction[iS*2] = startForce;
+        m_SegmentReaction[iS*2+1] = endForce;
+    }
+}
+
+Vector3d CSphFluid::BoundaryAcceleration(
+    const int a_ciFluid,
+    const Vector3d &a_rcSamplePos,
+    const Vector3d &a_rcSampleVel,
+    const double a_cdPsi
+    ) const
+{
+    const double cdH = m_dSmoothingRadius;
+    Vector3d offset = m_Position[a_ciFluid] - a_rcSamplePos;
+    double dR2 = offset.SquaredLength();
+    if(dR2 >= cdH*cdH || dR2 < 1e-18)
+    {
+        return Vector3d(0.0,0.0,0.0);
+    }
+    double dR = sqrt(dR2);
+    double dDiff = cdH - dR;
+    double dDensity = m_Density[a_ciFluid];
+
+    // the sample mirrors the fluid pressure, its density is taken as the rest density
+    Vector3d acc = offset*(a_cdPsi*m_Pressure[a_ciFluid]/(dDensity*dDensity)*m_dSpikyGrad*dDiff*dDiff/dR);
+    acc += (a_rcSampleVel - m_Velocity[a_ciFluid])*(m_dViscosity*a_cdPsi/(dDensity*m_dRestDensity)*m_dViscLaplacian*dDiff);
+    return acc;
+}
+
+double CSphFluid::NearestSegmentSample(
+    const int a_ciSegment,
+    const Vector3d &a_rcPosition,
+    Vector3d &a_rSamplePos,
+    Vector3d &a_rSampleVel
+    ) const
+{
+    const NetSegment &rcSegment = m_Segments[a_ciSegment];
+    const Vector3d &rcStart = m_NetPosition[rcSegment.iStart];
+    Vector3d span = m_NetPosition[rcSegment.iEnd] - rcStart;
+    double dLength2 = span.SquaredLength();
+    double dT = (dLength2 > 1e-18) ? (a_rcPosition - rcStart).DotProduct(span)/dLength2 : rcSegment.dT0;
+    dT = (dT < rcSegment.dT0) ? rcSegment.dT0 : ((dT > rcSegment.dT1) ? rcSegment.dT1 : dT);
+
+    a_rSamplePos = rcStart + span*dT;
+    a_rSampleVel = m_NetVelocity[rcSegment.iStart]*(1.0 - dT) + m_NetVelocity[rcSegment.iEnd]*dT;
+    return dT;
+}
+
+Vector3d CSphFluid::NearestBallSample(const int a_ciBall, const Vector3d &a_rcPosition) const
+{
+    Vector3d offset = a_rcPosition - m_BallPosition[a_ciBall];
+    double dDist = offset.Length();
+    if(dDist < 1e-9)
+    {
+        return m_BallPosition[a_ciBall] + Vector3d(0.0,m_BallRadius[a_ciBall],0.0);
+    }
+    return m_BallPosition[a_ciBall] + offset*(m_BallRadius[a_ciBall]/dDist);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Advance                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CSphFluid::Advance(
+    const int a_ciBegin,
+    const int a_ciEnd,
+    const double a_cdDeltaT,
+    const double a_cdTime,
+    const CForceFieldSet &a_rcForceFields,
+    const CObstacleField &a_rcObstacles,
+    std::vector<Vector3d> &a_rBallReaction
+    )
+{
+    ForceFieldBlock block;
+    for(int iStart = a_ciBegin ; iStart<a_ciEnd ; iStart += ForceFieldBlock::s_ciSize)
+    {
+        block.iCount = (a_ciEnd - iStart < ForceFieldBlock::s_ciSize) ? a_ciEnd - iStart : ForceFieldBlock::s_ciSize;
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            const Vector3d &rcPos = m_Position[iStart + iI];
+            const Vector3d &rcVel = m_Velocity[iStart + iI];
+            block.adPosX[iI] = rcPos.x; block.adPosY[iI] = rcPos.y; block.adPosZ[iI] = rcPos.z;
+            block.adVelX[iI] = rcVel.x; block.adVelY[iI] = rcVel.y; block.adVelZ[iI] = rcVel.z;
+            block.adMass[iI] = m_dParticleMass;
+        }
+
+        a_rcForceFields.Evaluate(block, a_cdTime);
+
+        for(int iI = 0 ; iI<block.iCount ; iI++)
+        {
+            int iIdx = iStart + iI;
+            Vector3d &rPos = m_Position[iIdx];
+            Vector3d &rVel = m_Velocity[iIdx];
+            Vector3d force(block.adForceX[iI], block.adForceY[iI], block.adForceZ[iI]);
+            force += m_Acceleration[iIdx]*m_dParticleMass;
+
+            a_rcObstacles.ResolveContact(rPos, 0.0, m_dRestitution, m_dFriction, rVel, force);
+
+            // semi-implicit Euler, the explicit order of the net is unstable for the stiff pressure
+            rVel += force*(a_cdDeltaT/m_dParticleMass);
+            rPos += rVel*a_cdDeltaT;
+
+            // the kernels only soften the balls, nothing may end up inside them
+            for(size_t uiBall = 0 ; uiBall<m_BallPosition.size() ; uiBall++)
+            {
+                Vector3d offset = rPos - m_BallPosition[uiBall];
+                double dRadius = m_BallRadius[uiBall];
+                double dDistSq = offset.SquaredLength();
+                if(dDistSq < dRadius*dRadius && dDistSq > 1e-12)
+                {
+                    Vector3d normal = offset/sqrt(dDistSq);
+                    rPos = m_BallPosition[uiBall] + normal*dRadius;
+                    double dNormalSpeed = (rVel - m_BallVelocity[uiBall]).DotProduct(normal);
+                    if(dNormalSpeed < 0.0)
+                    {
+                        rVel -= normal*dNormalSpeed;
+                        a_rBallReaction[uiBall] += normal*(dNormalSpeed*m_dParticleMass/a_cdDeltaT);
+                    }
+                }
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Draw                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CSphFluid::Draw()
+{
+    if(m_iNum == 0)
+    {
+        return;
+    }
+    if((int)m_VertexBuffer.size() < m_iNum*3)
+    {
+        m_VertexBuffer.resize(m_Position.size()*3);
+        m_ColorBuffer.resize(m_Position.size()*4);
+    }
+
+    // fast particles fade to white, the spray stands out from the body
+    CThreadPool::Instance().ParallelFor(0, m_iNum, [this](int a_iBegin, int a_iEnd)
+    {
+        for(int iI = a_iBegin ; iI<a_iEnd ; iI++)
+        {
+            const Vector3d &rcPos = m_Position[iI];
+            double dFoam = m_Velocity[iI].Length()/s_cdColorSpeed;
+            dFoam = (dFoam < 1.0) ? dFoam : 1.0;
+            m_VertexBuffer[iI*3]   = (float)rcPos.x;
+            m_VertexBuffer[iI*3+1] = (float)rcPos.y;
+            m_VertexBuffer[iI*3+2] = (float)rcPos.z;
+            m_ColorBuffer[iI*4]    = (float)(m_Color.x + (1.0 - m_Color.x)*dFoam);
+            m_ColorBuffer[iI*4+1]  = (float)(m_Color.y + (1.0 - m_Color.y)*dFoam);
+            m_ColorBuffer[iI*4+2]  = (float)(m_Color.z + (1.0 - m_Color.z)*dFoam);
+            m_ColorBuffer[iI*4+3]  = 0.8f;
+        }
+    }, s_ciMinChunk*8);
+
+    glPushAttrib(GL_ENABLE_BIT | GL_POINT_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+        glDisable(GL_LIGHTING);
+        glDisable(GL_TEXTURE_2D);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glPointSize(m_fPointSize);
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(3, GL_FLOAT, 0, &m_VertexBuffer[0]);
+        glColorPointer(4, GL_FLOAT, 0, &m_ColorBuffer[0]);
+        glDrawArrays(GL_POINTS, 0, m_iNum);
+    glPopClientAttrib();
+    glPopAttrib();
+}
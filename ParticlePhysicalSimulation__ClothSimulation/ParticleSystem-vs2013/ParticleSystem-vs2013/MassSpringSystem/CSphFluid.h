@@ -0,0 +1,148 @@
+#ifndef CSPHFLUID_H
+#define CSPHFLUID_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "CNeighborGrid.h"
+#include "CForceField.h"
+#include "CObstacleField.h"
+#include "GoalNetModel.h"
+#include "BallModel.h"
+
+/*
+ * Smoothed particle hydrodynamics fluid (Mueller et al. 2003: poly6 density,
+ * spiky pressure gradient, viscosity laplacian) on a hashed cell list.
+ *
+ * The strings of the net (its structural springs, cut into pieces no longer
+ * than h) and the balls act as boundary samples (Akinci et al. 2012): the
+ * nearest point of a string or of a ball surface adds to the fluid density
+ * and pushes the fluid with its own pressure. Every pair force is evaluated
+ * once from the fluid side and once, with the opposite sign, from the solid
+ * side, both passes only gather, so no thread writes into another particle.
+ * The reactions are handed to the net particles at the string ends and to
+ * the balls with the next ComputeAllForce(), one step late.
+ */
+class CSphFluid
+{
+    public:
+        explicit CSphFluid(const int a_ciCapacity = 200000);
+
+        void SetSmoothingRadius(const double a_cdRadius);     // also sets the particle spacing to half of it
+        inline void SetRestDensity(const double a_cdDensity){ m_dRestDensity = a_cdDensity; UpdateParticleMass(); }
+        inline void SetStiffness(const double a_cdStiffness){ m_dStiffness = a_cdStiffness; }
+        inline void SetViscosity(const double a_cdViscosity){ m_dViscosity = a_cdViscosity; }
+        inline void SetRestitution(const double a_cdRestitution){ m_dRestitution = a_cdRestitution; }
+        inline void SetFriction(const double a_cdFriction){ m_dFriction = a_cdFriction; }
+        inline void SetCapacity(const int a_ciCapacity){ m_iCapacity = (a_ciCapacity > 0) ? a_ciCapacity : 0; }
+        inline void SetColor(const Vector3d &a_rcColor){ m_Color = a_rcColor; }
+        inline void SetPointSize(const float a_cfPointSize){ m_fPointSize = a_cfPointSize; }
+
+        inline int ParticleNum() const { return m_iNum; }
+        inline double GetSmoothingRadius() const { return m_dSmoothingRadius; }
+        inline double GetParticleMass() const { return m_dParticleMass; }
+
+        // fills the box with particles on a grid of the rest spacing, returns how many fit
+        int AddBlock(const Vector3d &a_rcMin, const Vector3d &a_rcMax, const Vector3d &a_rcVelocity);
+        void Reset();
+
+        void Update(
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles,
+            GoalNet &a_rGoalNet,
+            vector<Ball> &a_rBalls
+            );
+        // adds the reactions of the last Update() to the net and the balls
+        void ApplyCoupling(GoalNet &a_rGoalNet, vector<Ball> &a_rBalls) const;
+
+        void Draw();
+
+    private:
+        struct NetSegment
+        {
+            int iStart;                     // net particles at the ends of the spring
+            int iEnd;
+            double dT0;                     // piece of the spring, 0 at the start particle
+            double dT1;
+        };
+
+        void UpdateParticleMass();
+        void SortParticles();
+        void SnapshotSolids(GoalNet &a_rGoalNet, vector<Ball> &a_rBalls);
+
+        void ComputeDensity(const int a_ciBegin, const int a_ciEnd);
+        void ComputeAcceleration(const int a_ciBegin, const int a_ciEnd, std::vector<Vector3d> &a_rBallReaction);
+        void ComputeSegmentReaction(const int a_ciBegin, const int a_ciEnd);
+        void SumChunkReaction(const int a_ciChunkNum);     // into the ball reactions, in chunk order
+        void Advance(
+            const int a_ciBegin,
+            const int a_ciEnd,
+            const double a_cdDeltaT,
+            const double a_cdTime,
+            const CForceFieldSet &a_rcForceFields,
+            const CObstacleField &a_rcObstacles,
+            std::vector<Vector3d> &a_rBallReaction
+            );
+
+        // pair terms shared by the fluid side and the solid side
+        Vector3d BoundaryAcceleration(
+            const int a_ciFluid,
+            const Vector3d &a_rcSamplePos,
+            const Vector3d &a_rcSampleVel,
+            const double a_cdPsi
+            ) const;
+        double NearestSegmentSample(
+            const int a_ciSegment,
+            const Vector3d &a_rcPosition,
+            Vector3d &a_rSamplePos,
+            Vector3d &a_rSampleVel
+            ) const;                        // returns the spring parameter of the sample
+        Vector3d NearestBallSample(const int a_ciBall, const Vector3d &a_rcPosition) const;
+
+        int m_iCapacity;
+        int m_iNum;
+
+        double m_dSmoothingRadius;          // h, the kernel support
+        double m_dSpacing;                  // rest distance of the particles
+        double m_dRestDensity;
+        double m_dParticleMass;             // calibrated so the rest lattice has the rest density
+        double m_dStiffness;                // p = k (rho - rho0)
+        double m_dViscosity;
+        double m_dRestitution;
+        double m_dFriction;
+
+        double m_dPoly6;                    // kernel constants of the current h
+        double m_dSpikyGrad;
+        double m_dViscLaplacian;
+
+        std::vector<Vector3d> m_Position;
+        std::vector<Vector3d> m_Velocity;
+        std::vector<Vector3d> m_Acceleration;
+        std::vector<double> m_Density;
+        std::vector<double> m_Pressure;
+        std::vector<Vector3d> m_SortScratch;
+
+        CNeighborGrid m_Grid;               // fluid particles
+        CNeighborGrid m_SegmentGrid;        // midpoints of the string pieces
+
+        std::vector<Vector3d> m_NetPosition;    // solid snapshot of the current step
+        std::vector<Vector3d> m_NetVelocity;
+        std::vector<NetSegment> m_Segments;
+        std::vector<Vector3d> m_SegmentMid;
+        std::vector<Vector3d> m_SegmentReaction;    // two per piece, start and end particle
+        std::vector<Vector3d> m_BallPosition;
+        std::vector<Vector3d> m_BallVelocity;
+        std::vector<double> m_BallRadius;
+
+        std::vector<Vector3d> m_NetReaction;    // forces for the next solid step
+        std::vector<Vector3d> m_BallReaction;
+        std::vector<Vector3d> m_ChunkReaction;  // ball reactions of every chunk of particles, chunk major
+
+        Vector3d m_Color;
+        float m_fPointSize;
+        std::vector<float> m_VertexBuffer;
+        std::vector<float> m_ColorBuffer;
+};
+
+#endif
@@ -13,7 +13,8 @@ CSpring::CSpring(const int a_ciSpringStartID,
     m_dSpringCoef(a_cdSpringCoef),
     m_dDamperCoef(a_cdDamperCoef),
     m_Color(a_rcColor),
-    m_nType(a_cType)
+    m_nType(a_cType),
+    m_bBroken(false)
 {
 }
 
@@ -24,7 +25,8 @@ CSpring::CSpring(const CSpring &a_rcSpring)
     m_dSpringCoef(a_rcSpring.m_dSpringCoef),
     m_dDamperCoef(a_rcSpring.m_dDamperCoef),
     m_Color(a_rcSpring.m_Color),
-    m_nType(a_rcSpring.m_nType)
+    m_nType(a_rcSpring.m_nType),
+    m_bBroken(a_rcSpring.m_bBroken)
 {
 }
 
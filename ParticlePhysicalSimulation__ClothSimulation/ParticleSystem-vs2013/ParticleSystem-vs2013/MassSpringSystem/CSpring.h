@@ -21,6 +21,7 @@ class CSpring
         double m_dDamperCoef;
         Vector3d m_Color;
         enType_t m_nType;
+        bool m_bBroken;                 // torn, kept in place until the net compacts its springs
         
     public:
         CSpring(
@@ -36,13 +37,16 @@ class CSpring
         ~CSpring();
         inline void SetSpringCoef(const double a_cdSpringCoef){m_dSpringCoef = a_cdSpringCoef;}
         inline void SetDamperCoef(const double a_cdDamperCoef){m_dDamperCoef = a_cdDamperCoef;}
-        inline int      GetSpringStartID()   {return m_iSpringStartID;}
-        inline int      GetSpringEndID()     {return m_iSpringEndID;}
+        inline void SetSpringIDs(const int a_ciStartID, const int a_ciEndID){m_iSpringStartID = a_ciStartID; m_iSpringEndID = a_ciEndID;}
+        inline int      GetSpringStartID() const {return m_iSpringStartID;}
+        inline int      GetSpringEndID() const   {return m_iSpringEndID;}
         inline double   GetSpringRestLength(){return m_dRestLength;}
         inline double   GetSpringCoef()      {return m_dSpringCoef;}
         inline double   GetDamperCoef()      {return m_dDamperCoef;}
         inline Vector3d GetSpringColor()     {return m_Color;}
         inline enType_t GetSpringType()      {return m_nType;}
+        inline bool     IsBroken() const     {return m_bBroken;}
+        inline void     Break()              {m_bBroken = true;}
 
 };
 
@@ -0,0 +1,612 @@
+#include <stdlib.h>
+#include <cmath>
+#include <atomic>
+#include "CStrainLimiter.h"
+#include "CThreadPool.h"
+
+namespace
+{
+    const int s_ciMinChunk = 256;           // springs or particles per parallel task
+    const double s_cdDefaultSpectralRadius = 0.9;
+
+    // how far a link is past its longest length, along the normal from start to end
+    inline bool Excess(const Vector3d &a_rcStart, const Vector3d &a_rcEnd, const double a_cdMaxLength, Vector3d &a_rNormal, double &a_rdExcess)
+    {
+        Vector3d offset = a_rcEnd - a_rcStart;
+        double dLength = offset.Length();
+        if(dLength <= a_cdMaxLength || dLength < 1e-12)
+        {
+            return false;
+        }
+        a_rNormal = offset/dLength;
+        a_rdExcess = dLength - a_cdMaxLength;
+        return true;
+    }
+
+    inline double InverseMass(CParticle &a_rParticle)
+    {
+        return a_rParticle.IsMovable() ? 1.0/a_rParticle.GetMass() : 0.0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CStrainLimiter::CStrainLimiter()
+    :m_dMaxStrain(0.0),
+    m_iIterationNum(4),
+    m_nSolver(Solver_nGaussSeidel),
+    m_dSpectralRadius(s_cdDefaultSpectralRadius),
+    m_iParticleNum(0),
+    m_iTopologyVersion(0),
+    m_iLogSeen(0),
+    m_Links(),
+    m_ColorStart(1, 0),
+    m_ColorEnd(),
+    m_LinkOf(),
+    m_ParticleStart(),
+    m_ParticleSpring()
+{
+}
+
+void CStrainLimiter::Reset()
+{
+    m_iParticleNum = 0;
+    m_iTopologyVersion = 0;
+    m_iLogSeen = 0;
+    m_Links.clear();
+    m_ColorStart.assign(1, 0);
+    m_ColorEnd.clear();
+    m_LinkOf.clear();
+    m_ParticleStart.clear();
+    m_ParticleSpring.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Coloring                                  //
+////////////////////////////////////////////////////////////////////////////////
+void CStrainLimiter::Build(GoalNet &a_rGoalNet)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciSpringNum = a_rGoalNet.SpringNum();
+    m_iParticleNum = ciParticleNum;
+    m_iTopologyVersion = a_rGoalNet.GetTopologyVersion();
+    m_iLogSeen = (int)a_rGoalNet.GetBrokenLog().size();
+
+    // intact springs around every particle, counting sort by particle
+    std::vector<int> particleStart(ciParticleNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        ++particleStart[rSpring.GetSpringStartID()+1];
+        ++particleStart[rSpring.GetSpringEndID()+1];
+    }
+    for(int iP = 0 ; iP<ciParticleNum ; iP++)
+    {
+        particleStart[iP+1] += particleStart[iP];
+    }
+    std::vector<int> particleSpring(particleStart[ciParticleNum]);
+    std::vector<int> cursor(particleStart.begin(), particleStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        particleSpring[cursor[rSpring.GetSpringStartID()]++] = iS;
+        particleSpring[cursor[rSpring.GetSpringEndID()]++] = iS;
+    }
+
+    // greedy: the smallest color none of the springs sharing a particle has yet
+    std::vector<int> springColor(ciSpringNum, -1);
+    std::vector<int> colorStamp;            // last spring that saw the color taken
+    int iColorNum = 0;
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        if(rSpring.IsBroken())
+        {
+            continue;
+        }
+        const int aciEnd[2] = { rSpring.GetSpringStartID(), rSpring.GetSpringEndID() };
+        for(int iE = 0 ; iE<2 ; iE++)
+        {
+            for(int iK = particleStart[aciEnd[iE]] ; iK<particleStart[aciEnd[iE]+1] ; iK++)
+            {
+                int iColor = springColor[particleSpring[iK]];
+                if(iColor >= 0)
+                {
+                    colorStamp[iColor] = iS;
+                }
+            }
+        }
+        int iColor = 0;
+        while(iColor < iColorNum && colorStamp[iColor] == iS)
+        {
+            ++iColor;
+        }
+        if(iColor == iColorNum)
+        {
+            colorStamp.push_back(-1);
+            ++iColorNum;
+        }
+        springColor[iS] = iColor;
+    }
+
+    // links grouped by color, in spring order inside a color
+    m_ColorStart.assign(iColorNum + 1, 0);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        if(springColor[iS] >= 0)
+        {
+            ++m_ColorStart[springColor[iS]+1];
+        }
+    }
+    for(int iC = 0 ; iC<iColorNum ; iC++)
+    {
+        m_ColorStart[iC+1] += m_ColorStart[iC];
+    }
+    m_Links.resize(m_ColorStart[iColorNum]);
+    m_LinkOf.assign(ciSpringNum, -1);
+    cursor.assign(m_ColorStart.begin(), m_ColorStart.end() - 1);
+    for(int iS = 0 ; iS<ciSpringNum ; iS++)
+    {
+        if(springColor[iS] < 0)
+        {
+            continue;
+        }
+        CSpring &rSpring = a_rGoalNet.GetSpring(iS);
+        int iL = cursor[springColor[iS]]++;
+        Link &rLink = m_Links[iL];
+        rLink.iStart = rSpring.GetSpringStartID();
+        rLink.iEnd = rSpring.GetSpringEndID();
+        rLink.dRestLength = rSpring.GetSpringRestLength();
+        rLink.iSpring = iS;
+        rLink.iColor = springColor[iS];
+        m_LinkOf[iS] = iL;
+    }
+    m_ColorEnd = cursor;
+    BuildIncidence();
+}
+
+void CStrainLimiter::BuildIncidence()
+{
+    // counting sort of the intact links by their particles, keyed by spring so a tear needs no update
+    m_ParticleStart.assign(m_iParticleNum + 1, 0);
+    for(int iC = 0 ; iC<ColorNum() ; iC++)
+    {
+        for(int iL = m_ColorStart[iC] ; iL<m_ColorEnd[iC] ; iL++)
+        {
+            ++m_ParticleStart[m_Links[iL].iStart+1];
+            ++m_ParticleStart[m_Links[iL].iEnd+1];
+        }
+    }
+    for(int iP = 0 ; iP<m_iParticleNum ; iP++)
+    {
+        m_ParticleStart[iP+1] += m_ParticleStart[iP];
+    }
+    m_ParticleSpring.resize(m_ParticleStart[m_iParticleNum]);
+    std::vector<int> cursor(m_ParticleStart.begin(), m_ParticleStart.end() - 1);
+    for(int iC = 0 ; iC<ColorNum() ; iC++)
+    {
+        for(int iL = m_ColorStart[iC] ; iL<m_ColorEnd[iC] ; iL++)
+        {
+            m_ParticleSpring[cursor[m_Links[iL].iStart]++] = m_Links[iL].iSpring;
+            m_ParticleSpring[cursor[m_Links[iL].iEnd]++] = m_Links[iL].iSpring;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                  Tearing                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CStrainLimiter::Sync(GoalNet &a_rGoalNet)
+{
+    const int ciVersion = a_rGoalNet.GetTopologyVersion();
+    if(m_iParticleNum != a_rGoalNet.ParticleNum() || ciVersion != m_iTopologyVersion)
+    {
+        // one compaction since the last step can be followed, anything else is colored anew
+        if(m_iParticleNum != a_rGoalNet.ParticleNum() || ciVersion != m_iTopologyVersion + 1 || a_rGoalNet.GetCompactionMap().empty())
+        {
+            Build(a_rGoalNet);
+            return;
+        }
+        Remap(a_rGoalNet.GetCompactionMap());
+        m_iTopologyVersion = ciVersion;
+        m_iLogSeen = 0;
+    }
+
+    const std::vector<int> &rcLog = a_rGoalNet.GetBrokenLog();
+    for( ; m_iLogSeen<(int)rcLog.size() ; m_iLogSeen++)
+    {
+        Remove(rcLog[m_iLogSeen]);
+    }
+}
+
+void CStrainLimiter::Remove(const int a_ciSpring)
+{
+    int iL = m_LinkOf[a_ciSpring];
+    if(iL < 0)
+    {
+        return;
+    }
+    // the last intact link of the color fills the hole, the color stays independent
+    int iLast = --m_ColorEnd[m_Links[iL].iColor];
+    if(iLast != iL)
+    {
+        m_Links[iL] = m_Links[iLast];
+        m_LinkOf[m_Links[iL].iSpring] = iL;
+    }
+    m_LinkOf[a_ciSpring] = -1;
+}
+
+void CStrainLimiter::Remap(const std::vector<int> &a_rcCompactionMap)
+{
+    int iSpringNum = 0;
+    for(unsigned int uiI = 0 ; uiI<a_rcCompactionMap.size() ; uiI++)
+    {
+        if(a_rcCompactionMap[uiI] >= 0)
+        {
+            ++iSpringNum;
+        }
+    }
+    // springs torn since the last step and compacted right away go with the rest
+    m_LinkOf.assign(iSpringNum, -1);
+    for(int iC = 0 ; iC<ColorNum() ; iC++)
+    {
+        int iEnd = m_ColorStart[iC];
+        for(int iL = m_ColorStart[iC] ; iL<m_ColorEnd[iC] ; iL++)
+        {
+            int iSpring = a_rcCompactionMap[m_Links[iL].iSpring];
+            if(iSpring < 0)
+            {
+                continue;
+            }
+            m_Links[iEnd] = m_Links[iL];
+            m_Links[iEnd].iSpring = iSpring;
+            m_LinkOf[iSpring] = iEnd++;
+        }
+        m_ColorEnd[iC] = iEnd;
+    }
+    BuildIncidence();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Apply                                    //
+////////////////////////////////////////////////////////////////////////////////
+int CStrainLimiter::Apply(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles)
+{
+    if(!IsEnable())
+    {
+        return 0;
+    }
+    Sync(a_rGoalNet);
+    if(m_nSolver == Solver_nJacobi)
+    {
+        return SolveJacobi(a_rGoalNet, a_rcObstacles);
+    }
+
+    int iOverNum = 0;
+    for(int iIter = 0 ; iIter<m_iIterationNum ; iIter++)
+    {
+        iOverNum = 0;
+        for(int iC = 0 ; iC<ColorNum() ; iC++)
+        {
+            iOverNum += Sweep(a_rGoalNet, iC);
+        }
+        iOverNum += SweepContact(a_rGoalNet, a_rcObstacles);
+        if(iOverNum == 0)
+        {
+            break;
+        }
+    }
+    return iOverNum;
+}
+
+int CStrainLimiter::Sweep(GoalNet &a_rGoalNet, const int a_ciColor)
+{
+    const double cdStretch = 1.0 + m_dMaxStrain;
+    std::atomic<int> overNum(0);
+
+    // the links of one color share no particle, so no two tasks touch the same one
+    CThreadPool::Instance().ParallelFor(m_ColorStart[a_ciColor], m_ColorEnd[a_ciColor], [&](int a_iBegin, int a_iEnd)
+    {
+        int iOverNum = 0;
+        for(int iL = a_iBegin ; iL<a_iEnd ; iL++)
+        {
+            const Link &rcLink = m_Links[iL];
+            CParticle &rStart = a_rGoalNet.GetParticle(rcLink.iStart);
+            CParticle &rEnd = a_rGoalNet.GetParticle(rcLink.iEnd);
+
+            Vector3d normal;
+            double dExcess;
+            if(!Excess(rStart.GetPosition(), rEnd.GetPosition(), rcLink.dRestLength*cdStretch, normal, dExcess))
+            {
+                continue;
+            }
+            double dInvMassStart = InverseMass(rStart);
+            double dInvMassEnd = InverseMass(rEnd);
+            double dInvMassSum = dInvMassStart + dInvMassEnd;
+            if(dInvMassSum <= 0.0)
+            {
+                continue;
+            }
+            ++iOverNum;
+
+            Vector3d shift = normal*(dExcess/dInvMassSum);
+            rStart.AddPosition(shift*dInvMassStart);
+            rEnd.AddPosition(shift*(-dInvMassEnd));
+
+            // drop the stretching part of the relative velocity, keep the momentum
+            double dStretchSpeed = (rEnd.GetVelocity() - rStart.GetVelocity()).DotProduct(normal);
+            if(dStretchSpeed > 0.0)
+            {
+                Vector3d impulse = normal*(dStretchSpeed/dInvMassSum);
+                rStart.AddVelocity(impulse*dInvMassStart);
+                rEnd.AddVelocity(impulse*(-dInvMassEnd));
+            }
+        }
+        overNum += iOverNum;
+    }, s_ciMinChunk);
+
+    return overNum;
+}
+
+int CStrainLimiter::SweepContact(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles)
+{
+    std::atomic<int> contactNum(0);
+
+    // one contact per particle, no two tasks touch the same one
+    CThreadPool::Instance().ParallelFor(0, a_rGoalNet.ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        int iContactNum = 0;
+        for(int iP = a_iBegin ; iP<a_iEnd ; iP++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+            double dDistance;
+            Vector3d normal;
+            if(!rParticle.IsMovable() || !a_rcObstacles.Sample(rParticle.GetPosition(), dDistance, normal) || dDistance >= 0.0)
+            {
+                continue;
+            }
+            ++iContactNum;
+            rParticle.AddPosition(normal*(-dDistance));
+            double dNormalSpeed = rParticle.GetVelocity().DotProduct(normal);
+            if(dNormalSpeed < 0.0)
+            {
+                rParticle.AddVelocity(normal*(-dNormalSpeed));
+            }
+        }
+        contactNum += iContactNum;
+    }, s_ciMinChunk);
+
+    return contactNum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Jacobi                                   //
+////////////////////////////////////////////////////////////////////////////////
+int CStrainLimiter::SolveJacobi(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles)
+{
+    const int ciParticleNum = a_rGoalNet.ParticleNum();
+    const int ciLinkNum = (int)m_Links.size();
+    m_LinkShift.resize(ciLinkNum);
+    m_LinkOver.assign(ciLinkNum, 0);
+    m_LinkActive.assign(ciLinkNum, 0);
+    m_Previous.resize(ciParticleNum);
+    m_ContactNormal.resize(ciParticleNum);
+    m_ContactDepth.resize(ciParticleNum);
+    m_ContactOver.assign(ciParticleNum, 0);
+    m_ContactActive.assign(ciParticleNum, 0);
+
+    // Chebyshev weights: 1, 2/(2 - r^2), then 4/(4 - r^2 w) of the last one
+    const double cdRadiusSq = m_dSpectralRadius*m_dSpectralRadius;
+    double dOmega = 1.0;
+    int iOverNum = 0;
+    for(int iIter = 0 ; iIter<m_iIterationNum ; iIter++)
+    {
+        iOverNum = ProjectLinks(a_rGoalNet) + ProjectContacts(a_rGoalNet, a_rcObstacles);
+        if(iOverNum == 0)
+        {
+            break;
+        }
+        if(iIter == 1)
+        {
+            dOmega = 2.0/(2.0 - cdRadiusSq);
+        }
+        else if(iIter > 1)
+        {
+            dOmega = 4.0/(4.0 - cdRadiusSq*dOmega);
+        }
+        GatherShifts(a_rGoalNet, dOmega);
+    }
+    GatherImpulses(a_rGoalNet);
+    return iOverNum;
+}
+
+int CStrainLimiter::ProjectLinks(GoalNet &a_rGoalNet)
+{
+    const double cdStretch = 1.0 + m_dMaxStrain;
+    std::atomic<int> overNum(0);
+
+    // every link writes its own slots only, the positions are only read
+    CThreadPool::Instance().ParallelFor(0, (int)m_Links.size(), [&](int a_iBegin, int a_iEnd)
+    {
+        int iOverNum = 0;
+        for(int iL = a_iBegin ; iL<a_iEnd ; iL++)
+        {
+            const Link &rcLink = m_Links[iL];
+            m_LinkOver[iL] = 0;
+            if(iL >= m_ColorEnd[rcLink.iColor])
+            {
+                continue;                   // past the intact links of its color, torn
+            }
+            CParticle &rStart = a_rGoalNet.GetParticle(rcLink.iStart);
+            CParticle &rEnd = a_rGoalNet.GetParticle(rcLink.iEnd);
+            Vector3d normal;
+            double dExcess;
+            if(!Excess(rStart.GetPosition(), rEnd.GetPosition(), rcLink.dRestLength*cdStretch, normal, dExcess))
+            {
+                continue;
+            }
+            double dInvMassSum = InverseMass(rStart) + InverseMass(rEnd);
+            if(dInvMassSum <= 0.0)
+            {
+                continue;
+            }
+            ++iOverNum;
+            m_LinkShift[iL] = normal*(dExcess/dInvMassSum);
+            m_LinkOver[iL] = 1;
+            m_LinkActive[iL] = 1;
+        }
+        overNum += iOverNum;
+    }, s_ciMinChunk);
+
+    return overNum;
+}
+
+int CStrainLimiter::ProjectContacts(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles)
+{
+    std::atomic<int> contactNum(0);
+
+    CThreadPool::Instance().ParallelFor(0, a_rGoalNet.ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        int iContactNum = 0;
+        for(int iP = a_iBegin ; iP<a_iEnd ; iP++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+            double dDistance;
+            m_ContactOver[iP] = 0;
+            if(!rParticle.IsMovable() || !a_rcObstacles.Sample(rParticle.GetPosition(), dDistance, m_ContactNormal[iP]) || dDistance >= 0.0)
+            {
+                continue;
+            }
+            ++iContactNum;
+            m_ContactDepth[iP] = -dDistance;
+            m_ContactOver[iP] = 1;
+            m_ContactActive[iP] = 1;
+        }
+        contactNum += iContactNum;
+    }, s_ciMinChunk);
+
+    return contactNum;
+}
+
+void CStrainLimiter::GatherShifts(GoalNet &a_rGoalNet, const double a_cdOmega)
+{
+    // every particle averages the corrections it is part of and moves itself only
+    CThreadPool::Instance().ParallelFor(0, a_rGoalNet.ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iP = a_iBegin ; iP<a_iEnd ; iP++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+            if(!rParticle.IsMovable())
+            {
+                continue;
+            }
+            const double cdInvMass = InverseMass(rParticle);
+            Vector3d sum(0.0, 0.0, 0.0);
+            int iNum = 0;
+            for(int iK = m_ParticleStart[iP] ; iK<m_ParticleStart[iP+1] ; iK++)
+            {
+                const int ciL = m_LinkOf[m_ParticleSpring[iK]];
+                if(ciL < 0 || !m_LinkOver[ciL])
+                {
+                    continue;
+                }
+                sum += (m_Links[ciL].iStart == iP) ? m_LinkShift[ciL]*cdInvMass : m_LinkShift[ciL]*(-cdInvMass);
+                ++iNum;
+            }
+            if(m_ContactOver[iP])
+            {
+                sum += m_ContactNormal[iP]*m_ContactDepth[iP];
+                ++iNum;
+            }
+
+            const Vector3d cPosition = rParticle.GetPosition();
+            Vector3d next = (iNum > 0) ? cPosition + sum/(double)iNum : cPosition;
+            if(a_cdOmega != 1.0)
+            {
+                next = m_Previous[iP] + (next - m_Previous[iP])*a_cdOmega;
+            }
+            m_Previous[iP] = cPosition;
+            rParticle.SetPosition(next);
+        }
+    }, s_ciMinChunk);
+}
+
+void CStrainLimiter::GatherImpulses(GoalNet &a_rGoalNet)
+{
+    // the stretching part of the relative velocity of every link that hit its limit, from the old velocities
+    CThreadPool::Instance().ParallelFor(0, (int)m_Links.size(), [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iL = a_iBegin ; iL<a_iEnd ; iL++)
+        {
+            const Link &rcLink = m_Links[iL];
+            m_LinkOver[iL] = 0;
+            if(!m_LinkActive[iL] || iL >= m_ColorEnd[rcLink.iColor])
+            {
+                continue;
+            }
+            CParticle &rStart = a_rGoalNet.GetParticle(rcLink.iStart);
+            CParticle &rEnd = a_rGoalNet.GetParticle(rcLink.iEnd);
+            Vector3d normal = rEnd.GetPosition() - rStart.GetPosition();
+            double dLength = normal.Length();
+            double dInvMassSum = InverseMass(rStart) + InverseMass(rEnd);
+            if(dLength < 1e-12 || dInvMassSum <= 0.0)
+            {
+                continue;
+            }
+            normal /= dLength;
+            double dStretchSpeed = (rEnd.GetVelocity() - rStart.GetVelocity()).DotProduct(normal);
+            if(dStretchSpeed > 0.0)
+            {
+                m_LinkShift[iL] = normal*(dStretchSpeed/dInvMassSum);
+                m_LinkOver[iL] = 1;
+            }
+        }
+    }, s_ciMinChunk);
+
+    CThreadPool::Instance().ParallelFor(0, a_rGoalNet.ParticleNum(), [&](int a_iBegin, int a_iEnd)
+    {
+        for(int iP = a_iBegin ; iP<a_iEnd ; iP++)
+        {
+            CParticle &rParticle = a_rGoalNet.GetParticle(iP);
+            if(!rParticle.IsMovable())
+            {
+                continue;
+            }
+            const double cdInvMass = InverseMass(rParticle);
+            Vector3d sum(0.0, 0.0, 0.0);
+            int iNum = 0;
+            for(int iK = m_ParticleStart[iP] ; iK<m_ParticleStart[iP+1] ; iK++)
+            {
+                const int ciL = m_LinkOf[m_ParticleSpring[iK]];
+                if(ciL < 0 || !m_LinkOver[ciL])
+                {
+                    continue;
+                }
+                sum += (m_Links[ciL].iStart == iP) ? m_LinkShift[ciL]*cdInvMass : m_LinkShift[ciL]*(-cdInvMass);
+                ++iNum;
+            }
+            if(m_ContactActive[iP])
+            {
+                double dNormalSpeed = rParticle.GetVelocity().DotProduct(m_ContactNormal[iP]);
+                if(dNormalSpeed < 0.0)
+                {
+                    sum += m_ContactNormal[iP]*(-dNormalSpeed);
+                    ++iNum;
+                }
+            }
+            if(iNum > 0)
+            {
+                rParticle.AddVelocity(sum/(double)iNum);
+            }
+        }
+    }, s_ciMinChunk);
+}
@@ -0,0 +1,110 @@
+#ifndef CSTRAINLIMITER_H
+#define CSTRAINLIMITER_H
+
+#include <vector>
+#include "Vector3d.h"
+#include "GoalNetModel.h"
+#include "CObstacleField.h"
+
+/*
+ * Provot style strain limiting (Provot 1995): after the integration every
+ * spring stretched beyond its rest length times (1 + max strain) pulls its
+ * two particles back to that length, weighted by the inverse masses, and
+ * loses the part of the relative velocity that stretches it further. The
+ * springs are greedily colored once so that no two springs of a color
+ * share a particle, the springs of one color are then corrected in
+ * parallel and the colors one after the other, a few sweeps per step.
+ * A torn spring is taken out of its color by moving the last link of the
+ * color into its place, and a compaction of the net springs only renumbers
+ * the links, so tearing never colors the net again.
+ *
+ * The obstacles are contact constraints of the same solve: a particle that
+ * ended up inside one is moved out along the normal and loses the velocity
+ * into it, after the colors of every sweep.
+ *
+ * The Jacobi solver has no order at all. Every link and every contact reads
+ * the positions of the last iteration and leaves its correction in a buffer
+ * of its own, every particle then averages the corrections it is part of,
+ * so both passes are parallel over the whole net. The plain average
+ * converges slower than the sweeps, the Chebyshev semi-iterative method
+ * (Wang 2015) extrapolates the iterates with weights from the spectral
+ * radius of the plain iteration and gets close to the sweeps again. The
+ * velocities are corrected once after the last iteration, for the links and
+ * the contacts that were active in any of them.
+ */
+class CStrainLimiter
+{
+    public:
+        typedef enum
+        {
+            Solver_nGaussSeidel = 0,
+            Solver_nJacobi
+        } enSolver_t;
+
+        CStrainLimiter();
+
+        inline void SetMaxStrain(const double a_cdMaxStrain){ m_dMaxStrain = (a_cdMaxStrain > 0.0) ? a_cdMaxStrain : 0.0; }
+        inline void SetIterationNum(const int a_ciIterationNum){ m_iIterationNum = (a_ciIterationNum > 0) ? a_ciIterationNum : 0; }
+        inline double GetMaxStrain() const { return m_dMaxStrain; }
+        inline int GetIterationNum() const { return m_iIterationNum; }
+        inline bool IsEnable() const { return m_dMaxStrain > 0.0 && m_iIterationNum > 0; }
+        inline void SetSolver(const enSolver_t a_cnSolver){ m_nSolver = a_cnSolver; }
+        inline enSolver_t GetSolver() const { return m_nSolver; }
+        inline void SetSpectralRadius(const double a_cdRadius){ m_dSpectralRadius = (a_cdRadius > 0.0) ? ((a_cdRadius < 1.0) ? a_cdRadius : 0.999) : 0.0; }   // 0 turns Chebyshev off
+        inline double GetSpectralRadius() const { return m_dSpectralRadius; }
+        inline int ColorNum() const { return (int)m_ColorStart.size() - 1; }
+
+        void Build(GoalNet &a_rGoalNet);    // colors the intact springs of the net
+        // returns the springs over the limit and the particles inside an obstacle before the last sweep
+        int Apply(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles);
+        void Reset();
+
+    private:
+        struct Link
+        {
+            int iStart;
+            int iEnd;
+            double dRestLength;
+            int iSpring;
+            int iColor;
+        };
+
+        void Sync(GoalNet &a_rGoalNet);     // follows the torn springs of the net
+        void Remove(const int a_ciSpring);
+        void Remap(const std::vector<int> &a_rcCompactionMap);
+        void BuildIncidence();              // springs around every particle
+        int Sweep(GoalNet &a_rGoalNet, const int a_ciColor);
+        int SweepContact(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles);
+        int SolveJacobi(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles);
+        int ProjectLinks(GoalNet &a_rGoalNet);      // corrections from the current positions
+        int ProjectContacts(GoalNet &a_rGoalNet, const CObstacleField &a_rcObstacles);
+        void GatherShifts(GoalNet &a_rGoalNet, const double a_cdOmega);
+        void GatherImpulses(GoalNet &a_rGoalNet);
+
+        double m_dMaxStrain;                // 0.1 allows 10% over the rest length
+        int m_iIterationNum;
+        enSolver_t m_nSolver;
+        double m_dSpectralRadius;           // of the plain Jacobi iteration, drives the Chebyshev weights
+
+        int m_iParticleNum;                 // net the coloring was built for
+        int m_iTopologyVersion;
+        int m_iLogSeen;                     // entries of the broken log already removed
+        std::vector<Link> m_Links;          // springs grouped by color
+        std::vector<int> m_ColorStart;      // first link of every color, one extra entry at the end
+        std::vector<int> m_ColorEnd;        // past the last intact link of every color
+        std::vector<int> m_LinkOf;          // link of every spring, -1 for a torn one
+        std::vector<int> m_ParticleStart;   // springs around every particle, one extra entry at the end
+        std::vector<int> m_ParticleSpring;
+
+        // Jacobi buffers
+        std::vector<Vector3d> m_LinkShift;  // correction of every link, times the inverse mass at each end
+        std::vector<char> m_LinkOver;       // over the limit in this iteration
+        std::vector<char> m_LinkActive;     // over the limit in any iteration of the step
+        std::vector<Vector3d> m_Previous;   // iterate before the last one, for the extrapolation
+        std::vector<Vector3d> m_ContactNormal;
+        std::vector<double> m_ContactDepth;
+        std::vector<char> m_ContactOver;    // inside an obstacle in this iteration
+        std::vector<char> m_ContactActive;  // in any iteration of the step
+};
+
+#endif
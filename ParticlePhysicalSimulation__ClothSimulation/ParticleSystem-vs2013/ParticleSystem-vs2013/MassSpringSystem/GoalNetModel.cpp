@@ -1,9 +1,24 @@
 #include "GoalNetModel.h"
 #include <iostream>
+#include <algorithm>
+#include "CThreadPool.h"
 #include "configFile.h"
 
 const double g_cdK = 2500.0f;
 const double g_cdD = 50.0f;
+const int g_ciMinLatticeChunk = 64;     // particles per parallel task of the lattice forces
+const int g_ciMortonBits = 10;          // per axis, 30 bits of Morton code
+
+// the low ten bits of a_uiValue moved two bits apart, to interleave three axes
+static unsigned int SpreadBits(unsigned int a_uiValue)
+{
+    a_uiValue &= 0x000003ff;
+    a_uiValue = (a_uiValue | (a_uiValue << 16)) & 0xff0000ff;
+    a_uiValue = (a_uiValue | (a_uiValue << 8)) & 0x0300f00f;
+    a_uiValue = (a_uiValue | (a_uiValue << 4)) & 0x030c30c3;
+    a_uiValue = (a_uiValue | (a_uiValue << 2)) & 0x09249249;
+    return a_uiValue;
+}
 
 GoalNet::GoalNet()
 :m_InitPos(Vector3d(0.0, 0.6, 0.0)),
@@ -24,7 +39,13 @@ m_dDamperCoefShear(g_cdD),
 m_dDamperCoefBending(g_cdD),
 m_ColorStruct(Vector3d(0.8,0.8,0.8)),
 m_ColorShear(Vector3d(0.0,0.0,0.0)),
-m_ColorBending(Vector3d(0.0,0.0,0.0))
+m_ColorBending(Vector3d(0.0,0.0,0.0)),
+m_dSpringEnergy(0.0),
+m_ChunkEnergy(),
+m_iBrokenNum(0),
+m_iTopologyVersion(0),
+m_Lattice(),
+m_bLatticeForce(true)
 {
     Initialize();
 }
@@ -37,9 +58,6 @@ m_NetLength(a_rcGoalNet.m_NetLength),
 m_NumAtWidth(a_rcGoalNet.m_NumAtWidth),
 m_NumAtHeight(a_rcGoalNet.m_NumAtHeight),
 m_NumAtLength(a_rcGoalNet.m_NumAtLength),
-m_Particles(a_rcGoalNet.m_Particles),
-m_Springs(a_rcGoalNet.m_Springs),
-m_ParticleIdMap(a_rcGoalNet.m_ParticleIdMap),
 m_dSpringCoefStruct(a_rcGoalNet.m_dSpringCoefStruct),
 m_dSpringCoefShear(a_rcGoalNet.m_dSpringCoefShear),
 m_dSpringCoefBending(a_rcGoalNet.m_dSpringCoefBending),
@@ -48,7 +66,13 @@ m_dDamperCoefShear(a_rcGoalNet.m_dDamperCoefShear),
 m_dDamperCoefBending(a_rcGoalNet.m_dDamperCoefBending),
 m_ColorStruct(a_rcGoalNet.m_ColorStruct),
 m_ColorShear(a_rcGoalNet.m_ColorShear),
-m_ColorBending(a_rcGoalNet.m_ColorBending)
+m_ColorBending(a_rcGoalNet.m_ColorBending),
+m_dSpringEnergy(0.0),
+m_ChunkEnergy(),
+m_iBrokenNum(0),
+m_iTopologyVersion(0),
+m_Lattice(),
+m_bLatticeForce(a_rcGoalNet.m_bLatticeForce)
 {
     Initialize();
 }
@@ -56,7 +80,13 @@ m_ColorBending(a_rcGoalNet.m_ColorBending)
 GoalNet::GoalNet(const std::string &a_rcsConfigFilename)
 :m_ColorStruct(Vector3d(0.8, 0.8, 0.8)),
 m_ColorShear(Vector3d(0.8, 0.8, 0.8)),
-m_ColorBending(Vector3d(0.8, 0.8, 0.8))
+m_ColorBending(Vector3d(0.8, 0.8, 0.8)),
+m_dSpringEnergy(0.0),
+m_ChunkEnergy(),
+m_iBrokenNum(0),
+m_iTopologyVersion(0),
+m_Lattice(),
+m_bLatticeForce(true)
 {
     ConfigFile configFile;
     configFile.suppressWarnings(1);
@@ -71,10 +101,6 @@ m_ColorBending(Vector3d(0.8, 0.8, 0.8))
     configFile.addOption("NumAtHeight", &m_NumAtHeight);
     configFile.addOption("NumAtLength", &m_NumAtLength);
     configFile.addOption("SpringCoef", &m_dSpringCoefStruct);
-    configFile.addOption("SpringCoef", &m_dSpringCoefShear);
-    configFile.addOption("SpringCoef", &m_dSpringCoefBending);
-    configFile.addOption("DamperCoef", &m_dDamperCoefStruct);
-    configFile.addOption("DamperCoef", &m_dDamperCoefStruct);
     configFile.addOption("DamperCoef", &m_dDamperCoefStruct);
 
     int code = configFile.parseOptions((char *)a_rcsConfigFilename.c_str());
@@ -84,6 +110,11 @@ m_ColorBending(Vector3d(0.8, 0.8, 0.8))
         system("pause");
         exit(0);
     }
+    // an option binds one variable only, the three types use the same coefficient
+    m_dSpringCoefShear   = m_dSpringCoefStruct;
+    m_dSpringCoefBending = m_dSpringCoefStruct;
+    m_dDamperCoefShear   = m_dDamperCoefStruct;
+    m_dDamperCoefBending = m_dDamperCoefStruct;
 
     Initialize();
 }
@@ -166,6 +197,48 @@ Vector3d GoalNet::GetInitPos() const
     return m_InitPos;
 }
 
+void GoalNet::GetTriangles(vector<int> &a_rTriangles)
+{
+    a_rTriangles.clear();
+    int aiCell[4][3];
+    for (int iFace = 0; iFace < 4; ++iFace)
+    {
+        // back face, roof, and the two sides
+        int iNumU = (iFace == 0) ? m_NumAtHeight : m_NumAtWidth;
+        int iNumV = (iFace == 2 || iFace == 3) ? m_NumAtHeight : m_NumAtLength;
+        for (int u = 0; u + 1 < iNumU; ++u)
+        {
+            for (int v = 0; v + 1 < iNumV; ++v)
+            {
+                for (int iC = 0; iC < 4; ++iC)
+                {
+                    int cu = u + ((iC == 1 || iC == 2) ? 1 : 0);
+                    int cv = v + ((iC >= 2) ? 1 : 0);
+                    if (iFace == 0)
+                    {
+                        aiCell[iC][0] = 0;  aiCell[iC][1] = cu;  aiCell[iC][2] = cv;
+                    }
+                    else if (iFace == 1)
+                    {
+                        aiCell[iC][0] = cu;  aiCell[iC][1] = m_NumAtHeight - 1;  aiCell[iC][2] = cv;
+                    }
+                    else
+                    {
+                        aiCell[iC][0] = cu;  aiCell[iC][1] = cv;  aiCell[iC][2] = (iFace == 2) ? 0 : m_NumAtLength - 1;
+                    }
+                }
+                int aiID[4];
+                for (int iC = 0; iC < 4; ++iC)
+                {
+                    aiID[iC] = GetParticleID(aiCell[iC][0], aiCell[iC][1], aiCell[iC][2]);
+                }
+                a_rTriangles.push_back(aiID[0]);  a_rTriangles.push_back(aiID[1]);  a_rTriangles.push_back(aiID[2]);
+                a_rTriangles.push_back(aiID[0]);  a_rTriangles.push_back(aiID[2]);  a_rTriangles.push_back(aiID[3]);
+            }
+        }
+    }
+}
+
 void GoalNet::SetSpringCoef(
     const double a_cdSpringCoef,
     const CSpring::enType_t a_cSpringType
@@ -175,16 +248,19 @@ void GoalNet::SetSpringCoef(
     {
         m_dSpringCoefStruct = a_cdSpringCoef;
         UpdateSpringCoef(a_cdSpringCoef, CSpring::Type_nStruct);
+        m_Lattice.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nStruct);
     }
     else if (a_cSpringType == CSpring::Type_nShear)
     {
         m_dSpringCoefShear = a_cdSpringCoef;
         UpdateSpringCoef(a_cdSpringCoef, CSpring::Type_nShear);
+        m_Lattice.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nShear);
     }
     else if (a_cSpringType == CSpring::Type_nBending)
     {
         m_dSpringCoefBending = a_cdSpringCoef;
         UpdateSpringCoef(a_cdSpringCoef, CSpring::Type_nBending);
+        m_Lattice.SetSpringCoef(a_cdSpringCoef, CSpring::Type_nBending);
     }
 }
 
@@ -197,16 +273,19 @@ void GoalNet::SetDamperCoef(
     {
         m_dDamperCoefStruct = a_cdDamperCoef;
         UpdateDamperCoef(a_cdDamperCoef, CSpring::Type_nStruct);
+        m_Lattice.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nStruct);
     }
     else if (a_cSpringType == CSpring::Type_nShear)
     {
         m_dDamperCoefShear = a_cdDamperCoef;
         UpdateDamperCoef(a_cdDamperCoef, CSpring::Type_nShear);
+        m_Lattice.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nShear);
     }
     else if (a_cSpringType == CSpring::Type_nBending)
     {
         m_dDamperCoefBending = a_cdDamperCoef;
         UpdateDamperCoef(a_cdDamperCoef, CSpring::Type_nBending);
+        m_Lattice.SetDamperCoef(a_cdDamperCoef, CSpring::Type_nBending);
     }
 }
 
@@ -239,6 +318,18 @@ void GoalNet::Reset()
             }
         }
     }
+    if (m_iBrokenNum > 0 || !m_CompactionMap.empty())
+    {
+        // the rest lengths come from the positions, which are the initial ones again
+        m_Springs.clear();
+        InitializeSpring();
+        SortSprings();
+        m_BrokenLog.clear();
+        m_CompactionMap.clear();
+        m_iBrokenNum = 0;
+        ++m_iTopologyVersion;
+        m_AdjacencyStart.clear();
+    }
 }
 
 void GoalNet::AddForceField(const Vector3d &a_kForce)
@@ -254,8 +345,40 @@ void GoalNet::ComputeInternalForce()
     //TO DO    
 	//int numAtBack = m_NumAtHeight * m_NumAtLength;
 	
+    m_dSpringEnergy = 0.0;
+    if (IsLatticeForce())
+    {
+        // every particle gathers its own springs, nothing is written twice; the
+        // energy of every fixed chunk is summed in chunk order, the same on every run
+        const int ciParticleNum = (int)m_Particles.size();
+        const int ciChunkNum = (ciParticleNum + g_ciMinLatticeChunk - 1)/g_ciMinLatticeChunk;
+        m_ChunkEnergy.assign(ciChunkNum, 0.0);
+        CThreadPool::Instance().ParallelFor(0, ciChunkNum, [&](int a_iBegin, int a_iEnd)
+        {
+            for (int iC = a_iBegin; iC < a_iEnd; ++iC)
+            {
+                const int ciEnd = ((iC + 1)*g_ciMinLatticeChunk < ciParticleNum) ? (iC + 1)*g_ciMinLatticeChunk : ciParticleNum;
+                double dEnergy = 0.0;
+                for (int iP = iC*g_ciMinLatticeChunk; iP < ciEnd; ++iP)
+                {
+                    CParticle &rParticle = m_Particles[iP];
+                    rParticle.AddForce(m_Lattice.Gather(*this, iP, rParticle.GetPosition(), rParticle.GetVelocity(), dEnergy));
+                }
+                m_ChunkEnergy[iC] = dEnergy;
+            }
+        }, 1);
+        for (int iC = 0; iC < ciChunkNum; ++iC)
+        {
+            m_dSpringEnergy += m_ChunkEnergy[iC];
+        }
+        return;
+    }
 	for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
     {
+        if (m_Springs[uiI].IsBroken())
+        {
+            continue;
+        }
 		int start = m_Springs[uiI].GetSpringStartID();
 		int end = m_Springs[uiI].GetSpringEndID();
 		CParticle p1 = m_Particles[start];
@@ -264,6 +387,11 @@ void GoalNet::ComputeInternalForce()
 		double dcoef = m_Springs[uiI].GetDamperCoef();
 		double restlength = m_Springs[uiI].GetSpringRestLength();
 		Vector3d f = ComputeSpringForce(p1.GetPosition(),p2.GetPosition(),scoef,restlength);
+        // |f| = k*|stretch|, so the stored energy k*stretch^2/2 needs no extra sqrt
+        if (scoef > 0.0)
+        {
+            m_dSpringEnergy += f.SquaredLength()/(2.0*scoef);
+        }
 		p1.AddForce(f);
 		p2.AddForce((-1)*f);
 		f = ComputeDamperForce(p1.GetPosition(),p2.GetPosition(),p1.GetVelocity(),p2.GetVelocity(),dcoef);
@@ -275,6 +403,84 @@ void GoalNet::ComputeInternalForce()
 	
 }
 
+bool GoalNet::BreakSpring(const int a_ciSpring)
+{
+    if (m_Springs[a_ciSpring].IsBroken())
+    {
+        return false;
+    }
+    m_Springs[a_ciSpring].Break();
+    m_BrokenLog.push_back(a_ciSpring);
+    ++m_iBrokenNum;
+    return true;
+}
+
+int GoalNet::Tear(const double a_cdMaxStrain)
+{
+    int iTornNum = 0;
+    double dFactor = (1.0 + a_cdMaxStrain)*(1.0 + a_cdMaxStrain);
+    for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
+    {
+        CSpring &rSpring = m_Springs[uiI];
+        if (rSpring.IsBroken())
+        {
+            continue;
+        }
+        double dRest = rSpring.GetSpringRestLength();
+        Vector3d offset = m_Particles[rSpring.GetSpringStartID()].GetPosition() - m_Particles[rSpring.GetSpringEndID()].GetPosition();
+        if (offset.SquaredLength() > dFactor*dRest*dRest)
+        {
+            BreakSpring(uiI);
+            ++iTornNum;
+        }
+    }
+    return iTornNum;
+}
+
+void GoalNet::CompactSprings()
+{
+    if (m_iBrokenNum == 0)
+    {
+        return;
+    }
+    m_CompactionMap.assign(m_Springs.size(), -1);
+    int iLive = 0;
+    for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
+    {
+        if (!m_Springs[uiI].IsBroken())
+        {
+            if (iLive != (int)uiI)
+            {
+                m_Springs[iLive] = m_Springs[uiI];
+            }
+            m_CompactionMap[uiI] = iLive++;
+        }
+    }
+    m_Springs.erase(m_Springs.begin() + iLive, m_Springs.end());
+    m_BrokenLog.clear();
+    m_iBrokenNum = 0;
+    ++m_iTopologyVersion;
+    m_AdjacencyStart.clear();
+}
+
+int GoalNet::FindSpring(const int a_ciParticleA, const int a_ciParticleB)
+{
+    if (m_AdjacencyStart.empty())
+    {
+        BuildAdjacency();
+    }
+    for (int iI = m_AdjacencyStart[a_ciParticleA]; iI < m_AdjacencyStart[a_ciParticleA + 1]; ++iI)
+    {
+        int iSpring = m_AdjacencySpring[iI];
+        CSpring &rSpring = m_Springs[iSpring];
+        if (!rSpring.IsBroken() && (rSpring.GetSpringStartID() == a_ciParticleB || rSpring.GetSpringEndID() == a_ciParticleB))
+        {
+            return iSpring;
+        }
+    }
+    return -1;
+}
+
 /*
  * private function
  */
@@ -282,6 +488,8 @@ void GoalNet::Initialize()
 {
     InitializeParticle();
     InitializeSpring();
+    ReorderParticles();
+    m_Lattice.Build(*this);
 }
 
 void GoalNet::InitializeParticle()
@@ -647,6 +855,109 @@ void GoalNet::InitializeSpring()
 	}
 }
 
+/*
+ * The construction order walks the whole cuboid and keeps the faces, so the
+ * two ends of a spring across a seam, or across rows of the back face, are
+ * far apart in the array. Sorting the particles along a Morton curve keeps
+ * neighbors in space near in memory for every loop that gathers over the
+ * springs. The grid id map follows the particles, so GetParticleID() still
+ * finds them, and the springs get the new ids and are sorted by them.
+ */
+void GoalNet::ReorderParticles()
+{
+    int iParticleNum = (int)m_Particles.size();
+    if (iParticleNum < 2)
+    {
+        return;
+    }
+    Vector3d minPos = m_Particles[0].GetPosition();
+    Vector3d maxPos = minPos;
+    for (int iP = 1; iP < iParticleNum; ++iP)
+    {
+        Vector3d pos = m_Particles[iP].GetPosition();
+        for (int iA = 0; iA < 3; ++iA)
+        {
+            minPos[iA] = (pos[iA] < minPos[iA]) ? pos[iA] : minPos[iA];
+            maxPos[iA] = (pos[iA] > maxPos[iA]) ? pos[iA] : maxPos[iA];
+        }
+    }
+    // one scale for all axes, the curve should not stretch the long side of the net
+    double dExtent = 0.0;
+    for (int iA = 0; iA < 3; ++iA)
+    {
+        dExtent = (maxPos[iA] - minPos[iA] > dExtent) ? maxPos[iA] - minPos[iA] : dExtent;
+    }
+    double dScale = (dExtent > 0.0) ? ((1 << g_ciMortonBits) - 1) / dExtent : 0.0;
+
+    vector< pair<unsigned int, int> > order(iParticleNum);
+    for (int iP = 0; iP < iParticleNum; ++iP)
+    {
+        Vector3d cell = (m_Particles[iP].GetPosition() - minPos) * dScale;
+        order[iP].first = (SpreadBits((unsigned int)(cell.x + 0.5)) << 2)
+            | (SpreadBits((unsigned int)(cell.y + 0.5)) << 1)
+            | SpreadBits((unsigned int)(cell.z + 0.5));
+        order[iP].second = iP;      // ties keep the construction order
+    }
+    sort(order.begin(), order.end());
+
+    vector<int> newId(iParticleNum);
+    vector<CParticle> particles;
+    particles.reserve(iParticleNum);
+    for (int iP = 0; iP < iParticleNum; ++iP)
+    {
+        newId[order[iP].second] = iP;
+        particles.push_back(m_Particles[order[iP].second]);
+    }
+    m_Particles.swap(particles);
+    for (map<int, int>::iterator it = m_ParticleIdMap.begin(); it != m_ParticleIdMap.end(); ++it)
+    {
+        it->second = newId[it->second];
+    }
+    for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
+    {
+        CSpring &rSpring = m_Springs[uiI];
+        rSpring.SetSpringIDs(newId[rSpring.GetSpringStartID()], newId[rSpring.GetSpringEndID()]);
+    }
+    SortSprings();
+    m_AdjacencyStart.clear();
+}
+
+static bool SpringLess(const CSpring &a_rcA, const CSpring &a_rcB)
+{
+    if (a_rcA.GetSpringStartID() != a_rcB.GetSpringStartID())
+    {
+        return a_rcA.GetSpringStartID() < a_rcB.GetSpringStartID();
+    }
+    return a_rcA.GetSpringEndID() < a_rcB.GetSpringEndID();
+}
+
+void GoalNet::SortSprings()
+{
+    stable_sort(m_Springs.begin(), m_Springs.end(), SpringLess);
+    m_AdjacencyStart.clear();
+}
+
+void GoalNet::BuildAdjacency()
+{
+    int iParticleNum = (int)m_Particles.size();
+    m_AdjacencyStart.assign(iParticleNum + 1, 0);
+    for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
+    {
+        ++m_AdjacencyStart[m_Springs[uiI].GetSpringStartID() + 1];
+        ++m_AdjacencyStart[m_Springs[uiI].GetSpringEndID() + 1];
+    }
+    for (int iP = 0; iP < iParticleNum; ++iP)
+    {
+        m_AdjacencyStart[iP + 1] += m_AdjacencyStart[iP];
+    }
+    m_AdjacencySpring.resize(m_AdjacencyStart[iParticleNum]);
+    vector<int> fill(m_AdjacencyStart.begin(), m_AdjacencyStart.end() - 1);
+    for (unsigned int uiI = 0; uiI < m_Springs.size(); uiI++)
+    {
+        m_AdjacencySpring[fill[m_Springs[uiI].GetSpringStartID()]++] = uiI;
+        m_AdjacencySpring[fill[m_Springs[uiI].GetSpringEndID()]++] = uiI;
+    }
+}
 
 Vector3d GoalNet::ComputeSpringForce(
     const Vector3d &a_crPos1,
@@ -686,15 +997,7 @@ void GoalNet::UpdateSpringCoef(
     {
         if (m_Springs[uiI].GetSpringType() == a_cSpringType)
         {
-            m_Springs[uiI].SetSpringCoef(m_dSpringCoefStruct);
-        }
-        else if (m_Springs[uiI].GetSpringType() == a_cSpringType)
-        {
-            m_Springs[uiI].SetSpringCoef(m_dSpringCoefShear);
-        }
-        else if (m_Springs[uiI].GetSpringType() == a_cSpringType)
-        {
-            m_Springs[uiI].SetSpringCoef(m_dSpringCoefBending);
+            m_Springs[uiI].SetSpringCoef(a_cdSpringCoef);
         }
     }
 
@@ -709,15 +1012,7 @@ void GoalNet::UpdateDamperCoef(
     {
         if (m_Springs[uiI].GetSpringType() == a_cSpringType)
         {
-            m_Springs[uiI].SetDamperCoef(m_dDamperCoefStruct);
-        }
-        else if (m_Springs[uiI].GetSpringType() == a_cSpringType)
-        {
-            m_Springs[uiI].SetDamperCoef(m_dDamperCoefShear);
-        }
-        else if (m_Springs[uiI].GetSpringType() == a_cSpringType)
-        {
-            m_Springs[uiI].SetDamperCoef(m_dDamperCoefBending);
+            m_Springs[uiI].SetDamperCoef(a_cdDamperCoef);
         }
     }
 }
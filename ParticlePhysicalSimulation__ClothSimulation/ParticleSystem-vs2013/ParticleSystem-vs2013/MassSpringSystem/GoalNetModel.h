@@ -5,6 +5,7 @@
 #include <map>
 #include "CParticle.h"
 #include "CSpring.h"
+#include "CLatticeForce.h"
 using namespace std;
 
 class GoalNet
@@ -12,7 +13,7 @@ class GoalNet
 public:
 
     GoalNet();
-    GoalNet(const GoalNet &a_rcGoalNet);
+    GoalNet(const GoalNet &a_rcGoalNet);     // the settings and coefficients, built at rest
     GoalNet(const std::string &a_rcsConfigFilename);
     ~GoalNet();
 
@@ -34,6 +35,7 @@ public:
         int zId
         );
     Vector3d GetInitPos() const;
+    void GetTriangles(vector<int> &a_rTriangles);   // the grid cells of the four faces split in two, three particles each
 
     void SetSpringCoef(
         const double a_cdSpringCoef,
@@ -44,9 +46,39 @@ public:
         const CSpring::enType_t a_cSpringType
         );
 
+    /*
+     * Tearing. A spring breaks in place, it stays in the array flagged until
+     * CompactSprings() squeezes the broken ones out, so breaking is O(1) and
+     * the spring ids stay valid in between. Every break is appended to the
+     * log, and every change of the ids (a compaction, or Reset() growing the
+     * torn springs back) bumps the topology version. A solver that keeps its
+     * own structure over the springs remembers the version and how much of
+     * the log it has seen, patches itself for the new entries, and after a
+     * single compaction remaps its spring ids with the compaction map
+     * (old id to new id, -1 for a removed spring) instead of building anew.
+     */
+    bool BreakSpring(const int a_ciSpring);         // false if it was broken already
+    int Tear(const double a_cdMaxStrain);           // breaks the springs stretched further, returns how many
+    void CompactSprings();
+    int FindSpring(const int a_ciParticleA, const int a_ciParticleB);  // an intact spring between the two, -1 if none
+    inline int BrokenSpringNum() const { return m_iBrokenNum; }
+    inline int GetTopologyVersion() const { return m_iTopologyVersion; }
+    inline const vector<int>& GetBrokenLog() const { return m_BrokenLog; }            // since the last version change
+    inline const vector<int>& GetCompactionMap() const { return m_CompactionMap; }    // of the last version change, empty after a reset
+
     void Reset();
     void AddForceField(const Vector3d &a_kForce);    //add gravity
     void ComputeInternalForce();
+    inline double GetSpringEnergy() const { return m_dSpringEnergy; }   // of the last ComputeInternalForce()
+
+    /*
+     * The springs of the four faces follow from the grid, so as long as none
+     * is torn the forces are gathered from the lattice stencils instead of
+     * the spring list, see CLatticeForce.
+     */
+    inline void SetLatticeForce(const bool a_cbLattice){ m_bLatticeForce = a_cbLattice; }
+    inline bool IsLatticeForce() const { return m_bLatticeForce && m_Lattice.IsBuilt() && m_iBrokenNum == 0 && m_CompactionMap.empty(); }
+    inline const CLatticeForce& GetLattice() const { return m_Lattice; }
 
 
 private:
@@ -54,6 +86,9 @@ private:
     void Initialize();
     void InitializeParticle();
     void InitializeSpring();
+    void ReorderParticles();    // along a Morton curve of the rest positions, once after the springs are made
+    void SortSprings();         // by first end, then by second end
+    void BuildAdjacency();
 
     Vector3d ComputeSpringForce(
         const Vector3d &a_crPos1,
@@ -115,6 +150,19 @@ private:
     Vector3d m_ColorStruct;     
     Vector3d m_ColorShear;
     Vector3d m_ColorBending;
+
+    double m_dSpringEnergy;
+    vector<double> m_ChunkEnergy;       // of every chunk of the lattice forces, summed in chunk order
+
+    int m_iBrokenNum;                   // still in m_Springs
+    int m_iTopologyVersion;
+    vector<int> m_BrokenLog;
+    vector<int> m_CompactionMap;
+    vector<int> m_AdjacencyStart;       // springs of each particle, built on demand, empty when stale
+    vector<int> m_AdjacencySpring;
+
+    CLatticeForce m_Lattice;
+    bool m_bLatticeForce;
 };
 
 #endif
\ No newline at end of file
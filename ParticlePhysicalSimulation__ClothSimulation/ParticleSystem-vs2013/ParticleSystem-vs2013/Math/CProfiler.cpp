@@ -0,0 +1,193 @@
+#include <algorithm>
+#include "CProfiler.h"
+
+#pragma warning(disable:4996)
+
+CProfiler g_Profiler;
+
+static const char *s_pcPhaseName[CProfiler::Phase_nCount] =
+{
+    "Force",
+    "ParticleObstacleColl",
+    "BallObstacleColl",
+    "BallToBallColl",
+    "BallParticleColl",
+    "ContinuousColl",
+    "ResetForce",
+    "ExplicitEuler",
+    "RungeKuttaStage1",
+    "RungeKuttaStage2",
+    "RungeKuttaStage3",
+    "RungeKuttaStage4",
+    "ProjectiveDynamics",
+    "Domain",
+    "FusedEuler",
+    "StrainLimit",
+    "Tear",
+    "Emitter",
+    "Fluid",
+    "Character",
+    "Cloth",
+    "Pick",
+    "Simulation",
+    "DrawGoalNet",
+    "DrawGoalpost",
+    "DrawBall",
+    "DrawEmitter",
+    "DrawFluid",
+    "DrawCharacter",
+    "DrawCloth",
+    "DrawObstacle",
+    "DrawPlane",
+    "DrawBackground",
+    "DrawInformation",
+    "Frame"
+};
+
+CProfiler::CProfiler()
+    :m_Sorted(),
+    m_iHistoryHead(0),
+    m_iHistorySize(0),
+    m_iFrameIndex(0),
+    m_pCsvFile(NULL)
+{
+    for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+    {
+        m_History[iPhase].assign(s_ciHistoryLength, 0.0);
+    }
+    m_Sorted.reserve(s_ciHistoryLength);
+    Clear();
+}
+
+CProfiler::~CProfiler()
+{
+    StopCsv();
+}
+
+void CProfiler::End(const enPhase_t a_cPhase)
+{
+    m_Counters[a_cPhase].StopCounter();
+    m_dFrameTime[a_cPhase] += m_Counters[a_cPhase].GetElapsedTime();
+    ++m_iFrameCall[a_cPhase];
+}
+
+void CProfiler::EndFrame()
+{
+    for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+    {
+        m_History[iPhase][m_iHistoryHead] = m_dFrameTime[iPhase] * 1000.0;
+        m_iLastCall[iPhase] = m_iFrameCall[iPhase];
+    }
+
+    if (m_pCsvFile != NULL)
+    {
+        fprintf(m_pCsvFile, "%d", m_iFrameIndex);
+        for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+        {
+            fprintf(m_pCsvFile, ",%.4f", m_History[iPhase][m_iHistoryHead]);
+        }
+        fprintf(m_pCsvFile, "\n");
+    }
+
+    m_iHistoryHead = (m_iHistoryHead + 1) % s_ciHistoryLength;
+    if (m_iHistorySize < s_ciHistoryLength)
+    {
+        ++m_iHistorySize;
+    }
+    ++m_iFrameIndex;
+
+    for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+    {
+        m_dFrameTime[iPhase] = 0.0;
+        m_iFrameCall[iPhase] = 0;
+    }
+}
+
+void CProfiler::Clear()
+{
+    for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+    {
+        m_dFrameTime[iPhase] = 0.0;
+        m_iFrameCall[iPhase] = 0;
+        m_iLastCall[iPhase] = 0;
+    }
+    m_iHistoryHead = 0;
+    m_iHistorySize = 0;
+}
+
+double CProfiler::GetAverage(const enPhase_t a_cPhase) const
+{
+    if (m_iHistorySize == 0)
+    {
+        return 0.0;
+    }
+    double dSum = 0.0;
+    for (int iI = 0; iI < m_iHistorySize; ++iI)
+    {
+        dSum += m_History[a_cPhase][iI];
+    }
+    return dSum / m_iHistorySize;
+}
+
+double CProfiler::GetPercentile(const enPhase_t a_cPhase, const double a_cdPercent)
+{
+    if (m_iHistorySize == 0)
+    {
+        return 0.0;
+    }
+    m_Sorted.assign(m_History[a_cPhase].begin(), m_History[a_cPhase].begin() + m_iHistorySize);
+    int iRank = (int)(a_cdPercent / 100.0 * (m_iHistorySize - 1) + 0.5);
+    if (iRank < 0)
+    {
+        iRank = 0;
+    }
+    if (iRank > m_iHistorySize - 1)
+    {
+        iRank = m_iHistorySize - 1;
+    }
+    std::nth_element(m_Sorted.begin(), m_Sorted.begin() + iRank, m_Sorted.end());
+    return m_Sorted[iRank];
+}
+
+int CProfiler::GetCallNum(const enPhase_t a_cPhase) const
+{
+    return m_iLastCall[a_cPhase];
+}
+
+const char *CProfiler::GetPhaseName(const enPhase_t a_cPhase)
+{
+    return s_pcPhaseName[a_cPhase];
+}
+
+bool CProfiler::StartCsv(const std::string &a_rcsFilename)
+{
+    StopCsv();
+    m_pCsvFile = fopen(a_rcsFilename.c_str(), "a");
+    if (m_pCsvFile == NULL)
+    {
+        printf("[Error] CProfiler::StartCsv, can not open %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    // write the header only once per file
+    fseek(m_pCsvFile, 0, SEEK_END);
+    if (ftell(m_pCsvFile) == 0)
+    {
+        fprintf(m_pCsvFile, "frame");
+        for (int iPhase = 0; iPhase < Phase_nCount; ++iPhase)
+        {
+            fprintf(m_pCsvFile, ",%s_ms", s_pcPhaseName[iPhase]);
+        }
+        fprintf(m_pCsvFile, "\n");
+    }
+    return true;
+}
+
+void CProfiler::StopCsv()
+{
+    if (m_pCsvFile != NULL)
+    {
+        fclose(m_pCsvFile);
+        m_pCsvFile = NULL;
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef CPROFILER_H
+#define CPROFILER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "performanceCounter.h"
+
+/*
+ * Per-phase timing of the simulation and the renderer.
+ * Every phase accumulates its elapsed time during a frame, EndFrame() pushes
+ * the totals into a rolling history (used for averages and percentiles) and,
+ * when enabled, appends one row per frame to a CSV file.
+ */
+class CProfiler
+{
+    public:
+        typedef enum
+        {
+            Phase_nForce,
+            Phase_nParticleObstacleCollision,
+            Phase_nBallObstacleCollision,
+            Phase_nBallToBallCollision,
+            Phase_nBallParticleCollision,
+            Phase_nContinuousCollision,
+            Phase_nResetForce,
+            Phase_nExplicitEuler,
+            Phase_nRungeKuttaStage1,
+            Phase_nRungeKuttaStage2,
+            Phase_nRungeKuttaStage3,
+            Phase_nRungeKuttaStage4,
+            Phase_nProjectiveDynamics,
+            Phase_nDomain,
+            Phase_nFusedEuler,
+            Phase_nStrainLimit,
+            Phase_nTear,
+            Phase_nEmitter,
+            Phase_nFluid,
+            Phase_nCharacter,
+            Phase_nCloth,
+            Phase_nPick,
+            Phase_nSimulation,
+            Phase_nDrawGoalNet,
+            Phase_nDrawGoalpost,
+            Phase_nDrawBall,
+            Phase_nDrawEmitter,
+            Phase_nDrawFluid,
+            Phase_nDrawCharacter,
+            Phase_nDrawCloth,
+            Phase_nDrawObstacle,
+            Phase_nDrawPlane,
+            Phase_nDrawBackground,
+            Phase_nDrawInformation,
+            Phase_nFrame,
+            Phase_nCount
+        } enPhase_t;
+
+        CProfiler();
+        ~CProfiler();
+
+        inline void Begin(const enPhase_t a_cPhase){ m_Counters[a_cPhase].StartCounter(); }
+        void End(const enPhase_t a_cPhase);
+        void EndFrame();
+        void Clear();
+
+        double GetAverage(const enPhase_t a_cPhase) const;               // in milliseconds
+        double GetPercentile(const enPhase_t a_cPhase, const double a_cdPercent);  // in milliseconds
+        int GetCallNum(const enPhase_t a_cPhase) const;                  // calls in the last frame
+        static const char *GetPhaseName(const enPhase_t a_cPhase);
+
+        bool StartCsv(const std::string &a_rcsFilename);
+        void StopCsv();
+        inline bool IsCsvOpen() const { return m_pCsvFile != NULL; }
+
+    private:
+        static const int s_ciHistoryLength = 240;   // frames kept for the rolling statistics
+
+        PerformanceCounter m_Counters[Phase_nCount];
+        double m_dFrameTime[Phase_nCount];       // seconds accumulated in the current frame
+        int m_iFrameCall[Phase_nCount];
+        int m_iLastCall[Phase_nCount];
+        std::vector<double> m_History[Phase_nCount];
+        std::vector<double> m_Sorted;            // scratch buffer for the percentiles
+        int m_iHistoryHead;
+        int m_iHistorySize;
+        int m_iFrameIndex;
+        FILE *m_pCsvFile;
+};
+
+/*
+ * Times the enclosing scope as one call of the given phase.
+ */
+class CScopedTimer
+{
+    public:
+        explicit CScopedTimer(const CProfiler::enPhase_t a_cPhase);
+        ~CScopedTimer();
+
+    private:
+        CScopedTimer(const CScopedTimer &);
+        CScopedTimer &operator=(const CScopedTimer &);
+
+        CProfiler::enPhase_t m_nPhase;
+};
+
+extern CProfiler g_Profiler;
+
+inline CScopedTimer::CScopedTimer(const CProfiler::enPhase_t a_cPhase)
+    :m_nPhase(a_cPhase)
+{
+    g_Profiler.Begin(m_nPhase);
+}
+
+inline CScopedTimer::~CScopedTimer()
+{
+    g_Profiler.End(m_nPhase);
+}
+
+#endif
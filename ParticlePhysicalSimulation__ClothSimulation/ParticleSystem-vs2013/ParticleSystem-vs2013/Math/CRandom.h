@@ -0,0 +1,32 @@
+#ifndef CRANDOM_H
+#define CRANDOM_H
+
+/*
+ * Small seeded random stream (xorshift32). Every user keeps its own stream,
+ * so a run does not depend on rand() or on what else drew numbers before.
+ */
+class CRandom
+{
+    public:
+        explicit CRandom(const unsigned int a_cuiSeed = s_cuiDefaultSeed){ Seed(a_cuiSeed); }
+
+        // xorshift never leaves 0, so 0 picks the default seed
+        inline void Seed(const unsigned int a_cuiSeed){ m_uiState = (a_cuiSeed != 0) ? a_cuiSeed : s_cuiDefaultSeed; }
+
+        inline unsigned int Next()
+        {
+            m_uiState ^= m_uiState << 13;
+            m_uiState ^= m_uiState >> 17;
+            m_uiState ^= m_uiState << 5;
+            return m_uiState;
+        }
+        inline double Uniform(){ return (double)(Next() >> 8) / 16777216.0; }             // in [0,1)
+        inline int UniformInt(const int a_ciNum){ return (int)(Uniform()*a_ciNum); }      // in [0,num)
+
+    private:
+        static const unsigned int s_cuiDefaultSeed = 0x9e3779b9u;
+
+        unsigned int m_uiState;
+};
+
+#endif
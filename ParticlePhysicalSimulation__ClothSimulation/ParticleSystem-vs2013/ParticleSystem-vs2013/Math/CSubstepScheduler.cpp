@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include "CSubstepScheduler.h"
+
+namespace
+{
+    const double s_cdMaxFrameGap = 0.25;    // a longer frame was a stall (a drag of the window), not owed
+    const double s_cdMinSimShare = 0.25;    // of the budget, even when the drawing alone overruns it
+    const int s_ciMaxStepNum = 200;         // per frame, before the first step is measured too
+    const double s_cdSmoothing = 0.1;       // weight of the newest frame
+    const double s_cdOverBudgetEnter = 0.5; // share of short frames
+    const double s_cdOverBudgetLeave = 0.1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CSubstepScheduler::CSubstepScheduler()
+    :m_bEnable(false),
+    m_dFrameBudget(1.0/60.0),
+    m_bClockValid(false),
+    m_dDebt(0.0),
+    m_iStepNum(0),
+    m_dSimTime(0.0),
+    m_dStepCost(0.0),
+    m_dDrawCost(0.0),
+    m_dRealTimeRatio(1.0),
+    m_dShortRatio(0.0),
+    m_bOverBudget(false)
+{
+}
+
+void CSubstepScheduler::SetEnable(const bool a_cbEnable)
+{
+    m_bEnable = a_cbEnable;
+    m_bClockValid = false;
+    m_dDebt = 0.0;
+    m_dRealTimeRatio = 1.0;
+    m_dShortRatio = 0.0;
+    m_bOverBudget = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Frames                                   //
+////////////////////////////////////////////////////////////////////////////////
+int CSubstepScheduler::BeginFrame(const double a_cdDeltaT, const bool a_cbRunning)
+{
+    m_SimCounter.StartCounter();
+    m_dSimTime = 0.0;
+    if(!a_cbRunning || a_cdDeltaT <= 0.0)
+    {
+        // a paused simulation owes nothing, the clock starts over with the next step
+        m_bClockValid = false;
+        m_dDebt = 0.0;
+        m_iStepNum = 0;
+        return 0;
+    }
+
+    m_FrameCounter.StopCounter();
+    double dWall = m_bClockValid ? m_FrameCounter.GetElapsedTime() : 0.0;
+    dWall = (dWall > s_cdMaxFrameGap) ? s_cdMaxFrameGap : dWall;
+    m_FrameCounter.StartCounter();
+    m_bClockValid = true;
+    m_dDebt += dWall;
+
+    // the steps owed, and the steps the budget leaves room for after the drawing
+    const int ciOwed = (int)floor(m_dDebt/a_cdDeltaT);
+    int iRoom = s_ciMaxStepNum;
+    if(m_dStepCost > 0.0)
+    {
+        double dSimBudget = m_dFrameBudget - m_dDrawCost;
+        dSimBudget = (dSimBudget > s_cdMinSimShare*m_dFrameBudget) ? dSimBudget : s_cdMinSimShare*m_dFrameBudget;
+        iRoom = (int)(dSimBudget/m_dStepCost);
+        iRoom = (iRoom < 1) ? 1 : ((iRoom > s_ciMaxStepNum) ? s_ciMaxStepNum : iRoom);
+    }
+    const bool cbShort = (ciOwed > iRoom);
+    m_iStepNum = cbShort ? iRoom : ciOwed;
+    m_dDebt -= ciOwed*a_cdDeltaT;       // the steps that did not fit are dropped, not owed to the next frame
+
+    if(dWall > 0.0)
+    {
+        m_dRealTimeRatio += s_cdSmoothing*(m_iStepNum*a_cdDeltaT/dWall - m_dRealTimeRatio);
+        m_dShortRatio += s_cdSmoothing*((cbShort ? 1.0 : 0.0) - m_dShortRatio);
+    }
+    if(!m_bOverBudget && m_dShortRatio > s_cdOverBudgetEnter)
+    {
+        m_bOverBudget = true;
+        printf("[Warning] CSubstepScheduler::BeginFrame, %.3f ms per step and %.3f ms of drawing do not fit %d steps into %.1f ms, the simulation runs at %.0f%% of real time\n",
+               m_dStepCost*1000.0, m_dDrawCost*1000.0, ciOwed, m_dFrameBudget*1000.0, m_dRealTimeRatio*100.0);
+    }
+    else if(m_bOverBudget && m_dShortRatio < s_cdOverBudgetLeave)
+    {
+        m_bOverBudget = false;
+    }
+    return m_iStepNum;
+}
+
+void CSubstepScheduler::EndSimulation()
+{
+    m_SimCounter.StopCounter();
+    m_dSimTime = m_SimCounter.GetElapsedTime();
+    if(m_iStepNum > 0)
+    {
+        const double cdStepCost = m_dSimTime/m_iStepNum;
+        m_dStepCost = (m_dStepCost > 0.0) ? m_dStepCost + s_cdSmoothing*(cdStepCost - m_dStepCost) : cdStepCost;
+    }
+}
+
+void CSubstepScheduler::EndFrame()
+{
+    m_SimCounter.StopCounter();
+    const double cdDrawCost = m_SimCounter.GetElapsedTime() - m_dSimTime;
+    m_dDrawCost += s_cdSmoothing*(cdDrawCost - m_dDrawCost);
+}
@@ -0,0 +1,56 @@
+#ifndef CSUBSTEPSCHEDULER_H
+#define CSUBSTEPSCHEDULER_H
+
+#include "performanceCounter.h"
+
+/*
+ * Number of simulation steps per display frame that keeps the simulated time
+ * locked to the wall clock. Every frame owes the wall time since the last
+ * one, BeginFrame() returns the whole steps of that debt, as many as the
+ * frame budget leaves room for after the drawing. The cost of a step and of
+ * the drawing are measured online and smoothed over a few frames.
+ *
+ * A frame that cannot take all its steps drops the rest of the debt instead
+ * of carrying it over, so an expensive scene runs slower than real time but
+ * does not fall further behind every frame. When most frames are short the
+ * scheduler is over budget and says so once on the console, the ratio of
+ * simulated to wall time tells by how much.
+ */
+class CSubstepScheduler
+{
+    public:
+        CSubstepScheduler();
+
+        void SetEnable(const bool a_cbEnable);
+        inline bool IsEnable() const { return m_bEnable; }
+        inline void SetFrameBudget(const double a_cdBudget){ m_dFrameBudget = a_cdBudget; }    // in seconds
+        inline double GetFrameBudget() const { return m_dFrameBudget; }
+
+        // steps to take this frame, 0 while the simulation is not running
+        int BeginFrame(const double a_cdDeltaT, const bool a_cbRunning);
+        void EndSimulation();           // after the steps
+        void EndFrame();                // after the drawing, before the buffer swap waits for the display
+
+        inline int GetStepNum() const { return m_iStepNum; }                // of the last frame
+        inline double GetStepCost() const { return m_dStepCost*1000.0; }    // in milliseconds
+        inline double GetRealTimeRatio() const { return m_dRealTimeRatio; } // simulated over wall time
+        inline bool IsOverBudget() const { return m_bOverBudget; }
+
+    private:
+        bool m_bEnable;
+        double m_dFrameBudget;
+
+        PerformanceCounter m_FrameCounter;      // from one BeginFrame() to the next
+        PerformanceCounter m_SimCounter;
+        bool m_bClockValid;                     // the frame counter runs since a frame of this run
+        double m_dDebt;                         // wall time the simulation still owes
+        int m_iStepNum;
+        double m_dSimTime;                      // of the steps of this frame
+        double m_dStepCost;                     // smoothed, in seconds
+        double m_dDrawCost;
+        double m_dRealTimeRatio;
+        double m_dShortRatio;                   // smoothed share of the frames that dropped steps
+        bool m_bOverBudget;
+};
+
+#endif
@@ -16,6 +16,7 @@ CCamera::CCamera()
 }
 CCamera::CCamera(const string &r_csCameraInfoFileName)
 {
+    m_bPickValid = false;
     fstream CameraInfoFile;
     CameraInfoFile.open(r_csCameraInfoFileName.c_str());
 
@@ -101,6 +102,7 @@ CCamera::CCamera(const CCamera &a_rcCamera)
                 a_rcCamera.m_dViewPort[1],
                 a_rcCamera.m_dViewPort[2],
                 a_rcCamera.m_dViewPort[3]);
+    m_bPickValid = false;
 }
 CCamera::~CCamera()
 {
@@ -113,6 +115,7 @@ void CCamera::CameraInit()
     SetEyeUpDir(Vector3d(0.0f,1.0f,0.0f));
     SetEyeAtPos(Vector3d(0.0f,0.0f,0.0f));
     SetViewPort(0.0f,0.0f,100.0f,100.0f);
+    m_bPickValid = false;
 }
 void CCamera::UpdateAspectRatio()
 {
@@ -163,6 +166,35 @@ void CCamera::ZoomAndRotateToOrigin(const double a_cdZoom,
               m_EyeAtPos.x,m_EyeAtPos.y,m_EyeAtPos.z,
               EyeUpVector.x,EyeUpVector.y,EyeUpVector.z);
     glMatrixMode(GL_MODELVIEW);
+
+    glGetDoublev(GL_MODELVIEW_MATRIX, m_adModelView);
+    glGetDoublev(GL_PROJECTION_MATRIX, m_adProjection);
+    glGetIntegerv(GL_VIEWPORT, m_aiViewport);
+    m_iWindowHeight = glutGet(GLUT_WINDOW_HEIGHT);
+    m_bPickValid = true;
+}
+bool CCamera::GetPickRay(const int a_ciX, const int a_ciY, Vector3d &a_rOrigin, Vector3d &a_rDirection) const
+{
+    if(!m_bPickValid)
+    {
+        return false;
+    }
+    // the window y grows downwards, the viewport y upwards
+    double dWinY = (double)(m_iWindowHeight - a_ciY);
+    double adNear[3];
+    double adFar[3];
+    if(gluUnProject((double)a_ciX, dWinY, 0.0, m_adModelView, m_adProjection, m_aiViewport, &adNear[0], &adNear[1], &adNear[2]) != GL_TRUE ||
+       gluUnProject((double)a_ciX, dWinY, 1.0, m_adModelView, m_adProjection, m_aiViewport, &adFar[0], &adFar[1], &adFar[2]) != GL_TRUE)
+    {
+        return false;
+    }
+    a_rOrigin = Vector3d(adNear[0], adNear[1], adNear[2]);
+    a_rDirection = Vector3d(adFar[0], adFar[1], adFar[2]) - a_rOrigin;
+    if(a_rDirection.Normalize() <= 0.0)
+    {
+        return false;
+    }
+    return true;
 }
 void CCamera::UseCamera()
 {
@@ -21,6 +21,13 @@ class CCamera
         Vector3d m_EyeUpDir;
         Vector3d m_EyeAtPos;
 
+        // the matrices of the last ZoomAndRotateToOrigin(), for picking between frames
+        double m_adModelView[16];
+        double m_adProjection[16];
+        int m_aiViewport[4];
+        int m_iWindowHeight;
+        bool m_bPickValid;
+
 		void CameraInit();
         void UpdateAspectRatio();
 		int GetMemberVarDim(const std::string &a_rsMemberVarName);
@@ -36,6 +43,8 @@ class CCamera
         void UseCameraWithViewport();
         void UseCameraWithViewportAndPick(const double a_cdX,const double a_cdY,
                                           const double a_cdWidth, const double a_cdHeight);
+        // ray through a window pixel of the last frame, the direction is unit length
+        bool GetPickRay(const int a_ciX, const int a_ciY, Vector3d &a_rOrigin, Vector3d &a_rDirection) const;
 
         inline void SetAspectRatio(const double a_cdAspectRatio){m_dAspectRatio = a_cdAspectRatio;}
         inline void SetEyeAtPos(const Vector3d &a_rEyeAtPos){m_EyeAtPos = a_rEyeAtPos;}
@@ -8,6 +8,19 @@
 #include "glut.h"
 #include "glui.h" 
 
+// one quadric is shared by every cylinder and sphere instead of a new one per call
+static GLUquadricObj *GetSharedQuadric()
+{
+    static GLUquadricObj *s_pQuadric = NULL;
+    if (s_pQuadric == NULL)
+    {
+        s_pQuadric = gluNewQuadric();
+        gluQuadricDrawStyle(s_pQuadric, (GLenum) GLU_FILL);
+        gluQuadricNormals(s_pQuadric, (GLenum) GLU_SMOOTH);
+        gluQuadricOrientation(s_pQuadric, GLU_OUTSIDE);
+    }
+    return s_pQuadric;
+}
 
 void setColor(const int color)
 {
@@ -92,8 +105,7 @@ void drawLine(const Vector3d &startPoint, const Vector3d &endPoint)
 void drawCylinder(const Vector3d &startPoint, const Vector3d &endPoint, double radius)
 {
     //the same quadric can be re-used for drawing many cylinders
-    GLUquadricObj *quadric = gluNewQuadric();
-    gluQuadricNormals(quadric, GLU_SMOOTH);
+    GLUquadricObj *quadric = GetSharedQuadric();
     int subdivisions = 18;
 
     Vector3d cyl_vec;
@@ -126,22 +138,16 @@ void drawCylinder(const Vector3d &startPoint, const Vector3d &endPoint, double r
         rz = 0;
     }
     glRotatef(ax, rx, ry, rz);
-    gluQuadricOrientation(quadric,GLU_OUTSIDE);
     gluCylinder(quadric, radius, radius, cyl_len, subdivisions, 1);
     
     glPopMatrix();
-
-    gluDeleteQuadric(quadric);
 }
 
 void drawBall(const Vector3d &ballPos, double radius)
 {
 	glPushMatrix();
     glTranslatef(ballPos.x, ballPos.y, ballPos.z);    // ym
-	GLUquadricObj *qobj;
-	qobj=gluNewQuadric();
-	gluQuadricDrawStyle(qobj, (GLenum) GLU_FILL);
-    gluQuadricNormals(qobj, (GLenum) GLU_SMOOTH);
+	GLUquadricObj *qobj = GetSharedQuadric();
 	glScalef(.3, .3, .3);
 	gluSphere(qobj,radius,25,25); 
 	glPopMatrix(); 
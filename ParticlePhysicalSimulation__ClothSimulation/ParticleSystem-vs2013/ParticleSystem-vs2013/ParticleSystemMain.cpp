@@ -1,7 +1,6 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <ctime>
 #include <cmath>
 #ifdef _MSC_VER
     #include <intrin.h>
@@ -9,11 +8,16 @@
 #include "glut.h"
 #include "glui.h"
 #include "performanceCounter.h"
+#include "CProfiler.h"
+#include "CSubstepScheduler.h"
 #include "CCamera.h"
 #include "CParticle.h"
 #include "CSpring.h"
 #include "CMassSpringSystem.h"
+#include "CIntegratorBench.h"
+#include "CScenario.h"
 #include "CBmp.h"
+#include "CTextureLoader.h"
 #include "configFile.h"
 #include "Global_Var.h"
 #include "Lighting.h"
@@ -33,10 +37,39 @@ void DrawPlane();
 void DrawPlaneShadow();
 void SavePicture();
 
+const char g_csBenchCsvFile[] = "integrator_bench.csv";
+
 int main(int argc,char** argv)
 {
+    // -bench [simulated seconds]: accuracy against cost of the integrators, no window
+    if(argc > 1 && std::string(argv[1]) == "-bench")
+    {
+        CIntegratorBench bench;
+        if(argc > 2)
+        {
+            bench.SetDuration(atof(argv[2]));
+        }
+        bench.Run(g_MassSpringSystem);
+        bench.Print();
+        return bench.WriteCsv(g_csBenchCsvFile) ? 0 : 1;
+    }
+
+    // -run script: replays the script to its end, no window
+    // -script script: replays it in the window, starting with the simulation
+    if(argc > 2 && (std::string(argv[1]) == "-run" || std::string(argv[1]) == "-script"))
+    {
+        if(!g_Scenario.Load(argv[2]))
+        {
+            return 1;
+        }
+        if(std::string(argv[1]) == "-run")
+        {
+            g_Scenario.Replay(g_MassSpringSystem);
+            return 0;
+        }
+    }
+
     OpenGLInit(argc,argv);
-    srand(time(NULL));
 	glutMainLoop();
 	return 0;
 }
@@ -74,6 +107,8 @@ void DrawAxis()
 
 void DrawInformation()
 {
+    CScopedTimer timer(CProfiler::Phase_nDrawInformation);
+
     glPushAttrib(GL_ENABLE_BIT);
     glPushMatrix();
         glDisable ( GL_LIGHTING );  
@@ -92,7 +127,7 @@ void DrawInformation()
         static const int s_ciTextStartX = 10;
         static const int s_ciTextStartY = 20;
         static const int s_ciTextRowRange = 15;
-        static const int s_ciInfoNum = 20;
+        static const int s_ciInfoNum = 40;
         std::string sInfo[s_ciInfoNum];
         char cInfoTemp[100] = "\0";
 
@@ -158,11 +193,68 @@ void DrawInformation()
         {
             sInfo[8] = "Integrator   :Runge Kutta 4th";
         }
+        else if(g_MassSpringSystem.GetIntegratorType() == 2)
+        {
+            sprintf(cInfoTemp, "Integrator   :Projective Dynamics, %d iterations", g_MassSpringSystem.GetProjectiveIterations());
+            sInfo[8] = cInfoTemp;
+        }
         if(!g_MassSpringSystem.CheckStable())
         {
             glColor4f ( 1.0f, 0.0f, 0.0f, 1.0f );
             sInfo[9] = "System is unstable!! Please press reset and modify your parameters!!";
         }
+        else if(g_MassSpringSystem.RecoveryNum() > 0)
+        {
+            sprintf(cInfoTemp, "Energy diverged %d times, rolled back and halved DeltaT until reset", g_MassSpringSystem.RecoveryNum());
+            sInfo[9] = cInfoTemp;
+        }
+        if(g_MassSpringSystem.EmitterParticleNum() > 0)
+        {
+            sInfo[10] = "Emitter      :";
+            sprintf(cInfoTemp, "%d particles", g_MassSpringSystem.EmitterParticleNum());
+            sInfo[10].append(cInfoTemp);
+        }
+        if(g_MassSpringSystem.FluidParticleNum() > 0)
+        {
+            sInfo[11] = "Fluid        :";
+            sprintf(cInfoTemp, "%d particles", g_MassSpringSystem.FluidParticleNum());
+            sInfo[11].append(cInfoTemp);
+        }
+        const CEnergyMonitor &rcEnergy = g_MassSpringSystem.GetEnergyMonitor();
+        sprintf(cInfoTemp, "Energy       :K %.3f  S %.3f  G %.3f J",
+                rcEnergy.GetKinetic(), rcEnergy.GetSpring(), rcEnergy.GetGravity());
+        sInfo[12] = cInfoTemp;
+        if(g_SubstepScheduler.IsEnable())
+        {
+            sprintf(cInfoTemp, "Real time    :%d steps/frame, %.3f ms/step, %.0f%% of real time%s",
+                    g_SubstepScheduler.GetStepNum(), g_SubstepScheduler.GetStepCost(),
+                    g_SubstepScheduler.GetRealTimeRatio()*100.0,
+                    g_SubstepScheduler.IsOverBudget() ? ", over the frame budget" : "");
+            sInfo[13] = cInfoTemp;
+        }
+        if(g_iCheckboxDrawProfiler == 1)
+        {
+            // rolling statistics over the last frames, in milliseconds per frame
+            int iRow = 14;
+            sprintf(cInfoTemp, "%-18s %8s %8s %8s %8s %6s", "Phase(ms/frame)", "avg", "p50", "p95", "p99", "calls");
+            sInfo[iRow++] = cInfoTemp;
+            for(int iPhase = 0 ; iPhase<CProfiler::Phase_nCount && iRow<s_ciInfoNum ; iPhase++)
+            {
+                CProfiler::enPhase_t nPhase = (CProfiler::enPhase_t)iPhase;
+                if(g_Profiler.GetAverage(nPhase) <= 0.0)
+                {
+                    continue;
+                }
+                sprintf(cInfoTemp, "%-18s %8.3f %8.3f %8.3f %8.3f %6d",
+                        CProfiler::GetPhaseName(nPhase),
+                        g_Profiler.GetAverage(nPhase),
+                        g_Profiler.GetPercentile(nPhase, 50.0),
+                        g_Profiler.GetPercentile(nPhase, 95.0),
+                        g_Profiler.GetPercentile(nPhase, 99.0),
+                        g_Profiler.GetCallNum(nPhase));
+                sInfo[iRow++] = cInfoTemp;
+            }
+        }
         for(int i=0 ; i<s_ciInfoNum ; i++)
         {
             drawText2D (s_ciTextStartX,s_ciTextStartY+i*s_ciTextRowRange,  sInfo[i].c_str() );
@@ -174,13 +266,22 @@ void DrawInformation()
 
 void DrawBackground()
 {
+    CScopedTimer timer(CProfiler::Phase_nDrawBackground);
+
+    if(g_uiBackgroundList != 0)
+    {
+        glCallList(g_uiBackgroundList);
+        return;
+    }
+    g_uiBackgroundList = glGenLists(1);
+    glNewList(g_uiBackgroundList, GL_COMPILE_AND_EXECUTE);
     glPushAttrib(GL_CURRENT_BIT);
         glPushMatrix();
             glDisable(GL_LIGHTING);
                 glEnable(GL_TEXTURE_2D);
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[1]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d(-30.0,-30.0,-30.0);
@@ -193,7 +294,7 @@ void DrawBackground()
                     glEnd();
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[3]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d(-30.0,-30.0,  30.0);
@@ -206,7 +307,7 @@ void DrawBackground()
                     glEnd();
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[0]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d(-30.0,-30.0, -30.0);
@@ -219,7 +320,7 @@ void DrawBackground()
                     glEnd();
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[2]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d( 30.0,-30.0, -30.0);
@@ -232,7 +333,7 @@ void DrawBackground()
                     glEnd();
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[5]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d(-30.0,-30.0, -30.0);
@@ -245,7 +346,7 @@ void DrawBackground()
                     glEnd();
                     glBindTexture(GL_TEXTURE_2D,g_uiTextureId[4]);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
                     glBegin(GL_QUADS);
                         glTexCoord2d( 0.0 , 0.0);
                         glVertex3d(-30.0, 30.0, -30.0);
@@ -261,10 +362,20 @@ void DrawBackground()
             glEnable(GL_LIGHTING);
         glPopMatrix();  
     glPopAttrib();
+    glEndList();
 }
 
 void DrawPlane()
 {
+    CScopedTimer timer(CProfiler::Phase_nDrawPlane);
+
+    if(g_uiPlaneList != 0)
+    {
+        glCallList(g_uiPlaneList);
+        return;
+    }
+    g_uiPlaneList = glGenLists(1);
+    glNewList(g_uiPlaneList, GL_COMPILE_AND_EXECUTE);
     glPushAttrib(GL_CURRENT_BIT);
         glPushMatrix();
             float fKa[] = { 0.5f, 0.5f, 0.5f, 1.0f };
@@ -283,7 +394,7 @@ void DrawPlane()
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
                     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
                     glBegin(GL_QUADS);
                     glNormal3d(0.0, 1.0, 0.0);
@@ -331,36 +442,39 @@ void DrawPlane()
                 glDisable(GL_TEXTURE_2D);
         glPopMatrix();  
     glPopAttrib();
+    glEndList();
 }
 
 void DrawPlaneShadow()
 {
+    if(g_uiPlaneShadowList != 0)
+    {
+        glCallList(g_uiPlaneShadowList);
+        return;
+    }
+    g_uiPlaneShadowList = glGenLists(1);
+    glNewList(g_uiPlaneShadowList, GL_COMPILE_AND_EXECUTE);
     glPushAttrib(GL_CURRENT_BIT);
         glPushMatrix();
             float fKa[] = { 0.2f, 0.2f, 0.2f, 1.0f };
 
             glMaterialfv(GL_FRONT, GL_AMBIENT, fKa);
+            glNormal3d(0.0,1.0,0.0);
+            glBegin( GL_QUADS );
             for(int i = 0 ; i<60 ; i++)
             {
                 for(int j = 0; j<60 ; j++)
                 {
-                    glBegin( GL_QUADS );
-                        glNormal3d(0.0,1.0,0.0);
-                        glVertex3d( -30.0+(double)(i), -1.0, -30.0+(double)(j) );
-
-                        glNormal3d(0.0,1.0,0.0);
-                        glVertex3d(  -30.0+(double)(i+1), -1.0, -30.0+(double)(j) );
-
-                        glNormal3d(0.0,1.0,0.0);
-                        glVertex3d(  -30.0+(double)(i+1), -1.0,  -30.0+(double)(j+1) );
-                        
-                        glNormal3d(0.0,1.0,0.0);
-                        glVertex3d( -30.0+(double)(i), -1.0, -30.0+(double)(j+1) );
-                    glEnd ();
+                    glVertex3d( -30.0+(double)(i), -1.0, -30.0+(double)(j) );
+                    glVertex3d(  -30.0+(double)(i+1), -1.0, -30.0+(double)(j) );
+                    glVertex3d(  -30.0+(double)(i+1), -1.0,  -30.0+(double)(j+1) );
+                    glVertex3d( -30.0+(double)(i), -1.0, -30.0+(double)(j+1) );
                 }
             }
+            glEnd ();
         glPopMatrix();  
     glPopAttrib();
+    glEndList();
 }
 
 void SavePicture()
@@ -399,11 +513,26 @@ void SavePicture()
 void display()
 {       
     g_PerformanceCounter.StartCounter();
+    g_Profiler.Begin(CProfiler::Phase_nFrame);
 
-    for(int i=0 ; i<g_iSpinnerSimPerFrame ; i++)
+    if(!g_TextureLoader.IsDone())
+    {
+        g_TextureLoader.UploadFinished(g_uiTextureId);
+    }
+
+    // a fixed count, or as many as keep the simulated time with the wall clock
+    int iStepNum = g_iSpinnerSimPerFrame;
+    if(g_SubstepScheduler.IsEnable())
+    {
+        iStepNum = g_SubstepScheduler.BeginFrame(g_MassSpringSystem.GetDeltaT(), g_MassSpringSystem.IsSimulation());
+    }
+    g_Profiler.Begin(CProfiler::Phase_nSimulation);
+    for(int i=0 ; i<iStepNum ; i++)
     {
-        g_MassSpringSystem.SimulationOneTimeStep();
+        g_Scenario.Step(g_MassSpringSystem);
     }
+    g_Profiler.End(CProfiler::Phase_nSimulation);
+    g_SubstepScheduler.EndSimulation();
     if(!g_MassSpringSystem.CheckStable())
     {
         GLUI_Control_CallBack(enControlID::PAUSE);
@@ -453,9 +582,12 @@ void display()
     {
         SavePicture();
     }
+    g_SubstepScheduler.EndFrame();
     
     glutSwapBuffers();
 
+    g_Profiler.End(CProfiler::Phase_nFrame);
+    g_Profiler.EndFrame();
     g_PerformanceCounter.StopCounter();
     g_dEditboxFPS = 1.0 / g_PerformanceCounter.GetElapsedTime();
     p_gGlui->sync_live();
@@ -0,0 +1,407 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include "CScenario.h"
+#include "performanceCounter.h"
+
+namespace
+{
+    // parameters a script can set, handled in CScenario::Apply()
+    const char *s_pcParamName[] =
+    {
+        "SpringCoef", "SpringCoefStruct", "SpringCoefShear", "SpringCoefBending",
+        "DamperCoef", "DeltaT", "IntegratorType", "StrainLimit", "TearStrain",
+        "ProjectiveIterations", "DomainNum", "Emitter", "Character", "AutoRecover"
+    };
+    const int s_ciParamNum = sizeof(s_pcParamName)/sizeof(s_pcParamName[0]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Load                                    //
+////////////////////////////////////////////////////////////////////////////////
+CScenario::CScenario()
+    :m_sFilename(),
+    m_Events(),
+    m_uiNextEvent(0),
+    m_bSeed(false),
+    m_uiSeed(1),
+    m_dEndTime(0.0),
+    m_dLastTime(0.0),
+    m_bCaptured(false),
+    m_Settings()
+{
+}
+
+void CScenario::Clear()
+{
+    m_sFilename.clear();
+    m_Events.clear();
+    m_bSeed = false;
+    m_uiSeed = 1;
+    m_dEndTime = 0.0;
+    m_bCaptured = false;
+    Rewind();
+}
+
+void CScenario::Rewind()
+{
+    m_uiNextEvent = 0;
+    m_dLastTime = 0.0;
+}
+
+bool CScenario::Load(const std::string &a_rcsFilename)
+{
+    Clear();
+
+    std::ifstream input(a_rcsFilename.c_str());
+    if(!input)
+    {
+        printf("[Warning] CScenario::Load, can not open %s.\n", a_rcsFilename.c_str());
+        return false;
+    }
+
+    // a script that does not read as written would replay something else, so it is all or nothing
+    std::string sLine;
+    for(int iLine = 1 ; std::getline(input, sLine) ; iLine++)
+    {
+        if(!Parse(sLine, iLine))
+        {
+            printf("[Warning] CScenario::Load, %s line %d can not be read: %s\n", a_rcsFilename.c_str(), iLine, sLine.c_str());
+            Clear();
+            return false;
+        }
+    }
+
+    std::stable_sort(m_Events.begin(), m_Events.end(), [](const Event &a_rcA, const Event &a_rcB)
+    {
+        return a_rcA.dTime < a_rcB.dTime;
+    });
+    if(m_dEndTime <= 0.0)
+    {
+        // one second past the last event
+        m_dEndTime = (m_Events.empty() ? 0.0 : m_Events.back().dTime) + 1.0;
+    }
+    m_sFilename = a_rcsFilename;
+    return true;
+}
+
+bool CScenario::Parse(const std::string &a_rcsLine, const int a_ciLineNum)
+{
+    std::istringstream line(a_rcsLine.substr(0, a_rcsLine.find('#')));
+    std::string sFirst;
+    if(!(line >> sFirst))
+    {
+        return true;                    // blank or comment
+    }
+
+    if(sFirst == "seed")
+    {
+        long lSeed;
+        m_bSeed = (line >> lSeed) && lSeed >= 0;
+        m_uiSeed = (unsigned int)lSeed;
+        return m_bSeed;
+    }
+    if(sFirst == "end")
+    {
+        return (line >> m_dEndTime) && m_dEndTime > 0.0;
+    }
+
+    Event event;
+    event.dMass = 1.0;
+    event.dValue = 0.0;
+    std::istringstream time(sFirst);
+    std::string sCommand;
+    if(!(time >> event.dTime) || event.dTime < 0.0 || !(line >> sCommand))
+    {
+        return false;
+    }
+
+    if(sCommand == "throw")
+    {
+        std::string sRandom;
+        std::streampos start = line.tellg();
+        if((line >> sRandom) && sRandom == "random")
+        {
+            event.nType = Event_nThrowRandom;
+        }
+        else
+        {
+            line.clear();
+            line.seekg(start);
+            event.nType = Event_nThrow;
+            if(!(line >> event.position.x >> event.position.y >> event.position.z
+                     >> event.velocity.x >> event.velocity.y >> event.velocity.z))
+            {
+                return false;
+            }
+            if(!(line >> event.dMass))
+            {
+                event.dMass = 1.0;      // the mass is optional
+            }
+            if(event.dMass <= 0.0)
+            {
+                return false;
+            }
+        }
+    }
+    else if(sCommand == "set")
+    {
+        event.nType = Event_nSet;
+        if(!(line >> event.sName >> event.dValue))
+        {
+            return false;
+        }
+        bool bKnown = false;
+        for(int iP = 0 ; iP<s_ciParamNum && !bKnown ; iP++)
+        {
+            bKnown = (event.sName == s_pcParamName[iP]);
+        }
+        if(!bKnown)
+        {
+            printf("[Warning] CScenario::Parse, unknown parameter %s on line %d.\n", event.sName.c_str(), a_ciLineNum);
+            return false;
+        }
+    }
+    else if(sCommand == "pause")
+    {
+        event.nType = Event_nPause;
+    }
+    else
+    {
+        return false;
+    }
+    m_Events.push_back(event);
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Play                                    //
+////////////////////////////////////////////////////////////////////////////////
+void CScenario::Step(CMassSpringSystem &a_rSystem)
+{
+    if(!a_rSystem.IsSimulation())
+    {
+        return;
+    }
+
+    // only a reset puts the sim time back to 0, the script starts over with it
+    if(a_rSystem.GetSimTime() == 0.0)
+    {
+        if(m_dLastTime > 0.0)
+        {
+            Rewind();
+        }
+        if(m_uiNextEvent == 0)
+        {
+            if(m_bCaptured)
+            {
+                Restore(a_rSystem);
+            }
+            else
+            {
+                Capture(a_rSystem);
+            }
+            if(m_bSeed)
+            {
+                a_rSystem.SetSeed(m_uiSeed);
+            }
+        }
+    }
+
+    // due within half a step, so an event at a multiple of dt does not slip by rounding
+    const double cdDue = a_rSystem.GetSimTime() + 0.5*a_rSystem.GetDeltaT();
+    while(m_uiNextEvent < m_Events.size() && m_Events[m_uiNextEvent].dTime <= cdDue)
+    {
+        Apply(a_rSystem, m_Events[m_uiNextEvent++]);
+        if(!a_rSystem.IsSimulation())
+        {
+            return;                     // paused, the rest waits for the next start
+        }
+    }
+
+    a_rSystem.SimulationOneTimeStep();
+    m_dLastTime = a_rSystem.GetSimTime();
+}
+
+void CScenario::Apply(CMassSpringSystem &a_rSystem, const Event &a_rcEvent)
+{
+    if(a_rcEvent.nType == Event_nThrow)
+    {
+        a_rSystem.CreateBall(a_rcEvent.position, a_rcEvent.velocity, a_rcEvent.dMass);
+    }
+    else if(a_rcEvent.nType == Event_nThrowRandom)
+    {
+        a_rSystem.CreateBall();
+    }
+    else if(a_rcEvent.nType == Event_nPause)
+    {
+        a_rSystem.SetPauseSimulation();
+    }
+    else
+    {
+        const std::string &rcsName = a_rcEvent.sName;
+        const double cdValue = a_rcEvent.dValue;
+        if(rcsName == "SpringCoef")
+        {
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nStruct);
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nShear);
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nBending);
+        }
+        else if(rcsName == "SpringCoefStruct")
+        {
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nStruct);
+        }
+        else if(rcsName == "SpringCoefShear")
+        {
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nShear);
+        }
+        else if(rcsName == "SpringCoefBending")
+        {
+            a_rSystem.SetSpringCoef(cdValue, CSpring::Type_nBending);
+        }
+        else if(rcsName == "DamperCoef")
+        {
+            a_rSystem.SetDamperCoef(cdValue, CSpring::Type_nStruct);
+            a_rSystem.SetDamperCoef(cdValue, CSpring::Type_nShear);
+            a_rSystem.SetDamperCoef(cdValue, CSpring::Type_nBending);
+        }
+        else if(rcsName == "DeltaT")
+        {
+            a_rSystem.SetDeltaT(cdValue);
+        }
+        else if(rcsName == "IntegratorType")
+        {
+            a_rSystem.SetIntegratorType((int)cdValue);
+        }
+        else if(rcsName == "StrainLimit")
+        {
+            a_rSystem.SetStrainLimit(cdValue/100.0);    // in percent like the configuration
+        }
+        else if(rcsName == "TearStrain")
+        {
+            a_rSystem.SetTearStrain(cdValue/100.0);
+        }
+        else if(rcsName == "ProjectiveIterations")
+        {
+            a_rSystem.SetProjectiveIterations((int)cdValue);
+        }
+        else if(rcsName == "DomainNum")
+        {
+            a_rSystem.SetDomainNum((int)cdValue);
+        }
+        else if(rcsName == "Emitter")
+        {
+            a_rSystem.SetEmitterEnable(cdValue != 0.0);
+        }
+        else if(rcsName == "Character")
+        {
+            a_rSystem.SetCharacterEnable(cdValue != 0.0);
+        }
+        else if(rcsName == "AutoRecover")
+        {
+            a_rSystem.SetAutoRecover(cdValue != 0.0);
+        }
+    }
+}
+
+void CScenario::Capture(CMassSpringSystem &a_rSystem)
+{
+    m_Settings.dSpringCoef[0] = a_rSystem.GetSpringCoef(CSpring::Type_nStruct);
+    m_Settings.dSpringCoef[1] = a_rSystem.GetSpringCoef(CSpring::Type_nShear);
+    m_Settings.dSpringCoef[2] = a_rSystem.GetSpringCoef(CSpring::Type_nBending);
+    m_Settings.dDamperCoef[0] = a_rSystem.GetDamperCoef(CSpring::Type_nStruct);
+    m_Settings.dDamperCoef[1] = a_rSystem.GetDamperCoef(CSpring::Type_nShear);
+    m_Settings.dDamperCoef[2] = a_rSystem.GetDamperCoef(CSpring::Type_nBending);
+    m_Settings.dDeltaT = a_rSystem.GetDeltaT();
+    m_Settings.iIntegratorType = a_rSystem.GetIntegratorType();
+    m_Settings.dStrainLimit = a_rSystem.GetStrainLimit();
+    m_Settings.dTearStrain = a_rSystem.GetTearStrain();
+    m_Settings.iProjectiveIterations = a_rSystem.GetProjectiveIterations();
+    m_Settings.iDomainNum = a_rSystem.GetDomainNum();
+    m_Settings.bEmitter = a_rSystem.IsEmitterEnable();
+    m_Settings.bCharacter = a_rSystem.IsCharacterEnable();
+    m_Settings.bAutoRecover = a_rSystem.IsAutoRecover();
+    m_bCaptured = true;
+}
+
+void CScenario::Restore(CMassSpringSystem &a_rSystem)
+{
+    // only what differs, the coefficient setters make the solvers rebuild
+    const CSpring::enType_t cType[3] = {CSpring::Type_nStruct, CSpring::Type_nShear, CSpring::Type_nBending};
+    for(int iT = 0 ; iT<3 ; iT++)
+    {
+        if(a_rSystem.GetSpringCoef(cType[iT]) != m_Settings.dSpringCoef[iT])
+        {
+            a_rSystem.SetSpringCoef(m_Settings.dSpringCoef[iT], cType[iT]);
+        }
+        if(a_rSystem.GetDamperCoef(cType[iT]) != m_Settings.dDamperCoef[iT])
+        {
+            a_rSystem.SetDamperCoef(m_Settings.dDamperCoef[iT], cType[iT]);
+        }
+    }
+    a_rSystem.SetDeltaT(m_Settings.dDeltaT);
+    a_rSystem.SetIntegratorType(m_Settings.iIntegratorType);
+    a_rSystem.SetStrainLimit(m_Settings.dStrainLimit);
+    a_rSystem.SetTearStrain(m_Settings.dTearStrain);
+    a_rSystem.SetProjectiveIterations(m_Settings.iProjectiveIterations);
+    if(a_rSystem.GetDomainNum() != m_Settings.iDomainNum)
+    {
+        a_rSystem.SetDomainNum(m_Settings.iDomainNum);
+    }
+    a_rSystem.SetEmitterEnable(m_Settings.bEmitter);
+    a_rSystem.SetCharacterEnable(m_Settings.bCharacter);
+    a_rSystem.SetAutoRecover(m_Settings.bAutoRecover);
+}
+
+void CScenario::Replay(CMassSpringSystem &a_rSystem)
+{
+    a_rSystem.SetPauseSimulation();
+    a_rSystem.Reset();
+    Rewind();
+    a_rSystem.SetStartSimulation();
+
+    PerformanceCounter counter;
+    int iStepNum = 0;
+    int iPauseNum = 0;
+    counter.StartCounter();
+    while(a_rSystem.GetSimTime() < m_dEndTime - 0.5*a_rSystem.GetDeltaT())
+    {
+        Step(a_rSystem);
+        if(a_rSystem.IsSimulation())
+        {
+            ++iStepNum;
+        }
+        else
+        {
+            ++iPauseNum;
+            a_rSystem.SetStartSimulation();
+        }
+    }
+    counter.StopCounter();
+
+    double dWall = counter.GetElapsedTime();
+    printf("[Scenario] %s: %d steps to %.4f s, %d pauses passed over, %d recoveries\n",
+        m_sFilename.c_str(), iStepNum, a_rSystem.GetSimTime(), iPauseNum, a_rSystem.RecoveryNum());
+    printf("[Scenario] %.3f s wall, %.4f ms/step, checksum %.17g\n",
+        dWall, (iStepNum > 0) ? 1000.0*dWall/iStepNum : 0.0, Checksum(a_rSystem));
+}
+
+double CScenario::Checksum(CMassSpringSystem &a_rSystem)
+{
+    // weighted per axis, so a mirrored state does not sum to the same
+    double dSum = 0.0;
+    GoalNet &rGoalNet = a_rSystem.GetGoalNet();
+    for(int iP = 0 ; iP<rGoalNet.ParticleNum() ; iP++)
+    {
+        Vector3d pos = rGoalNet.GetParticle(iP).GetPosition();
+        dSum += pos.x + 2.0*pos.y + 3.0*pos.z;
+    }
+    for(int iB = 0 ; iB<a_rSystem.BallNum() ; iB++)
+    {
+        Vector3d pos = a_rSystem.GetBall(iB).GetPosition();
+        dSum += pos.x + 2.0*pos.y + 3.0*pos.z;
+    }
+    return dSum;
+}
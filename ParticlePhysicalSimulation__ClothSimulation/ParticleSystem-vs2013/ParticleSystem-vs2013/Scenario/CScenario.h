@@ -0,0 +1,99 @@
+#ifndef CSCENARIO_H
+#define CSCENARIO_H
+
+#include <vector>
+#include <string>
+#include "Vector3d.h"
+#include "CMassSpringSystem.h"
+
+/*
+ * Timed script of what would otherwise come from the GUI: ball throws,
+ * parameter changes and pauses. One line per event, the simulated second
+ * it fires at first, '#' starts a comment:
+ *
+ *   seed 7                                     random seed of the system
+ *   end 4.0                                    length of a headless run
+ *   0.5 throw 7.0 1.6 0.0 -49.0 -7.0 0.0 1.0   position, velocity, optional mass
+ *   0.8 throw random                           the random throw of the Throw button
+ *   1.0 set SpringCoef 3000                    see Apply() for the names
+ *   2.0 pause
+ *
+ * The script advances the system itself, an event fires right before the
+ * first step that starts within half a step of its time, so the GUI and a
+ * headless run replay the same steps with the same events. The parameters
+ * the script changes are put back when it starts over after a reset.
+ */
+class CScenario
+{
+    public:
+        CScenario();
+
+        bool Load(const std::string &a_rcsFilename);
+        void Clear();
+        void Rewind();                  // back to the first event, the system is reset by the caller
+
+        inline bool IsEmpty() const { return m_Events.empty() && !m_bSeed; }
+        inline double GetEndTime() const { return m_dEndTime; }
+        inline const std::string &GetFilename() const { return m_sFilename; }
+
+        // fires the due events and steps the system once, nothing while it is paused
+        void Step(CMassSpringSystem &a_rSystem);
+
+        // resets the system and plays the script to its end without a window,
+        // pauses are passed over, prints the cost and a checksum of the state
+        void Replay(CMassSpringSystem &a_rSystem);
+        static double Checksum(CMassSpringSystem &a_rSystem);
+
+    private:
+        typedef enum
+        {
+            Event_nThrow = 0,
+            Event_nThrowRandom,
+            Event_nSet,
+            Event_nPause
+        } enEvent_t;
+
+        // everything a script can set, and the time step a recovery halves
+        struct Settings
+        {
+            double dSpringCoef[3];      // per spring type
+            double dDamperCoef[3];
+            double dDeltaT;
+            int iIntegratorType;
+            double dStrainLimit;
+            double dTearStrain;
+            int iProjectiveIterations;
+            int iDomainNum;
+            bool bEmitter;
+            bool bCharacter;
+            bool bAutoRecover;
+        };
+
+        struct Event
+        {
+            double dTime;
+            enEvent_t nType;
+            Vector3d position;
+            Vector3d velocity;
+            double dMass;
+            std::string sName;          // of the parameter
+            double dValue;
+        };
+
+        bool Parse(const std::string &a_rcsLine, const int a_ciLineNum);
+        void Apply(CMassSpringSystem &a_rSystem, const Event &a_rcEvent);
+        void Capture(CMassSpringSystem &a_rSystem);
+        void Restore(CMassSpringSystem &a_rSystem);
+
+        std::string m_sFilename;
+        std::vector<Event> m_Events;    // sorted by time, stable for the same time
+        size_t m_uiNextEvent;
+        bool m_bSeed;
+        unsigned int m_uiSeed;
+        double m_dEndTime;
+        double m_dLastTime;             // sim time after the last step, to notice a reset
+        bool m_bCaptured;
+        Settings m_Settings;            // of the system before the first event, a replay starts from them again
+};
+
+#endif
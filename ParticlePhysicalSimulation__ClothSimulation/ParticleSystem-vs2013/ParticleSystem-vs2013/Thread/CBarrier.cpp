@@ -0,0 +1,25 @@
+#include "CBarrier.h"
+
+CBarrier::CBarrier(const int a_ciThreadNum)
+    :m_iThreadNum((a_ciThreadNum > 0) ? a_ciThreadNum : 1),
+    m_iWaitNum(0),
+    m_uiGeneration(0)
+{
+}
+
+void CBarrier::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    unsigned int uiGeneration = m_uiGeneration;
+    if(++m_iWaitNum == m_iThreadNum)
+    {
+        m_iWaitNum = 0;
+        ++m_uiGeneration;
+        m_Condition.notify_all();
+        return;
+    }
+    while(uiGeneration == m_uiGeneration)
+    {
+        m_Condition.wait(lock);
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef CBARRIER_H
+#define CBARRIER_H
+
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Reusable barrier for a fixed number of threads: Wait() returns once all
+ * of them have called it, then the barrier is ready for the next round.
+ */
+class CBarrier
+{
+    public:
+        explicit CBarrier(const int a_ciThreadNum);
+
+        void Wait();
+        inline int GetThreadNum() const { return m_iThreadNum; }
+
+    private:
+        CBarrier(const CBarrier &);
+        CBarrier &operator=(const CBarrier &);
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        int m_iThreadNum;
+        int m_iWaitNum;
+        unsigned int m_uiGeneration;    // tells a new round from a spurious wake up
+};
+
+#endif
@@ -0,0 +1,79 @@
+#include <thread>
+#include "CThreadAffinity.h"
+
+#if (defined __unix__) || (defined __APPLE__)
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+int CThreadAffinity::ProcessorNum()
+{
+    int iNum = (int)std::thread::hardware_concurrency();
+    return (iNum > 0) ? iNum : 1;
+}
+
+int CThreadAffinity::NodeOfProcessor(const int a_ciProcessor)
+{
+#ifdef __linux__
+    // sysfs links every cpu to its node directory
+    char acPath[128];
+    for(int iNode = 0 ; iNode<64 ; iNode++)
+    {
+        sprintf(acPath, "/sys/devices/system/cpu/cpu%d/node%d", a_ciProcessor, iNode);
+        if(access(acPath, F_OK) == 0)
+        {
+            return iNode;
+        }
+    }
+#endif
+    return 0;
+}
+
+bool CThreadAffinity::PinCurrentThread(const int a_ciProcessor)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(a_ciProcessor, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+#else
+
+#define NOMINMAX
+#include <windows.h>
+
+int CThreadAffinity::ProcessorNum()
+{
+    int iNum = (int)std::thread::hardware_concurrency();
+    return (iNum > 0) ? iNum : 1;
+}
+
+int CThreadAffinity::NodeOfProcessor(const int a_ciProcessor)
+{
+    UCHAR ucNode = 0;
+    if(a_ciProcessor < 64 && GetNumaProcessorNode((UCHAR)a_ciProcessor, &ucNode) && ucNode != 0xFF)
+    {
+        return (int)ucNode;
+    }
+    return 0;
+}
+
+bool CThreadAffinity::PinCurrentThread(const int a_ciProcessor)
+{
+    // one processor group only, that is up to 64 processors
+    if(a_ciProcessor >= (int)(sizeof(DWORD_PTR)*8))
+    {
+        return false;
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << a_ciProcessor) != 0;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CTHREADAFFINITY_H
+#define CTHREADAFFINITY_H
+
+/*
+ * Processors and NUMA nodes of the machine, and pinning of the calling
+ * thread to one processor. Where the platform has no such call every
+ * processor is on node 0 and pinning does nothing.
+ */
+class CThreadAffinity
+{
+    public:
+        static int ProcessorNum();
+        static int NodeOfProcessor(const int a_ciProcessor);
+        static bool PinCurrentThread(const int a_ciProcessor);   // false if the thread could not be pinned
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include <atomic>
+#include <memory>
+#include "CThreadPool.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                               Range Task State                             //
+////////////////////////////////////////////////////////////////////////////////
+namespace
+{
+    // shared by the caller and the helpers of one ParallelFor, helpers which
+    // start after the range is finished only see an exhausted counter
+    struct RangeState
+    {
+        std::atomic<int> iNextChunk;
+        std::atomic<int> iDoneChunk;
+        int iBegin;
+        int iEnd;
+        int iChunkSize;
+        int iChunkNum;
+        CThreadPool::RangeTask_t Task;
+        std::mutex Mutex;
+        std::condition_variable Done;
+    };
+
+    void RunChunks(RangeState &a_rState)
+    {
+        for(;;)
+        {
+            int iChunk = a_rState.iNextChunk.fetch_add(1);
+            if(iChunk >= a_rState.iChunkNum)
+            {
+                return;
+            }
+            int iBegin = a_rState.iBegin + iChunk*a_rState.iChunkSize;
+            int iEnd = iBegin + a_rState.iChunkSize;
+            if(iEnd > a_rState.iEnd)
+            {
+                iEnd = a_rState.iEnd;
+            }
+            a_rState.Task(iBegin, iEnd);
+
+            if(a_rState.iDoneChunk.fetch_add(1) + 1 == a_rState.iChunkNum)
+            {
+                std::lock_guard<std::mutex> lock(a_rState.Mutex);
+                a_rState.Done.notify_all();
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                 Constructor                                //
+////////////////////////////////////////////////////////////////////////////////
+CThreadPool::CThreadPool(const int a_ciThreadNum)
+    :m_iBusyNum(0),
+    m_bStop(false)
+{
+    int iThreadNum = a_ciThreadNum;
+    if(iThreadNum <= 0)
+    {
+        iThreadNum = (int)std::thread::hardware_concurrency() - 1;
+    }
+    if(iThreadNum < 1)
+    {
+        iThreadNum = 1;
+    }
+
+    m_Workers.reserve(iThreadNum);
+    for(int iI = 0 ; iI<iThreadNum ; iI++)
+    {
+        m_Workers.push_back(std::thread(&CThreadPool::WorkerLoop, this));
+    }
+}
+
+CThreadPool::~CThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bStop = true;
+    }
+    m_TaskCondition.notify_all();
+    for(size_t uiI = 0 ; uiI<m_Workers.size() ; uiI++)
+    {
+        m_Workers[uiI].join();
+    }
+}
+
+CThreadPool &CThreadPool::Instance()
+{
+    static CThreadPool s_Pool;
+    return s_Pool;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                    Tasks                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CThreadPool::Enqueue(const Task_t &a_rcTask)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Tasks.push_back(a_rcTask);
+    }
+    m_TaskCondition.notify_one();
+}
+
+void CThreadPool::WaitAll()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while(!m_Tasks.empty() || m_iBusyNum > 0)
+    {
+        m_IdleCondition.wait(lock);
+    }
+}
+
+void CThreadPool::ParallelFor(const int a_ciBegin, const int a_ciEnd, const RangeTask_t &a_rcTask, const int a_ciMinChunk)
+{
+    int iCount = a_ciEnd - a_ciBegin;
+    if(iCount <= 0)
+    {
+        return;
+    }
+
+    int iMinChunk = (a_ciMinChunk > 0) ? a_ciMinChunk : 1;
+    int iThreadNum = GetThreadNum() + 1;
+    // a few chunks per thread so an uneven chunk does not stall the others
+    int iChunkSize = (iCount + iThreadNum*4 - 1) / (iThreadNum*4);
+    if(iChunkSize < iMinChunk)
+    {
+        iChunkSize = iMinChunk;
+    }
+    int iChunkNum = (iCount + iChunkSize - 1) / iChunkSize;
+    if(iChunkNum == 1)
+    {
+        a_rcTask(a_ciBegin, a_ciEnd);
+        return;
+    }
+
+    std::shared_ptr<RangeState> pState(new RangeState());
+    pState->iNextChunk = 0;
+    pState->iDoneChunk = 0;
+    pState->iBegin = a_ciBegin;
+    pState->iEnd = a_ciEnd;
+    pState->iChunkSize = iChunkSize;
+    pState->iChunkNum = iChunkNum;
+    pState->Task = a_rcTask;
+
+    int iHelperNum = iChunkNum - 1;
+    if(iHelperNum > GetThreadNum())
+    {
+        iHelperNum = GetThreadNum();
+    }
+    for(int iI = 0 ; iI<iHelperNum ; iI++)
+    {
+        Enqueue([pState](){ RunChunks(*pState); });
+    }
+
+    RunChunks(*pState);
+
+    std::unique_lock<std::mutex> lock(pState->Mutex);
+    while(pState->iDoneChunk.load() < iChunkNum)
+    {
+        pState->Done.wait(lock);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                   Worker                                   //
+////////////////////////////////////////////////////////////////////////////////
+void CThreadPool::WorkerLoop()
+{
+    for(;;)
+    {
+        Task_t task;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            while(!m_bStop && m_Tasks.empty())
+            {
+                m_TaskCondition.wait(lock);
+            }
+            if(m_Tasks.empty())
+            {
+                return;
+            }
+            task = m_Tasks.front();
+            m_Tasks.pop_front();
+            ++m_iBusyNum;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_iBusyNum;
+            if(m_Tasks.empty() && m_iBusyNum == 0)
+            {
+                m_IdleCondition.notify_all();
+            }
+        }
+    }
+}
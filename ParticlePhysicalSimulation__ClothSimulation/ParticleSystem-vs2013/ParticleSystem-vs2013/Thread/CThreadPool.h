@@ -0,0 +1,50 @@
+#ifndef CTHREADPOOL_H
+#define CTHREADPOOL_H
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Fixed set of worker threads fed from one FIFO queue.
+ * Enqueue() is fire-and-forget, WaitAll() blocks until the queue is drained,
+ * ParallelFor() splits [begin,end) into chunks and returns when every chunk
+ * is done (the calling thread works on chunks too).
+ */
+class CThreadPool
+{
+    public:
+        typedef std::function<void()> Task_t;
+        typedef std::function<void(int,int)> RangeTask_t;    // [begin,end)
+
+        explicit CThreadPool(const int a_ciThreadNum = 0);   // 0: one less than the hardware threads
+        ~CThreadPool();
+
+        void Enqueue(const Task_t &a_rcTask);
+        void WaitAll();
+        void ParallelFor(const int a_ciBegin, const int a_ciEnd, const RangeTask_t &a_rcTask, const int a_ciMinChunk = 64);
+
+        inline int GetThreadNum() const { return (int)m_Workers.size(); }
+
+        // shared pool of the application, the first call must come from the main thread
+        static CThreadPool &Instance();
+
+    private:
+        CThreadPool(const CThreadPool &);
+        CThreadPool &operator=(const CThreadPool &);
+
+        void WorkerLoop();
+
+        std::vector<std::thread> m_Workers;
+        std::deque<Task_t> m_Tasks;
+        std::mutex m_Mutex;
+        std::condition_variable m_TaskCondition;
+        std::condition_variable m_IdleCondition;
+        int m_iBusyNum;
+        bool m_bStop;
+};
+
+#endif